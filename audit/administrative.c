@@ -52,8 +52,8 @@ static mode_t mode = 0777;
 static struct pollfd fds[1];
 static char adregex[80];
 static const char *auclass = "ad";
-static const char *path = "fileforaudit";
-static const char *successreg = "fileforaudit.*return,success";
+static const char *path;
+static const char *successreg;
 
 
 ATF_TC_WITH_CLEANUP(settimeofday_success);
@@ -336,12 +336,10 @@ ATF_TC_CLEANUP(auditctl_success, tc)
 	/*
 	 * auditctl(2) disables audit log at /var/audit and initiates auditing
 	 * at the configured path. To reset this, we need to stop and start the
-	 * auditd(8) again. Here, we check if auditd(8) was running already
-	 * before the test started. If so, we stop and start it again.
+	 * auditd(8) again. One the test case started itself is already gone,
+	 * so only an auditd(8) that was running before the test is restarted.
 	 */
-	system("service auditd onestop > /dev/null 2>&1");
-	if (!atf_utils_file_exists("started_auditd"))
-		system("service auditd onestart > /dev/null 2>&1");
+	auditd_restart();
 }
 
 
@@ -1396,6 +1394,9 @@ ATF_TC_CLEANUP(swapoff_failure, tc)
 
 ATF_TP_ADD_TCS(tp)
 {
+	path = fixture_name("fileforaudit");
+	successreg = fixture_regex(path, "success");
+
 	ATF_TP_ADD_TC(tp, settimeofday_success);
 	ATF_TP_ADD_TC(tp, settimeofday_failure);
 	ATF_TP_ADD_TC(tp, clock_settime_success);
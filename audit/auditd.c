@@ -0,0 +1,387 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#include <sys/file.h>
+#include <sys/wait.h>
+
+#include <bsm/audit.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "auditd.h"
+
+#define AUDITD_PATH	"/usr/sbin/auditd"
+#define AUDITD_PIDFILE	"/var/run/auditd.pid"
+#define AUDITD_WAIT	10		/* Seconds to start or stop */
+#define LEASE_WAIT	20		/* Seconds for a restart to get its turn */
+
+extern char **environ;
+
+static bool pidfile_running(void);
+static bool pidfile_auditing(void);
+static bool pidfile_start(void);
+static bool pidfile_stop(void);
+
+const struct auditd_backend auditd_pidfile = {
+	.running = pidfile_running,
+	.auditing = pidfile_auditing,
+	.start = pidfile_start,
+	.stop = pidfile_stop,
+};
+
+/*
+ * PID of the running auditd(8) according to its pidfile, or 0 if it is not
+ * running
+ */
+static pid_t
+auditd_pid(void)
+{
+	FILE *pidfile;
+	long pid;
+	int found;
+
+	if ((pidfile = fopen(AUDITD_PIDFILE, "r")) == NULL)
+		return (0);
+	found = fscanf(pidfile, "%ld", &pid);
+	fclose(pidfile);
+	if (found != 1 || pid <= 0)
+		return (0);
+
+	/* The pidfile of a daemon that was killed stays behind */
+	if (kill((pid_t)pid, 0) == -1 && errno == ESRCH)
+		return (0);
+	return ((pid_t)pid);
+}
+
+static bool
+pidfile_running(void)
+{
+	return (auditd_pid() != 0);
+}
+
+/*
+ * auditd(8) switches kernel auditing on once it has opened its trail, which
+ * may well be after it wrote its pidfile
+ */
+static bool
+pidfile_auditing(void)
+{
+	int cond;
+
+	return (auditon(A_GETCOND, &cond, sizeof(cond)) == 0 &&
+	    cond == AUC_AUDITING);
+}
+
+/*
+ * Run auditd(8) without service(8) and its shell, and wait for it to have
+ * put itself in the background and written its pidfile
+ */
+static bool
+pidfile_start(void)
+{
+	struct timespec nap = { 0, 10000000 };
+	char *argv[] = { AUDITD_PATH, NULL };
+	pid_t pid;
+	int i, status;
+
+	if (posix_spawn(&pid, AUDITD_PATH, NULL, NULL, argv, environ) != 0)
+		return (false);
+	if (waitpid(pid, &status, 0) == -1 ||
+	    !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		return (false);
+	for (i = 0; i < AUDITD_WAIT * 100; i++) {
+		if (auditd_pid() != 0)
+			return (true);
+		nanosleep(&nap, NULL);
+	}
+	return (false);
+}
+
+/*
+ * Ask auditd(8) to close its trail and exit, as audit -t would, and wait
+ * for it to be gone so that it can be started again right away
+ */
+static bool
+pidfile_stop(void)
+{
+	struct timespec nap = { 0, 10000000 };
+	pid_t pid;
+	int i;
+
+	if ((pid = auditd_pid()) == 0)
+		return (true);
+	if (kill(pid, SIGTERM) == -1)
+		return (errno == ESRCH);
+	for (i = 0; i < AUDITD_WAIT * 100; i++) {
+		if (kill(pid, 0) == -1 && errno == ESRCH)
+			return (true);
+		nanosleep(&nap, NULL);
+	}
+	return (false);
+}
+
+/*
+ * The lease file, locked for the time it is being updated. It reads
+ * "started 0" or "started 1", then "restart" followed by the PID of the
+ * process waiting to restart auditd(8) or 0, and the PID of every holder
+ * on a line of its own.
+ */
+struct lease {
+	FILE		*stream;
+	bool		 started;	/* auditd(8) is down to the holders */
+	pid_t		 restarter;	/* No lease is granted meanwhile */
+	pid_t		*holders;
+	size_t		 nholders;
+	size_t		 size;
+};
+
+static bool
+lease_add(struct lease *lease, pid_t holder)
+{
+	pid_t *holders;
+	size_t size;
+
+	if (lease->nholders == lease->size) {
+		size = (lease->size == 0) ? 16 : lease->size * 2;
+		holders = realloc(lease->holders, size * sizeof(*holders));
+		if (holders == NULL)
+			return (false);
+		lease->holders = holders;
+		lease->size = size;
+	}
+	lease->holders[lease->nholders++] = holder;
+	return (true);
+}
+
+static void
+lease_remove(struct lease *lease, pid_t holder)
+{
+	size_t i;
+
+	for (i = 0; i < lease->nholders; i++) {
+		if (lease->holders[i] == holder) {
+			lease->holders[i] = lease->holders[--lease->nholders];
+			return;
+		}
+	}
+}
+
+/*
+ * Open and lock the lease file, and read it without the holders that are
+ * gone
+ */
+static bool
+lease_open(struct lease *lease)
+{
+	const char *path;
+	long holder, restarter;
+	int filedesc, started;
+
+	memset(lease, 0, sizeof(*lease));
+	if ((path = getenv("AUDIT_LEASE")) == NULL)
+		path = AUDITD_LEASE;
+	if ((filedesc = open(path, O_RDWR | O_CREAT, 0644)) == -1)
+		return (false);
+	if (flock(filedesc, LOCK_EX) == -1 ||
+	    (lease->stream = fdopen(filedesc, "r+")) == NULL) {
+		close(filedesc);
+		return (false);
+	}
+
+	if (fscanf(lease->stream, "started %d", &started) != 1)
+		return (true);
+	lease->started = (started != 0);
+	if (fscanf(lease->stream, " restart %ld", &restarter) == 1 &&
+	    (kill((pid_t)restarter, 0) == 0 || errno != ESRCH))
+		lease->restarter = (pid_t)restarter;
+	while (fscanf(lease->stream, "%ld", &holder) == 1) {
+		if (holder != LEASE_SUITE && kill((pid_t)holder, 0) == -1 &&
+		    errno == ESRCH)
+			continue;
+		if (!lease_add(lease, (pid_t)holder)) {
+			fclose(lease->stream);
+			return (false);
+		}
+	}
+	return (true);
+}
+
+/*
+ * Write the lease back and unlock it. Returns "ok" unless that fails.
+ */
+static bool
+lease_close(struct lease *lease, bool ok)
+{
+	size_t i;
+
+	rewind(lease->stream);
+	if (ftruncate(fileno(lease->stream), 0) == -1)
+		ok = false;
+	fprintf(lease->stream, "started %d\nrestart %ld\n", lease->started,
+	    (long)lease->restarter);
+	for (i = 0; i < lease->nholders; i++)
+		fprintf(lease->stream, "%ld\n", (long)lease->holders[i]);
+	if (fclose(lease->stream) != 0)
+		ok = false;
+	free(lease->holders);
+	return (ok);
+}
+
+/*
+ * Wait for auditd(8), whether it was just started or found running, to have
+ * switched kernel auditing on. The lease stays locked meanwhile, so that a
+ * program taking a lease after this one waits as well.
+ */
+static bool
+lease_wait_auditing(const struct auditd_backend *backend)
+{
+	struct timespec nap = { 0, 10000000 };
+	int i;
+
+	for (i = 0; i < AUDITD_WAIT * 100; i++) {
+		if (backend->auditing())
+			return (true);
+		nanosleep(&nap, NULL);
+	}
+	return (false);
+}
+
+/*
+ * Make sure auditd(8) runs and audits on behalf of "holder", starting it if
+ * need be. "started" tells whether this call did. Returns false on failure.
+ */
+bool
+lease_acquire(const struct auditd_backend *backend, pid_t holder,
+    bool *started)
+{
+	struct timespec nap = { 0, 10000000 };
+	struct lease lease;
+	bool ok = true;
+	int i;
+
+	*started = false;
+	if (!lease_open(&lease))
+		return (false);
+
+	/* A restart that is waiting for the holders goes first */
+	for (i = 0; lease.restarter != 0 && i < LEASE_WAIT * 100; i++) {
+		if (!lease_close(&lease, true))
+			return (false);
+		nanosleep(&nap, NULL);
+		if (!lease_open(&lease))
+			return (false);
+	}
+	if (lease.restarter != 0)
+		return (lease_close(&lease, false));
+
+	/* An auditd(8) the holders rely on may have been stopped under them */
+	if (!backend->running()) {
+		ok = backend->start();
+		*started = ok;
+		lease.started = lease.started || ok;
+	}
+	if (ok)
+		ok = lease_wait_auditing(backend);
+	if (ok)
+		ok = lease_add(&lease, holder);
+
+	/* Without a holder, nobody would stop the auditd(8) started here */
+	if (!ok && *started && backend->stop()) {
+		*started = false;
+		lease.started = false;
+	}
+	return (lease_close(&lease, ok));
+}
+
+/*
+ * Let go of the lease of "holder". If it was the last one and auditd(8) was
+ * started for the holders, it is stopped. Returns false on failure.
+ */
+bool
+lease_release(const struct auditd_backend *backend, pid_t holder)
+{
+	struct lease lease;
+	bool ok = true;
+
+	if (!lease_open(&lease))
+		return (false);
+	lease_remove(&lease, holder);
+	if (lease.nholders == 0 && lease.started) {
+		ok = backend->stop();
+		lease.started = !ok;
+	}
+	return (lease_close(&lease, ok));
+}
+
+/*
+ * Have whatever auditd(8) runs read audit_control(5) again by stopping and
+ * starting it, once every holder other than LEASE_SUITE has let go. New
+ * leases are held back meanwhile. Returns false on failure.
+ */
+bool
+lease_restart(const struct auditd_backend *backend)
+{
+	struct timespec nap = { 0, 10000000 };
+	struct lease lease;
+	size_t i, others;
+	bool ok = true;
+	int tries;
+
+	for (tries = 0; ; tries++) {
+		if (!lease_open(&lease))
+			return (false);
+		others = 0;
+		for (i = 0; i < lease.nholders; i++) {
+			if (lease.holders[i] != LEASE_SUITE)
+				others++;
+		}
+		if (others == 0)
+			break;
+		if (tries == LEASE_WAIT * 100) {
+			lease.restarter = 0;
+			return (lease_close(&lease, false));
+		}
+		lease.restarter = getpid();
+		if (!lease_close(&lease, true))
+			return (false);
+		nanosleep(&nap, NULL);
+	}
+
+	if (backend->running())
+		ok = backend->stop() && backend->start() &&
+		    lease_wait_auditing(backend);
+	lease.restarter = 0;
+	return (lease_close(&lease, ok));
+}
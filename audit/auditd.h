@@ -0,0 +1,71 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#ifndef _AUDITD_H_
+#define _AUDITD_H_
+
+#include <sys/types.h>
+
+#include <stdbool.h>
+
+/*
+ * Looking up, starting and stopping auditd(8). start() returns once the
+ * daemon is up, stop() once it is gone. auditing() tells whether it has
+ * switched kernel auditing on yet, which it does some time after start().
+ */
+struct auditd_backend {
+	bool	(*running)(void);
+	bool	(*auditing)(void);
+	bool	(*start)(void);
+	bool	(*stop)(void);
+};
+
+/* Through its pidfile, the default */
+extern const struct auditd_backend auditd_pidfile;
+
+/*
+ * A lease file shared by every test program of a run lists the processes
+ * relying on auditd(8), and whether one of them started it. The last one to
+ * let go stops it again. The lease of a process that died without letting
+ * go is dropped by the next one to take or return a lease. A lease is only
+ * granted once kernel auditing is on.
+ *
+ * lease_restart() restarts auditd(8) once every other holder has let go,
+ * holding new leases back meanwhile, so that no test program loses records
+ * to the restart.
+ *
+ * LEASE_SUITE stands for a whole run of the suite, see auditd_lease.c, and
+ * is never dropped that way.
+ */
+#define AUDITD_LEASE	"/var/run/audit_tests.lease"	/* Or AUDIT_LEASE */
+#define LEASE_SUITE	0
+
+bool	lease_acquire(const struct auditd_backend *, pid_t, bool *);
+bool	lease_release(const struct auditd_backend *, pid_t);
+bool	lease_restart(const struct auditd_backend *);
+
+#endif	/* _AUDITD_H_ */
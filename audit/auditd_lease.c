@@ -0,0 +1,73 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * Keeps auditd(8) running across a whole run of the test-suite. Without
+ * it, every test case that finds auditd(8) stopped starts it, waits for its
+ * startup record and stops it again when it is done:
+ *
+ *	/usr/tests/sys/audit/auditd_lease acquire
+ *	kyua test -k /usr/tests/sys/audit/Kyuafile
+ *	/usr/tests/sys/audit/auditd_lease release
+ *
+ * auditd(8) is only stopped by the release if the acquire started it.
+ */
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "auditd.h"
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: auditd_lease acquire | release\n");
+	exit(2);
+}
+
+int
+main(int argc, char *argv[])
+{
+	bool started;
+
+	if (argc != 2)
+		usage();
+
+	if (strcmp(argv[1], "acquire") == 0) {
+		if (!lease_acquire(&auditd_pidfile, LEASE_SUITE, &started))
+			errx(1, "Cannot take a lease on auditd(8)");
+		if (started)
+			printf("Started auditd(8)\n");
+	} else if (strcmp(argv[1], "release") == 0) {
+		if (!lease_release(&auditd_pidfile, LEASE_SUITE))
+			errx(1, "Cannot return the lease on auditd(8)");
+	} else
+		usage();
+	return (0);
+}
@@ -0,0 +1,467 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * Delivery latency benchmark for audit(4). For each audit class used by the
+ * test programs, it repeats the syscall their test cases trigger in a tight
+ * loop and times every record from just before the syscall to its arrival
+ * on auditpipe(4). Then it doubles the burst size until the pipe starts to
+ * drop records, to find the highest delivery rate it sustains.
+ *
+ * With -o, the records of the latency run are saved to a trail, alongside
+ * a "<trail>.lat" file holding, for every record in the trail, two 64 bit
+ * big-endian nanosecond time stamps since the epoch: the start of the
+ * triggering syscall (0 for records of other processes) and the arrival.
+ * trail/bsmlat analyses both files on any host.
+ */
+
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/msg.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include <bsm/libbsm.h>
+#include <security/audit/audit_ioctl.h>
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LAT_MAGIC	"BSMLAT1"	/* Followed by a NUL */
+#define MIN_BURST	1024
+
+static const char *path = "fileforaudit";
+static const char *errpath = "dirdoesnotexist/fileforaudit";
+static mode_t mode = 0777;
+
+/*
+ * The syscall each class is exercised with, as issued by its test cases.
+ * Failure modes are preferred, as they can be repeated without side effects.
+ */
+static void
+trigger_fr(void)
+{
+	close(open(path, O_RDONLY));
+}
+
+static void
+trigger_fw(void)
+{
+	close(open(path, O_WRONLY));
+}
+
+static void
+trigger_fc(void)
+{
+	mkdir(path, mode);
+}
+
+static void
+trigger_fd(void)
+{
+	rmdir(errpath);
+}
+
+static void
+trigger_fm(void)
+{
+	chmod(errpath, mode);
+}
+
+static void
+trigger_fa(void)
+{
+	struct stat sb;
+
+	stat(errpath, &sb);
+}
+
+static void
+trigger_cl(void)
+{
+	close(-1);
+}
+
+static void
+trigger_ex(void)
+{
+	char *const arg[] = { NULL };
+
+	execve(errpath, arg, arg);
+}
+
+static void
+trigger_nt(void)
+{
+	socket(-1, -1, -1);
+}
+
+static void
+trigger_ip(void)
+{
+	msgget((key_t)(-1), 0);
+}
+
+static void
+trigger_pc(void)
+{
+	kill(0, -2);
+}
+
+static void
+trigger_ad(void)
+{
+	setauid(NULL);
+}
+
+static void
+trigger_io(void)
+{
+	ioctl(-1, FIONREAD, NULL);
+}
+
+static void
+trigger_ot(void)
+{
+	audit(NULL, -1);
+}
+
+static const struct {
+	const char	*class;
+	const char	*syscall;
+	void		(*trigger)(void);
+} triggers[] = {
+	{ "fr", "open(2)", trigger_fr },
+	{ "fw", "open(2)", trigger_fw },
+	{ "fc", "mkdir(2)", trigger_fc },
+	{ "fd", "rmdir(2)", trigger_fd },
+	{ "fm", "chmod(2)", trigger_fm },
+	{ "fa", "stat(2)", trigger_fa },
+	{ "cl", "close(2)", trigger_cl },
+	{ "ex", "execve(2)", trigger_ex },
+	{ "nt", "socket(2)", trigger_nt },
+	{ "ip", "msgget(2)", trigger_ip },
+	{ "pc", "kill(2)", trigger_pc },
+	{ "ad", "setauid(2)", trigger_ad },
+	{ "io", "ioctl(2)", trigger_io },
+	{ "ot", "audit(2)", trigger_ot },
+};
+
+/*
+ * State shared with the thread draining the pipe during one run. The
+ * trigger time of syscall i is written before the syscall is issued, and
+ * only read back once its record has arrived.
+ */
+struct run {
+	FILE		*pipestream;
+	long		 count;
+	struct timespec	*started;
+	long		 own;		/* Records of our own syscalls */
+	struct timespec	 last;		/* Arrival of the last of them */
+	FILE		*trail;
+	FILE		*lat;
+};
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: latency_bench [-m max_burst] [-n count] "
+	    "[-o trail] [class ...]\n");
+	exit(1);
+}
+
+static uint64_t
+nanoseconds(const struct timespec *ts)
+{
+	return ((uint64_t)ts->tv_sec * 1000000000 + ts->tv_nsec);
+}
+
+static void
+put_be64(FILE *fp, uint64_t val)
+{
+	unsigned char buf[8];
+	int i;
+
+	for (i = 0; i < 8; i++)
+		buf[i] = val >> (56 - 8 * i);
+	if (fwrite(buf, sizeof(buf), 1, fp) != 1)
+		err(1, "latency file");
+}
+
+/*
+ * Process ID of the subject token of a record, 0 if there is none
+ */
+static pid_t
+record_pid(u_char *buff, int reclen)
+{
+	tokenstr_t token;
+	int bytes = 0;
+
+	while (bytes < reclen) {
+		if (au_fetch_tok(&token, buff + bytes, reclen - bytes) == -1)
+			break;
+		switch (token.id) {
+		case AUT_SUBJECT32:
+			return (token.tt.subj32.pid);
+		case AUT_SUBJECT32_EX:
+			return (token.tt.subj32_ex.pid);
+		case AUT_SUBJECT64:
+			return (token.tt.subj64.pid);
+		case AUT_SUBJECT64_EX:
+			return (token.tt.subj64_ex.pid);
+		}
+		bytes += token.len;
+	}
+	return (0);
+}
+
+/*
+ * Drain the pipe until every syscall of the run has its record, or the
+ * pipe stays silent for a second because the rest was dropped
+ */
+static void *
+drain(void *arg)
+{
+	struct run *run = arg;
+	struct pollfd fds[1];
+	struct timespec arrival;
+	u_char *buff;
+	int reclen;
+	bool own;
+
+	fds[0].fd = fileno(run->pipestream);
+	fds[0].events = POLLIN;
+	while (run->own < run->count) {
+		if (poll(fds, 1, 1000) <= 0)
+			break;
+		if ((reclen = au_read_rec(run->pipestream, &buff)) == -1)
+			break;
+		clock_gettime(CLOCK_REALTIME, &arrival);
+
+		own = (record_pid(buff, reclen) == getpid());
+		if (run->trail != NULL) {
+			if (fwrite(buff, reclen, 1, run->trail) != 1)
+				err(1, "trail");
+			put_be64(run->lat, own ?
+			    nanoseconds(&run->started[run->own]) : 0);
+			put_be64(run->lat, nanoseconds(&arrival));
+		}
+		if (own) {
+			run->own++;
+			run->last = arrival;
+		}
+		free(buff);
+	}
+	return (NULL);
+}
+
+/*
+ * Issue "count" syscalls of trigger "t" while another thread drains the
+ * pipe. Returns the number of records dropped by the pipe meanwhile.
+ */
+static u_int64_t
+run_burst(struct run *run, int filedesc, size_t t)
+{
+	pthread_t reader;
+	u_int64_t drops, after;
+	long i;
+	int error;
+
+	if (ioctl(filedesc, AUDITPIPE_FLUSH) < 0)
+		err(1, "AUDITPIPE_FLUSH");
+	if (ioctl(filedesc, AUDITPIPE_GET_DROPS, &drops) < 0)
+		err(1, "AUDITPIPE_GET_DROPS");
+
+	run->own = 0;
+	if ((error = pthread_create(&reader, NULL, drain, run)) != 0)
+		errc(1, error, "pthread_create");
+	for (i = 0; i < run->count; i++) {
+		clock_gettime(CLOCK_REALTIME, &run->started[i]);
+		triggers[t].trigger();
+	}
+	if ((error = pthread_join(reader, NULL)) != 0)
+		errc(1, error, "pthread_join");
+
+	if (ioctl(filedesc, AUDITPIPE_GET_DROPS, &after) < 0)
+		err(1, "AUDITPIPE_GET_DROPS");
+	return (after - drops);
+}
+
+static void
+select_class(int filedesc, const char *class)
+{
+	au_class_ent_t *ent;
+	au_mask_t fmask;
+
+	if ((ent = getauclassnam(class)) == NULL)
+		errx(1, "unknown audit class: %s", class);
+	fmask.am_success = fmask.am_failure = ent->ac_class;
+	if (ioctl(filedesc, AUDITPIPE_SET_PRESELECT_FLAGS, &fmask) < 0)
+		err(1, "AUDITPIPE_SET_PRESELECT_FLAGS");
+	if (ioctl(filedesc, AUDITPIPE_SET_PRESELECT_NAFLAGS, &fmask) < 0)
+		err(1, "AUDITPIPE_SET_PRESELECT_NAFLAGS");
+}
+
+static void
+bench_class(int filedesc, struct run *run, size_t t, long count,
+    long maxburst)
+{
+	struct timespec start;
+	double rate, best = 0;
+	u_int64_t drops;
+	long burst;
+
+	select_class(filedesc, triggers[t].class);
+
+	run->count = count;
+	drops = run_burst(run, filedesc, t);
+	printf("%-2s %-10s %ld/%ld records, %ju dropped", triggers[t].class,
+	    triggers[t].syscall, run->own, count, (uintmax_t)drops);
+
+	/* The latency run is the only one worth keeping */
+	run->trail = run->lat = NULL;
+	for (burst = MIN_BURST; burst <= maxburst; burst *= 2) {
+		run->count = burst;
+		clock_gettime(CLOCK_REALTIME, &start);
+		drops = run_burst(run, filedesc, t);
+		if (drops > 0 || run->own < burst)
+			break;
+		rate = run->own / ((nanoseconds(&run->last) -
+		    nanoseconds(&start)) / 1e9);
+		if (rate > best)
+			best = rate;
+	}
+	printf(", %.0f records/s sustained", best);
+	if (burst <= maxburst)
+		printf(", drops from %ld", burst);
+	printf("\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct run run;
+	const char *output = NULL;
+	char *latpath = NULL;
+	FILE *trail = NULL, *lat = NULL;
+	long count = 1000, maxburst = 1 << 20;
+	size_t t;
+	int ch, filedesc, i, qlimit, fmode = AUDITPIPE_PRESELECT_MODE_LOCAL;
+
+	while ((ch = getopt(argc, argv, "m:n:o:")) != -1) {
+		switch (ch) {
+		case 'm':
+			if ((maxburst = strtol(optarg, NULL, 10)) < MIN_BURST)
+				usage();
+			break;
+		case 'n':
+			if ((count = strtol(optarg, NULL, 10)) <= 0)
+				usage();
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	memset(&run, 0, sizeof(run));
+	if ((run.started = calloc(count > maxburst ? count : maxburst,
+	    sizeof(*run.started))) == NULL)
+		err(1, "calloc");
+	if (output != NULL) {
+		if (asprintf(&latpath, "%s.lat", output) == -1)
+			err(1, "asprintf");
+		if ((trail = fopen(output, "w")) == NULL)
+			err(1, "%s", output);
+		if ((lat = fopen(latpath, "w")) == NULL)
+			err(1, "%s", latpath);
+		if (fwrite(LAT_MAGIC, sizeof(LAT_MAGIC), 1, lat) != 1)
+			err(1, "%s", latpath);
+		fclose(trail);
+		fclose(lat);
+	}
+
+	/* The triggers run from a scratch directory holding "path" */
+	if ((filedesc = open(path, O_CREAT | O_RDWR, mode)) == -1)
+		err(1, "%s", path);
+	close(filedesc);
+
+	if ((filedesc = open("/dev/auditpipe", O_RDONLY)) == -1)
+		err(1, "/dev/auditpipe");
+	if ((run.pipestream = fdopen(filedesc, "r")) == NULL)
+		err(1, "fdopen");
+	setvbuf(run.pipestream, NULL, _IONBF, 0);
+	if (ioctl(filedesc, AUDITPIPE_SET_PRESELECT_MODE, &fmode) < 0)
+		err(1, "AUDITPIPE_SET_PRESELECT_MODE");
+	if (ioctl(filedesc, AUDITPIPE_GET_QLIMIT_MAX, &qlimit) < 0)
+		err(1, "AUDITPIPE_GET_QLIMIT_MAX");
+	if (ioctl(filedesc, AUDITPIPE_SET_QLIMIT, &qlimit) < 0)
+		err(1, "AUDITPIPE_SET_QLIMIT");
+
+	for (t = 0; t < sizeof(triggers) / sizeof(triggers[0]); t++) {
+		for (i = 0; i < argc; i++) {
+			if (strcmp(argv[i], triggers[t].class) == 0)
+				break;
+		}
+		if (argc > 0 && i == argc)
+			continue;
+
+		/* Each class appends its latency run to the same trail */
+		if (output != NULL) {
+			trail = fopen(output, "a");
+			lat = fopen(latpath, "a");
+			if (trail == NULL || lat == NULL)
+				err(1, "%s", output);
+		}
+		run.trail = trail;
+		run.lat = lat;
+		bench_class(filedesc, &run, t, count, maxburst);
+		if (output != NULL) {
+			fclose(trail);
+			fclose(lat);
+		}
+	}
+
+	fclose(run.pipestream);
+	unlink(path);
+	return (0);
+}
@@ -0,0 +1,148 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * Micro-benchmark for the regex cache in utils.c. Renders the first record
+ * of a trail to the default text form once, then matches it N times both
+ * the way atf_utils_grep_string(3) does (compile, match, free) and with a
+ * handle from get_audit_regex().
+ */
+
+#include <bsm/libbsm.h>
+
+#include <err.h>
+#include <regex.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "utils.h"
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: regex_bench [-n count] trail regex\n");
+	exit(1);
+}
+
+/*
+ * Read the first record of "path" and return it in the default text form
+ */
+static char *
+render_trail(const char *path)
+{
+	tokenstr_t token;
+	u_char *buff;
+	char del[] = ",";
+	char *membuff;
+	size_t size;
+	int reclen, bytes = 0;
+	FILE *trail, *memstream;
+
+	if ((trail = fopen(path, "r")) == NULL)
+		err(1, "%s", path);
+	if ((reclen = au_read_rec(trail, &buff)) == -1)
+		errx(1, "%s: no audit record", path);
+	if ((memstream = open_memstream(&membuff, &size)) == NULL)
+		err(1, "open_memstream");
+
+	while (bytes < reclen) {
+		if (au_fetch_tok(&token, buff + bytes, reclen - bytes) == -1)
+			errx(1, "%s: incomplete audit record", path);
+		au_print_flags_tok(memstream, &token, del, AU_OFLAG_NONE);
+		bytes += token.len;
+	}
+
+	fclose(memstream);
+	fclose(trail);
+	free(buff);
+	return (membuff);
+}
+
+static double
+elapsed(const struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return ((end.tv_sec - start->tv_sec) * 1e9 +
+	    (end.tv_nsec - start->tv_nsec));
+}
+
+int
+main(int argc, char *argv[])
+{
+	const struct audit_regex *rgx;
+	struct timespec start;
+	regex_t preg;
+	char *record;
+	long count = 100000, i, matches;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "n:")) != -1) {
+		switch (ch) {
+		case 'n':
+			if ((count = strtol(optarg, NULL, 10)) <= 0)
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 2)
+		usage();
+
+	record = render_trail(argv[0]);
+
+	/* What check_audit() used to do for every record off the pipe */
+	matches = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < count; i++) {
+		if (regcomp(&preg, argv[1], REG_EXTENDED) != 0)
+			errx(1, "invalid regex: %s", argv[1]);
+		matches += (regexec(&preg, record, 0, NULL, 0) == 0);
+		regfree(&preg);
+	}
+	printf("uncached: %8.1f ns/record (%ld matches)\n",
+	    elapsed(&start) / count, matches);
+
+	/* The handle is looked up per check, as check_audit() does now */
+	matches = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < count; i++) {
+		rgx = get_audit_regex(argv[1]);
+		matches += match_audit_regex(rgx, record);
+	}
+	printf("cached:   %8.1f ns/record (%ld matches)\n",
+	    elapsed(&start) / count, matches);
+
+	free(record);
+	return (0);
+}
@@ -49,10 +49,10 @@ static struct statfs statfsbuff;
 static const char *buff = "ezio";
 static const char *auclass = "fa";
 static const char *name = "authorname";
-static const char *path = "fileforaudit";
-static const char *errpath = "dirdoesnotexist/fileforaudit";
-static const char *successreg = "fileforaudit.*return,success";
-static const char *failurereg = "fileforaudit.*return,failure";
+static const char *path;
+static const char *errpath;
+static const char *successreg;
+static const char *failurereg;
 
 
 ATF_TC_WITH_CLEANUP(stat_success);
@@ -1138,6 +1138,11 @@ ATF_TC_CLEANUP(extattr_list_link_failure, tc)
 
 ATF_TP_ADD_TCS(tp)
 {
+	path = fixture_name("fileforaudit");
+	errpath = fixture_name("dirdoesnotexist/fileforaudit");
+	successreg = fixture_regex(path, "success");
+	failurereg = fixture_regex(path, "failure");
+
 	ATF_TP_ADD_TC(tp, stat_success);
 	ATF_TP_ADD_TC(tp, stat_failure);
 	ATF_TP_ADD_TC(tp, lstat_success);
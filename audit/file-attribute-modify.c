@@ -33,6 +33,7 @@
 #include <sys/time.h>
 
 #include <atf-c.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <stdint.h>
 #include <unistd.h>
@@ -49,823 +50,202 @@ static char extregex[80];
 static const char *buff = "ezio";
 static const char *auclass = "fm";
 static const char *name = "authorname";
-static const char *path = "fileforaudit";
-static const char *errpath = "adirhasnoname/fileforaudit";
-static const char *successreg = "fileforaudit.*return,success";
-static const char *failurereg = "fileforaudit.*return,failure";
+static const char *path;
+static const char *errpath;
 
-
-ATF_TC_WITH_CLEANUP(flock_success);
-ATF_TC_HEAD(flock_success, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of a successful "
-					"flock(2) call");
-}
-
-ATF_TC_BODY(flock_success, tc)
-{
-	pid = getpid();
-	snprintf(extregex, sizeof(extregex), "flock.*%d.*return,success", pid);
-
-	/* File needs to exist to call flock(2) */
-	ATF_REQUIRE((filedesc = open(path, O_CREAT, mode)) != -1);
-	FILE *pipefd = setup(fds, auclass);
-	ATF_REQUIRE_EQ(0, flock(filedesc, LOCK_SH));
-	check_audit(fds, extregex, pipefd);
-	close(filedesc);
-}
-
-ATF_TC_CLEANUP(flock_success, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(flock_failure);
-ATF_TC_HEAD(flock_failure, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of an unsuccessful "
-					"flock(2) call");
-}
-
-ATF_TC_BODY(flock_failure, tc)
-{
-	const char *regex = "flock.*return,failure : Bad file descriptor";
-	FILE *pipefd = setup(fds, auclass);
-	ATF_REQUIRE_EQ(-1, flock(-1, LOCK_SH));
-	check_audit(fds, regex, pipefd);
-}
-
-ATF_TC_CLEANUP(flock_failure, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(fcntl_success);
-ATF_TC_HEAD(fcntl_success, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of a successful "
-					"fcntl(2) call");
-}
-
-ATF_TC_BODY(fcntl_success, tc)
-{
-	int flagstatus;
-	/* File needs to exist to call fcntl(2) */
-	ATF_REQUIRE((filedesc = open(path, O_CREAT, mode)) != -1);
-	FILE *pipefd = setup(fds, auclass);
-
-	/* Retrieve the status flags of 'filedesc' and store it in flagstatus */
-	ATF_REQUIRE((flagstatus = fcntl(filedesc, F_GETFL, 0)) != -1);
-	snprintf(extregex, sizeof(extregex),
-			"fcntl.*return,success,%d", flagstatus);
-	check_audit(fds, extregex, pipefd);
-	close(filedesc);
-}
-
-ATF_TC_CLEANUP(fcntl_success, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(fcntl_failure);
-ATF_TC_HEAD(fcntl_failure, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of an unsuccessful "
-					"fcntl(2) call");
-}
-
-ATF_TC_BODY(fcntl_failure, tc)
-{
-	const char *regex = "fcntl.*return,failure : Bad file descriptor";
-	FILE *pipefd = setup(fds, auclass);
-	ATF_REQUIRE_EQ(-1, fcntl(-1, F_GETFL, 0));
-	check_audit(fds, regex, pipefd);
-}
-
-ATF_TC_CLEANUP(fcntl_failure, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(fsync_success);
-ATF_TC_HEAD(fsync_success, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of a successful "
-					"fsync(2) call");
-}
-
-ATF_TC_BODY(fsync_success, tc)
-{
-	pid = getpid();
-	snprintf(extregex, sizeof(extregex), "fsync.*%d.*return,success", pid);
-
-	/* File needs to exist to call fsync(2) */
-	ATF_REQUIRE((filedesc = open(path, O_CREAT, mode)) != -1);
-	FILE *pipefd = setup(fds, auclass);
-	ATF_REQUIRE_EQ(0, fsync(filedesc));
-	check_audit(fds, extregex, pipefd);
-	close(filedesc);
-}
-
-ATF_TC_CLEANUP(fsync_success, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(fsync_failure);
-ATF_TC_HEAD(fsync_failure, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of an unsuccessful "
-					"fsync(2) call");
-}
-
-ATF_TC_BODY(fsync_failure, tc)
-{
-	const char *regex = "fsync.*return,failure : Bad file descriptor";
-	FILE *pipefd = setup(fds, auclass);
-	/* Failure reason: Invalid file descriptor */
-	ATF_REQUIRE_EQ(-1, fsync(-1));
-	check_audit(fds, regex, pipefd);
-}
-
-ATF_TC_CLEANUP(fsync_failure, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(chmod_success);
-ATF_TC_HEAD(chmod_success, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of a successful "
-					"chmod(2) call");
-}
-
-ATF_TC_BODY(chmod_success, tc)
-{
-	/* File needs to exist to call chmod(2) */
-	ATF_REQUIRE((filedesc = open(path, O_CREAT, mode)) != -1);
-	FILE *pipefd = setup(fds, auclass);
-	ATF_REQUIRE_EQ(0, chmod(path, mode));
-	check_audit(fds, successreg, pipefd);
-	close(filedesc);
-}
-
-ATF_TC_CLEANUP(chmod_success, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(chmod_failure);
-ATF_TC_HEAD(chmod_failure, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of an unsuccessful "
-					"chmod(2) call");
-}
-
-ATF_TC_BODY(chmod_failure, tc)
-{
-	FILE *pipefd = setup(fds, auclass);
-	/* Failure reason: file does not exist */
-	ATF_REQUIRE_EQ(-1, chmod(errpath, mode));
-	check_audit(fds, failurereg, pipefd);
-}
-
-ATF_TC_CLEANUP(chmod_failure, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(fchmod_success);
-ATF_TC_HEAD(fchmod_success, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of a successful "
-					"fchmod(2) call");
-}
-
-ATF_TC_BODY(fchmod_success, tc)
-{
-	pid = getpid();
-	snprintf(extregex, sizeof(extregex), "fchmod.*%d.*return,success", pid);
-
-	/* File needs to exist to call fchmod(2) */
-	ATF_REQUIRE((filedesc = open(path, O_CREAT, mode)) != -1);
-	FILE *pipefd = setup(fds, auclass);
-	ATF_REQUIRE_EQ(0, fchmod(filedesc, mode));
-	check_audit(fds, extregex, pipefd);
-	close(filedesc);
-}
-
-ATF_TC_CLEANUP(fchmod_success, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(fchmod_failure);
-ATF_TC_HEAD(fchmod_failure, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of an unsuccessful "
-					"fchmod(2) call");
-}
-
-ATF_TC_BODY(fchmod_failure, tc)
-{
-	const char *regex = "fchmod.*return,failure : Bad file descriptor";
-	FILE *pipefd = setup(fds, auclass);
-	/* Failure reason: Invalid file descriptor */
-	ATF_REQUIRE_EQ(-1, fchmod(-1, mode));
-	check_audit(fds, regex, pipefd);
-}
-
-ATF_TC_CLEANUP(fchmod_failure, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(lchmod_success);
-ATF_TC_HEAD(lchmod_success, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of a successful "
-					"lchmod(2) call");
-}
-
-ATF_TC_BODY(lchmod_success, tc)
-{
-	/* Symbolic link needs to exist to call lchmod(2) */
-	ATF_REQUIRE_EQ(0, symlink("symlink", path));
-	FILE *pipefd = setup(fds, auclass);
-	ATF_REQUIRE_EQ(0, lchmod(path, mode));
-	check_audit(fds, successreg, pipefd);
-}
-
-ATF_TC_CLEANUP(lchmod_success, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(lchmod_failure);
-ATF_TC_HEAD(lchmod_failure, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of an unsuccessful "
-					"lchmod(2) call");
-}
-
-ATF_TC_BODY(lchmod_failure, tc)
-{
-	FILE *pipefd = setup(fds, auclass);
-	/* Failure reason: file does not exist */
-	ATF_REQUIRE_EQ(-1, lchmod(errpath, mode));
-	check_audit(fds, failurereg, pipefd);
-}
-
-ATF_TC_CLEANUP(lchmod_failure, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(fchmodat_success);
-ATF_TC_HEAD(fchmodat_success, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of a successful "
-					"fchmodat(2) call");
-}
-
-ATF_TC_BODY(fchmodat_success, tc)
-{
-	/* File needs to exist to call fchmodat(2) */
-	ATF_REQUIRE((filedesc = open(path, O_CREAT, mode)) != -1);
-	FILE *pipefd = setup(fds, auclass);
-	ATF_REQUIRE_EQ(0, fchmodat(AT_FDCWD, path, mode, 0));
-	check_audit(fds, successreg, pipefd);
-	close(filedesc);
-}
-
-ATF_TC_CLEANUP(fchmodat_success, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(fchmodat_failure);
-ATF_TC_HEAD(fchmodat_failure, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of an unsuccessful "
-					"fchmodat(2) call");
-}
-
-ATF_TC_BODY(fchmodat_failure, tc)
-{
-	FILE *pipefd = setup(fds, auclass);
-	/* Failure reason: file does not exist */
-	ATF_REQUIRE_EQ(-1, fchmodat(AT_FDCWD, errpath, mode, 0));
-	check_audit(fds, failurereg, pipefd);
-}
-
-ATF_TC_CLEANUP(fchmodat_failure, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(chown_success);
-ATF_TC_HEAD(chown_success, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of a successful "
-					"chown(2) call");
-}
-
-ATF_TC_BODY(chown_success, tc)
-{
-	/* File needs to exist to call chown(2) */
-	ATF_REQUIRE((filedesc = open(path, O_CREAT, mode)) != -1);
-	FILE *pipefd = setup(fds, auclass);
-	ATF_REQUIRE_EQ(0, chown(path, uid, gid));
-	check_audit(fds, successreg, pipefd);
-	close(filedesc);
-}
-
-ATF_TC_CLEANUP(chown_success, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(chown_failure);
-ATF_TC_HEAD(chown_failure, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of an unsuccessful "
-					"chown(2) call");
-}
-
-ATF_TC_BODY(chown_failure, tc)
-{
-	FILE *pipefd = setup(fds, auclass);
-	/* Failure reason: file does not exist */
-	ATF_REQUIRE_EQ(-1, chown(errpath, uid, gid));
-	check_audit(fds, failurereg, pipefd);
-}
-
-ATF_TC_CLEANUP(chown_failure, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(fchown_success);
-ATF_TC_HEAD(fchown_success, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of a successful "
-					"fchown(2) call");
-}
-
-ATF_TC_BODY(fchown_success, tc)
-{
-	pid = getpid();
-	snprintf(extregex, sizeof(extregex), "fchown.*%d.*return,success", pid);
-
-	/* File needs to exist to call fchown(2) */
-	ATF_REQUIRE((filedesc = open(path, O_CREAT, mode)) != -1);
-	FILE *pipefd = setup(fds, auclass);
-	ATF_REQUIRE_EQ(0, fchown(filedesc, uid, gid));
-	check_audit(fds, extregex, pipefd);
-	close(filedesc);
-}
-
-ATF_TC_CLEANUP(fchown_success, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(fchown_failure);
-ATF_TC_HEAD(fchown_failure, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of an unsuccessful "
-					"fchown(2) call");
-}
-
-ATF_TC_BODY(fchown_failure, tc)
-{
-	const char *regex = "fchown.*return,failure : Bad file descriptor";
-	FILE *pipefd = setup(fds, auclass);
-	/* Failure reason: Invalid file descriptor */
-	ATF_REQUIRE_EQ(-1, fchown(-1, uid, gid));
-	check_audit(fds, regex, pipefd);
-}
-
-ATF_TC_CLEANUP(fchown_failure, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(lchown_success);
-ATF_TC_HEAD(lchown_success, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of a successful "
-					"lchown(2) call");
-}
-
-ATF_TC_BODY(lchown_success, tc)
-{
-	/* Symbolic link needs to exist to call lchown(2) */
-	ATF_REQUIRE_EQ(0, symlink("symlink", path));
-	FILE *pipefd = setup(fds, auclass);
-	ATF_REQUIRE_EQ(0, lchown(path, uid, gid));
-	check_audit(fds, successreg, pipefd);
-}
-
-ATF_TC_CLEANUP(lchown_success, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(lchown_failure);
-ATF_TC_HEAD(lchown_failure, tc)
+/*
+ * Calls of the success/failure pairs below, given the row's fixture. The
+ * unsuccessful ones have no fixture: the path does not exist and the file
+ * descriptor is -1.
+ */
+static int
+call_flock(const char *fpath, int fd)
 {
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of an unsuccessful "
-					"lchown(2) call");
+	return (flock(fd, LOCK_SH));
 }
 
-ATF_TC_BODY(lchown_failure, tc)
+static int
+call_fsync(const char *fpath, int fd)
 {
-	FILE *pipefd = setup(fds, auclass);
-	/* Failure reason: Symbolic link does not exist */
-	ATF_REQUIRE_EQ(-1, lchown(errpath, uid, gid));
-	check_audit(fds, failurereg, pipefd);
+	return (fsync(fd));
 }
 
-ATF_TC_CLEANUP(lchown_failure, tc)
+static int
+call_chmod(const char *fpath, int fd)
 {
-	cleanup();
+	return (chmod(fpath, mode));
 }
 
-
-ATF_TC_WITH_CLEANUP(fchownat_success);
-ATF_TC_HEAD(fchownat_success, tc)
+static int
+call_fchmod(const char *fpath, int fd)
 {
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of a successful "
-					"fchownat(2) call");
+	return (fchmod(fd, mode));
 }
 
-ATF_TC_BODY(fchownat_success, tc)
+static int
+call_lchmod(const char *fpath, int fd)
 {
-	/* File needs to exist to call fchownat(2) */
-	ATF_REQUIRE((filedesc = open(path, O_CREAT, mode)) != -1);
-	FILE *pipefd = setup(fds, auclass);
-	ATF_REQUIRE_EQ(0, fchownat(AT_FDCWD, path, uid, gid, 0));
-	check_audit(fds, successreg, pipefd);
-	close(filedesc);
+	return (lchmod(fpath, mode));
 }
 
-ATF_TC_CLEANUP(fchownat_success, tc)
+static int
+call_fchmodat(const char *fpath, int fd)
 {
-	cleanup();
+	return (fchmodat(AT_FDCWD, fpath, mode, 0));
 }
 
-
-ATF_TC_WITH_CLEANUP(fchownat_failure);
-ATF_TC_HEAD(fchownat_failure, tc)
+static int
+call_chown(const char *fpath, int fd)
 {
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of an unsuccessful "
-					"fchownat(2) call");
+	return (chown(fpath, uid, gid));
 }
 
-ATF_TC_BODY(fchownat_failure, tc)
+static int
+call_fchown(const char *fpath, int fd)
 {
-	FILE *pipefd = setup(fds, auclass);
-	/* Failure reason: file does not exist */
-	ATF_REQUIRE_EQ(-1, fchownat(AT_FDCWD, errpath, uid, gid, 0));
-	check_audit(fds, failurereg, pipefd);
+	return (fchown(fd, uid, gid));
 }
 
-ATF_TC_CLEANUP(fchownat_failure, tc)
+static int
+call_lchown(const char *fpath, int fd)
 {
-	cleanup();
+	return (lchown(fpath, uid, gid));
 }
 
-
-ATF_TC_WITH_CLEANUP(chflags_success);
-ATF_TC_HEAD(chflags_success, tc)
+static int
+call_fchownat(const char *fpath, int fd)
 {
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of a successful "
-					"chflags(2) call");
+	return (fchownat(AT_FDCWD, fpath, uid, gid, 0));
 }
 
-ATF_TC_BODY(chflags_success, tc)
+static int
+call_chflags(const char *fpath, int fd)
 {
-	/* File needs to exist to call chflags(2) */
-	ATF_REQUIRE((filedesc = open(path, O_CREAT, mode)) != -1);
-	FILE *pipefd = setup(fds, auclass);
-	ATF_REQUIRE_EQ(0, chflags(path, UF_OFFLINE));
-	check_audit(fds, successreg, pipefd);
-	close(filedesc);
+	return (chflags(fpath, UF_OFFLINE));
 }
 
-ATF_TC_CLEANUP(chflags_success, tc)
+static int
+call_fchflags(const char *fpath, int fd)
 {
-	cleanup();
+	return (fchflags(fd, UF_OFFLINE));
 }
 
-
-ATF_TC_WITH_CLEANUP(chflags_failure);
-ATF_TC_HEAD(chflags_failure, tc)
+static int
+call_lchflags(const char *fpath, int fd)
 {
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of an unsuccessful "
-					"chflags(2) call");
+	return (lchflags(fpath, UF_OFFLINE));
 }
 
-ATF_TC_BODY(chflags_failure, tc)
+static int
+call_utimes(const char *fpath, int fd)
 {
-	FILE *pipefd = setup(fds, auclass);
-	/* Failure reason: file does not exist */
-	ATF_REQUIRE_EQ(-1, chflags(errpath, UF_OFFLINE));
-	check_audit(fds, failurereg, pipefd);
+	return (utimes(fpath, NULL));
 }
 
-ATF_TC_CLEANUP(chflags_failure, tc)
+static int
+call_futimes(const char *fpath, int fd)
 {
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(fchflags_success);
-ATF_TC_HEAD(fchflags_success, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of a successful "
-					"fchflags(2) call");
-}
-
-ATF_TC_BODY(fchflags_success, tc)
-{
-	pid = getpid();
-	snprintf(extregex, sizeof(extregex), "fchflags.*%d.*ret.*success", pid);
-	/* File needs to exist to call fchflags(2) */
-	ATF_REQUIRE((filedesc = open(path, O_CREAT, mode)) != -1);
-
-	FILE *pipefd = setup(fds, auclass);
-	ATF_REQUIRE_EQ(0, fchflags(filedesc, UF_OFFLINE));
-	check_audit(fds, extregex, pipefd);
-	close(filedesc);
-}
-
-ATF_TC_CLEANUP(fchflags_success, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(fchflags_failure);
-ATF_TC_HEAD(fchflags_failure, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of an unsuccessful "
-					"fchflags(2) call");
-}
-
-ATF_TC_BODY(fchflags_failure, tc)
-{
-	const char *regex = "fchflags.*return,failure : Bad file descriptor";
-	FILE *pipefd = setup(fds, auclass);
-	/* Failure reason: Invalid file descriptor */
-	ATF_REQUIRE_EQ(-1, fchflags(-1, UF_OFFLINE));
-	check_audit(fds, regex, pipefd);
-}
-
-ATF_TC_CLEANUP(fchflags_failure, tc)
-{
-	cleanup();
+	return (futimes(fd, NULL));
 }
 
-
-ATF_TC_WITH_CLEANUP(lchflags_success);
-ATF_TC_HEAD(lchflags_success, tc)
+static int
+call_lutimes(const char *fpath, int fd)
 {
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of a successful "
-					"lchflags(2) call");
+	return (lutimes(fpath, NULL));
 }
 
-ATF_TC_BODY(lchflags_success, tc)
+static int
+call_futimesat(const char *fpath, int fd)
 {
-	/* Symbolic link needs to exist to call lchflags(2) */
-	ATF_REQUIRE_EQ(0, symlink("symlink", path));
-	FILE *pipefd = setup(fds, auclass);
-	ATF_REQUIRE_EQ(0, lchflags(path, UF_OFFLINE));
-	check_audit(fds, successreg, pipefd);
+	return (futimesat(AT_FDCWD, fpath, NULL));
 }
 
-ATF_TC_CLEANUP(lchflags_success, tc)
-{
-	cleanup();
-}
+static const struct audit_case cases[] = {
+	AUDIT_CASE_SUCCESS(flock, case_file, false),
+	AUDIT_CASE_FAILURE(flock, NULL, EBADF, false),
+	AUDIT_CASE_SUCCESS(fsync, case_file, false),
+	AUDIT_CASE_FAILURE(fsync, NULL, EBADF, false),
 
+	AUDIT_CASE_SUCCESS(chmod, case_file, true),
+	AUDIT_CASE_FAILURE(chmod, NULL, ENOENT, true),
+	AUDIT_CASE_SUCCESS(fchmod, case_file, false),
+	AUDIT_CASE_FAILURE(fchmod, NULL, EBADF, false),
+	AUDIT_CASE_SUCCESS(lchmod, case_symlink, true),
+	AUDIT_CASE_FAILURE(lchmod, NULL, ENOENT, true),
+	AUDIT_CASE_SUCCESS(fchmodat, case_file, true),
+	AUDIT_CASE_FAILURE(fchmodat, NULL, ENOENT, true),
 
-ATF_TC_WITH_CLEANUP(lchflags_failure);
-ATF_TC_HEAD(lchflags_failure, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of an unsuccessful "
-					"lchflags(2) call");
-}
+	AUDIT_CASE_SUCCESS(chown, case_file, true),
+	AUDIT_CASE_FAILURE(chown, NULL, ENOENT, true),
+	AUDIT_CASE_SUCCESS(fchown, case_file, false),
+	AUDIT_CASE_FAILURE(fchown, NULL, EBADF, false),
+	AUDIT_CASE_SUCCESS(lchown, case_symlink, true),
+	AUDIT_CASE_FAILURE(lchown, NULL, ENOENT, true),
+	AUDIT_CASE_SUCCESS(fchownat, case_file, true),
+	AUDIT_CASE_FAILURE(fchownat, NULL, ENOENT, true),
 
-ATF_TC_BODY(lchflags_failure, tc)
-{
-	FILE *pipefd = setup(fds, auclass);
-	/* Failure reason: Symbolic link does not exist */
-	ATF_REQUIRE_EQ(-1, lchflags(errpath, UF_OFFLINE));
-	check_audit(fds, failurereg, pipefd);
-}
+	AUDIT_CASE_SUCCESS(chflags, case_file, true),
+	AUDIT_CASE_FAILURE(chflags, NULL, ENOENT, true),
+	AUDIT_CASE_SUCCESS(fchflags, case_file, false),
+	AUDIT_CASE_FAILURE(fchflags, NULL, EBADF, false),
+	AUDIT_CASE_SUCCESS(lchflags, case_symlink, true),
+	AUDIT_CASE_FAILURE(lchflags, NULL, ENOENT, true),
 
-ATF_TC_CLEANUP(lchflags_failure, tc)
-{
-	cleanup();
-}
+	AUDIT_CASE_SUCCESS(utimes, case_file, true),
+	AUDIT_CASE_FAILURE(utimes, NULL, ENOENT, true),
+	AUDIT_CASE_SUCCESS(futimes, case_file, false),
+	AUDIT_CASE_FAILURE(futimes, NULL, EBADF, false),
+	AUDIT_CASE_SUCCESS(lutimes, case_symlink, true),
+	AUDIT_CASE_FAILURE(lutimes, NULL, ENOENT, true),
+	AUDIT_CASE_SUCCESS(futimesat, case_file, true),
+	AUDIT_CASE_FAILURE(futimesat, NULL, ENOENT, true),
+};
 
 
-ATF_TC_WITH_CLEANUP(utimes_success);
-ATF_TC_HEAD(utimes_success, tc)
+ATF_TC_WITH_CLEANUP(fcntl_success);
+ATF_TC_HEAD(fcntl_success, tc)
 {
 	atf_tc_set_md_var(tc, "descr", "Tests the audit of a successful "
-					"utimes(2) call");
+					"fcntl(2) call");
 }
 
-ATF_TC_BODY(utimes_success, tc)
+ATF_TC_BODY(fcntl_success, tc)
 {
-	/* File needs to exist to call utimes(2) */
+	int flagstatus;
+	/* File needs to exist to call fcntl(2) */
 	ATF_REQUIRE((filedesc = open(path, O_CREAT, mode)) != -1);
 	FILE *pipefd = setup(fds, auclass);
-	ATF_REQUIRE_EQ(0, utimes(path, NULL));
-	check_audit(fds, successreg, pipefd);
-	close(filedesc);
-}
-
-ATF_TC_CLEANUP(utimes_success, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(utimes_failure);
-ATF_TC_HEAD(utimes_failure, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of an unsuccessful "
-					"utimes(2) call");
-}
-
-ATF_TC_BODY(utimes_failure, tc)
-{
-	FILE *pipefd = setup(fds, auclass);
-	/* Failure reason: file does not exist */
-	ATF_REQUIRE_EQ(-1, utimes(errpath, NULL));
-	check_audit(fds, failurereg, pipefd);
-}
-
-ATF_TC_CLEANUP(utimes_failure, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(futimes_success);
-ATF_TC_HEAD(futimes_success, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of a successful "
-					"futimes(2) call");
-}
 
-ATF_TC_BODY(futimes_success, tc)
-{
-	pid = getpid();
-	snprintf(extregex, sizeof(extregex), "futimes.*%d.*ret.*success", pid);
-
-	/* File needs to exist to call futimes(2) */
-	ATF_REQUIRE((filedesc = open(path, O_CREAT, mode)) != -1);
-	FILE *pipefd = setup(fds, auclass);
-	ATF_REQUIRE_EQ(0, futimes(filedesc, NULL));
+	/* Retrieve the status flags of 'filedesc' and store it in flagstatus */
+	ATF_REQUIRE((flagstatus = fcntl(filedesc, F_GETFL, 0)) != -1);
+	snprintf(extregex, sizeof(extregex),
+			"fcntl.*return,success,%d", flagstatus);
 	check_audit(fds, extregex, pipefd);
 	close(filedesc);
 }
 
-ATF_TC_CLEANUP(futimes_success, tc)
+ATF_TC_CLEANUP(fcntl_success, tc)
 {
 	cleanup();
 }
 
 
-ATF_TC_WITH_CLEANUP(futimes_failure);
-ATF_TC_HEAD(futimes_failure, tc)
+ATF_TC_WITH_CLEANUP(fcntl_failure);
+ATF_TC_HEAD(fcntl_failure, tc)
 {
 	atf_tc_set_md_var(tc, "descr", "Tests the audit of an unsuccessful "
-					"futimes(2) call");
+					"fcntl(2) call");
 }
 
-ATF_TC_BODY(futimes_failure, tc)
+ATF_TC_BODY(fcntl_failure, tc)
 {
-	const char *regex = "futimes.*return,failure : Bad file descriptor";
+	const char *regex = "fcntl.*return,failure : Bad file descriptor";
 	FILE *pipefd = setup(fds, auclass);
-	/* Failure reason: Invalid file descriptor */
-	ATF_REQUIRE_EQ(-1, futimes(-1, NULL));
+	ATF_REQUIRE_EQ(-1, fcntl(-1, F_GETFL, 0));
 	check_audit(fds, regex, pipefd);
 }
 
-ATF_TC_CLEANUP(futimes_failure, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(lutimes_success);
-ATF_TC_HEAD(lutimes_success, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of a successful "
-					"lutimes(2) call");
-}
-
-ATF_TC_BODY(lutimes_success, tc)
-{
-	/* Symbolic link needs to exist to call lutimes(2) */
-	ATF_REQUIRE_EQ(0, symlink("symlink", path));
-	FILE *pipefd = setup(fds, auclass);
-	ATF_REQUIRE_EQ(0, lutimes(path, NULL));
-	check_audit(fds, successreg, pipefd);
-}
-
-ATF_TC_CLEANUP(lutimes_success, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(lutimes_failure);
-ATF_TC_HEAD(lutimes_failure, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of an unsuccessful "
-					"lutimes(2) call");
-}
-
-ATF_TC_BODY(lutimes_failure, tc)
-{
-	FILE *pipefd = setup(fds, auclass);
-	/* Failure reason: symbolic link does not exist */
-	ATF_REQUIRE_EQ(-1, lutimes(errpath, NULL));
-	check_audit(fds, failurereg, pipefd);
-}
-
-ATF_TC_CLEANUP(lutimes_failure, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(futimesat_success);
-ATF_TC_HEAD(futimesat_success, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of a successful "
-					"futimesat(2) call");
-}
-
-ATF_TC_BODY(futimesat_success, tc)
-{
-	/* File needs to exist to call futimesat(2) */
-	ATF_REQUIRE((filedesc = open(path, O_CREAT, mode)) != -1);
-	FILE *pipefd = setup(fds, auclass);
-	ATF_REQUIRE_EQ(0, futimesat(AT_FDCWD, path, NULL));
-	check_audit(fds, successreg, pipefd);
-	close(filedesc);
-}
-
-ATF_TC_CLEANUP(futimesat_success, tc)
-{
-	cleanup();
-}
-
-
-ATF_TC_WITH_CLEANUP(futimesat_failure);
-ATF_TC_HEAD(futimesat_failure, tc)
-{
-	atf_tc_set_md_var(tc, "descr", "Tests the audit of an unsuccessful "
-					"futimesat(2) call");
-}
-
-ATF_TC_BODY(futimesat_failure, tc)
-{
-	FILE *pipefd = setup(fds, auclass);
-	/* Failure reason: file does not exist */
-	ATF_REQUIRE_EQ(-1, futimesat(AT_FDCWD, errpath, NULL));
-	check_audit(fds, failurereg, pipefd);
-}
-
-ATF_TC_CLEANUP(futimesat_failure, tc)
+ATF_TC_CLEANUP(fcntl_failure, tc)
 {
 	cleanup();
 }
@@ -1272,46 +652,12 @@ ATF_TC_CLEANUP(extattr_delete_link_failure, tc)
 
 ATF_TP_ADD_TCS(tp)
 {
-	ATF_TP_ADD_TC(tp, flock_success);
-	ATF_TP_ADD_TC(tp, flock_failure);
+	path = fixture_name("fileforaudit");
+	errpath = fixture_name("adirhasnoname/fileforaudit");
+
+	AUDIT_TP_ADD_CASES(tp, auclass, cases);
 	ATF_TP_ADD_TC(tp, fcntl_success);
 	ATF_TP_ADD_TC(tp, fcntl_failure);
-	ATF_TP_ADD_TC(tp, fsync_success);
-	ATF_TP_ADD_TC(tp, fsync_failure);
-
-	ATF_TP_ADD_TC(tp, chmod_success);
-	ATF_TP_ADD_TC(tp, chmod_failure);
-	ATF_TP_ADD_TC(tp, fchmod_success);
-	ATF_TP_ADD_TC(tp, fchmod_failure);
-	ATF_TP_ADD_TC(tp, lchmod_success);
-	ATF_TP_ADD_TC(tp, lchmod_failure);
-	ATF_TP_ADD_TC(tp, fchmodat_success);
-	ATF_TP_ADD_TC(tp, fchmodat_failure);
-
-	ATF_TP_ADD_TC(tp, chown_success);
-	ATF_TP_ADD_TC(tp, chown_failure);
-	ATF_TP_ADD_TC(tp, fchown_success);
-	ATF_TP_ADD_TC(tp, fchown_failure);
-	ATF_TP_ADD_TC(tp, lchown_success);
-	ATF_TP_ADD_TC(tp, lchown_failure);
-	ATF_TP_ADD_TC(tp, fchownat_success);
-	ATF_TP_ADD_TC(tp, fchownat_failure);
-
-	ATF_TP_ADD_TC(tp, chflags_success);
-	ATF_TP_ADD_TC(tp, chflags_failure);
-	ATF_TP_ADD_TC(tp, fchflags_success);
-	ATF_TP_ADD_TC(tp, fchflags_failure);
-	ATF_TP_ADD_TC(tp, lchflags_success);
-	ATF_TP_ADD_TC(tp, lchflags_failure);
-
-	ATF_TP_ADD_TC(tp, utimes_success);
-	ATF_TP_ADD_TC(tp, utimes_failure);
-	ATF_TP_ADD_TC(tp, futimes_success);
-	ATF_TP_ADD_TC(tp, futimes_failure);
-	ATF_TP_ADD_TC(tp, lutimes_success);
-	ATF_TP_ADD_TC(tp, lutimes_failure);
-	ATF_TP_ADD_TC(tp, futimesat_success);
-	ATF_TP_ADD_TC(tp, futimesat_failure);
 
 	ATF_TP_ADD_TC(tp, mprotect_success);
 	ATF_TP_ADD_TC(tp, mprotect_failure);
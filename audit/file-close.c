@@ -43,9 +43,9 @@ static mode_t mode = 0777;
 static char extregex[80];
 static struct stat statbuff;
 static const char *auclass = "cl";
-static const char *path = "fileforaudit";
-static const char *errpath = "dirdoesnotexist/fileforaudit";
-static const char *failurereg = "fileforaudit.*return,failure";
+static const char *path;
+static const char *errpath;
+static const char *failurereg;
 
 
 ATF_TC_WITH_CLEANUP(munmap_success);
@@ -222,6 +222,10 @@ ATF_TC_CLEANUP(revoke_failure, tc)
 
 ATF_TP_ADD_TCS(tp)
 {
+	path = fixture_name("fileforaudit");
+	errpath = fixture_name("dirdoesnotexist/fileforaudit");
+	failurereg = fixture_regex(path, "failure");
+
 	ATF_TP_ADD_TC(tp, munmap_success);
 	ATF_TP_ADD_TC(tp, munmap_failure);
 
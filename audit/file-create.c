@@ -40,9 +40,9 @@ static mode_t mode = 0777;
 static int filedesc;
 static dev_t dev =  0;
 static const char *auclass = "fc";
-static const char *path = "fileforaudit";
-static const char *successreg = "fileforaudit.*return,success";
-static const char *failurereg = "fileforaudit.*return,failure";
+static const char *path;
+static const char *successreg;
+static const char *failurereg;
 
 
 ATF_TC_WITH_CLEANUP(mkdir_success);
@@ -555,6 +555,10 @@ ATF_TC_CLEANUP(symlinkat_failure, tc)
 
 ATF_TP_ADD_TCS(tp)
 {
+	path = fixture_name("fileforaudit");
+	successreg = fixture_regex(path, "success");
+	failurereg = fixture_regex(path, "failure");
+
 	ATF_TP_ADD_TC(tp, mkdir_success);
 	ATF_TP_ADD_TC(tp, mkdir_failure);
 	ATF_TP_ADD_TC(tp, mkdirat_success);
@@ -36,10 +36,10 @@
 static struct pollfd fds[1];
 static mode_t mode = 0777;
 static int filedesc;
-static const char *path = "fileforaudit";
-static const char *errpath = "dirdoesnotexist/fileforaudit";
-static const char *successreg = "fileforaudit.*return,success";
-static const char *failurereg = "fileforaudit.*return,failure";
+static const char *path;
+static const char *errpath;
+static const char *successreg;
+static const char *failurereg;
 
 
 ATF_TC_WITH_CLEANUP(rmdir_success);
@@ -257,6 +257,11 @@ ATF_TC_CLEANUP(unlinkat_failure, tc)
 
 ATF_TP_ADD_TCS(tp)
 {
+	path = fixture_name("fileforaudit");
+	errpath = fixture_name("dirdoesnotexist/fileforaudit");
+	successreg = fixture_regex(path, "success");
+	failurereg = fixture_regex(path, "failure");
+
 	ATF_TP_ADD_TC(tp, rmdir_success);
 	ATF_TP_ADD_TC(tp, rmdir_failure);
 
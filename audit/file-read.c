@@ -32,9 +32,9 @@
 
 static struct pollfd fds[1];
 static char buff[1024];
-static const char *path = "fileforaudit";
-static const char *successreg = "fileforaudit.*return,success";
-static const char *failurereg = "fileforaudit.*return,failure";
+static const char *path;
+static const char *successreg;
+static const char *failurereg;
 
 
 ATF_TC_WITH_CLEANUP(readlink_success);
@@ -127,6 +127,10 @@ ATF_TC_CLEANUP(readlinkat_failure, tc)
 
 ATF_TP_ADD_TCS(tp)
 {
+	path = fixture_name("fileforaudit");
+	successreg = fixture_regex(path, "success");
+	failurereg = fixture_regex(path, "failure");
+
 	ATF_TP_ADD_TC(tp, readlink_success);
 	ATF_TP_ADD_TC(tp, readlink_failure);
 	ATF_TP_ADD_TC(tp, readlinkat_success);
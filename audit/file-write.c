@@ -34,10 +34,10 @@ static struct pollfd fds[1];
 static mode_t mode = 0777;
 static int filedesc;
 static off_t offlen = 0;
-static const char *path = "fileforaudit";
-static const char *errpath = "dirdoesnotexist/fileforaudit";
-static const char *successreg = "fileforaudit.*return,success";
-static const char *failurereg = "fileforaudit.*return,failure";
+static const char *path;
+static const char *errpath;
+static const char *successreg;
+static const char *failurereg;
 
 
 ATF_TC_WITH_CLEANUP(truncate_success);
@@ -132,6 +132,11 @@ ATF_TC_CLEANUP(ftruncate_failure, tc)
 
 ATF_TP_ADD_TCS(tp)
 {
+	path = fixture_name("fileforaudit");
+	errpath = fixture_name("dirdoesnotexist/fileforaudit");
+	successreg = fixture_regex(path, "success");
+	failurereg = fixture_regex(path, "failure");
+
 	ATF_TP_ADD_TC(tp, truncate_success);
 	ATF_TP_ADD_TC(tp, truncate_failure);
 	ATF_TP_ADD_TC(tp, ftruncate_success);
@@ -35,7 +35,9 @@
 #include <sys/stat.h>
 
 #include <atf-c.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <unistd.h>
 
@@ -57,7 +59,7 @@ static struct shmid_ds shmbuff;
 static struct semid_ds sembuff;
 static char ipcregex[BUFFSIZE];
 static const char *auclass = "ip";
-static char path[BUFFSIZE] = "/fileforaudit";
+static const char *path;
 static unsigned short semvals[BUFFSIZE];
 
 
@@ -97,10 +99,14 @@ ATF_TC_HEAD(msgget_failure, tc)
 
 ATF_TC_BODY(msgget_failure, tc)
 {
-	const char *regex = "msgget.*return,failure.*No such file or directory";
+	struct audit_match match = {
+		.event = "AUE_MSGGET",
+		.status = MATCH_FAILURE,
+		.error = ENOENT,
+	};
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(-1, msgget((key_t)(-1), 0));
-	check_audit(fds, regex, pipefd);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(msgget_failure, tc)
@@ -153,10 +159,14 @@ ATF_TC_HEAD(msgsnd_failure, tc)
 
 ATF_TC_BODY(msgsnd_failure, tc)
 {
-	const char *regex = "msgsnd.*Message IPC.*return,failure : Bad address";
+	struct audit_match match = {
+		.event = "AUE_MSGSND",
+		.status = MATCH_FAILURE,
+		.error = EFAULT,
+	};
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(-1, msgsnd(-1, NULL, 0, IPC_NOWAIT));
-	check_audit(fds, regex, pipefd);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(msgsnd_failure, tc)
@@ -213,10 +223,14 @@ ATF_TC_HEAD(msgrcv_failure, tc)
 
 ATF_TC_BODY(msgrcv_failure, tc)
 {
-	const char *regex = "msgrcv.*return,failure : Invalid argument";
+	struct audit_match match = {
+		.event = "AUE_MSGRCV",
+		.status = MATCH_FAILURE,
+		.error = EINVAL,
+	};
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(-1, msgrcv(-1, NULL, 0, 0, MSG_NOERROR | IPC_NOWAIT));
-	check_audit(fds, regex, pipefd);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(msgrcv_failure, tc)
@@ -260,10 +274,14 @@ ATF_TC_HEAD(msgctl_rmid_failure, tc)
 
 ATF_TC_BODY(msgctl_rmid_failure, tc)
 {
-	const char *regex = "msgctl.*IPC_RMID.*return,failur.*Invalid argument";
+	struct audit_match match = {
+		.event = "AUE_MSGCTL_RMID",
+		.status = MATCH_FAILURE,
+		.error = EINVAL,
+	};
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(-1, msgctl(-1, IPC_RMID, NULL));
-	check_audit(fds, regex, pipefd);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(msgctl_rmid_failure, tc)
@@ -310,10 +328,14 @@ ATF_TC_HEAD(msgctl_stat_failure, tc)
 
 ATF_TC_BODY(msgctl_stat_failure, tc)
 {
-	const char *regex = "msgctl.*IPC_STAT.*return,failur.*Invalid argument";
+	struct audit_match match = {
+		.event = "AUE_MSGCTL_STAT",
+		.status = MATCH_FAILURE,
+		.error = EINVAL,
+	};
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(-1, msgctl(-1, IPC_STAT, &msgbuff));
-	check_audit(fds, regex, pipefd);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(msgctl_stat_failure, tc)
@@ -362,10 +384,14 @@ ATF_TC_HEAD(msgctl_set_failure, tc)
 
 ATF_TC_BODY(msgctl_set_failure, tc)
 {
-	const char *regex = "msgctl.*IPC_SET.*return,failure.*Invalid argument";
+	struct audit_match match = {
+		.event = "AUE_MSGCTL_SET",
+		.status = MATCH_FAILURE,
+		.error = EINVAL,
+	};
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(-1, msgctl(-1, IPC_SET, &msgbuff));
-	check_audit(fds, regex, pipefd);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(msgctl_set_failure, tc)
@@ -436,10 +462,14 @@ ATF_TC_HEAD(shmget_failure, tc)
 
 ATF_TC_BODY(shmget_failure, tc)
 {
-	const char *regex = "shmget.*return,failure.*No such file or directory";
+	struct audit_match match = {
+		.event = "AUE_SHMGET",
+		.status = MATCH_FAILURE,
+		.error = ENOENT,
+	};
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(-1, shmget((key_t)(-1), 0, 0));
-	check_audit(fds, regex, pipefd);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(shmget_failure, tc)
@@ -544,10 +574,14 @@ ATF_TC_HEAD(shmdt_failure, tc)
 
 ATF_TC_BODY(shmdt_failure, tc)
 {
-	const char *regex = "shmdt.*return,failure : Invalid argument";
+	struct audit_match match = {
+		.event = "AUE_SHMDT",
+		.status = MATCH_FAILURE,
+		.error = EINVAL,
+	};
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(-1, shmdt(NULL));
-	check_audit(fds, regex, pipefd);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(shmdt_failure, tc)
@@ -592,10 +626,14 @@ ATF_TC_HEAD(shmctl_rmid_failure, tc)
 
 ATF_TC_BODY(shmctl_rmid_failure, tc)
 {
-	const char *regex = "shmctl.*IPC_RMID.*return,fail.*Invalid argument";
+	struct audit_match match = {
+		.event = "AUE_SHMCTL_RMID",
+		.status = MATCH_FAILURE,
+		.error = EINVAL,
+	};
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(-1, shmctl(-1, IPC_RMID, NULL));
-	check_audit(fds, regex, pipefd);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(shmctl_rmid_failure, tc)
@@ -643,10 +681,14 @@ ATF_TC_HEAD(shmctl_stat_failure, tc)
 
 ATF_TC_BODY(shmctl_stat_failure, tc)
 {
-	const char *regex = "shmctl.*IPC_STAT.*return,fail.*Invalid argument";
+	struct audit_match match = {
+		.event = "AUE_SHMCTL_STAT",
+		.status = MATCH_FAILURE,
+		.error = EINVAL,
+	};
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(-1, shmctl(-1, IPC_STAT, &shmbuff));
-	check_audit(fds, regex, pipefd);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(shmctl_stat_failure, tc)
@@ -696,10 +738,14 @@ ATF_TC_HEAD(shmctl_set_failure, tc)
 
 ATF_TC_BODY(shmctl_set_failure, tc)
 {
-	const char *regex = "shmctl.*IPC_SET.*return,failure.*Invalid argument";
+	struct audit_match match = {
+		.event = "AUE_SHMCTL_SET",
+		.status = MATCH_FAILURE,
+		.error = EINVAL,
+	};
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(-1, shmctl(-1, IPC_SET, &shmbuff));
-	check_audit(fds, regex, pipefd);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(shmctl_set_failure, tc)
@@ -881,10 +927,14 @@ ATF_TC_HEAD(semctl_getval_failure, tc)
 
 ATF_TC_BODY(semctl_getval_failure, tc)
 {
-	const char *regex = "semctl.*GETVAL.*return,failure : Invalid argument";
+	struct audit_match match = {
+		.event = "AUE_SEMCTL_GETVAL",
+		.status = MATCH_FAILURE,
+		.error = EINVAL,
+	};
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(-1, semctl(-1, 0, GETVAL));
-	check_audit(fds, regex, pipefd);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(semctl_getval_failure, tc)
@@ -933,10 +983,14 @@ ATF_TC_HEAD(semctl_setval_failure, tc)
 
 ATF_TC_BODY(semctl_setval_failure, tc)
 {
-	const char *regex = "semctl.*SETVAL.*return,failure : Invalid argument";
+	struct audit_match match = {
+		.event = "AUE_SEMCTL_SETVAL",
+		.status = MATCH_FAILURE,
+		.error = EINVAL,
+	};
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(-1, semctl(-1, 0, SETVAL, semarg));
-	check_audit(fds, regex, pipefd);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(semctl_setval_failure, tc)
@@ -984,10 +1038,14 @@ ATF_TC_HEAD(semctl_getpid_failure, tc)
 
 ATF_TC_BODY(semctl_getpid_failure, tc)
 {
-	const char *regex = "semctl.*GETPID.*return,failure : Invalid argument";
+	struct audit_match match = {
+		.event = "AUE_SEMCTL_GETPID",
+		.status = MATCH_FAILURE,
+		.error = EINVAL,
+	};
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(-1, semctl(-1, 0, GETPID));
-	check_audit(fds, regex, pipefd);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(semctl_getpid_failure, tc)
@@ -1035,10 +1093,14 @@ ATF_TC_HEAD(semctl_getncnt_failure, tc)
 
 ATF_TC_BODY(semctl_getncnt_failure, tc)
 {
-	const char *regex = "semctl.*GETNCNT.*return,failure.*Invalid argument";
+	struct audit_match match = {
+		.event = "AUE_SEMCTL_GETNCNT",
+		.status = MATCH_FAILURE,
+		.error = EINVAL,
+	};
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(-1, semctl(-1, 0, GETNCNT));
-	check_audit(fds, regex, pipefd);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(semctl_getncnt_failure, tc)
@@ -1086,10 +1148,14 @@ ATF_TC_HEAD(semctl_getzcnt_failure, tc)
 
 ATF_TC_BODY(semctl_getzcnt_failure, tc)
 {
-	const char *regex = "semctl.*GETZCNT.*return,failure.*Invalid argument";
+	struct audit_match match = {
+		.event = "AUE_SEMCTL_GETZCNT",
+		.status = MATCH_FAILURE,
+		.error = EINVAL,
+	};
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(-1, semctl(-1, 0, GETZCNT));
-	check_audit(fds, regex, pipefd);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(semctl_getzcnt_failure, tc)
@@ -1138,10 +1204,14 @@ ATF_TC_HEAD(semctl_getall_failure, tc)
 
 ATF_TC_BODY(semctl_getall_failure, tc)
 {
-	const char *regex = "semctl.*GETALL.*return,failure : Invalid argument";
+	struct audit_match match = {
+		.event = "AUE_SEMCTL_GETALL",
+		.status = MATCH_FAILURE,
+		.error = EINVAL,
+	};
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(-1, semctl(-1, 0, GETALL, semarg));
-	check_audit(fds, regex, pipefd);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(semctl_getall_failure, tc)
@@ -1193,10 +1263,14 @@ ATF_TC_HEAD(semctl_setall_failure, tc)
 
 ATF_TC_BODY(semctl_setall_failure, tc)
 {
-	const char *regex = "semctl.*SETALL.*return,failure : Invalid argument";
+	struct audit_match match = {
+		.event = "AUE_SEMCTL_SETALL",
+		.status = MATCH_FAILURE,
+		.error = EINVAL,
+	};
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(-1, semctl(-1, 0, SETALL, semarg));
-	check_audit(fds, regex, pipefd);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(semctl_setall_failure, tc)
@@ -1245,10 +1319,14 @@ ATF_TC_HEAD(semctl_stat_failure, tc)
 
 ATF_TC_BODY(semctl_stat_failure, tc)
 {
-	const char *regex = "semctl.*IPC_STAT.*return,fail.*Invalid argument";
+	struct audit_match match = {
+		.event = "AUE_SEMCTL_STAT",
+		.status = MATCH_FAILURE,
+		.error = EINVAL,
+	};
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(-1, semctl(-1, 0, IPC_STAT, semarg));
-	check_audit(fds, regex, pipefd);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(semctl_stat_failure, tc)
@@ -1308,10 +1386,14 @@ ATF_TC_BODY(semctl_set_failure, tc)
 	/* Fill up the sembuff structure to be used with IPC_SET */
 	ATF_REQUIRE_EQ(0, semctl(semid, 0, IPC_STAT, semarg));
 
-	const char *regex = "semctl.*IPC_SET.*return,failure.*Invalid argument";
+	struct audit_match match = {
+		.event = "AUE_SEMCTL_SET",
+		.status = MATCH_FAILURE,
+		.error = EINVAL,
+	};
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(-1, semctl(-1, 0, IPC_SET, semarg));
-	check_audit(fds, regex, pipefd);
+	check_audit_match(fds, &match, pipefd);
 
 	/* Destroy the semaphore set with ID = semid */
 	ATF_REQUIRE_EQ(0, semctl(semid, 0, IPC_RMID));
@@ -1359,10 +1441,14 @@ ATF_TC_HEAD(semctl_rmid_failure, tc)
 
 ATF_TC_BODY(semctl_rmid_failure, tc)
 {
-	const char *regex = "semctl.*IPC_RMID.*return,fail.*Invalid argument";
+	struct audit_match match = {
+		.event = "AUE_SEMCTL_RMID",
+		.status = MATCH_FAILURE,
+		.error = EINVAL,
+	};
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(-1, semctl(-1, 0, IPC_RMID, semarg));
-	check_audit(fds, regex, pipefd);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(semctl_rmid_failure, tc)
@@ -1431,11 +1517,12 @@ ATF_TC_HEAD(shm_open_failure, tc)
 
 ATF_TC_BODY(shm_open_failure, tc)
 {
-	const char *regex = "shm_open.*fileforaudit.*return,failure";
+	snprintf(ipcregex, sizeof(ipcregex),
+			"shm_open.*%s.*return,failure", path);
 	FILE *pipefd = setup(fds, auclass);
 	/* Failure reason: File does not exist */
 	ATF_REQUIRE_EQ(-1, shm_open(path, O_TRUNC | O_RDWR, 0600));
-	check_audit(fds, regex, pipefd);
+	check_audit(fds, ipcregex, pipefd);
 }
 
 ATF_TC_CLEANUP(shm_open_failure, tc)
@@ -1454,15 +1541,16 @@ ATF_TC_HEAD(shm_unlink_success, tc)
 ATF_TC_BODY(shm_unlink_success, tc)
 {
 	/* Build an absolute path to a file in the test-case directory */
-	char dirpath[50];
+	char dirpath[PATH_MAX];
 	ATF_REQUIRE(getcwd(dirpath, sizeof(dirpath)) != NULL);
-	strlcat(dirpath, path, sizeof(dirpath));
+	ATF_REQUIRE(strlcat(dirpath, path, sizeof(dirpath)) < sizeof(dirpath));
 	ATF_REQUIRE(shm_open(dirpath, O_CREAT | O_TRUNC | O_RDWR, 0600) != -1);
 
-	const char *regex = "shm_unlink.*fileforaudit.*return,success";
+	snprintf(ipcregex, sizeof(ipcregex),
+			"shm_unlink.*%s.*return,success", path);
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(0, shm_unlink(dirpath));
-	check_audit(fds, regex, pipefd);
+	check_audit(fds, ipcregex, pipefd);
 }
 
 ATF_TC_CLEANUP(shm_unlink_success, tc)
@@ -1480,10 +1568,11 @@ ATF_TC_HEAD(shm_unlink_failure, tc)
 
 ATF_TC_BODY(shm_unlink_failure, tc)
 {
-	const char *regex = "shm_unlink.*fileforaudit.*return,failure";
+	snprintf(ipcregex, sizeof(ipcregex),
+			"shm_unlink.*%s.*return,failure", path);
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(-1, shm_unlink(path));
-	check_audit(fds, regex, pipefd);
+	check_audit(fds, ipcregex, pipefd);
 }
 
 ATF_TC_CLEANUP(shm_unlink_failure, tc)
@@ -1575,10 +1664,14 @@ ATF_TC_HEAD(posix_openpt_failure, tc)
 
 ATF_TC_BODY(posix_openpt_failure, tc)
 {
-	const char *regex = "posix_openpt.*return,failure : Invalid argument";
+	struct audit_match match = {
+		.event = "AUE_POSIX_OPENPT",
+		.status = MATCH_FAILURE,
+		.error = EINVAL,
+	};
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(-1, posix_openpt(-1));
-	check_audit(fds, regex, pipefd);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(posix_openpt_failure, tc)
@@ -1589,6 +1682,8 @@ ATF_TC_CLEANUP(posix_openpt_failure, tc)
 
 ATF_TP_ADD_TCS(tp)
 {
+	path = fixture_name("/fileforaudit");
+
 	ATF_TP_ADD_TC(tp, msgget_success);
 	ATF_TP_ADD_TC(tp, msgget_failure);
 	ATF_TP_ADD_TC(tp, msgsnd_success);
@@ -32,6 +32,7 @@
 #include <sys/un.h>
 
 #include <atf-c.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <stdarg.h>
 #include <unistd.h>
@@ -39,7 +40,6 @@
 #include "utils.h"
 
 #define MAX_DATA 128
-#define SERVER_PATH "server"
 
 static pid_t pid;
 static mode_t mode = 0777;
@@ -54,10 +54,20 @@ static char extregex[MAX_DATA];
 static char data[MAX_DATA];
 static char msgbuff[MAX_DATA] = "This message does not exist";
 static const char *auclass = "nt";
-static const char *path = "fileforaudit";
-static const char *nosupregex = "return,failure : Address family "
-				"not supported by protocol family";
-static const char *invalregex = "return,failure : Bad file descriptor";
+static const char *path;
+static const char *serverpath;
+
+/* Failures on an unsupported domain, argument 1, and an invalid socket */
+static struct audit_match nosupmatch = {
+	.status = MATCH_FAILURE,
+	.error = EAFNOSUPPORT,
+	.arg = 1,
+	.argval = 0,
+};
+static struct audit_match invalmatch = {
+	.status = MATCH_FAILURE,
+	.error = EBADF,
+};
 
 /*
  * Initialize iovec structure to be used as a field of struct msghdr
@@ -108,7 +118,7 @@ assign_address(struct sockaddr_un *serveraddr)
 {
 	memset(serveraddr, 0, sizeof(*serveraddr));
 	serveraddr->sun_family = AF_UNIX;
-	strcpy(serveraddr->sun_path, SERVER_PATH);
+	strcpy(serveraddr->sun_path, serverpath);
 }
 
 
@@ -144,11 +154,11 @@ ATF_TC_HEAD(socket_failure, tc)
 
 ATF_TC_BODY(socket_failure, tc)
 {
-	snprintf(extregex, sizeof(extregex), "socket.*%s", nosupregex);
+	nosupmatch.event = "AUE_SOCKET";
 	FILE *pipefd = setup(fds, auclass);
 	/* Failure reason: Unsupported value of 'domain' argument: 0 */
 	ATF_REQUIRE_EQ(-1, socket(0, SOCK_STREAM, 0));
-	check_audit(fds, extregex, pipefd);
+	check_audit_match(fds, &nosupmatch, pipefd);
 }
 
 ATF_TC_CLEANUP(socket_failure, tc)
@@ -167,12 +177,16 @@ ATF_TC_HEAD(socketpair_success, tc)
 ATF_TC_BODY(socketpair_success, tc)
 {
 	int sv[2];
+	/* Check for argument 3, the default protocol, in the audit record */
+	struct audit_match match = {
+		.event = "AUE_SOCKETPAIR",
+		.status = MATCH_SUCCESS,
+		.arg = 3,
+		.argval = 0,
+	};
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(0, socketpair(PF_UNIX, SOCK_STREAM, 0, sv));
-
-	/* Check for 0x0 (argument 3: default protocol) in the audit record */
-	snprintf(extregex, sizeof(extregex), "socketpair.*0x0.*return,success");
-	check_audit(fds, extregex, pipefd);
+	check_audit_match(fds, &match, pipefd);
 	close_sockets(2, sv[0], sv[1]);
 }
 
@@ -191,11 +205,11 @@ ATF_TC_HEAD(socketpair_failure, tc)
 
 ATF_TC_BODY(socketpair_failure, tc)
 {
-	snprintf(extregex, sizeof(extregex), "socketpair.*%s", nosupregex);
+	nosupmatch.event = "AUE_SOCKETPAIR";
 	FILE *pipefd = setup(fds, auclass);
 	/* Failure reason: Unsupported value of 'domain' argument: 0 */
 	ATF_REQUIRE_EQ(-1, socketpair(0, SOCK_STREAM, 0, NULL));
-	check_audit(fds, extregex, pipefd);
+	check_audit_match(fds, &nosupmatch, pipefd);
 }
 
 ATF_TC_CLEANUP(socketpair_failure, tc)
@@ -241,11 +255,11 @@ ATF_TC_HEAD(setsockopt_failure, tc)
 
 ATF_TC_BODY(setsockopt_failure, tc)
 {
-	snprintf(extregex, sizeof(extregex), "setsockopt.*%s", invalregex);
+	invalmatch.event = "AUE_SETSOCKOPT";
 	FILE *pipefd = setup(fds, auclass);
 	/* Failure reason: Invalid socket descriptor */
 	ATF_REQUIRE_EQ(-1, setsockopt(-1, SOL_SOCKET, 0, NULL, 0));
-	check_audit(fds, extregex, pipefd);
+	check_audit_match(fds, &invalmatch, pipefd);
 }
 
 ATF_TC_CLEANUP(setsockopt_failure, tc)
@@ -268,7 +282,7 @@ ATF_TC_BODY(bind_success, tc)
 	ATF_REQUIRE((sockfd = socket(PF_UNIX, SOCK_STREAM, 0)) != -1);
 	/* Check the presence of AF_UNIX address path in audit record */
 	snprintf(extregex, sizeof(extregex),
-		"bind.*unix.*%s.*return,success", SERVER_PATH);
+		"bind.*unix.*%s.*return,success", serverpath);
 
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(0, bind(sockfd, (struct sockaddr *)&server, len));
@@ -294,7 +308,7 @@ ATF_TC_BODY(bind_failure, tc)
 	assign_address(&server);
 	/* Check the presence of AF_UNIX path in audit record */
 	snprintf(extregex, sizeof(extregex),
-			"bind.*%s.*return,failure", SERVER_PATH);
+			"bind.*%s.*return,failure", serverpath);
 
 	FILE *pipefd = setup(fds, auclass);
 	/* Failure reason: Invalid socket descriptor */
@@ -347,13 +361,13 @@ ATF_TC_HEAD(bindat_failure, tc)
 ATF_TC_BODY(bindat_failure, tc)
 {
 	assign_address(&server);
-	snprintf(extregex, sizeof(extregex), "bindat.*%s", invalregex);
+	invalmatch.event = "AUE_BINDAT";
 
 	FILE *pipefd = setup(fds, auclass);
 	/* Failure reason: Invalid socket descriptor */
 	ATF_REQUIRE_EQ(-1, bindat(AT_FDCWD, -1,
 			(struct sockaddr *)&server, len));
-	check_audit(fds, extregex, pipefd);
+	check_audit_match(fds, &invalmatch, pipefd);
 }
 
 ATF_TC_CLEANUP(bindat_failure, tc)
@@ -400,11 +414,11 @@ ATF_TC_HEAD(listen_failure, tc)
 
 ATF_TC_BODY(listen_failure, tc)
 {
-	snprintf(extregex, sizeof(extregex), "listen.*%s", invalregex);
+	invalmatch.event = "AUE_LISTEN";
 	FILE *pipefd = setup(fds, auclass);
 	/* Failure reason: Invalid socket descriptor */
 	ATF_REQUIRE_EQ(-1, listen(-1, 1));
-	check_audit(fds, extregex, pipefd);
+	check_audit_match(fds, &invalmatch, pipefd);
 }
 
 ATF_TC_CLEANUP(listen_failure, tc)
@@ -433,7 +447,7 @@ ATF_TC_BODY(connect_success, tc)
 
 	/* Audit record must contain AF_UNIX address path & sockfd2 */
 	snprintf(extregex, sizeof(extregex),
-			"connect.*0x%x.*%s.*success", sockfd2, SERVER_PATH);
+			"connect.*0x%x.*%s.*success", sockfd2, serverpath);
 
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(0, connect(sockfd2, (struct sockaddr *)&server, len));
@@ -461,7 +475,7 @@ ATF_TC_BODY(connect_failure, tc)
 	assign_address(&server);
 	/* Audit record must contain AF_UNIX address path */
 	snprintf(extregex, sizeof(extregex),
-			"connect.*%s.*return,failure", SERVER_PATH);
+			"connect.*%s.*return,failure", serverpath);
 
 	FILE *pipefd = setup(fds, auclass);
 	/* Failure reason: Invalid socket descriptor */
@@ -522,13 +536,13 @@ ATF_TC_HEAD(connectat_failure, tc)
 ATF_TC_BODY(connectat_failure, tc)
 {
 	assign_address(&server);
-	snprintf(extregex, sizeof(extregex), "connectat.*%s", invalregex);
+	invalmatch.event = "AUE_CONNECTAT";
 
 	FILE *pipefd = setup(fds, auclass);
 	/* Failure reason: Invalid socket descriptor */
 	ATF_REQUIRE_EQ(-1, connectat(AT_FDCWD, -1,
 			(struct sockaddr *)&server, len));
-	check_audit(fds, extregex, pipefd);
+	check_audit_match(fds, &invalmatch, pipefd);
 }
 
 ATF_TC_CLEANUP(connectat_failure, tc)
@@ -583,11 +597,11 @@ ATF_TC_HEAD(accept_failure, tc)
 
 ATF_TC_BODY(accept_failure, tc)
 {
-	snprintf(extregex, sizeof(extregex), "accept.*%s", invalregex);
+	invalmatch.event = "AUE_ACCEPT";
 	FILE *pipefd = setup(fds, auclass);
 	/* Failure reason: Invalid socket descriptor */
 	ATF_REQUIRE_EQ(-1, accept(-1, NULL, NULL));
-	check_audit(fds, extregex, pipefd);
+	check_audit_match(fds, &invalmatch, pipefd);
 }
 
 ATF_TC_CLEANUP(accept_failure, tc)
@@ -645,11 +659,11 @@ ATF_TC_HEAD(send_failure, tc)
 
 ATF_TC_BODY(send_failure, tc)
 {
-	snprintf(extregex, sizeof(extregex), "send.*%s", invalregex);
+	invalmatch.event = "AUE_SENDTO";
 	FILE *pipefd = setup(fds, auclass);
 	/* Failure reason: Invalid socket descriptor */
 	ATF_REQUIRE_EQ(-1, send(-1, NULL, 0, 0));
-	check_audit(fds, extregex, pipefd);
+	check_audit_match(fds, &invalmatch, pipefd);
 }
 
 ATF_TC_CLEANUP(send_failure, tc)
@@ -708,11 +722,11 @@ ATF_TC_HEAD(recv_failure, tc)
 
 ATF_TC_BODY(recv_failure, tc)
 {
-	snprintf(extregex, sizeof(extregex), "recv.*%s", invalregex);
+	invalmatch.event = "AUE_RECVFROM";
 	FILE *pipefd = setup(fds, auclass);
 	/* Failure reason: Invalid socket descriptor */
 	ATF_REQUIRE_EQ(-1, recv(-1, NULL, 0, 0));
-	check_audit(fds, extregex, pipefd);
+	check_audit_match(fds, &invalmatch, pipefd);
 }
 
 ATF_TC_CLEANUP(recv_failure, tc)
@@ -767,11 +781,11 @@ ATF_TC_HEAD(sendto_failure, tc)
 
 ATF_TC_BODY(sendto_failure, tc)
 {
-	snprintf(extregex, sizeof(extregex), "sendto.*%s", invalregex);
+	invalmatch.event = "AUE_SENDTO";
 	FILE *pipefd = setup(fds, auclass);
 	/* Failure reason: Invalid socket descriptor */
 	ATF_REQUIRE_EQ(-1, sendto(-1, NULL, 0, 0, NULL, 0));
-	check_audit(fds, extregex, pipefd);
+	check_audit_match(fds, &invalmatch, pipefd);
 }
 
 ATF_TC_CLEANUP(sendto_failure, tc)
@@ -828,11 +842,11 @@ ATF_TC_HEAD(recvfrom_failure, tc)
 
 ATF_TC_BODY(recvfrom_failure, tc)
 {
-	snprintf(extregex, sizeof(extregex), "recvfrom.*%s", invalregex);
+	invalmatch.event = "AUE_RECVFROM";
 	FILE *pipefd = setup(fds, auclass);
 	/* Failure reason: Invalid socket descriptor */
 	ATF_REQUIRE_EQ(-1, recvfrom(-1, NULL, 0, 0, NULL, NULL));
-	check_audit(fds, extregex, pipefd);
+	check_audit_match(fds, &invalmatch, pipefd);
 }
 
 ATF_TC_CLEANUP(recvfrom_failure, tc)
@@ -890,11 +904,14 @@ ATF_TC_HEAD(sendmsg_failure, tc)
 
 ATF_TC_BODY(sendmsg_failure, tc)
 {
-	snprintf(extregex, sizeof(extregex),
-		"sendmsg.*return,failure : Bad address");
+	struct audit_match match = {
+		.event = "AUE_SENDMSG",
+		.status = MATCH_FAILURE,
+		.error = EFAULT,
+	};
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(-1, sendmsg(-1, NULL, 0));
-	check_audit(fds, extregex, pipefd);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(sendmsg_failure, tc)
@@ -958,11 +975,14 @@ ATF_TC_HEAD(recvmsg_failure, tc)
 
 ATF_TC_BODY(recvmsg_failure, tc)
 {
-	snprintf(extregex, sizeof(extregex),
-		"recvmsg.*return,failure : Bad address");
+	struct audit_match match = {
+		.event = "AUE_RECVMSG",
+		.status = MATCH_FAILURE,
+		.error = EFAULT,
+	};
 	FILE *pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(-1, recvmsg(-1, NULL, 0));
-	check_audit(fds, extregex, pipefd);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(recvmsg_failure, tc)
@@ -1090,6 +1110,9 @@ ATF_TC_CLEANUP(sendfile_failure, tc)
 
 ATF_TP_ADD_TCS(tp)
 {
+	path = fixture_name("fileforaudit");
+	serverpath = fixture_name("server");
+
 	ATF_TP_ADD_TC(tp, socket_success);
 	ATF_TP_ADD_TC(tp, socket_failure);
 	ATF_TP_ADD_TC(tp, socketpair_success);
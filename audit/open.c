@@ -54,8 +54,8 @@ static struct pollfd fds[1];
 static mode_t o_mode = 0777;
 static int filedesc;
 static char extregex[80];
-static const char *path = "fileforaudit";
-static const char *errpath = "adirhasnoname/fileforaudit";
+static const char *path;
+static const char *errpath;
 
 /*
  * Define test-cases for success and failure modes of both open(2) and openat(2)
@@ -70,7 +70,7 @@ ATF_TC_HEAD(open_ ## mode ## _success, tc) 				      \
 ATF_TC_BODY(open_ ## mode ## _success, tc) 				      \
 { 									      \
 	snprintf(extregex, sizeof(extregex), 				      \
-		"open.*%s.*fileforaudit.*return,success", regex); 	      \
+		"open.*%s.*%s.*return,success", regex, path);		      \
 	/* File needs to exist for successful open(2) invocation */ 	      \
 	ATF_REQUIRE((filedesc = open(path, O_CREAT, o_mode)) != -1); 	      \
 	FILE *pipefd = setup(fds, class); 				      \
@@ -91,7 +91,7 @@ ATF_TC_HEAD(open_ ## mode ## _failure, tc) 				      \
 ATF_TC_BODY(open_ ## mode ## _failure, tc) 				      \
 { 									      \
 	snprintf(extregex, sizeof(extregex), 				      \
-		"open.*%s.*fileforaudit.*return,failure", regex); 	      \
+		"open.*%s.*%s.*return,failure", regex, path);		      \
 	FILE *pipefd = setup(fds, class); 				      \
 	ATF_REQUIRE_EQ(-1, syscall(SYS_open, errpath, flag)); 		      \
 	check_audit(fds, extregex, pipefd); 				      \
@@ -110,7 +110,7 @@ ATF_TC_BODY(openat_ ## mode ## _success, tc) 				      \
 { 									      \
 	int filedesc2; 							      \
 	snprintf(extregex, sizeof(extregex), 				      \
-		"openat.*%s.*fileforaudit.*return,success", regex); 	      \
+		"openat.*%s.*%s.*return,success", regex, path);		      \
 	/* File needs to exist for successful openat(2) invocation */ 	      \
 	ATF_REQUIRE((filedesc = open(path, O_CREAT, o_mode)) != -1); 	      \
 	FILE *pipefd = setup(fds, class); 				      \
@@ -132,7 +132,7 @@ ATF_TC_HEAD(openat_ ## mode ## _failure, tc) 				      \
 ATF_TC_BODY(openat_ ## mode ## _failure, tc) 				      \
 { 									      \
 	snprintf(extregex, sizeof(extregex), 				      \
-		"openat.*%s.*fileforaudit.*return,failure", regex); 	      \
+		"openat.*%s.*%s.*return,failure", regex, path);		      \
 	FILE *pipefd = setup(fds, class); 				      \
 	ATF_REQUIRE_EQ(-1, openat(AT_FDCWD, errpath, flag)); 		      \
 	check_audit(fds, extregex, pipefd); 				      \
@@ -175,8 +175,93 @@ OPEN_AT_TC_DEFINE(read_write_creat_trunc, "read,write,creat,trunc", O_RDWR |
 	O_CREAT | O_TRUNC, "fw")
 
 
+/*
+ * The whole flag matrix in a single test case: every open(2) and openat(2)
+ * variant is issued in both modes, then one drain of auditpipe(4) has to
+ * turn up all of the 48 records
+ */
+static const struct {
+	const char	*open;
+	const char	*openat;
+	int		 flag;
+} openflags[] = {
+	{ "AUE_OPEN_R", "AUE_OPENAT_R", O_RDONLY },
+	{ "AUE_OPEN_RC", "AUE_OPENAT_RC", O_RDONLY | O_CREAT },
+	{ "AUE_OPEN_RT", "AUE_OPENAT_RT", O_RDONLY | O_TRUNC },
+	{ "AUE_OPEN_RTC", "AUE_OPENAT_RTC", O_RDONLY | O_CREAT | O_TRUNC },
+	{ "AUE_OPEN_W", "AUE_OPENAT_W", O_WRONLY },
+	{ "AUE_OPEN_WC", "AUE_OPENAT_WC", O_WRONLY | O_CREAT },
+	{ "AUE_OPEN_WT", "AUE_OPENAT_WT", O_WRONLY | O_TRUNC },
+	{ "AUE_OPEN_WTC", "AUE_OPENAT_WTC", O_WRONLY | O_CREAT | O_TRUNC },
+	{ "AUE_OPEN_RW", "AUE_OPENAT_RW", O_RDWR },
+	{ "AUE_OPEN_RWC", "AUE_OPENAT_RWC", O_RDWR | O_CREAT },
+	{ "AUE_OPEN_RWT", "AUE_OPENAT_RWT", O_RDWR | O_TRUNC },
+	{ "AUE_OPEN_RWTC", "AUE_OPENAT_RWTC", O_RDWR | O_CREAT | O_TRUNC },
+};
+
+ATF_TC_WITH_CLEANUP(open_openat_matrix);
+ATF_TC_HEAD(open_openat_matrix, tc)
+{
+	atf_tc_set_md_var(tc, "descr", "Tests the audit of open(2) and "
+				"openat(2) with every combination of flags, in "
+				"both success and failure modes");
+}
+
+ATF_TC_BODY(open_openat_matrix, tc)
+{
+	struct audit_session *sess;
+	struct audit_batch *batch;
+	struct audit_match match = { .path = path };
+	int fd;
+	size_t i;
+
+	/* File needs to exist for successful open(2) invocation */
+	ATF_REQUIRE((filedesc = open(path, O_CREAT, o_mode)) != -1);
+	sess = session_setup("fr,fw");
+
+	batch = batch_new();
+	for (i = 0; i < sizeof(openflags) / sizeof(openflags[0]); i++) {
+		match.status = MATCH_SUCCESS;
+		match.event = openflags[i].open;
+		batch_expect_match(batch, &match);
+		match.event = openflags[i].openat;
+		batch_expect_match(batch, &match);
+
+		match.status = MATCH_FAILURE;
+		match.event = openflags[i].open;
+		batch_expect_match(batch, &match);
+		match.event = openflags[i].openat;
+		batch_expect_match(batch, &match);
+	}
+
+	for (i = 0; i < sizeof(openflags) / sizeof(openflags[0]); i++) {
+		ATF_REQUIRE((fd = syscall(SYS_open, path,
+		    openflags[i].flag)) != -1);
+		close(fd);
+		ATF_REQUIRE((fd = openat(AT_FDCWD, path,
+		    openflags[i].flag)) != -1);
+		close(fd);
+		ATF_REQUIRE_EQ(-1, syscall(SYS_open, errpath,
+		    openflags[i].flag));
+		ATF_REQUIRE_EQ(-1, openat(AT_FDCWD, errpath,
+		    openflags[i].flag));
+	}
+
+	session_check_batch(sess, batch);
+	close(filedesc);
+}
+
+ATF_TC_CLEANUP(open_openat_matrix, tc)
+{
+	cleanup();
+}
+
+
 ATF_TP_ADD_TCS(tp)
 {
+	path = fixture_name("fileforaudit");
+	errpath = fixture_name("adirhasnoname/fileforaudit");
+
 	OPEN_AT_TC_ADD(tp, read);
 	OPEN_AT_TC_ADD(tp, read_creat);
 	OPEN_AT_TC_ADD(tp, read_trunc);
@@ -192,5 +277,7 @@ ATF_TP_ADD_TCS(tp)
 	OPEN_AT_TC_ADD(tp, read_write_trunc);
 	OPEN_AT_TC_ADD(tp, read_write_creat_trunc);
 
+	ATF_TP_ADD_TC(tp, open_openat_matrix);
+
 	return (atf_no_error());
 }
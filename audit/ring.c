@@ -0,0 +1,271 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include "ring.h"
+
+/*
+ * Sleep until the ring's event count moves past "gen", read before the
+ * condition the caller is waiting for was found false
+ */
+static void
+ring_wait(struct ring *ring, uint64_t gen)
+{
+	pthread_mutex_lock(&ring->lock);
+	atomic_fetch_add(&ring->waiters, 1);
+	while (atomic_load(&ring->events) == gen)
+		pthread_cond_wait(&ring->cond, &ring->lock);
+	atomic_fetch_sub(&ring->waiters, 1);
+	pthread_mutex_unlock(&ring->lock);
+}
+
+static void
+ring_wake(struct ring *ring)
+{
+	atomic_fetch_add(&ring->events, 1);
+	if (atomic_load(&ring->waiters) > 0) {
+		pthread_mutex_lock(&ring->lock);
+		pthread_cond_broadcast(&ring->cond);
+		pthread_mutex_unlock(&ring->lock);
+	}
+}
+
+/*
+ * Set up an empty ring of at least "nslots" records, calling "retire", if
+ * not NULL, for every record freed. Returns 0 or an errno value.
+ */
+int
+ring_init(struct ring *ring, unsigned nslots, ring_retire_t retire)
+{
+	int error;
+
+	ring->nslots = 1;
+	while (ring->nslots < nslots)
+		ring->nslots *= 2;
+	if ((ring->slots = calloc(ring->nslots, sizeof(*ring->slots))) == NULL)
+		return (ENOMEM);
+	if ((error = pthread_mutex_init(&ring->lock, NULL)) != 0) {
+		free(ring->slots);
+		return (error);
+	}
+	if ((error = pthread_cond_init(&ring->cond, NULL)) != 0) {
+		pthread_mutex_destroy(&ring->lock);
+		free(ring->slots);
+		return (error);
+	}
+	ring->retire = retire;
+	atomic_init(&ring->events, 0);
+	atomic_init(&ring->waiters, 0);
+	ring_clear(ring);
+	return (0);
+}
+
+void
+ring_destroy(struct ring *ring)
+{
+	uint64_t i;
+
+	for (i = 0; i < ring->nslots; i++) {
+		free(ring->slots[i].data);
+		free(ring->slots[i].hits);
+	}
+	free(ring->slots);
+	ring->slots = NULL;
+	pthread_cond_destroy(&ring->cond);
+	pthread_mutex_destroy(&ring->lock);
+}
+
+/*
+ * Discard every record. No other thread may use the ring meanwhile. The
+ * memory of the slots is kept for the records to come.
+ */
+void
+ring_clear(struct ring *ring)
+{
+	uint64_t i;
+
+	for (i = 0; i < ring->nslots; i++) {
+		atomic_init(&ring->slots[i].seq, i);
+		atomic_init(&ring->slots[i].done, 0);
+	}
+	atomic_init(&ring->head, 0);
+	atomic_init(&ring->tail, 0);
+	atomic_init(&ring->free, 0);
+	atomic_init(&ring->limit, UINT64_MAX);
+	atomic_init(&ring->closed, false);
+}
+
+/*
+ * The slot to fill with the next record, waiting for one to be freed if
+ * the ring is full. Returns NULL once the ring is closed. Only a single
+ * thread may fill the ring.
+ */
+struct ring_slot *
+ring_reserve(struct ring *ring)
+{
+	struct ring_slot *slot;
+	uint64_t gen, pos;
+
+	pos = atomic_load(&ring->head);
+	slot = &ring->slots[pos & (ring->nslots - 1)];
+	for (;;) {
+		gen = atomic_load(&ring->events);
+		if (atomic_load(&ring->closed))
+			return (NULL);
+		if (atomic_load(&slot->seq) == pos)
+			return (slot);
+		ring_wait(ring, gen);
+	}
+}
+
+/*
+ * Hand the record filled into "slot" out to the consumers
+ */
+void
+ring_publish(struct ring *ring, struct ring_slot *slot)
+{
+	uint64_t pos;
+
+	pos = atomic_load(&ring->head);
+	atomic_store(&slot->seq, pos + 1);
+	atomic_store(&ring->head, pos + 1);
+	ring_wake(ring);
+}
+
+/*
+ * Take the oldest record nobody has taken yet, waiting for one if there is
+ * none, and store its position in "pos". Returns NULL once the ring is
+ * closed.
+ */
+struct ring_slot *
+ring_take(struct ring *ring, uint64_t *pos)
+{
+	struct ring_slot *slot;
+	uint64_t gen, tail;
+
+	for (;;) {
+		gen = atomic_load(&ring->events);
+		if (atomic_load(&ring->closed))
+			return (NULL);
+		tail = atomic_load(&ring->tail);
+		slot = &ring->slots[tail & (ring->nslots - 1)];
+		if (atomic_load(&slot->seq) == tail + 1) {
+			if (atomic_compare_exchange_weak(&ring->tail, &tail,
+			    tail + 1)) {
+				*pos = tail;
+				return (slot);
+			}
+			continue;
+		}
+		/* Empty, unless another consumer took the record meanwhile */
+		if (atomic_load(&ring->tail) == tail)
+			ring_wait(ring, gen);
+	}
+}
+
+/*
+ * Mark the record at "pos" in "slot" as matched, and free every matched
+ * record from the oldest one on up to the first one still being matched
+ * or the limit set by ring_hold(). Whichever thread gets to free a record
+ * retires it, passing "arg" on; a record is retired only once the one
+ * before it has been.
+ */
+void
+ring_done(struct ring *ring, struct ring_slot *slot, uint64_t pos, void *arg)
+{
+	struct ring_slot *next;
+	uint64_t done, free;
+	bool freed = false;
+
+	atomic_store(&slot->done, pos + 1);
+	for (;;) {
+		free = atomic_load(&ring->free);
+		if (free > atomic_load(&ring->limit))
+			break;
+
+		/* The slot may hold a later record by now if "free" moved on */
+		next = &ring->slots[free & (ring->nslots - 1)];
+		done = free + 1;
+		if (!atomic_compare_exchange_strong(&next->done, &done, 0))
+			break;
+		if (ring->retire != NULL)
+			ring->retire(next, free, arg);
+		atomic_store(&next->seq, free + ring->nslots);
+		atomic_store(&ring->free, free + 1);
+		freed = true;
+	}
+	if (freed)
+		ring_wake(ring);
+}
+
+/*
+ * Keep the records after "pos" from being freed, so that ring_rewind()
+ * can hand them out again
+ */
+void
+ring_hold(struct ring *ring, uint64_t pos)
+{
+	atomic_store(&ring->limit, pos);
+}
+
+/*
+ * Whether the record at "pos" and every one before it have been matched
+ */
+bool
+ring_freed(struct ring *ring, uint64_t pos)
+{
+	return (atomic_load(&ring->free) > pos);
+}
+
+/*
+ * Make every thread waiting on the ring, and any that would, return NULL
+ */
+void
+ring_close(struct ring *ring)
+{
+	atomic_store(&ring->closed, true);
+	ring_wake(ring);
+}
+
+/*
+ * Reopen a closed ring, with the records taken but not freed yet being
+ * the next to be taken. No other thread may use the ring meanwhile.
+ */
+void
+ring_rewind(struct ring *ring)
+{
+	uint64_t pos, tail;
+
+	tail = atomic_load(&ring->tail);
+	for (pos = atomic_load(&ring->free); pos < tail; pos++)
+		atomic_store(&ring->slots[pos & (ring->nslots - 1)].done, 0);
+	atomic_store(&ring->tail, atomic_load(&ring->free));
+	atomic_store(&ring->limit, UINT64_MAX);
+	atomic_store(&ring->closed, false);
+}
@@ -0,0 +1,93 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#ifndef _RING_H_
+#define _RING_H_
+
+#include <sys/types.h>
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * A bounded ring of audit records between the single thread reading them
+ * from the pipe and the threads matching them. Records are filled and taken
+ * without locks: every slot carries a sequence number telling whether it
+ * holds the record at a given position or is free for it. The mutex and
+ * condition variable only put threads to sleep on a full or empty ring.
+ *
+ * A taken record is not freed as soon as it has been matched but once every
+ * record before it has been. The retire function is then called for the
+ * records one at a time, in order, and the records after a given position
+ * can be handed out again, see ring_hold() and ring_rewind().
+ */
+struct ring_slot {
+	_Atomic uint64_t seq;		/* Position filled, taken or freed */
+	_Atomic uint64_t done;		/* Position + 1 once matched */
+	u_char		*data;		/* Grown by the producer as required */
+	size_t		 size;
+	int		 len;
+	struct timespec	 time;		/* When the record was read */
+	u_char		*hits;		/* Left by the consumer for retiring */
+	size_t		 hitsize;
+};
+
+typedef void	(*ring_retire_t)(struct ring_slot *, uint64_t, void *);
+
+struct ring {
+	struct ring_slot *slots;
+	uint64_t	 nslots;	/* A power of two */
+	_Atomic uint64_t head;		/* Next position to fill */
+	_Atomic uint64_t tail;		/* Next position to take */
+	_Atomic uint64_t free;		/* Next position to free */
+	_Atomic uint64_t limit;		/* Last position that may be freed */
+	ring_retire_t	 retire;
+	_Atomic bool	 closed;
+	_Atomic uint64_t events;	/* Bumped whenever a waiter may go on */
+	_Atomic int	 waiters;
+	pthread_mutex_t	 lock;
+	pthread_cond_t	 cond;
+};
+
+int	ring_init(struct ring *, unsigned, ring_retire_t);
+void	ring_destroy(struct ring *);
+void	ring_clear(struct ring *);
+
+struct ring_slot *ring_reserve(struct ring *);
+void	ring_publish(struct ring *, struct ring_slot *);
+struct ring_slot *ring_take(struct ring *, uint64_t *);
+void	ring_done(struct ring *, struct ring_slot *, uint64_t, void *);
+
+void	ring_hold(struct ring *, uint64_t);
+bool	ring_freed(struct ring *, uint64_t);
+void	ring_close(struct ring *);
+void	ring_rewind(struct ring *);
+
+#endif /* _RING_H_ */
@@ -26,43 +26,393 @@
  */
 
 #include <sys/ioctl.h>
+#include <sys/stat.h>
 
 #include <bsm/libbsm.h>
+#ifdef __FreeBSD__
 #include <security/audit/audit_ioctl.h>
+#endif
 
 #include <atf-c.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
 
+#include "auditd.h"
+#include "ring.h"
 #include "utils.h"
 
 /*
- * Checks the presence of "auditregex" in auditpipe(4) after the
- * corresponding system call has been triggered.
+ * Operations a session needs from the device supplying the audit records.
+ * The default is auditpipe(4); a regular file or FIFO can stand in for it
+ * so that the session lifecycle can be exercised without audit(4) support.
+ */
+struct pipe_backend {
+	bool	needs_auditd;
+	void	(*preselect)(int, au_mask_t *);
+	void	(*flush)(int);
+	void	(*counters)(int, struct audit_counters *);
+	au_asid_t (*isolate)(void);
+};
+
+static void file_preselect(int, au_mask_t *);
+static void file_flush(int);
+static void file_counters(int, struct audit_counters *);
+
+static const struct pipe_backend file_backend = {
+	.needs_auditd = false,
+	.preselect = file_preselect,
+	.flush = file_flush,
+	.counters = file_counters,
+};
+
+#ifdef __FreeBSD__
+static void auditpipe_preselect(int, au_mask_t *);
+static void auditpipe_flush(int);
+static void auditpipe_counters(int, struct audit_counters *);
+static au_asid_t auditpipe_isolate(void);
+
+static const struct pipe_backend auditpipe_backend = {
+	.needs_auditd = true,
+	.preselect = auditpipe_preselect,
+	.flush = auditpipe_flush,
+	.counters = auditpipe_counters,
+	.isolate = auditpipe_isolate,
+};
+
+static struct audit_session session = {
+	.backend = &auditpipe_backend,
+	.path = "/dev/auditpipe",
+};
+#else
+/* Without auditpipe(4), session_use_file() has to supply the records */
+static struct audit_session session = {
+	.backend = &file_backend,
+};
+#endif
+
+/*
+ * Whether auditd(8) runs is looked up once per test program, which holds a
+ * lease on it from then on until it exits, see lease_acquire()
+ */
+static struct {
+	const struct auditd_backend *backend;
+	bool		 probed;
+	bool		 leased;
+	pid_t		 owner;		/* Which forks as well */
+	bool		 atexit;	/* auditd_release() registered */
+} auditd = {
+	.backend = &auditd_pidfile,
+};
+
+/*
+ * The process that opened the session's pipe, which closes it when it
+ * exits, see session_atexit()
+ */
+static pid_t sessionowner;
+
+/* Every pattern compiled so far, see get_audit_regex() */
+static struct audit_regex *regexcache;
+
+/*
+ * Memory the records read from the pipe, and their text form, are kept in.
+ * Every slot of the ring and every matcher has its own, reused for every
+ * record and only grown, geometrically, when one does not fit, so that
+ * once the largest record has been seen draining the pipe performs no heap
+ * allocation. session.allocs counts the growths.
+ */
+#define ARENA_MINSIZE	4096
+
+struct record_text {
+	FILE		*stream;	/* Writes to text, see render_record() */
+	char		*text;
+	size_t		 size;
+};
+
+/*
+ * While a check runs, a reader thread does nothing but read records from
+ * the pipe into a ring, so that the pipe is drained at the rate it fills
+ * however long matching takes, and AUDIT_MATCHERS (default 2) threads
+ * match them against the batch. The records left in the ring when the
+ * check is over are the first ones the next check sees.
+ *
+ * Each time the pipe is readable, a single read(2) of up to READ_BUFSIZE
+ * bytes fetches as many records as are queued. A record cut short by the
+ * end of the buffer is completed by the next read.
+ */
+#define READ_BUFSIZE		(64 * 1024)
+#define RING_SLOTS		64
+#define DEFAULT_MATCHERS	2
+#define MAX_MATCHERS		64
+
+struct matcher {
+	pthread_t	 thread;
+	struct record_text text;
+	u_char		*lastrec;	/* Copy of the last rejected record */
+	size_t		 lastsize;
+	int		 lastlen;
+	uint64_t	 lastpos;
+	unsigned	 latency[LATENCY_BUCKETS];
+	int		 allocs;
+};
+
+static struct {
+	bool		 ready;
+	struct ring	 ring;
+	pthread_t	 reader;
+	int		 wakefd[2];	/* Interrupts the reader's poll(2) */
+	u_char		*buf;		/* What the reader's read(2) returned */
+	size_t		 bufsize;
+	size_t		 len;		/* Bytes of records not handed out */
+	struct timespec	 readtime;	/* Of the last read(2) */
+	int		 reads;		/* Calls returning records */
+	int		 foreign;	/* Records of other audit sessions */
+	int		 allocs;	/* By the reader */
+	struct matcher	*matchers;
+	int		 nmatchers;
+	struct audit_batch *batch;	/* Being checked */
+	atomic_bool	 failed;	/* A thread gave up, see drain_fail() */
+	char		 error[256];	/* Why the first one did */
+	pthread_mutex_t	 lock;		/* Wakes up the checking thread */
+	pthread_cond_t	 cond;
+} drain;
+
+/* The text form of the last record a failed check rejected */
+static struct record_text lasttext;
+
+/*
+ * Printing tokens looks up users and events through functions such as
+ * getpwuid(3) that are not thread-safe, so only one record is rendered at
+ * a time
+ */
+static pthread_mutex_t render_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * What a test expects to find in auditpipe(4): either a regular expression
+ * matched against the default text form of a record, or predicates that are
+ * evaluated directly on the fields of its BSM tokens.
+ */
+struct record_filter {
+	const struct audit_regex *regex;
+	struct audit_match	 match;
+	au_event_t		 event;		/* Resolved from match.event */
+	atomic_bool		 found;
+};
+
+/*
+ * Every record a check waits for. A single check is a set of one; a batch
+ * collects many and drains the pipe once for all of them.
+ */
+struct audit_batch {
+	struct record_filter	*filters;
+	int			 nfilters;
+	atomic_int		 nfound;
+	int			 cap;
+	u_char			*lastrec;	/* Last rejected record */
+	int			 lastlen;
+	uint64_t		 lastpos;
+	struct timespec		 since;		/* Start of the check */
+	bool			 async;		/* Records may trail the check */
+	atomic_bool		 overtaken;	/* A later record came first */
+};
+
+/*
+ * How long a check waits for its records, by audit_class. Classes whose
+ * records are emitted by another process get longer, everything else is
+ * expected well within DEFAULT_TIMEOUT. AUDIT_TIMEOUT in the environment,
+ * in (fractional) seconds, overrides the table.
+ */
+#define DEFAULT_TIMEOUT	5
+
+static const struct {
+	const char	*name;
+	time_t		 timeout;
+} class_timeouts[] = {
+	{ "no", 30 },		/* auditd(8) startup */
+	{ "ad", 10 },
+	{ "ex", 10 },
+	{ "pc", 10 },
+};
+
+/*
+ * Stop the check on behalf of the reader or a matcher. atf_tc_fail() writes
+ * the result of the test case and exits, which only the checking thread may
+ * do, so the first error is kept for check_auditpipe() to report.
+ */
+static void
+drain_fail(const char *fmt, ...)
+{
+	va_list ap;
+
+	pthread_mutex_lock(&drain.lock);
+	if (!atomic_load(&drain.failed)) {
+		va_start(ap, fmt);
+		vsnprintf(drain.error, sizeof(drain.error), fmt, ap);
+		va_end(ap);
+		atomic_store(&drain.failed, true);
+	}
+	pthread_cond_broadcast(&drain.cond);
+	pthread_mutex_unlock(&drain.lock);
+	ring_close(&drain.ring);
+}
+
+/*
+ * Make room for a record of "size" bytes in "*base", discarding the
+ * previous one, and count the growth in "allocs". Returns NULL, the check
+ * failed, if there is no memory left.
+ */
+static u_char *
+arena_reset(u_char **base, size_t *cursize, size_t size, int *allocs)
+{
+	u_char *newbase;
+	size_t newsize;
+
+	if (size > *cursize) {
+		newsize = (*cursize == 0) ? ARENA_MINSIZE : *cursize;
+		while (newsize < size)
+			newsize *= 2;
+		if ((newbase = realloc(*base, newsize)) == NULL) {
+			drain_fail("Cannot allocate %zu bytes", newsize);
+			return (NULL);
+		}
+		*base = newbase;
+		*cursize = newsize;
+		(*allocs)++;
+	}
+	return (*base);
+}
+
+/*
+ * Audit session ID of the subject token of the record. Returns false for a
+ * record without one.
+ */
+static bool
+record_session(u_char *buff, int reclen, au_asid_t *asid)
+{
+	tokenstr_t token;
+	int bytes = 0;
+
+	while (bytes < reclen) {
+		if (au_fetch_tok(&token, buff + bytes, reclen - bytes) == -1)
+			return (false);
+
+		switch (token.id) {
+		case AUT_SUBJECT32:
+			*asid = token.tt.subj32.sid;
+			return (true);
+		case AUT_SUBJECT32_EX:
+			*asid = token.tt.subj32_ex.sid;
+			return (true);
+		case AUT_SUBJECT64:
+			*asid = token.tt.subj64.sid;
+			return (true);
+		case AUT_SUBJECT64_EX:
+			*asid = token.tt.subj64_ex.sid;
+			return (true);
+		}
+		bytes += token.len;
+	}
+	return (false);
+}
+
+/*
+ * Hand the complete records at the start of the reader's buffer out to the
+ * matchers, and move whatever follows them to the front. Returns false if
+ * the ring was closed meanwhile, the records left over are then handed out
+ * by the next check, or if the buffer does not hold records at all.
  */
 static bool
-get_records(const char *auditregex, FILE *pipestream)
+split_records(void)
+{
+	struct ring_slot *slot;
+	u_char *rec, *end, *data;
+	size_t reclen;
+	au_asid_t asid;
+	bool open = true;
+
+	rec = drain.buf;
+	end = drain.buf + drain.len;
+	while (end - rec >= 5) {
+		/* Every kind of header stores the record length after its id */
+		switch (rec[0]) {
+		case AUT_HEADER32:
+		case AUT_HEADER32_EX:
+		case AUT_HEADER64:
+		case AUT_HEADER64_EX:
+			break;
+		default:
+			drain_fail("Audit record starting with token %#x",
+			    rec[0]);
+			return (false);
+		}
+		reclen = (size_t)rec[1] << 24 | (size_t)rec[2] << 16 |
+		    (size_t)rec[3] << 8 | rec[4];
+		if (reclen < 5 || reclen > INT_MAX) {
+			drain_fail("Audit record of %zu bytes", reclen);
+			return (false);
+		}
+		if ((size_t)(end - rec) < reclen)
+			break;
+
+		/* Records of concurrent test cases are none of our business */
+		if (session.asid != 0 &&
+		    record_session(rec, (int)reclen, &asid) &&
+		    asid != session.asid) {
+			drain.foreign++;
+			rec += reclen;
+			continue;
+		}
+
+		if ((slot = ring_reserve(&drain.ring)) == NULL) {
+			open = false;
+			break;
+		}
+		if ((data = arena_reset(&slot->data, &slot->size, reclen,
+		    &drain.allocs)) == NULL)
+			return (false);
+		memcpy(data, rec, reclen);
+		slot->len = (int)reclen;
+		slot->time = drain.readtime;
+		ring_publish(&drain.ring, slot);
+		rec += reclen;
+	}
+
+	drain.len = (size_t)(end - rec);
+	memmove(drain.buf, rec, drain.len);
+	return (open);
+}
+
+/*
+ * Render all tokens of an audit record in the default form into "text".
+ * The memory stream grows as required, so long records are never
+ * truncated. The text stays valid until the next call with "text", NULL
+ * is returned, the check failed, for a record that cannot be rendered.
+ */
+static const char *
+render_record(struct record_text *text, u_char *buff, int reclen,
+    int *allocs)
 {
-	uint8_t *buff;
 	tokenstr_t token;
-	ssize_t size = 1024;
-	char membuff[size];
 	char del[] = ",";
-	int reclen, bytes = 0;
-	FILE *memstream;
+	int bytes = 0;
 
-	/*
-	 * Open a stream on 'membuff' (address to memory buffer) for storing
-	 * the audit records in the default mode.'reclen' is the length of the
-	 * available records from auditpipe which is passed to the functions
-	 * au_fetch_tok(3) and au_print_flags_tok(3) for further use.
-	 */
-	ATF_REQUIRE((memstream = fmemopen(membuff, size, "w")) != NULL);
-	ATF_REQUIRE((reclen = au_read_rec(pipestream, &buff)) != -1);
+	if (text->stream == NULL) {
+		if ((text->stream = open_memstream(&text->text,
+		    &text->size)) == NULL) {
+			drain_fail("open_memstream: %s", strerror(errno));
+			return (NULL);
+		}
+		(*allocs)++;
+	}
+	rewind(text->stream);
+	pthread_mutex_lock(&render_lock);
 
 	/*
 	 * Iterate through each BSM token, extracting the bits that are
@@ -70,26 +420,454 @@ get_records(const char *auditregex, FILE *pipestream)
 	 */
 	while (bytes < reclen) {
 		if (au_fetch_tok(&token, buff + bytes, reclen - bytes) == -1) {
-			perror("au_read_rec");
-			atf_tc_fail("Incomplete Audit Record");
+			pthread_mutex_unlock(&render_lock);
+			drain_fail("Incomplete Audit Record");
+			return (NULL);
 		}
 
 		/* Print the tokens as they are obtained, in the default form */
-		au_print_flags_tok(memstream, &token, del, AU_OFLAG_NONE);
+		au_print_flags_tok(text->stream, &token, del, AU_OFLAG_NONE);
+		bytes += token.len;
+	}
+	pthread_mutex_unlock(&render_lock);
+
+	/* Rewinding leaves the text of a longer record behind */
+	if (fputc('\0', text->stream) == EOF || fflush(text->stream) != 0) {
+		drain_fail("Cannot render audit record: %s", strerror(errno));
+		return (NULL);
+	}
+	return (text->text);
+}
+
+/*
+ * Path tokens hold the absolute path, whereas tests mostly know the one
+ * relative to their working directory
+ */
+static bool
+path_endswith(const char *path, const char *suffix)
+{
+	size_t pathlen = strlen(path), suffixlen = strlen(suffix);
+
+	return (pathlen >= suffixlen &&
+	    strcmp(path + pathlen - suffixlen, suffix) == 0);
+}
+
+/*
+ * Walk the tokens of a record in place and evaluate the predicates of
+ * "filter" against their fields. Nothing is formatted as text here.
+ */
+static bool
+match_tokens(const struct record_filter *filter, u_char *buff, int reclen)
+{
+	const struct audit_match *match = &filter->match;
+	tokenstr_t token;
+	bool pathfound = (match->path == NULL);
+	bool argfound = (match->arg == 0);
+	int bytes = 0, status = -1, error;
+	uint32_t event = 0, pid = 0;
+
+	while (bytes < reclen) {
+		if (au_fetch_tok(&token, buff + bytes, reclen - bytes) == -1) {
+			drain_fail("Incomplete Audit Record");
+			return (false);
+		}
+
+		switch (token.id) {
+		case AUT_HEADER32:
+			event = token.tt.hdr32.e_type;
+			break;
+		case AUT_HEADER32_EX:
+			event = token.tt.hdr32_ex.e_type;
+			break;
+		case AUT_HEADER64:
+			event = token.tt.hdr64.e_type;
+			break;
+		case AUT_HEADER64_EX:
+			event = token.tt.hdr64_ex.e_type;
+			break;
+		case AUT_SUBJECT32:
+			pid = token.tt.subj32.pid;
+			break;
+		case AUT_SUBJECT32_EX:
+			pid = token.tt.subj32_ex.pid;
+			break;
+		case AUT_SUBJECT64:
+			pid = token.tt.subj64.pid;
+			break;
+		case AUT_SUBJECT64_EX:
+			pid = token.tt.subj64_ex.pid;
+			break;
+		case AUT_PATH:
+			if (!pathfound)
+				pathfound = path_endswith(token.tt.path.path,
+				    match->path);
+			break;
+		case AUT_ARG32:
+			if (!argfound && token.tt.arg32.no == match->arg)
+				argfound = (token.tt.arg32.val ==
+				    match->argval);
+			break;
+		case AUT_ARG64:
+			if (!argfound && token.tt.arg64.no == match->arg)
+				argfound = (token.tt.arg64.val ==
+				    match->argval);
+			break;
+		case AUT_RETURN32:
+			status = token.tt.ret32.status;
+			break;
+		case AUT_RETURN64:
+			status = token.tt.ret64.err;
+			break;
+		}
+
+		/* The header leads the record, bail out on a different event */
+		if (filter->event != 0 && event != filter->event)
+			return (false);
 		bytes += token.len;
 	}
 
-	free(buff);
+	if (!pathfound || !argfound ||
+	    (match->pid != 0 && pid != (uint32_t)match->pid))
+		return (false);
+
+	switch (match->status) {
+	case MATCH_SUCCESS:
+		return (status == 0);
+	case MATCH_FAILURE:
+		if (status <= 0)
+			return (false);
+		if (match->error == 0)
+			return (true);
+		return (au_bsm_to_errno(status, &error) == 0 &&
+		    error == match->error);
+	default:
+		return (true);
+	}
+}
+
+/*
+ * Time stamp of the header token leading the record, with the millisecond
+ * resolution BSM stores. Returns false for a record without a header.
+ */
+static bool
+record_time(u_char *buff, int reclen, struct timespec *ts)
+{
+	tokenstr_t token;
+
+	if (au_fetch_tok(&token, buff, reclen) == -1)
+		return (false);
+
+	switch (token.id) {
+	case AUT_HEADER32:
+		ts->tv_sec = token.tt.hdr32.s;
+		ts->tv_nsec = token.tt.hdr32.ms * 1000000L;
+		return (true);
+	case AUT_HEADER32_EX:
+		ts->tv_sec = token.tt.hdr32_ex.s;
+		ts->tv_nsec = token.tt.hdr32_ex.ms * 1000000L;
+		return (true);
+	case AUT_HEADER64:
+		ts->tv_sec = token.tt.hdr64.s;
+		ts->tv_nsec = token.tt.hdr64.ms * 1000000L;
+		return (true);
+	case AUT_HEADER64_EX:
+		ts->tv_sec = token.tt.hdr64_ex.s;
+		ts->tv_nsec = token.tt.hdr64_ex.ms * 1000000L;
+		return (true);
+	default:
+		return (false);
+	}
+}
+
+/*
+ * Nanoseconds from "start" to "end", negative if "end" comes first
+ */
+static long long
+timespec_diff(const struct timespec *start, const struct timespec *end)
+{
+	return ((long long)(end->tv_sec - start->tv_sec) * 1000000000LL +
+	    (end->tv_nsec - start->tv_nsec));
+}
+
+/*
+ * Account the time between the audited syscall and the delivery of its
+ * record to us in the log2 histogram "latency"
+ */
+static void
+record_latency(unsigned latency[], const struct timespec *rectime,
+    const struct timespec *now)
+{
+	long long msec;
+	int bucket = 0;
+
+	msec = timespec_diff(rectime, now) / 1000000;
+	while (msec > 0 && bucket < LATENCY_BUCKETS - 1) {
+		msec >>= 1;
+		bucket++;
+	}
+	latency[bucket]++;
+}
+
+/*
+ * Wake up the thread waiting for the batch to be checked
+ */
+static void
+drain_notify(void)
+{
+	pthread_mutex_lock(&drain.lock);
+	pthread_cond_broadcast(&drain.cond);
+	pthread_mutex_unlock(&drain.lock);
+}
+
+/*
+ * Find every expectation of "batch" still open that the record in "slot"
+ * meets, rendering the record at most once. Which one of them it satisfies
+ * is up to retire_record().
+ */
+static void
+match_record(struct matcher *matcher, struct audit_batch *batch,
+    struct ring_slot *slot)
+{
+	struct record_filter *filter;
+	const char *text = NULL;
+	u_char *hits;
+	size_t size;
+	int i;
+	bool found;
+
+	size = (size_t)batch->nfilters / 8 + 1;
+	if ((hits = arena_reset(&slot->hits, &slot->hitsize, size,
+	    &matcher->allocs)) == NULL)
+		return;
+	memset(hits, 0, size);
+
+	for (i = 0; i < batch->nfilters; i++) {
+		filter = &batch->filters[i];
+		if (atomic_load(&filter->found))
+			continue;
+
+		if (filter->regex != NULL) {
+			if (text == NULL && (text = render_record(
+			    &matcher->text, slot->data, slot->len,
+			    &matcher->allocs)) == NULL)
+				return;
+			found = match_audit_regex(filter->regex, text);
+		} else
+			found = match_tokens(filter, slot->data, slot->len);
+
+		if (found)
+			slot->hits[i / 8] |= 1 << (i % 8);
+	}
+}
+
+/*
+ * Called by ring_done() for every record once it and all the records before
+ * it have been matched, so one record at a time in the order of the pipe:
+ * the record satisfies the first expectation still open that it meets,
+ * exactly as if the records had been matched one after the other.
+ */
+static void
+retire_record(struct ring_slot *slot, uint64_t pos, void *arg)
+{
+	struct matcher *matcher = arg;
+	struct audit_batch *batch = drain.batch;
+	struct record_filter *filter;
+	struct timespec rectime;
+	u_char *lastrec;
+	int i;
+	bool dated;
+
+	/* The record may not have been matched at all */
+	if (atomic_load(&drain.failed))
+		return;
+
+	dated = record_time(slot->data, slot->len, &rectime);
+
+	for (i = 0; i < batch->nfilters; i++) {
+		filter = &batch->filters[i];
+		if (!(slot->hits[i / 8] & (1 << (i % 8))) ||
+		    atomic_load(&filter->found))
+			continue;
+
+		atomic_store(&filter->found, true);
+		if (dated)
+			record_latency(matcher->latency, &rectime, &slot->time);
+
+		/* Whatever comes after is left for the next check */
+		if (atomic_fetch_add(&batch->nfound, 1) + 1 == batch->nfilters)
+			ring_hold(&drain.ring, pos);
+		drain_notify();
+		return;
+	}
+
+	/*
+	 * auditpipe(4) delivers records in the order they were committed. The
+	 * syscalls we wait for returned before the check started, so once an
+	 * unmatched record of a syscall entered after that shows up, whatever
+	 * is still missing is not going to arrive at all.
+	 */
+	if (!batch->async && dated &&
+	    timespec_diff(&batch->since, &rectime) > 0) {
+		atomic_store(&batch->overtaken, true);
+		drain_notify();
+	}
+
+	/* Keep a copy around, it is rendered if the check times out */
+	if ((lastrec = arena_reset(&matcher->lastrec, &matcher->lastsize,
+	    (size_t)slot->len, &matcher->allocs)) == NULL)
+		return;
+	memcpy(lastrec, slot->data, slot->len);
+	matcher->lastlen = slot->len;
+	matcher->lastpos = pos;
+}
+
+/*
+ * Look "name" up in audit_event(5), either by its symbolic name such as
+ * AUE_SOCKET or by its description such as socket(2)
+ */
+static au_event_t
+get_event_number(const char *name)
+{
+	au_event_ent_t *event;
+	au_event_t number = 0;
+
+	setauevent();
+	while ((event = getauevent()) != NULL) {
+		if (strcmp(event->ae_name, name) == 0 ||
+		    strcmp(event->ae_desc, name) == 0) {
+			number = event->ae_number;
+			break;
+		}
+	}
+	endauevent();
+
+	ATF_REQUIRE_MSG(number != 0, "Unknown audit event: %s", name);
+	return (number);
+}
+
+/*
+ * Return the compiled form of "pattern", compiling it only the first time
+ * it is seen. Patterns are compared by value since callers such as open.c
+ * reuse a single buffer for different expressions.
+ */
+const struct audit_regex *
+get_audit_regex(const char *pattern)
+{
+	struct audit_regex *rgx;
+	char errbuf[128];
+	int error;
+
+	for (rgx = regexcache; rgx != NULL; rgx = rgx->next) {
+		if (strcmp(rgx->pattern, pattern) == 0)
+			return (rgx);
+	}
+
+	ATF_REQUIRE((rgx = malloc(sizeof(*rgx))) != NULL);
+	ATF_REQUIRE((rgx->pattern = strdup(pattern)) != NULL);
+	error = regcomp(&rgx->preg, pattern, REG_EXTENDED | REG_NOSUB);
+	if (error != 0) {
+		regerror(error, &rgx->preg, errbuf, sizeof(errbuf));
+		atf_tc_fail("Regex %s: %s", pattern, errbuf);
+	}
+
+	rgx->next = regexcache;
+	regexcache = rgx;
+	return (rgx);
+}
+
+bool
+match_audit_regex(const struct audit_regex *rgx, const char *str)
+{
+	return (regexec(&rgx->preg, str, 0, NULL, 0) == 0);
+}
+
+/*
+ * Name for a file, directory or socket the test case creates, made unique
+ * to the case by appending its pid to "base". Like the regular expressions
+ * built from it, it is kept for the lifetime of the test program.
+ */
+const char *
+fixture_name(const char *base)
+{
+	char *name;
+
+	ATF_REQUIRE(asprintf(&name, "%s.%d", base, (int)getpid()) != -1);
+	return (name);
+}
+
+/*
+ * Regular expression matching the record of a syscall on "name" that
+ * returned "outcome", i.e. "success" or "failure"
+ */
+const char *
+fixture_regex(const char *name, const char *outcome)
+{
+	char *pattern, *p;
+	const char *c;
+
+	/* Every character of the name may need escaping */
+	ATF_REQUIRE((pattern = malloc(2 * strlen(name) +
+	    strlen(".*return,") + strlen(outcome) + 1)) != NULL);
+	for (c = name, p = pattern; *c != '\0'; c++) {
+		if (strchr("\\^$.[]|()*+?{}", *c) != NULL)
+			*p++ = '\\';
+		*p++ = *c;
+	}
+	sprintf(p, ".*return,%s", outcome);
+	return (pattern);
+}
+
+/*
+ * Describe the expectation for failure messages
+ */
+static void
+describe_filter(const struct record_filter *filter, char *desc, size_t size)
+{
+	const struct audit_match *match = &filter->match;
+	static const char *status[] = { "any", "success", "failure" };
+
+	if (filter->regex != NULL) {
+		snprintf(desc, size, "%s", filter->regex->pattern);
+		return;
+	}
+
+	snprintf(desc, size, "event=%s status=%s errno=%d path=%s pid=%d "
+	    "arg%d=%#jx", match->event != NULL ? match->event : "any",
+	    status[match->status], match->error,
+	    match->path != NULL ? match->path : "any", (int)match->pid,
+	    match->arg, (uintmax_t)match->argval);
+}
+
+/*
+ * List every expectation of "batch" that was not met, one per line
+ */
+static char *
+describe_missing(const struct audit_batch *batch)
+{
+	char desc[256];
+	char *membuff;
+	size_t size;
+	int i;
+	FILE *memstream;
+
+	ATF_REQUIRE((memstream = open_memstream(&membuff, &size)) != NULL);
+	for (i = 0; i < batch->nfilters; i++) {
+		if (batch->filters[i].found)
+			continue;
+		describe_filter(&batch->filters[i], desc, sizeof(desc));
+		fprintf(memstream, "\n  %s", desc);
+	}
 	ATF_REQUIRE_EQ(0, fclose(memstream));
-	return (atf_utils_grep_string("%s", membuff, auditregex));
+	return (membuff);
 }
 
+#ifdef __FreeBSD__
 /*
  * Override the system-wide audit mask settings in /etc/security/audit_control
  * and set the auditpipe's maximum allowed queue length limit
  */
 static void
-set_preselect_mode(int filedesc, au_mask_t *fmask)
+auditpipe_preselect(int filedesc, au_mask_t *fmask)
 {
 	int qlimit_max;
 	int fmode = AUDITPIPE_PRESELECT_MODE_LOCAL;
@@ -113,129 +891,1092 @@ set_preselect_mode(int filedesc, au_mask_t *fmask)
 	/* Set the queue length limit as obtained from previous step */
 	if (ioctl(filedesc, AUDITPIPE_SET_QLIMIT, &qlimit_max) < 0)
 		atf_tc_fail("Set max-qlimit: %s", strerror(errno));
+}
 
-	/* This removes any outstanding record on the auditpipe */
+/*
+ * This removes any outstanding record on the auditpipe
+ */
+static void
+auditpipe_flush(int filedesc)
+{
 	if (ioctl(filedesc, AUDITPIPE_FLUSH) < 0)
 		atf_tc_fail("Auditpipe flush: %s", strerror(errno));
 }
 
 /*
- * Get the corresponding audit_mask for class-name "name" then set the
- * success and failure bits for fmask to be used as the ioctl argument
+ * Read the pipe's statistics, which count from the moment it was opened
  */
-static au_mask_t
-get_audit_mask(const char *name)
+static void
+auditpipe_counters(int filedesc, struct audit_counters *counters)
 {
-	au_mask_t fmask;
-	au_class_ent_t *class;
+	u_int64_t value;
+	u_int qlen;
 
-	ATF_REQUIRE((class = getauclassnam(name)) != NULL);
-	fmask.am_success = class->ac_class;
-	fmask.am_failure = class->ac_class;
-	return (fmask);
+	if (ioctl(filedesc, AUDITPIPE_GET_INSERTS, &value) < 0)
+		atf_tc_fail("Auditpipe inserts: %s", strerror(errno));
+	counters->inserts = value;
+	if (ioctl(filedesc, AUDITPIPE_GET_READS, &value) < 0)
+		atf_tc_fail("Auditpipe reads: %s", strerror(errno));
+	counters->reads = value;
+	if (ioctl(filedesc, AUDITPIPE_GET_DROPS, &value) < 0)
+		atf_tc_fail("Auditpipe drops: %s", strerror(errno));
+	counters->drops = value;
+	if (ioctl(filedesc, AUDITPIPE_GET_QLEN, &qlen) < 0)
+		atf_tc_fail("Auditpipe queue length: %s", strerror(errno));
+	counters->qlen = qlen;
 }
 
 /*
- * Loop until the auditpipe returns something, check if it is what
- * we want, else repeat the procedure until ppoll(2) times out.
+ * Move the test program, and whatever it forks from here on, to an audit
+ * session of its own, numbered after its pid so that it is unique among the
+ * test cases running at the same time. Its records can then be told apart
+ * from theirs by the subject token alone. setaudit_addr(2) stores the number
+ * as given, FreeBSD does not allocate one for AU_ASSIGN_ASID. The audit ID,
+ * the process mask and the terminal are inherited unchanged: which records
+ * the session sees is up to auditpipe(4)'s own preselection.
  */
-static void
-check_auditpipe(struct pollfd fd[], const char *auditregex, FILE *pipestream)
+static au_asid_t
+auditpipe_isolate(void)
 {
-	struct timespec currtime, endtime, timeout;
+	auditinfo_addr_t auinfo;
 
-	/* Set the expire time for poll(2) while waiting for syscall audit */
-	ATF_REQUIRE_EQ(0, clock_gettime(CLOCK_MONOTONIC, &endtime));
-	endtime.tv_sec += 10;
-	timeout.tv_nsec = endtime.tv_nsec;
-
-	for (;;) {
-		/* Update the time left for auditpipe to return any event */
-		ATF_REQUIRE_EQ(0, clock_gettime(CLOCK_MONOTONIC, &currtime));
-		timeout.tv_sec = endtime.tv_sec - currtime.tv_sec;
-
-		switch (ppoll(fd, 1, &timeout, NULL)) {
-		/* ppoll(2) returns, check if it's what we want */
-		case 1:
-			if (fd[0].revents & POLLIN) {
-				if (get_records(auditregex, pipestream))
-					return;
-			} else {
-				atf_tc_fail("Auditpipe returned an "
-				"unknown event %#x", fd[0].revents);
-			}
-			break;
+	if (getaudit_addr(&auinfo, sizeof(auinfo)) != 0)
+		atf_tc_fail("getaudit_addr: %s", strerror(errno));
+	auinfo.ai_asid = getpid();
+	if (setaudit_addr(&auinfo, sizeof(auinfo)) != 0)
+		atf_tc_fail("setaudit_addr: %s", strerror(errno));
+	return (auinfo.ai_asid);
+}
+
+#endif /* __FreeBSD__ */
+
+/*
+ * A file does not filter anything, every record written to it is returned
+ */
+static void
+file_preselect(int filedesc, au_mask_t *fmask)
+{
+}
+
+/*
+ * Skip past the records already present in the file-backed stand-in. For a
+ * FIFO, read and discard whatever is pending without blocking.
+ */
+static void
+file_flush(int filedesc)
+{
+	struct stat sb;
+	char discard[BUFSIZ];
+	int flags;
+
+	ATF_REQUIRE_EQ(0, fstat(filedesc, &sb));
+	if (S_ISREG(sb.st_mode)) {
+		ATF_REQUIRE(lseek(filedesc, 0, SEEK_END) != -1);
+		return;
+	}
+
+	ATF_REQUIRE((flags = fcntl(filedesc, F_GETFL)) != -1);
+	ATF_REQUIRE(fcntl(filedesc, F_SETFL, flags | O_NONBLOCK) != -1);
+	while (read(filedesc, discard, sizeof(discard)) > 0)
+		;
+	ATF_REQUIRE(fcntl(filedesc, F_SETFL, flags) != -1);
+}
+
+/*
+ * A file keeps no statistics. They are taken from "<path>.counters" when
+ * it exists, holding the inserts, reads, drops and queue length as decimal
+ * numbers, so that a test can play the part of the kernel.
+ */
+static void
+file_counters(int filedesc, struct audit_counters *counters)
+{
+	char *path;
+	uintmax_t inserts, reads, drops;
+	FILE *fp;
+
+	memset(counters, 0, sizeof(*counters));
+	ATF_REQUIRE(asprintf(&path, "%s.counters", session.path) != -1);
+	fp = fopen(path, "r");
+	free(path);
+	if (fp == NULL)
+		return;
+
+	ATF_REQUIRE_EQ(4, fscanf(fp, "%ju %ju %ju %u", &inserts, &reads,
+	    &drops, &counters->qlen));
+	counters->inserts = inserts;
+	counters->reads = reads;
+	counters->drops = drops;
+	ATF_REQUIRE_EQ(0, fclose(fp));
+}
+
+/*
+ * Get the corresponding audit_mask for class-name "name" then set the
+ * success and failure bits for fmask to be used as the ioctl argument
+ */
+static au_mask_t
+get_audit_mask(const char *name)
+{
+	au_mask_t fmask = { 0, 0 };
+	au_class_ent_t *class;
+	char *names, *next, *classname;
+
+	/* A comma separated list selects the union of its classes */
+	ATF_REQUIRE((names = strdup(name)) != NULL);
+	for (next = names; (classname = strsep(&next, ",")) != NULL; ) {
+		ATF_REQUIRE_MSG((class = getauclassnam(classname)) != NULL,
+		    "Unknown audit class: %s", classname);
+		fmask.am_success |= class->ac_class;
+		fmask.am_failure |= class->ac_class;
+	}
+	free(names);
+	return (fmask);
+}
+
+/*
+ * The deadline for checks of audit_class list "name": the longest of its
+ * classes in class_timeouts[], unless AUDIT_TIMEOUT says otherwise
+ */
+static struct timespec
+get_class_timeout(const char *name)
+{
+	struct timespec timeout = { DEFAULT_TIMEOUT, 0 };
+	const char *env;
+	char *names, *next, *classname, *end;
+	double seconds;
+	size_t i;
 
-		/* poll(2) timed out */
-		case 0:
-			atf_tc_fail("%s not found in auditpipe within the "
-					"time limit", auditregex);
+	if ((env = getenv("AUDIT_TIMEOUT")) != NULL) {
+		seconds = strtod(env, &end);
+		ATF_REQUIRE_MSG(end != env && *end == '\0' && seconds > 0,
+		    "Invalid AUDIT_TIMEOUT: %s", env);
+		timeout.tv_sec = (time_t)seconds;
+		timeout.tv_nsec = (long)((seconds - timeout.tv_sec) * 1e9);
+		return (timeout);
+	}
+
+	ATF_REQUIRE((names = strdup(name)) != NULL);
+	for (next = names; (classname = strsep(&next, ",")) != NULL; ) {
+		for (i = 0; i < sizeof(class_timeouts) /
+		    sizeof(class_timeouts[0]); i++) {
+			if (strcmp(class_timeouts[i].name, classname) == 0 &&
+			    class_timeouts[i].timeout > timeout.tv_sec)
+				timeout.tv_sec = class_timeouts[i].timeout;
+		}
+	}
+	free(names);
+	return (timeout);
+}
+
+/*
+ * Write the pipe's activity since session_setup() into "delta" and as a
+ * single line of "key=value" fields to the file named by AUDIT_COUNTERS if
+ * set, else to stderr, which ends up in the test case's report
+ */
+static void
+report_counters(const char *result, struct audit_counters *delta)
+{
+	const char *path;
+	FILE *fp = stderr;
+
+	session_counters(&session, delta);
+
+	if ((path = getenv("AUDIT_COUNTERS")) != NULL)
+		ATF_REQUIRE((fp = fopen(path, "a")) != NULL);
+
+	fprintf(fp, "auditpipe class=%s inserts=%ju reads=%ju drops=%ju "
+	    "qlen=%u result=%s\n", session.auclass, (uintmax_t)delta->inserts,
+	    (uintmax_t)delta->reads, (uintmax_t)delta->drops, delta->qlen,
+	    result);
+	if (fp != stderr)
+		ATF_REQUIRE_EQ(0, fclose(fp));
+}
+
+/*
+ * Fail the check, naming whatever expectation of "batch" is still missing
+ * along with what the pipe went through meanwhile
+ */
+static void
+report_missing(struct audit_batch *batch, const char *why)
+{
+	struct audit_counters delta;
+	char desc[256], stats[128];
+	const char *last;
+	char *missing;
+
+	report_counters("missing", &delta);
+	snprintf(stats, sizeof(stats), "auditpipe had %ju inserted, %ju read, "
+	    "%ju dropped, %u queued", (uintmax_t)delta.inserts,
+	    (uintmax_t)delta.reads, (uintmax_t)delta.drops, delta.qlen);
+
+	if (batch->nfilters > 1) {
+		missing = describe_missing(batch);
+		atf_tc_fail("%d of %d expected records not found in auditpipe "
+			"%s (%s):%s", batch->nfilters - batch->nfound,
+			batch->nfilters, why, stats, missing);
+	}
+
+	describe_filter(&batch->filters[0], desc, sizeof(desc));
+	if (batch->lastrec == NULL)
+		atf_tc_fail("%s not found in auditpipe %s (%s)", desc, why,
+			stats);
+
+	/* Only now is it worth rendering what we did see */
+	if ((last = render_record(&lasttext, batch->lastrec, batch->lastlen,
+	    &session.allocs)) == NULL)
+		last = drain.error;
+	atf_tc_fail("%s not found in auditpipe %s (%s), last record: %s",
+		desc, why, stats, last);
+}
+
+/*
+ * Fill the ring with the records of the pipe until it is closed
+ */
+static void *
+read_records(void *arg)
+{
+	struct pollfd *pipefd = arg;
+	struct pollfd fds[2];
+	struct timespec nap = { 0, 1000000 };
+	u_char *buf;
+	size_t size;
+	ssize_t n;
+
+	fds[0] = *pipefd;
+	fds[1].fd = drain.wakefd[0];
+	fds[1].events = POLLIN;
+
+	/* Records the previous check read but did not hand out come first */
+	while (split_records()) {
+		if (poll(fds, 2, -1) == -1) {
+			if (errno == EINTR)
+				continue;
+			drain_fail("Poll: %s", strerror(errno));
+			break;
+		}
+		if (fds[1].revents != 0)
 			break;
+		if (!(fds[0].revents & POLLIN)) {
+			drain_fail("Auditpipe returned an unknown event %#x",
+			    fds[0].revents);
+			break;
+		}
+
+		/* Only a record longer than the buffer can fill it */
+		if (drain.len == drain.bufsize) {
+			size = (drain.bufsize == 0) ? READ_BUFSIZE :
+			    drain.bufsize * 2;
+			if ((buf = realloc(drain.buf, size)) == NULL) {
+				drain_fail("Cannot allocate %zu bytes", size);
+				break;
+			}
+			drain.buf = buf;
+			drain.bufsize = size;
+			drain.allocs++;
+		}
 
-		/* poll(2) standard error */
-		case -1:
-			atf_tc_fail("Poll: %s", strerror(errno));
+		n = read(fds[0].fd, drain.buf + drain.len,
+		    drain.bufsize - drain.len);
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			drain_fail("Read: %s", strerror(errno));
 			break;
+		}
+		if (n == 0) {
+			/*
+			 * Only the file-backed stand-in can run dry, keep
+			 * polling in case another writer appends the record
+			 * we are waiting for, without starving the matchers.
+			 */
+			nanosleep(&nap, NULL);
+			continue;
+		}
+		(void)clock_gettime(CLOCK_REALTIME, &drain.readtime);
+		drain.len += (size_t)n;
+		drain.reads++;
+	}
+	return (NULL);
+}
 
-		default:
-			atf_tc_fail("Poll returned too many file descriptors");
+/*
+ * Match the records of the ring against the batch until it is closed
+ */
+static void *
+match_records(void *arg)
+{
+	struct matcher *matcher = arg;
+	struct audit_batch *batch = drain.batch;
+	struct ring_slot *slot;
+	uint64_t pos;
+
+	while ((slot = ring_take(&drain.ring, &pos)) != NULL) {
+		match_record(matcher, batch, slot);
+		ring_done(&drain.ring, slot, pos, matcher);
+	}
+	return (NULL);
+}
+
+/*
+ * Set up the ring and the matchers on first use
+ */
+static void
+drain_init(void)
+{
+	pthread_condattr_t attr;
+	const char *env;
+	char *end;
+	long nmatchers = DEFAULT_MATCHERS;
+
+	if ((env = getenv("AUDIT_MATCHERS")) != NULL) {
+		nmatchers = strtol(env, &end, 10);
+		ATF_REQUIRE_MSG(end != env && *end == '\0' && nmatchers > 0 &&
+		    nmatchers <= MAX_MATCHERS, "Invalid AUDIT_MATCHERS: %s",
+		    env);
+	}
+
+	ATF_REQUIRE_EQ(0, ring_init(&drain.ring, RING_SLOTS, retire_record));
+	ATF_REQUIRE_EQ(0, pipe(drain.wakefd));
+	ATF_REQUIRE_EQ(0, pthread_mutex_init(&drain.lock, NULL));
+	ATF_REQUIRE_EQ(0, pthread_condattr_init(&attr));
+	ATF_REQUIRE_EQ(0, pthread_condattr_setclock(&attr, CLOCK_MONOTONIC));
+	ATF_REQUIRE_EQ(0, pthread_cond_init(&drain.cond, &attr));
+	ATF_REQUIRE_EQ(0, pthread_condattr_destroy(&attr));
+	ATF_REQUIRE((drain.matchers = calloc(nmatchers,
+	    sizeof(*drain.matchers))) != NULL);
+	drain.nmatchers = (int)nmatchers;
+	drain.ready = true;
+}
+
+static void
+drain_destroy(void)
+{
+	struct matcher *matcher;
+	int i;
+
+	if (!drain.ready)
+		return;
+	for (i = 0; i < drain.nmatchers; i++) {
+		matcher = &drain.matchers[i];
+		if (matcher->text.stream != NULL)
+			ATF_REQUIRE_EQ(0, fclose(matcher->text.stream));
+		free(matcher->text.text);
+		free(matcher->lastrec);
+	}
+	free(drain.matchers);
+	free(drain.buf);
+	ATF_REQUIRE_EQ(0, close(drain.wakefd[0]));
+	ATF_REQUIRE_EQ(0, close(drain.wakefd[1]));
+	pthread_cond_destroy(&drain.cond);
+	pthread_mutex_destroy(&drain.lock);
+	ring_destroy(&drain.ring);
+	memset(&drain, 0, sizeof(drain));
+
+	if (lasttext.stream != NULL)
+		ATF_REQUIRE_EQ(0, fclose(lasttext.stream));
+	free(lasttext.text);
+	memset(&lasttext, 0, sizeof(lasttext));
+}
+
+/*
+ * Start the reader and the matchers on "batch"
+ */
+static void
+drain_start(struct pollfd fd[], struct audit_batch *batch)
+{
+	int i;
+
+	if (!drain.ready)
+		drain_init();
+	atomic_store(&batch->nfound, 0);
+	atomic_store(&batch->overtaken, false);
+	atomic_store(&drain.failed, false);
+	drain.batch = batch;
+
+	ATF_REQUIRE_EQ(0, pthread_create(&drain.reader, NULL, read_records,
+	    &fd[0]));
+	for (i = 0; i < drain.nmatchers; i++) {
+		drain.matchers[i].lastlen = 0;
+		ATF_REQUIRE_EQ(0, pthread_create(&drain.matchers[i].thread,
+		    NULL, match_records, &drain.matchers[i]));
+	}
+}
+
+/*
+ * Stop the threads, keeping the records after the last one meeting an
+ * expectation in the ring, and collect what the threads accounted
+ */
+static void
+drain_stop(struct audit_batch *batch)
+{
+	struct matcher *matcher;
+	char wake = 0;
+	int i, j;
+
+	ring_close(&drain.ring);
+	ATF_REQUIRE_EQ(1, write(drain.wakefd[1], &wake, 1));
+	ATF_REQUIRE_EQ(0, pthread_join(drain.reader, NULL));
+	for (i = 0; i < drain.nmatchers; i++)
+		ATF_REQUIRE_EQ(0, pthread_join(drain.matchers[i].thread,
+		    NULL));
+	ATF_REQUIRE_EQ(1, read(drain.wakefd[0], &wake, 1));
+	ring_rewind(&drain.ring);
+	drain.batch = NULL;
+
+	session.allocs += drain.allocs;
+	drain.allocs = 0;
+	session.reads += drain.reads;
+	drain.reads = 0;
+	session.foreign += drain.foreign;
+	drain.foreign = 0;
+	batch->lastrec = NULL;
+	for (i = 0; i < drain.nmatchers; i++) {
+		matcher = &drain.matchers[i];
+		for (j = 0; j < LATENCY_BUCKETS; j++)
+			session.latency[j] += matcher->latency[j];
+		memset(matcher->latency, 0, sizeof(matcher->latency));
+		session.allocs += matcher->allocs;
+		matcher->allocs = 0;
+
+		if (matcher->lastlen > 0 && (batch->lastrec == NULL ||
+		    matcher->lastpos > batch->lastpos)) {
+			batch->lastrec = matcher->lastrec;
+			batch->lastlen = matcher->lastlen;
+			batch->lastpos = matcher->lastpos;
+		}
+	}
+}
+
+/*
+ * Let the reader drain the pipe and the matchers check every record it
+ * returns until the batch is complete, the session's deadline passes or a
+ * record of a later syscall shows that ours will never come.
+ */
+static void
+check_auditpipe(struct pollfd fd[], struct audit_batch *batch,
+    FILE *pipestream)
+{
+	struct timespec endtime;
+	struct audit_counters delta;
+	const char *why = NULL;
+	int error = 0;
+
+	/* Set the deadline for the records of the syscalls audited so far */
+	ATF_REQUIRE_EQ(0, clock_gettime(CLOCK_REALTIME, &batch->since));
+	ATF_REQUIRE_EQ(0, clock_gettime(CLOCK_MONOTONIC, &endtime));
+	endtime.tv_sec += session.timeout.tv_sec;
+	endtime.tv_nsec += session.timeout.tv_nsec;
+	if (endtime.tv_nsec >= 1000000000L) {
+		endtime.tv_sec++;
+		endtime.tv_nsec -= 1000000000L;
+	}
+
+	drain_start(fd, batch);
+	pthread_mutex_lock(&drain.lock);
+	while (atomic_load(&batch->nfound) < batch->nfilters) {
+		if (atomic_load(&drain.failed))
+			break;
+		if (atomic_load(&batch->overtaken)) {
+			why = "before a later record";
+			break;
 		}
+		if (error == ETIMEDOUT) {
+			why = "within the time limit";
+			break;
+		}
+		error = pthread_cond_timedwait(&drain.cond, &drain.lock,
+		    &endtime);
 	}
+	pthread_mutex_unlock(&drain.lock);
+	drain_stop(batch);
+
+	/* Whatever the reader or a matcher ran into, reported from here */
+	if (atomic_load(&drain.failed))
+		atf_tc_fail("%s", drain.error);
+	if (why != NULL)
+		report_missing(batch, why);
+	if (!batch->async)
+		report_counters("found", &delta);
 }
 
 /*
  * Wrapper functions around static "check_auditpipe"
  */
 static void
-check_audit_startup(struct pollfd fd[], const char *auditrgx, FILE *pipestream){
-	check_auditpipe(fd, auditrgx, pipestream);
+check_audit_regex(struct pollfd fd[], const char *auditrgx, FILE *pipestream){
+	struct record_filter filter = { .regex = get_audit_regex(auditrgx) };
+	struct audit_batch batch = { .filters = &filter, .nfilters = 1 };
+
+	check_auditpipe(fd, &batch, pipestream);
+}
+
+static void
+check_audit_filter(struct pollfd fd[], const struct audit_match *match,
+    FILE *pipestream)
+{
+	struct record_filter filter = { .match = *match };
+	struct audit_batch batch = { .filters = &filter, .nfilters = 1 };
+
+	if (match->event != NULL)
+		filter.event = get_event_number(match->event);
+	check_auditpipe(fd, &batch, pipestream);
 }
 
+/*
+ * Replace the lookup and control of auditd(8), e.g. to exercise the logic
+ * below without it. Must be called before auditd_acquire().
+ */
 void
-check_audit(struct pollfd fd[], const char *auditrgx, FILE *pipestream) {
-	check_auditpipe(fd, auditrgx, pipestream);
+session_use_auditd(const struct auditd_backend *backend)
+{
+	auditd.backend = backend;
+	auditd.probed = false;
+	auditd.leased = false;
+}
 
-	/* Teardown: /dev/auditpipe's instance opened for this test-suite */
-	ATF_REQUIRE_EQ(0, fclose(pipestream));
+static void
+auditd_atexit(void)
+{
+	auditd_release();
 }
 
-FILE
-*setup(struct pollfd fd[], const char *name)
+/*
+ * Make sure auditd(8) runs and kernel auditing is on, starting it on the
+ * first call of the program if need be. Returns true if this call started
+ * it.
+ */
+bool
+auditd_acquire(void)
 {
-	au_mask_t fmask, nomask;
-	fmask = get_audit_mask(name);
-	nomask = get_audit_mask("no");
-	FILE *pipestream;
+	bool started;
+
+	if (auditd.probed)
+		return (false);
+	auditd.probed = true;
+	ATF_REQUIRE_MSG(lease_acquire(auditd.backend, getpid(), &started),
+	    "Cannot take a lease on auditd(8)");
+	auditd.leased = true;
+	auditd.owner = getpid();
+	if (!auditd.atexit) {
+		ATF_REQUIRE_EQ(0, atexit(auditd_atexit));
+		auditd.atexit = true;
+	}
+	return (started);
+}
+
+/*
+ * Return the program's lease, which stops auditd(8) if it was the last one
+ * and auditd(8) was started for the test-suite. Child processes, which
+ * exit(3) as well, leave it alone.
+ */
+void
+auditd_release(void)
+{
+	if (!auditd.leased || auditd.owner != getpid())
+		return;
+	auditd.leased = false;
+	if (!lease_release(auditd.backend, getpid()))
+		fprintf(stderr, "Cannot return the lease on auditd(8)\n");
+}
+
+/*
+ * Restart auditd(8) if it runs, so that it reads audit_control(5) again.
+ * One only the test program relied on is gone by the time its cleanup runs.
+ * The restart waits for the other test programs to return their leases and
+ * holds new ones back, see lease_restart().
+ */
+void
+auditd_restart(void)
+{
+	ATF_REQUIRE_MSG(lease_restart(auditd.backend),
+	    "Cannot restart auditd(8)");
+}
 
-	ATF_REQUIRE((fd[0].fd = open("/dev/auditpipe", O_RDONLY)) != -1);
-	ATF_REQUIRE((pipestream = fdopen(fd[0].fd, "r")) != NULL);
-	fd[0].events = POLLIN;
+/*
+ * Close the pipe when the test program exits. Child processes, which
+ * exit(3) as well, leave it to their parent.
+ */
+static void
+session_atexit(void)
+{
+	if (sessionowner == getpid())
+		session_close();
+}
+
+/*
+ * Open the session's pipe once per test program. Whether or not auditd(8)
+ * was running already, we wait for kernel auditing to be on, see
+ * auditd_acquire(). If it was started here, we wait for its startup record
+ * to arrive as well.
+ * From then on, only the records of the program's own audit session are
+ * matched, see auditpipe_isolate().
+ */
+static void
+session_open(void)
+{
+	struct record_filter startup = {
+		.regex = get_audit_regex("audit startup"),
+	};
+	struct audit_batch batch = {
+		.filters = &startup,
+		.nfilters = 1,
+		.async = true,
+	};
+	au_mask_t nomask;
+
+	ATF_REQUIRE_MSG(session.path != NULL, "No auditpipe(4) available");
+	ATF_REQUIRE((session.fds[0].fd = open(session.path, O_RDONLY)) != -1);
+	ATF_REQUIRE((session.pipestream = fdopen(session.fds[0].fd, "r"))
+		!= NULL);
+	session.fds[0].events = POLLIN;
+	session.opens++;
 
 	/*
-	 * Disable stream buffering for read operations from /dev/auditpipe.
-	 * Otherwise it is possible that fread(3), called via au_read_rec(3),
-	 * can store buffered data in user-space unbeknown to ppoll(2), which
-	 * as a result, reports that /dev/auditpipe is empty.
+	 * The records are read from the descriptor, see read_records().
+	 * Disable stream buffering for anyone reading /dev/auditpipe through
+	 * the stream setup() returns, so that it never holds data in
+	 * user-space unbeknown to ppoll(2).
 	 */
-	ATF_REQUIRE_EQ(0, setvbuf(pipestream, NULL, _IONBF, 0));
+	ATF_REQUIRE_EQ(0, setvbuf(session.pipestream, NULL, _IONBF, 0));
+
+	if (session.backend->needs_auditd) {
+		/* Preselect audit_class "no" for the audit startup record */
+		nomask = get_audit_mask("no");
+		session.backend->preselect(session.fds[0].fd, &nomask);
+		session.backend->flush(session.fds[0].fd);
+
+		/*
+		 * The startup record of an auditd(8) we started is written
+		 * after it went to the background, so records of other
+		 * processes may well overtake it.
+		 */
+		if (auditd_acquire()) {
+			session.timeout = get_class_timeout("no");
+			check_auditpipe(session.fds, &batch,
+			    session.pipestream);
+		}
+
+		/* Leave the records of auditd(8) and other programs out */
+		session.asid = session.backend->isolate();
+	}
+
+	/*
+	 * Registered after auditd_acquire()'s handler, so that the pipe is
+	 * closed before the lease on auditd(8) is returned
+	 */
+	if (sessionowner == 0)
+		ATF_REQUIRE_EQ(0, atexit(session_atexit));
+	sessionowner = getpid();
+}
+
+/*
+ * Replace /dev/auditpipe with the regular file or FIFO at "path". Must be
+ * called before the first session_setup() of the test program.
+ */
+void
+session_use_file(const char *path)
+{
+	ATF_REQUIRE(session.pipestream == NULL);
+	session.backend = &file_backend;
+	session.path = path;
+}
 
-	/* Set local preselection audit_class as "no" for audit startup */
-	set_preselect_mode(fd[0].fd, &nomask);
-	ATF_REQUIRE_EQ(0, system("service auditd onestatus || \
-	{ service auditd onestart && touch started_auditd ; }"));
+/*
+ * Prepare the session for a test case of audit_class "name", opening the
+ * pipe on first use and discarding any record queued before this point.
+ */
+struct audit_session *
+session_setup(const char *name)
+{
+	au_mask_t fmask;
 
-	/* If 'started_auditd' exists, that means we started auditd(8) */
-	if (atf_utils_file_exists("started_auditd"))
-		check_audit_startup(fd, "audit startup", pipestream);
+	fmask = get_audit_mask(name);
+	if (session.pipestream == NULL)
+		session_open();
 
 	/* Set local preselection parameters specific to "name" audit_class */
-	set_preselect_mode(fd[0].fd, &fmask);
-	return (pipestream);
+	session.backend->preselect(session.fds[0].fd, &fmask);
+	session.rearms++;
+	session.backend->flush(session.fds[0].fd);
+	if (drain.ready) {
+		ring_clear(&drain.ring);
+		drain.len = 0;
+	}
+	session.flushes++;
+	session.timeout = get_class_timeout(name);
+
+	/* Whatever the pipe does from here on is down to this test case */
+	free(session.auclass);
+	ATF_REQUIRE((session.auclass = strdup(name)) != NULL);
+	session.backend->counters(session.fds[0].fd, &session.counters);
+	return (&session);
+}
+
+/*
+ * Activity of the pipe since the last session_setup(). The queue length
+ * is not a counter, it is the current one.
+ */
+void
+session_counters(struct audit_session *sess, struct audit_counters *delta)
+{
+	struct audit_counters now;
+
+	sess->backend->counters(sess->fds[0].fd, &now);
+	delta->inserts = now.inserts - sess->counters.inserts;
+	delta->reads = now.reads - sess->counters.reads;
+	delta->drops = now.drops - sess->counters.drops;
+	delta->qlen = now.qlen;
+}
+
+/*
+ * Give the checks of the current test case "timeout" instead of the default
+ * of its audit_class, until the next session_setup()
+ */
+void
+session_set_timeout(struct audit_session *sess, const struct timespec *timeout)
+{
+	sess->timeout = *timeout;
+}
+
+/*
+ * Check for "auditrgx" without giving up the pipe for subsequent test cases
+ */
+void
+session_check(struct audit_session *sess, const char *auditrgx)
+{
+	check_audit_regex(sess->fds, auditrgx, sess->pipestream);
+}
+
+/*
+ * Same as session_check(), but with predicates on the record's tokens
+ */
+void
+session_check_match(struct audit_session *sess,
+    const struct audit_match *match)
+{
+	check_audit_filter(sess->fds, match, sess->pipestream);
+}
+
+/*
+ * Start an empty set of expectations, to be filled with batch_expect() and
+ * batch_expect_match() before the triggering code runs
+ */
+struct audit_batch *
+batch_new(void)
+{
+	struct audit_batch *batch;
+
+	ATF_REQUIRE((batch = calloc(1, sizeof(*batch))) != NULL);
+	return (batch);
+}
+
+static struct record_filter *
+batch_add(struct audit_batch *batch)
+{
+	struct record_filter *filters;
+
+	if (batch->nfilters == batch->cap) {
+		batch->cap = (batch->cap == 0) ? 16 : batch->cap * 2;
+		ATF_REQUIRE((filters = realloc(batch->filters,
+		    batch->cap * sizeof(*filters))) != NULL);
+		batch->filters = filters;
+	}
+	filters = &batch->filters[batch->nfilters++];
+	memset(filters, 0, sizeof(*filters));
+	return (filters);
+}
+
+/*
+ * Expect a record matching "auditrgx". Each expectation is met by its own
+ * record, so the same pattern can be added once per expected occurrence.
+ */
+void
+batch_expect(struct audit_batch *batch, const char *auditrgx)
+{
+	batch_add(batch)->regex = get_audit_regex(auditrgx);
+}
+
+/*
+ * Expect a record matching the predicates of "match", which is copied.
+ * The strings it points to must stay valid until the batch is checked.
+ */
+void
+batch_expect_match(struct audit_batch *batch, const struct audit_match *match)
+{
+	struct record_filter *filter;
+
+	filter = batch_add(batch);
+	filter->match = *match;
+	if (match->event != NULL)
+		filter->event = get_event_number(match->event);
+}
+
+/*
+ * Drain the pipe once until every expectation of "batch" has been met,
+ * failing with the list of missing records otherwise. Frees "batch".
+ */
+void
+session_check_batch(struct audit_session *sess, struct audit_batch *batch)
+{
+	ATF_REQUIRE(batch->nfilters > 0);
+	check_auditpipe(sess->fds, batch, sess->pipestream);
+	free(batch->filters);
+	free(batch);
+}
+
+/*
+ * Test tables registered by audit_cases_add(). A test case finds its row
+ * by its identifier.
+ */
+struct case_table {
+	const char	*auclass;
+	const struct audit_case *cases;
+	size_t		 ncases;
+	atf_tc_t	*tcs;		/* One per row */
+	struct case_table *next;
+};
+
+static struct case_table *casetables;
+
+/*
+ * Preconditions for the rows of test tables: a regular file, or a symbolic
+ * link to a file that does not exist
+ */
+int
+case_file(const char *path)
+{
+	int filedesc;
+
+	ATF_REQUIRE((filedesc = open(path, O_CREAT, 0600)) != -1);
+	return (filedesc);
+}
+
+int
+case_symlink(const char *path)
+{
+	ATF_REQUIRE_EQ(0, symlink("symlink", path));
+	return (-1);
+}
+
+/*
+ * Look up the table and the row of test case "tc"
+ */
+static const struct case_table *
+find_case(const atf_tc_t *tc, const struct audit_case **row)
+{
+	const struct case_table *table;
+	const char *ident;
+	size_t i;
+
+	ident = atf_tc_get_ident(tc);
+	for (table = casetables; table != NULL; table = table->next) {
+		for (i = 0; i < table->ncases; i++) {
+			*row = &table->cases[i];
+			if (strcmp((*row)->name, ident) == 0)
+				return (table);
+		}
+	}
+	atf_tc_fail("No test table has a case %s", ident);
+}
+
+static void
+case_head(atf_tc_t *tc)
+{
+	const struct audit_case *row;
+
+	(void)find_case(tc, &row);
+	atf_tc_set_md_var(tc, "descr", "Tests the audit of %s %s call",
+	    row->match.status == MATCH_FAILURE ?
+	    "an unsuccessful" : "a successful", row->match.event);
+}
+
+static void
+case_body(const atf_tc_t *tc)
+{
+	const struct case_table *table;
+	const struct audit_case *row;
+
+	table = find_case(tc, &row);
+	run_audit_cases(table->auclass, row, 1);
+}
+
+static void
+case_cleanup(const atf_tc_t *tc)
+{
+	cleanup();
+}
+
+/*
+ * Register the "ncases" rows of "cases" with "tp" as test cases of
+ * audit_class "auclass", the same way ATF_TP_ADD_TC() does for static ones.
+ * Call through AUDIT_TP_ADD_CASES(); the rows must outlive the program.
+ */
+atf_error_t
+audit_cases_add(atf_tp_t *tp, const char *auclass,
+    const struct audit_case *cases, size_t ncases)
+{
+	struct case_table *table;
+	atf_error_t error;
+	char **config;
+	size_t i;
+
+	if ((table = calloc(1, sizeof(*table))) == NULL ||
+	    (table->tcs = calloc(ncases, sizeof(*table->tcs))) == NULL)
+		return (atf_no_memory_error());
+	table->auclass = auclass;
+	table->cases = cases;
+	table->ncases = ncases;
+	table->next = casetables;
+	casetables = table;
+
+	if ((config = atf_tp_get_config(tp)) == NULL)
+		return (atf_no_memory_error());
+	error = atf_no_error();
+	for (i = 0; i < ncases && !atf_is_error(error); i++) {
+		error = atf_tc_init(&table->tcs[i], cases[i].name, case_head,
+		    case_body, case_cleanup, (const char *const *)config);
+		if (!atf_is_error(error))
+			error = atf_tp_add_tc(tp, &table->tcs[i]);
+	}
+	atf_utils_free_charpp(config);
+	return (error);
+}
+
+/*
+ * Run the "ncases" rows of "cases" in a single session of audit_class
+ * "auclass". Every fixture is prepared before the pipe is flushed, so
+ * that their own records are out of the way, and every call made before
+ * the records are checked.
+ */
+void
+run_audit_cases(const char *auclass, const struct audit_case *cases,
+    size_t ncases)
+{
+	struct audit_session *sess;
+	struct audit_batch *batch;
+	struct audit_match match;
+	const char **paths;
+	int *filedescs;
+	size_t i;
+	int ret;
+
+	ATF_REQUIRE((paths = calloc(ncases, sizeof(*paths))) != NULL);
+	ATF_REQUIRE((filedescs = calloc(ncases, sizeof(*filedescs))) != NULL);
+	for (i = 0; i < ncases; i++) {
+		paths[i] = fixture_name(cases[i].name);
+		if (cases[i].prepare != NULL)
+			filedescs[i] = cases[i].prepare(paths[i]);
+		else if (cases[i].match.status != MATCH_FAILURE)
+			filedescs[i] = AT_FDCWD;
+		else
+			filedescs[i] = -1;
+	}
+
+	sess = session_setup(auclass);
+	batch = batch_new();
+	for (i = 0; i < ncases; i++) {
+		match = cases[i].match;
+		match.pid = getpid();
+		if (cases[i].named)
+			match.path = paths[i];
+		batch_expect_match(batch, &match);
+	}
+
+	for (i = 0; i < ncases; i++) {
+		errno = 0;
+		ret = cases[i].call(paths[i], filedescs[i]);
+		if (cases[i].match.status != MATCH_FAILURE)
+			ATF_REQUIRE_MSG(ret != -1, "%s: %s", cases[i].name,
+			    strerror(errno));
+		else if (ret != -1)
+			atf_tc_fail("%s: Unexpected success", cases[i].name);
+		else if (cases[i].match.error != 0)
+			ATF_REQUIRE_EQ_MSG(cases[i].match.error, errno,
+			    "%s: %s", cases[i].name, strerror(errno));
+	}
+
+	session_check_batch(sess, batch);
+	for (i = 0; i < ncases; i++) {
+		if (filedescs[i] >= 0)
+			close(filedescs[i]);
+	}
+	free(filedescs);
+	free(paths);
+}
+
+/*
+ * Print the latency histogram of the records matched since the pipe was
+ * opened to stderr, which ends up in the test case's report
+ */
+static void
+report_latency(void)
+{
+	unsigned total = 0;
+	int i;
+
+	for (i = 0; i < LATENCY_BUCKETS; i++)
+		total += session.latency[i];
+	if (total == 0)
+		return;
+
+	fprintf(stderr, "Syscall to auditpipe delivery latency, %u records:\n",
+	    total);
+	for (i = 0; i < LATENCY_BUCKETS; i++) {
+		if (session.latency[i] == 0)
+			continue;
+		if (i == 0)
+			fprintf(stderr, "  < 1 ms: %u\n", session.latency[i]);
+		else if (i == LATENCY_BUCKETS - 1)
+			fprintf(stderr, "  >= %d ms: %u\n", 1 << (i - 1),
+			    session.latency[i]);
+		else
+			fprintf(stderr, "  %d-%d ms: %u\n", 1 << (i - 1),
+			    1 << i, session.latency[i]);
+	}
+	memset(session.latency, 0, sizeof(session.latency));
+}
+
+/*
+ * Teardown: /dev/auditpipe's instance opened for this test-suite. The
+ * pipe is given up when the test program exits, see session_atexit().
+ */
+void
+session_close(void)
+{
+	if (session.pipestream == NULL)
+		return;
+
+	report_latency();
+	ATF_REQUIRE_EQ(0, fclose(session.pipestream));
+	session.pipestream = NULL;
+	session.fds[0].fd = -1;
+
+	drain_destroy();
+}
+
+void
+check_audit(struct pollfd fd[], const char *auditrgx, FILE *pipestream) {
+	check_audit_regex(fd, auditrgx, pipestream);
+}
+
+void
+check_audit_match(struct pollfd fd[], const struct audit_match *match,
+    FILE *pipestream)
+{
+	check_audit_filter(fd, match, pipestream);
+}
+
+FILE
+*setup(struct pollfd fd[], const char *name)
+{
+	struct audit_session *sess;
+
+	sess = session_setup(name);
+	fd[0] = sess->fds[0];
+	return (sess->pipestream);
 }
 
 void
 cleanup(void)
 {
-	if (atf_utils_file_exists("started_auditd"))
-		system("service auditd onestop > /dev/null 2>&1");
+	auditd_release();
 }
@@ -29,13 +29,168 @@
 #ifndef _UTILS_H_
 #define _UTILS_H_
 
+#include <atf-c.h>
 #include <poll.h>
+#include <regex.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
 #include <bsm/audit.h>
 
+/*
+ * Buckets of the syscall to delivery latency histogram: the first counts
+ * records delivered within 1 ms, bucket i those within [2^(i-1), 2^i) ms
+ * and the last one everything slower.
+ */
+#define LATENCY_BUCKETS	16
+
+/*
+ * Activity counters of the pipe. Between two snapshots they tell whether a
+ * missing record was never generated, or generated and dropped under load.
+ */
+struct audit_counters {
+	uint64_t	 inserts;	/* Records queued to the pipe */
+	uint64_t	 reads;		/* Records read from it */
+	uint64_t	 drops;		/* Records lost to a full queue */
+	unsigned	 qlen;		/* Records waiting to be read */
+};
+
+/*
+ * A session keeps a single auditpipe(4) instance open for the lifetime of
+ * the test program. Every test case re-arms the preselection flags for its
+ * own audit_class and flushes whatever records the previous case left over.
+ * The counters are exposed so that the lifecycle itself can be verified.
+ */
+struct audit_session {
+	struct pollfd	 fds[1];
+	FILE		*pipestream;
+	const struct pipe_backend *backend;
+	const char	*path;
+	int		 opens;		/* Number of times the pipe was opened */
+	int		 rearms;	/* Number of preselection flag updates */
+	int		 flushes;	/* Number of discarded record queues */
+	int		 allocs;	/* Growths of the record buffers */
+	int		 reads;		/* read(2) calls returning records */
+	int		 foreign;	/* Records of other audit sessions skipped */
+	au_asid_t	 asid;		/* Audit session of the test, 0 if shared */
+	struct timespec	 timeout;	/* How long a check waits for records */
+	unsigned	 latency[LATENCY_BUCKETS];	/* Of matched records */
+	char		*auclass;	/* audit_class of the current case */
+	struct audit_counters counters;	/* Snapshot taken at setup */
+};
+
+/* Return status of the audited system call */
+#define MATCH_ANY	0
+#define MATCH_SUCCESS	1
+#define MATCH_FAILURE	2
+
+/*
+ * Predicates evaluated directly on the BSM tokens of an audit record,
+ * unset members (NULL or 0) match anything.
+ */
+struct audit_match {
+	const char	*event;		/* AUE_* name or event description */
+	int		 status;	/* One of the MATCH_* values */
+	int		 error;		/* errno(2) value of a failed call */
+	const char	*path;		/* Suffix of any path token */
+	pid_t		 pid;		/* Process ID of the subject token */
+	int		 arg;		/* Number of an argument token */
+	uint64_t	 argval;	/* Value of argument "arg" */
+};
+
+/*
+ * A row of a test table. The fixture of the row, if any, is created at
+ * "path" by "prepare", which returns its descriptor or -1. "call" is then
+ * given both and must return -1 exactly when "match" expects a failure. A
+ * row without a fixture is given AT_FDCWD if it expects a success and -1
+ * otherwise, so that a single call can serve both rows of a pair.
+ */
+struct audit_case {
+	const char	*name;		/* Test case identifier */
+	int		(*prepare)(const char *);
+	int		(*call)(const char *, int);
+	struct audit_match match;	/* Expected record, pid and path aside */
+	bool		 named;		/* Whether the record names the path */
+};
+
+/*
+ * The success and failure rows of syscall "call", both made by a
+ * call_<call>() of the test program. "err" is the errno(2) expected of the
+ * failure, 0 accepts any.
+ */
+#define AUDIT_CASE_SUCCESS(call, prepare, named)			\
+	{ #call "_success", (prepare), call_##call,			\
+	    { .event = #call "(2)", .status = MATCH_SUCCESS }, (named) }
+#define AUDIT_CASE_FAILURE(call, prepare, err, named)			\
+	{ #call "_failure", (prepare), call_##call,			\
+	    { .event = #call "(2)", .status = MATCH_FAILURE,		\
+	    .error = (err) }, (named) }
+
+/*
+ * Register every row of "cases" as a test case of its own, see
+ * audit_cases_add()
+ */
+#define AUDIT_TP_ADD_CASES(tp, auclass, cases) do {			\
+	atf_error_t atfu_err;						\
+	atfu_err = audit_cases_add((tp), (auclass), (cases),		\
+	    sizeof(cases) / sizeof((cases)[0]));			\
+	if (atf_is_error(atfu_err))					\
+		return (atfu_err);					\
+} while (0)
+
+/*
+ * A regular expression compiled on first use and shared by every later
+ * check of the test program with an identical pattern
+ */
+struct audit_regex {
+	char		*pattern;
+	regex_t		 preg;
+	struct audit_regex *next;
+};
+
+/* Records expected from a single run of the triggering code */
+struct audit_batch;
+
+/* How auditd(8) is looked up and controlled, see auditd.h */
+struct auditd_backend;
+
+const struct audit_regex *get_audit_regex(const char *);
+bool match_audit_regex(const struct audit_regex *, const char *);
+
+/*
+ * Call from ATF_TP_ADD_TCS(), which runs in the process of the test case
+ * itself, to name the fixtures of the program's test cases
+ */
+const char *fixture_name(const char *);
+const char *fixture_regex(const char *, const char *);
+
+int case_file(const char *);
+int case_symlink(const char *);
+atf_error_t audit_cases_add(atf_tp_t *, const char *,
+    const struct audit_case *, size_t);
+void run_audit_cases(const char *, const struct audit_case *, size_t);
+
 void check_audit(struct pollfd [], const char *, FILE *);
+void check_audit_match(struct pollfd [], const struct audit_match *, FILE *);
 FILE *setup(struct pollfd [], const char *);
 void cleanup(void);
 
+void session_use_file(const char *);
+void session_use_auditd(const struct auditd_backend *);
+bool auditd_acquire(void);
+void auditd_release(void);
+void auditd_restart(void);
+struct audit_session *session_setup(const char *);
+void session_set_timeout(struct audit_session *, const struct timespec *);
+void session_counters(struct audit_session *, struct audit_counters *);
+void session_check(struct audit_session *, const char *);
+void session_check_match(struct audit_session *, const struct audit_match *);
+void session_close(void);
+
+struct audit_batch *batch_new(void);
+void batch_expect(struct audit_batch *, const char *);
+void batch_expect_match(struct audit_batch *, const struct audit_match *);
+void session_check_batch(struct audit_session *, struct audit_batch *);
+
 #endif  /* _SETUP_H_ */
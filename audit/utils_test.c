@@ -0,0 +1,1065 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * Tests for the harness in utils.c itself. A regular file stands in for
+ * auditpipe(4), so neither auditd(8) nor root privileges are needed.
+ */
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <atf-c.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "auditd.h"
+#include "ring.h"
+#include "utils.h"
+
+static struct pollfd fds[1];
+static const char *pipepath = "auditpipe";
+static const char *counterpath = "auditpipe.counters";
+static const char *socketreg = "socket.*return,success";
+
+/*
+ * The socket(2) record of praudit's "trail" input, 113 bytes long
+ */
+static const unsigned char socketrec[] = {
+	0x14, 0x00, 0x00, 0x00, 0x71, 0x0b, 0x00, 0xb7, 0x00, 0x00, 0x5b, 0x1e,
+	0x4c, 0x85, 0x00, 0x00, 0x01, 0x7c, 0x2d, 0x01, 0x00, 0x00, 0x00, 0x1c,
+	0x00, 0x07, 0x64, 0x6f, 0x6d, 0x61, 0x69, 0x6e, 0x00, 0x2d, 0x02, 0x00,
+	0x00, 0x00, 0x02, 0x00, 0x05, 0x74, 0x79, 0x70, 0x65, 0x00, 0x2d, 0x03,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x70, 0x72, 0x6f, 0x74, 0x6f, 0x63,
+	0x6f, 0x6c, 0x00, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x1b, 0x8d, 0x00, 0x00, 0x12, 0x74, 0x00, 0x00, 0x93, 0x04,
+	0x0a, 0x00, 0x02, 0x02, 0x27, 0x00, 0x00, 0x00, 0x00, 0x03, 0x13, 0xb1,
+	0x05, 0x00, 0x00, 0x00, 0x71
+};
+
+/*
+ * Append the socket(2) record to the file standing in for auditpipe(4),
+ * with the header's time stamp replaced by "sec", the subject's process by
+ * "pid" and its audit session by "asid" unless they are zero
+ */
+static void
+append_record_as(time_t sec, pid_t pid, au_asid_t asid)
+{
+	unsigned char record[sizeof(socketrec)];
+	int filedesc;
+
+	memcpy(record, socketrec, sizeof(record));
+	if (sec != 0) {
+		record[10] = (sec >> 24) & 0xff;
+		record[11] = (sec >> 16) & 0xff;
+		record[12] = (sec >> 8) & 0xff;
+		record[13] = sec & 0xff;
+	}
+	if (pid != 0) {
+		record[84] = (pid >> 24) & 0xff;
+		record[85] = (pid >> 16) & 0xff;
+		record[86] = (pid >> 8) & 0xff;
+		record[87] = pid & 0xff;
+	}
+	if (asid != 0) {
+		record[88] = (asid >> 24) & 0xff;
+		record[89] = (asid >> 16) & 0xff;
+		record[90] = (asid >> 8) & 0xff;
+		record[91] = asid & 0xff;
+	}
+
+	ATF_REQUIRE((filedesc = open(pipepath, O_WRONLY | O_APPEND)) != -1);
+	ATF_REQUIRE_EQ((ssize_t)sizeof(record),
+		write(filedesc, record, sizeof(record)));
+	ATF_REQUIRE_EQ(0, close(filedesc));
+}
+
+static void
+append_record_at(time_t sec)
+{
+	append_record_as(sec, 0, 0);
+}
+
+static void
+append_record(void)
+{
+	append_record_as(0, 0, 0);
+}
+
+
+ATF_TC_WITHOUT_HEAD(session_lifecycle);
+ATF_TC_BODY(session_lifecycle, tc)
+{
+	struct audit_session *sess;
+
+	atf_utils_create_file(pipepath, "%s", "");
+	session_use_file(pipepath);
+
+	sess = session_setup("nt");
+	append_record();
+	session_check(sess, socketreg);
+
+	/* The second case reuses the pipe but re-arms and flushes it */
+	sess = session_setup("fr");
+	ATF_REQUIRE_EQ(1, sess->opens);
+	ATF_REQUIRE_EQ(2, sess->rearms);
+	ATF_REQUIRE_EQ(2, sess->flushes);
+	append_record();
+	session_check(sess, socketreg);
+
+	session_close();
+	ATF_REQUIRE_EQ(NULL, sess->pipestream);
+}
+
+
+ATF_TC_WITHOUT_HEAD(session_flush);
+ATF_TC_BODY(session_flush, tc)
+{
+	struct audit_session *sess;
+
+	atf_utils_create_file(pipepath, "%s", "");
+	session_use_file(pipepath);
+	append_record();
+
+	/* A record queued before setup must not be visible to the case */
+	sess = session_setup("nt");
+	ATF_REQUIRE_EQ((off_t)sizeof(socketrec),
+		lseek(sess->fds[0].fd, 0, SEEK_CUR));
+	session_close();
+}
+
+
+ATF_TC_WITHOUT_HEAD(session_match);
+ATF_TC_BODY(session_match, tc)
+{
+	struct audit_session *sess;
+	struct audit_match match = {
+		.event = "AUE_SOCKET",
+		.status = MATCH_SUCCESS,
+		.pid = 7053,
+	};
+
+	atf_utils_create_file(pipepath, "%s", "");
+	session_use_file(pipepath);
+
+	sess = session_setup("nt");
+	append_record();
+	session_check_match(sess, &match);
+
+	/* The event can also be named by its audit_event(5) description */
+	match.event = "socket(2)";
+	append_record();
+	session_check_match(sess, &match);
+
+	/* Arguments are told apart by number: domain AF_INET6, protocol 0 */
+	match.arg = 1;
+	match.argval = 28;
+	append_record();
+	session_check_match(sess, &match);
+	match.arg = 3;
+	match.argval = 0;
+	append_record();
+	session_check_match(sess, &match);
+	session_close();
+}
+
+
+ATF_TC_WITHOUT_HEAD(batch_check);
+ATF_TC_BODY(batch_check, tc)
+{
+	struct audit_session *sess;
+	struct audit_batch *batch;
+	struct audit_match match = {
+		.event = "AUE_SOCKET",
+		.status = MATCH_SUCCESS,
+	};
+
+	atf_utils_create_file(pipepath, "%s", "");
+	session_use_file(pipepath);
+	sess = session_setup("nt,fr");
+
+	/* Each expectation consumes a record of its own */
+	batch = batch_new();
+	batch_expect(batch, socketreg);
+	batch_expect_match(batch, &match);
+	match.pid = 7053;
+	batch_expect_match(batch, &match);
+	append_record();
+	append_record();
+	append_record();
+	session_check_batch(sess, batch);
+
+	/* All three records were drained in a single check */
+	ATF_REQUIRE_EQ(1, sess->opens);
+	ATF_REQUIRE_EQ(1, sess->flushes);
+	ATF_REQUIRE_EQ(3 * (off_t)sizeof(socketrec),
+		lseek(sess->fds[0].fd, 0, SEEK_CUR));
+	session_close();
+}
+
+
+ATF_TC(session_timeout);
+ATF_TC_HEAD(session_timeout, tc)
+{
+	atf_tc_set_md_var(tc, "descr", "A missing record fails the check "
+				"at the deadline of the session");
+	atf_tc_set_md_var(tc, "timeout", "5");
+}
+
+ATF_TC_BODY(session_timeout, tc)
+{
+	struct audit_session *sess;
+	struct timespec timeout = { 0, 200000000 };
+
+	atf_utils_create_file(pipepath, "%s", "");
+	session_use_file(pipepath);
+
+	/* The slowest class of the list decides */
+	if (getenv("AUDIT_TIMEOUT") == NULL) {
+		ATF_REQUIRE_EQ(10, session_setup("fr,pc")->timeout.tv_sec);
+		ATF_REQUIRE_EQ(5, session_setup("nt")->timeout.tv_sec);
+	}
+
+	sess = session_setup("nt");
+	session_set_timeout(sess, &timeout);
+	atf_tc_expect_fail("Nothing is ever written to the pipe");
+	session_check(sess, socketreg);
+}
+
+
+ATF_TC(session_overtaken);
+ATF_TC_HEAD(session_overtaken, tc)
+{
+	atf_tc_set_md_var(tc, "descr", "A record of a later syscall fails "
+				"the check without waiting for the deadline");
+	atf_tc_set_md_var(tc, "timeout", "5");
+}
+
+ATF_TC_BODY(session_overtaken, tc)
+{
+	struct audit_session *sess;
+	struct timespec timeout = { 60, 0 };
+
+	atf_utils_create_file(pipepath, "%s", "");
+	session_use_file(pipepath);
+
+	sess = session_setup("nt");
+	session_set_timeout(sess, &timeout);
+	append_record_at(time(NULL) + 60);
+	atf_tc_expect_fail("The only record is not a failed socket(2)");
+	session_check(sess, "socket.*return,failure");
+}
+
+
+ATF_TC(session_corrupt);
+ATF_TC_HEAD(session_corrupt, tc)
+{
+	atf_tc_set_md_var(tc, "descr", "A record the reader cannot split "
+				"fails the check without waiting for the "
+				"deadline");
+	atf_tc_set_md_var(tc, "timeout", "5");
+}
+
+ATF_TC_BODY(session_corrupt, tc)
+{
+	struct audit_session *sess;
+	struct timespec timeout = { 60, 0 };
+	static const unsigned char trailer[] = { 0x13, 0xb1, 0x05, 0x00, 0x00 };
+	int filedesc;
+
+	atf_utils_create_file(pipepath, "%s", "");
+	session_use_file(pipepath);
+
+	/* A trailer token where the next record's header should be */
+	sess = session_setup("nt");
+	session_set_timeout(sess, &timeout);
+	ATF_REQUIRE((filedesc = open(pipepath, O_WRONLY | O_APPEND)) != -1);
+	ATF_REQUIRE_EQ((ssize_t)sizeof(trailer),
+		write(filedesc, trailer, sizeof(trailer)));
+	ATF_REQUIRE_EQ(0, close(filedesc));
+	atf_tc_expect_fail("The pipe holds no audit record");
+	session_check(sess, socketreg);
+}
+
+
+ATF_TC_WITHOUT_HEAD(session_latency);
+ATF_TC_BODY(session_latency, tc)
+{
+	struct audit_session *sess;
+	unsigned total = 0;
+	int i;
+
+	atf_utils_create_file(pipepath, "%s", "");
+	session_use_file(pipepath);
+
+	/* A record from the future counts as delivered immediately */
+	sess = session_setup("nt");
+	append_record();
+	append_record_at(time(NULL) + 60);
+	session_check(sess, socketreg);
+	session_check(sess, socketreg);
+
+	for (i = 0; i < LATENCY_BUCKETS; i++)
+		total += sess->latency[i];
+	ATF_REQUIRE_EQ(2, total);
+	ATF_REQUIRE_EQ(1, sess->latency[0]);
+	ATF_REQUIRE_EQ(1, sess->latency[LATENCY_BUCKETS - 1]);
+
+	/* The histogram is reported and reset along with the session */
+	session_close();
+	ATF_REQUIRE_EQ(0, sess->latency[LATENCY_BUCKETS - 1]);
+}
+
+
+ATF_TC_WITHOUT_HEAD(session_counters);
+ATF_TC_BODY(session_counters, tc)
+{
+	struct audit_session *sess;
+	struct audit_counters delta;
+
+	atf_utils_create_file(pipepath, "%s", "");
+	atf_utils_create_file(counterpath, "%s", "7 7 1 0\n");
+	session_use_file(pipepath);
+	ATF_REQUIRE_EQ(0, setenv("AUDIT_COUNTERS", "counters.log", 1));
+
+	/* Only the activity since setup is attributed to the case */
+	sess = session_setup("nt");
+	atf_utils_create_file(counterpath, "%s", "10 9 1 1\n");
+	append_record();
+	session_check(sess, socketreg);
+
+	session_counters(sess, &delta);
+	ATF_REQUIRE_EQ(3, delta.inserts);
+	ATF_REQUIRE_EQ(2, delta.reads);
+	ATF_REQUIRE_EQ(0, delta.drops);
+	ATF_REQUIRE_EQ(1, delta.qlen);
+	ATF_REQUIRE(atf_utils_grep_file("^auditpipe class=nt inserts=3 "
+	    "reads=2 drops=0 qlen=1 result=found$", "counters.log"));
+	session_close();
+}
+
+
+ATF_TC(session_counters_drops);
+ATF_TC_HEAD(session_counters_drops, tc)
+{
+	atf_tc_set_md_var(tc, "descr", "A record dropped by the pipe is "
+				"reported as such");
+	atf_tc_set_md_var(tc, "timeout", "5");
+}
+
+ATF_TC_BODY(session_counters_drops, tc)
+{
+	struct audit_session *sess;
+	struct timespec timeout = { 0, 200000000 };
+
+	atf_utils_create_file(pipepath, "%s", "");
+	atf_utils_create_file(counterpath, "%s", "0 0 0 0\n");
+	session_use_file(pipepath);
+	ATF_REQUIRE_EQ(0, setenv("AUDIT_COUNTERS", "counters.log", 1));
+
+	sess = session_setup("nt");
+	session_set_timeout(sess, &timeout);
+	atf_utils_create_file(counterpath, "%s", "1 0 1 0\n");
+	atf_tc_expect_fail("The record was dropped by the pipe");
+	session_check(sess, socketreg);
+}
+
+
+ATF_TC_WITHOUT_HEAD(session_allocs);
+ATF_TC_BODY(session_allocs, tc)
+{
+	struct audit_session *sess;
+	struct audit_match match = {
+		.event = "AUE_SOCKET",
+		.status = MATCH_SUCCESS,
+	};
+	int allocs, i;
+
+	atf_utils_create_file(pipepath, "%s", "");
+	session_use_file(pipepath);
+	ATF_REQUIRE_EQ(0, setenv("AUDIT_MATCHERS", "1", 1));
+	sess = session_setup("nt");
+	append_record();
+	session_check(sess, socketreg);
+
+	/* The read buffer, the record, its hits and its text took one each */
+	ATF_REQUIRE_EQ(4, sess->allocs);
+
+	/* Once every slot of the ring has held a record, nothing is added */
+	for (i = 0; i < 100; i++) {
+		append_record();
+		session_check(sess, socketreg);
+		append_record();
+		session_check_match(sess, &match);
+	}
+	allocs = sess->allocs;
+	for (i = 0; i < 100; i++) {
+		append_record();
+		session_check(sess, socketreg);
+		append_record();
+		session_check_match(sess, &match);
+	}
+	ATF_REQUIRE_EQ(allocs, sess->allocs);
+	session_close();
+}
+
+
+ATF_TC_WITHOUT_HEAD(session_foreign);
+ATF_TC_BODY(session_foreign, tc)
+{
+	struct audit_session *sess;
+
+	atf_utils_create_file(pipepath, "%s", "");
+	session_use_file(pipepath);
+	sess = session_setup("nt");
+
+	/* The record of the other session would match as well */
+	sess->asid = 4725;
+	append_record();
+	append_record_as(0, 0, 4725);
+	session_check(sess, socketreg);
+	ATF_REQUIRE_EQ(1, sess->foreign);
+	ATF_REQUIRE_EQ(2 * (off_t)sizeof(socketrec),
+		lseek(sess->fds[0].fd, 0, SEEK_CUR));
+	session_close();
+}
+
+
+ATF_TC(session_fifo);
+ATF_TC_HEAD(session_fifo, tc)
+{
+	atf_tc_set_md_var(tc, "descr", "Records written to a FIFO in a burst "
+				"are all matched by several matchers");
+	atf_tc_set_md_var(tc, "timeout", "30");
+}
+
+ATF_TC_BODY(session_fifo, tc)
+{
+	struct audit_session *sess;
+	struct audit_batch *batch;
+	struct audit_match match = {
+		.event = "AUE_SOCKET",
+		.status = MATCH_SUCCESS,
+		.pid = 7053,
+	};
+	int go[2], filedesc, i, status;
+	pid_t child;
+	char c;
+
+	ATF_REQUIRE_EQ(0, mkfifo(pipepath, 0600));
+	ATF_REQUIRE_EQ(0, pipe(go));
+	ATF_REQUIRE((child = fork()) != -1);
+	if (child == 0) {
+		/* Write every record at once, and keep the FIFO open */
+		close(go[1]);
+		if ((filedesc = open(pipepath, O_WRONLY)) == -1 ||
+		    read(go[0], &c, 1) != 1)
+			_exit(1);
+		for (i = 0; i < 1000; i++) {
+			if (write(filedesc, socketrec, sizeof(socketrec)) !=
+			    (ssize_t)sizeof(socketrec))
+				_exit(1);
+		}
+		read(go[0], &c, 1);
+		_exit(0);
+	}
+	ATF_REQUIRE_EQ(0, close(go[0]));
+
+	session_use_file(pipepath);
+	ATF_REQUIRE_EQ(0, setenv("AUDIT_MATCHERS", "4", 1));
+	sess = session_setup("nt");
+	batch = batch_new();
+	for (i = 0; i < 1000; i++) {
+		if (i % 2 == 0)
+			batch_expect(batch, socketreg);
+		else
+			batch_expect_match(batch, &match);
+	}
+	ATF_REQUIRE_EQ(1, write(go[1], "", 1));
+	session_check_batch(sess, batch);
+
+	ATF_REQUIRE_EQ(0, close(go[1]));
+	ATF_REQUIRE_EQ(child, waitpid(child, &status, 0));
+	ATF_REQUIRE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	session_close();
+}
+
+
+ATF_TC(session_reads);
+ATF_TC_HEAD(session_reads, tc)
+{
+	atf_tc_set_md_var(tc, "descr", "Queued records are fetched by a "
+				"single read(2), a record cut short by one "
+				"is completed by the next");
+	atf_tc_set_md_var(tc, "timeout", "10");
+}
+
+ATF_TC_BODY(session_reads, tc)
+{
+	struct audit_session *sess;
+	struct audit_batch *batch;
+	struct timespec nap = { 0, 200000000 };
+	int filedesc, i, status;
+	pid_t child;
+
+	atf_utils_create_file(pipepath, "%s", "");
+	session_use_file(pipepath);
+	sess = session_setup("nt");
+	batch = batch_new();
+	for (i = 0; i < 100; i++) {
+		append_record();
+		batch_expect(batch, socketreg);
+	}
+	session_check_batch(sess, batch);
+	ATF_REQUIRE_EQ(1, sess->reads);
+
+	/* Only the first half of the record is there for the first read */
+	ATF_REQUIRE((filedesc = open(pipepath, O_WRONLY | O_APPEND)) != -1);
+	ATF_REQUIRE_EQ(50, write(filedesc, socketrec, 50));
+	ATF_REQUIRE((child = fork()) != -1);
+	if (child == 0) {
+		nanosleep(&nap, NULL);
+		if (write(filedesc, socketrec + 50, sizeof(socketrec) - 50) !=
+		    (ssize_t)sizeof(socketrec) - 50)
+			_exit(1);
+		_exit(0);
+	}
+	ATF_REQUIRE_EQ(0, close(filedesc));
+	session_check(sess, socketreg);
+
+	ATF_REQUIRE_EQ(child, waitpid(child, &status, 0));
+	ATF_REQUIRE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	session_close();
+}
+
+
+#define RING_RECORDS	100000
+
+static struct ring ring;
+static _Atomic int taken[RING_RECORDS];
+static _Atomic uint64_t retired;
+
+/* Publish the numbers 0 to RING_RECORDS - 1 as record lengths */
+static void *
+ring_producer(void *arg)
+{
+	struct ring_slot *slot;
+	int i;
+
+	for (i = 0; i < RING_RECORDS; i++) {
+		if ((slot = ring_reserve(&ring)) == NULL)
+			break;
+		slot->len = i;
+		ring_publish(&ring, slot);
+	}
+	return (NULL);
+}
+
+/* Only ever called for one record at a time, in order */
+static void
+ring_retire(struct ring_slot *slot, uint64_t pos, void *arg)
+{
+	if ((uint64_t)slot->len == pos && pos == atomic_load(&retired))
+		atomic_store(&retired, pos + 1);
+}
+
+static void *
+ring_consumer(void *arg)
+{
+	struct ring_slot *slot;
+	uint64_t pos;
+
+	while ((slot = ring_take(&ring, &pos)) != NULL) {
+		if ((uint64_t)slot->len == pos)
+			atomic_fetch_add(&taken[slot->len], 1);
+		ring_done(&ring, slot, pos, NULL);
+	}
+	return (NULL);
+}
+
+
+ATF_TC_WITHOUT_HEAD(ring_spmc);
+ATF_TC_BODY(ring_spmc, tc)
+{
+	pthread_t producer, consumers[4];
+	struct timespec nap = { 0, 1000000 };
+	int i;
+
+	/* A small ring, so that both sides keep waiting for each other */
+	ATF_REQUIRE_EQ(0, ring_init(&ring, 8, ring_retire));
+	for (i = 0; i < 4; i++)
+		ATF_REQUIRE_EQ(0, pthread_create(&consumers[i], NULL,
+		    ring_consumer, NULL));
+	ATF_REQUIRE_EQ(0, pthread_create(&producer, NULL, ring_producer,
+	    NULL));
+	ATF_REQUIRE_EQ(0, pthread_join(producer, NULL));
+	while (!ring_freed(&ring, RING_RECORDS - 1))
+		nanosleep(&nap, NULL);
+	ring_close(&ring);
+	for (i = 0; i < 4; i++)
+		ATF_REQUIRE_EQ(0, pthread_join(consumers[i], NULL));
+
+	/* Every record was taken exactly once, at its own position */
+	for (i = 0; i < RING_RECORDS; i++)
+		ATF_REQUIRE_EQ_MSG(1, taken[i], "record %d", i);
+	ATF_REQUIRE_EQ(RING_RECORDS, atomic_load(&retired));
+	ring_destroy(&ring);
+}
+
+
+ATF_TC_WITHOUT_HEAD(ring_rewind);
+ATF_TC_BODY(ring_rewind, tc)
+{
+	struct ring_slot *slot, *slots[4];
+	uint64_t pos;
+	int i;
+
+	ATF_REQUIRE_EQ(0, ring_init(&ring, 4, NULL));
+	for (i = 0; i < 4; i++) {
+		ATF_REQUIRE((slot = ring_reserve(&ring)) != NULL);
+		slot->len = i;
+		ring_publish(&ring, slot);
+	}
+	for (i = 0; i < 4; i++) {
+		ATF_REQUIRE((slots[i] = ring_take(&ring, &pos)) != NULL);
+		ATF_REQUIRE_EQ((uint64_t)i, pos);
+	}
+
+	/* Records after the held one are not freed, even once matched */
+	ring_hold(&ring, 1);
+	for (i = 3; i >= 0; i--)
+		ring_done(&ring, slots[i], i, NULL);
+	ATF_REQUIRE(ring_freed(&ring, 1));
+	ATF_REQUIRE(!ring_freed(&ring, 2));
+
+	/* Closing makes the waiting calls return, rewinding hands them out */
+	ring_close(&ring);
+	ATF_REQUIRE_EQ(NULL, ring_take(&ring, &pos));
+	ring_rewind(&ring);
+	ATF_REQUIRE((slot = ring_take(&ring, &pos)) != NULL);
+	ATF_REQUIRE_EQ(2, pos);
+	ATF_REQUIRE_EQ(2, slot->len);
+
+	/* Cleared, the ring starts over */
+	ring_clear(&ring);
+	ATF_REQUIRE((slot = ring_reserve(&ring)) != NULL);
+	ATF_REQUIRE_EQ(&ring.slots[0], slot);
+	ring_destroy(&ring);
+}
+
+
+ATF_TC_WITHOUT_HEAD(regex_intern);
+ATF_TC_BODY(regex_intern, tc)
+{
+	const struct audit_regex *rgx;
+	char pattern[32];
+
+	rgx = get_audit_regex(socketreg);
+	ATF_REQUIRE(match_audit_regex(rgx, "header,socket(2),return,success"));
+	ATF_REQUIRE(!match_audit_regex(rgx, "header,socket(2),return,failure"));
+
+	/* Identical patterns share a handle even from a different buffer */
+	snprintf(pattern, sizeof(pattern), "%s", socketreg);
+	ATF_REQUIRE_EQ(rgx, get_audit_regex(pattern));
+	ATF_REQUIRE(rgx != get_audit_regex("socket.*return,failure"));
+}
+
+
+ATF_TC_WITHOUT_HEAD(fixture_names);
+ATF_TC_BODY(fixture_names, tc)
+{
+	const struct audit_regex *rgx;
+	const char *name;
+	char expected[32], text[64];
+
+	snprintf(expected, sizeof(expected), "fileforaudit.%d", (int)getpid());
+	name = fixture_name("fileforaudit");
+	ATF_REQUIRE_STREQ(expected, name);
+
+	/* The dot before the pid is taken literally */
+	rgx = get_audit_regex(fixture_regex(name, "success"));
+	snprintf(text, sizeof(text), "path,/tmp/%s,return,success", name);
+	ATF_REQUIRE(match_audit_regex(rgx, text));
+	snprintf(text, sizeof(text), "path,/tmp/fileforaudit-%d,return,success",
+	    (int)getpid());
+	ATF_REQUIRE(!match_audit_regex(rgx, text));
+	snprintf(text, sizeof(text), "path,/tmp/%s,return,failure", name);
+	ATF_REQUIRE(!match_audit_regex(rgx, text));
+}
+
+
+/*
+ * An auditd(8) that only exists in these counters. It switches auditing on
+ * once it has been asked whether it did "fake_delay" times.
+ */
+static bool fake_up;
+static int fake_probes, fake_starts, fake_stops, fake_polls, fake_delay;
+
+static bool
+fake_running(void)
+{
+	fake_probes++;
+	return (fake_up);
+}
+
+static bool
+fake_auditing(void)
+{
+	return (fake_up && ++fake_polls > fake_delay);
+}
+
+static bool
+fake_start(void)
+{
+	fake_starts++;
+	fake_up = true;
+	return (true);
+}
+
+static bool
+fake_stop(void)
+{
+	fake_stops++;
+	fake_up = false;
+	return (true);
+}
+
+static const struct auditd_backend fake_auditd = {
+	.running = fake_running,
+	.auditing = fake_auditing,
+	.start = fake_start,
+	.stop = fake_stop,
+};
+
+
+ATF_TC_WITHOUT_HEAD(auditd_lifecycle);
+ATF_TC_BODY(auditd_lifecycle, tc)
+{
+	pid_t child;
+	int status;
+
+	/* Started once and looked up only once */
+	ATF_REQUIRE_EQ(0, setenv("AUDIT_LEASE", "lease", 1));
+	session_use_auditd(&fake_auditd);
+	ATF_REQUIRE(auditd_acquire());
+	ATF_REQUIRE(!auditd_acquire());
+	ATF_REQUIRE_EQ(1, fake_probes);
+	ATF_REQUIRE_EQ(1, fake_starts);
+
+	/* A child exiting leaves it running */
+	ATF_REQUIRE((child = fork()) != -1);
+	if (child == 0) {
+		auditd_release();
+		_exit(fake_stops);
+	}
+	ATF_REQUIRE_EQ(child, waitpid(child, &status, 0));
+	ATF_REQUIRE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+	/* The program that started it stops it, once */
+	auditd_release();
+	auditd_release();
+	ATF_REQUIRE_EQ(1, fake_stops);
+	ATF_REQUIRE(!fake_up);
+
+	/* One that was running already is left alone */
+	fake_up = true;
+	session_use_auditd(&fake_auditd);
+	ATF_REQUIRE(!auditd_acquire());
+	auditd_release();
+	ATF_REQUIRE_EQ(1, fake_starts);
+	ATF_REQUIRE_EQ(1, fake_stops);
+
+	/* Only a running one is restarted */
+	auditd_restart();
+	ATF_REQUIRE(fake_up);
+	ATF_REQUIRE_EQ(2, fake_starts);
+	ATF_REQUIRE_EQ(2, fake_stops);
+	fake_up = false;
+	auditd_restart();
+	ATF_REQUIRE_EQ(2, fake_starts);
+}
+
+
+ATF_TC_WITHOUT_HEAD(auditd_auditing);
+ATF_TC_BODY(auditd_auditing, tc)
+{
+	bool started;
+
+	ATF_REQUIRE_EQ(0, setenv("AUDIT_LEASE", "lease", 1));
+
+	/* Found running but not auditing yet, the lease waits for it */
+	fake_up = true;
+	fake_delay = 3;
+	session_use_auditd(&fake_auditd);
+	ATF_REQUIRE(!auditd_acquire());
+	ATF_REQUIRE_EQ(0, fake_starts);
+	ATF_REQUIRE_EQ(4, fake_polls);
+
+	/* As does the next program's, even though it is on by now */
+	fake_polls = 0;
+	fake_delay = 0;
+	ATF_REQUIRE(lease_acquire(&fake_auditd, LEASE_SUITE, &started));
+	ATF_REQUIRE(!started);
+	ATF_REQUIRE_EQ(1, fake_polls);
+
+	/* One that was just started is waited for as well */
+	ATF_REQUIRE(lease_release(&fake_auditd, LEASE_SUITE));
+	auditd_release();
+	fake_up = false;
+	fake_polls = 0;
+	fake_delay = 2;
+	ATF_REQUIRE(lease_acquire(&fake_auditd, LEASE_SUITE, &started));
+	ATF_REQUIRE(started);
+	ATF_REQUIRE_EQ(3, fake_polls);
+	ATF_REQUIRE(lease_release(&fake_auditd, LEASE_SUITE));
+	ATF_REQUIRE(!fake_up);
+}
+
+
+ATF_TC(auditd_auditing_timeout);
+ATF_TC_HEAD(auditd_auditing_timeout, tc)
+{
+	atf_tc_set_md_var(tc, "descr", "An auditd(8) started for a lease "
+				"that is never granted is stopped again");
+	atf_tc_set_md_var(tc, "timeout", "30");
+}
+
+ATF_TC_BODY(auditd_auditing_timeout, tc)
+{
+	bool started;
+
+	ATF_REQUIRE_EQ(0, setenv("AUDIT_LEASE", "lease", 1));
+
+	/* Started, but auditing never comes on */
+	fake_delay = INT_MAX;
+	ATF_REQUIRE(!lease_acquire(&fake_auditd, LEASE_SUITE, &started));
+	ATF_REQUIRE(!started);
+	ATF_REQUIRE_EQ(1, fake_starts);
+	ATF_REQUIRE_EQ(1, fake_stops);
+	ATF_REQUIRE(!fake_up);
+
+	/* Nor is one started by somebody else taken for the lease's own */
+	fake_up = true;
+	fake_delay = 0;
+	ATF_REQUIRE(lease_acquire(&fake_auditd, LEASE_SUITE, &started));
+	ATF_REQUIRE(!started);
+	ATF_REQUIRE(lease_release(&fake_auditd, LEASE_SUITE));
+	ATF_REQUIRE_EQ(1, fake_stops);
+	ATF_REQUIRE(fake_up);
+}
+
+
+ATF_TC_WITHOUT_HEAD(auditd_lease);
+ATF_TC_BODY(auditd_lease, tc)
+{
+	pid_t child;
+	int status;
+	bool started;
+
+	ATF_REQUIRE_EQ(0, setenv("AUDIT_LEASE", "lease", 1));
+
+	/* Taken for the suite, auditd(8) outlives the test programs */
+	ATF_REQUIRE(lease_acquire(&fake_auditd, LEASE_SUITE, &started));
+	ATF_REQUIRE(started);
+	session_use_auditd(&fake_auditd);
+	ATF_REQUIRE(!auditd_acquire());
+	auditd_release();
+	ATF_REQUIRE_EQ(1, fake_starts);
+	ATF_REQUIRE_EQ(0, fake_stops);
+
+	/* The lease of a program that died is not waited for */
+	ATF_REQUIRE((child = fork()) != -1);
+	if (child == 0) {
+		_exit(lease_acquire(&fake_auditd, getpid(), &started) ?
+		    0 : 1);
+	}
+	ATF_REQUIRE_EQ(child, waitpid(child, &status, 0));
+	ATF_REQUIRE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	ATF_REQUIRE(lease_release(&fake_auditd, LEASE_SUITE));
+	ATF_REQUIRE_EQ(1, fake_starts);
+	ATF_REQUIRE_EQ(1, fake_stops);
+	ATF_REQUIRE(!fake_up);
+}
+
+
+ATF_TC(auditd_restart_lease);
+ATF_TC_HEAD(auditd_restart_lease, tc)
+{
+	atf_tc_set_md_var(tc, "descr", "A restart of auditd(8) waits for "
+				"the holders of a lease and holds new ones "
+				"back");
+	atf_tc_set_md_var(tc, "timeout", "15");
+}
+
+ATF_TC_BODY(auditd_restart_lease, tc)
+{
+	struct timespec nap = { 0, 200000000 };
+	pid_t holder, restarter, latecomer;
+	int ready[2], go[2], status;
+	char c = 0;
+	bool started;
+
+	ATF_REQUIRE_EQ(0, setenv("AUDIT_LEASE", "lease", 1));
+	ATF_REQUIRE_EQ(0, pipe(ready));
+	ATF_REQUIRE_EQ(0, pipe(go));
+	fake_up = true;
+
+	/* A test program holding a lease until told otherwise */
+	ATF_REQUIRE((holder = fork()) != -1);
+	if (holder == 0) {
+		/* Let go as well if this program dies first */
+		close(go[1]);
+		if (!lease_acquire(&fake_auditd, getpid(), &started) ||
+		    write(ready[1], &c, 1) != 1 || read(go[0], &c, 1) != 1 ||
+		    !lease_release(&fake_auditd, getpid()))
+			_exit(1);
+		_exit(0);
+	}
+	ATF_REQUIRE_EQ(1, read(ready[0], &c, 1));
+
+	/* Neither the restart nor a lease taken after it was asked for go on */
+	ATF_REQUIRE((restarter = fork()) != -1);
+	if (restarter == 0) {
+		_exit(lease_restart(&fake_auditd) && fake_stops == 1 &&
+		    fake_starts == 1 ? 0 : 1);
+	}
+	nanosleep(&nap, NULL);
+	ATF_REQUIRE((latecomer = fork()) != -1);
+	if (latecomer == 0) {
+		_exit(lease_acquire(&fake_auditd, LEASE_SUITE, &started) ?
+		    0 : 1);
+	}
+	nanosleep(&nap, NULL);
+	ATF_REQUIRE_EQ(0, waitpid(restarter, &status, WNOHANG));
+	ATF_REQUIRE_EQ(0, waitpid(latecomer, &status, WNOHANG));
+
+	/* Until the holder lets go */
+	ATF_REQUIRE_EQ(1, write(go[1], &c, 1));
+	ATF_REQUIRE_EQ(holder, waitpid(holder, &status, 0));
+	ATF_REQUIRE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	ATF_REQUIRE_EQ(restarter, waitpid(restarter, &status, 0));
+	ATF_REQUIRE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	ATF_REQUIRE_EQ(latecomer, waitpid(latecomer, &status, 0));
+	ATF_REQUIRE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	ATF_REQUIRE(lease_release(&fake_auditd, LEASE_SUITE));
+}
+
+
+/*
+ * Stands in for a syscall of a test table, writing the record it would
+ * produce to the file standing in for auditpipe(4). Like the calls of the
+ * test programs, it fails when given -1.
+ */
+static int
+call_socket(const char *path, int filedesc)
+{
+	if (filedesc == -1)
+		return (-1);
+	append_record_as(0, getpid(), 0);
+	return (0);
+}
+
+static const struct audit_case socketcases[] = {
+	{ "socket_plain", NULL, call_socket,
+	    { .event = "socket(2)", .status = MATCH_SUCCESS }, false },
+	{ "socket_file", case_file, call_socket,
+	    { .event = "socket(2)", .status = MATCH_SUCCESS }, false },
+};
+
+ATF_TC_WITHOUT_HEAD(audit_cases);
+ATF_TC_BODY(audit_cases, tc)
+{
+	struct audit_session *sess;
+
+	atf_utils_create_file(pipepath, "%s", "");
+	session_use_file(pipepath);
+
+	/* The whole table runs in one session, the fixtures prepared first */
+	run_audit_cases("nt", socketcases, 2);
+	ATF_REQUIRE(atf_utils_file_exists(fixture_name("socket_file")));
+	ATF_REQUIRE(!atf_utils_file_exists(fixture_name("socket_plain")));
+
+	sess = session_setup("nt");
+	ATF_REQUIRE_EQ(2, sess->rearms);
+	ATF_REQUIRE_EQ(2, sess->flushes);
+	session_close();
+}
+
+
+ATF_TC_WITHOUT_HEAD(legacy_setup);
+ATF_TC_BODY(legacy_setup, tc)
+{
+	atf_utils_create_file(pipepath, "%s", "");
+	session_use_file(pipepath);
+
+	FILE *pipefd = setup(fds, "nt");
+	append_record();
+	check_audit(fds, socketreg, pipefd);
+
+	/* check_audit() keeps the pipe, the next setup reuses it */
+	ATF_REQUIRE(setup(fds, "nt") != NULL);
+	ATF_REQUIRE_EQ(1, session_setup("nt")->opens);
+	session_close();
+}
+
+
+ATF_TP_ADD_TCS(tp)
+{
+	ATF_TP_ADD_TC(tp, session_lifecycle);
+	ATF_TP_ADD_TC(tp, session_flush);
+	ATF_TP_ADD_TC(tp, session_match);
+	ATF_TP_ADD_TC(tp, batch_check);
+	ATF_TP_ADD_TC(tp, session_timeout);
+	ATF_TP_ADD_TC(tp, session_overtaken);
+	ATF_TP_ADD_TC(tp, session_corrupt);
+	ATF_TP_ADD_TC(tp, session_latency);
+	ATF_TP_ADD_TC(tp, session_counters);
+	ATF_TP_ADD_TC(tp, session_counters_drops);
+	ATF_TP_ADD_TC(tp, session_allocs);
+	ATF_TP_ADD_TC(tp, session_foreign);
+	ATF_TP_ADD_TC(tp, session_fifo);
+	ATF_TP_ADD_TC(tp, session_reads);
+	ATF_TP_ADD_TC(tp, ring_spmc);
+	ATF_TP_ADD_TC(tp, ring_rewind);
+	ATF_TP_ADD_TC(tp, regex_intern);
+	ATF_TP_ADD_TC(tp, fixture_names);
+	ATF_TP_ADD_TC(tp, auditd_lifecycle);
+	ATF_TP_ADD_TC(tp, auditd_auditing);
+	ATF_TP_ADD_TC(tp, auditd_auditing_timeout);
+	ATF_TP_ADD_TC(tp, auditd_lease);
+	ATF_TP_ADD_TC(tp, auditd_restart_lease);
+	ATF_TP_ADD_TC(tp, audit_cases);
+	ATF_TP_ADD_TC(tp, legacy_setup);
+
+	return (atf_no_error());
+}
@@ -0,0 +1,182 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+/*
+ * Benchmark for bsm_find_records(). Builds a synthetic trail in memory as
+ * scan_bench does, then finds its records by walking them one at a time
+ * and by searching for trailer tokens with 1, 2, 4, ... threads, checks
+ * both find the same records and reports MB/s. Build with e.g.
+ * make CFLAGS="-O2 -mavx2" to use AVX2 instead of SSE2.
+ */
+
+#include <err.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bsmscan.h"
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+	    "usage: bound_bench [-j threads] [-n rounds] [-s megabytes] trail\n");
+	exit(1);
+}
+
+static int
+every_record(struct bsm_cursor *rec, void *arg)
+{
+	(void)rec;
+	(void)arg;
+	return (1);
+}
+
+/*
+ * Repeat the trail at "path" until it fills "size" bytes
+ */
+static uint8_t *
+build_trail(const char *path, size_t *size)
+{
+	uint8_t *buff, sample[65536];
+	ssize_t n;
+	size_t len;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) == -1)
+		err(1, "%s", path);
+	if ((n = read(fd, sample, sizeof(sample))) <= 0)
+		errx(1, "%s: empty or unreadable", path);
+	close(fd);
+
+	*size -= *size % (size_t)n;
+	if (*size == 0 || (buff = malloc(*size)) == NULL)
+		errx(1, "cannot allocate the synthetic trail");
+	for (len = 0; len < *size; len += (size_t)n)
+		memcpy(buff + len, sample, (size_t)n);
+	return (buff);
+}
+
+static double
+elapsed(const struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return ((end.tv_sec - start->tv_sec) +
+	    (end.tv_nsec - start->tv_nsec) / 1e9);
+}
+
+static void
+report(const char *what, size_t size, double best)
+{
+	printf("%-20s %8.1f MB/s\n", what, size / (1024.0 * 1024.0) / best);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct bsm_scan scan, walk;
+	struct timespec start;
+	uint8_t *trail;
+	size_t size = 256;
+	double best, secs;
+	long maxthreads, rounds = 5, i;
+	int ch, nthreads;
+	char what[32];
+
+	if ((maxthreads = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+		maxthreads = 1;
+
+	while ((ch = getopt(argc, argv, "j:n:s:")) != -1) {
+		switch (ch) {
+		case 'j':
+			if ((maxthreads = strtol(optarg, NULL, 10)) < 1)
+				usage();
+			break;
+		case 'n':
+			if ((rounds = strtol(optarg, NULL, 10)) < 1)
+				usage();
+			break;
+		case 's':
+			if ((size = strtoul(optarg, NULL, 10)) == 0)
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 1)
+		usage();
+
+	size *= 1024 * 1024;
+	trail = build_trail(argv[0], &size);
+
+	printf("%zu MB trail, best of %ld rounds, %s\n",
+	    size / (1024 * 1024), rounds, BSM_SIMD);
+	best = 0;
+	for (i = 0; i < rounds; i++) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if (bsm_scan(trail, size, 1, every_record, NULL, &walk) != 0)
+			errx(1, "scan failed");
+		secs = elapsed(&start);
+		if (i < rounds - 1)
+			bsm_scan_free(&walk);
+		if (i == 0 || secs < best)
+			best = secs;
+	}
+	report("record walk:", size, best);
+
+	for (nthreads = 1; nthreads <= maxthreads; nthreads *= 2) {
+		best = 0;
+		for (i = 0; i < rounds; i++) {
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			if (bsm_find_records(trail, size, nthreads, &scan) != 0)
+				errx(1, "search failed");
+			secs = elapsed(&start);
+			if (scan.nmatches != walk.nmatches ||
+			    memcmp(scan.matches, walk.matches,
+			    scan.nmatches * sizeof(size_t)) != 0)
+				errx(1, "%d threads: found %zu records, "
+				    "walked %zu", nthreads, scan.nmatches,
+				    walk.nmatches);
+			bsm_scan_free(&scan);
+			if (i == 0 || secs < best)
+				best = secs;
+		}
+		snprintf(what, sizeof(what), "%d threads:", nthreads);
+		report(what, size, best);
+	}
+
+	bsm_scan_free(&walk);
+	free(trail);
+	return (0);
+}
@@ -0,0 +1,182 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * bsmcat(1) prints BSM audit trails in the forms praudit(1) supports, using
+ * only the portable decoder in this directory. It lets trails recorded on
+ * FreeBSD be inspected on hosts without libbsm.
+ */
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bsmdec.h"
+#include "bsmfmt.h"
+
+#define AUDIT_EVENT_FILE	"/etc/security/audit_event"
+#define READ_BUFFER_SIZE	(1024 * 1024)
+
+static const char *del = ",";
+static struct bsm_out out;
+static int interactive;
+static int partial;
+static int flags;
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: bsmcat [-lnp] [-j | -x] [-r | -s] [-d del] "
+	    "[-e audit_event] [file ...]\n");
+	exit(1);
+}
+
+/*
+ * Print every record read from "fd". Like praudit(1), output stops quietly
+ * at the first corrupted record unless -p asks to skip ahead to the next
+ * valid one.
+ */
+static int
+print_trail(int fd, const char *name, void *buf)
+{
+	struct bsm_reader rd;
+	struct bsm_cursor rec;
+	int ret;
+
+	bsm_reader_init(&rd, fd, buf, READ_BUFFER_SIZE);
+	for (;;) {
+		if (partial && bsm_reader_resync(&rd) != BSM_OK)
+			break;
+		errno = 0;
+		ret = bsm_read_record(&rd, &rec);
+		if (ret == BSM_OK) {
+			bsm_print_record(&out, &rec, del, flags);
+			if (interactive)
+				(void)bsm_out_flush(&out);
+			continue;
+		}
+		if (ret == BSM_ERROR && errno != 0) {
+			warn("%s", name);
+			return (1);
+		}
+		if (ret == BSM_END || !partial)
+			break;
+		/* The resync point was a false positive, look past it */
+		rd.off++;
+	}
+	return (0);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *eventfile = AUDIT_EVENT_FILE;
+	void *buf;
+	int ch, fd, i, status = 0;
+
+	while ((ch = getopt(argc, argv, "d:e:jlnprsx")) != -1) {
+		switch (ch) {
+		case 'd':
+			del = optarg;
+			break;
+		case 'e':
+			eventfile = optarg;
+			break;
+		case 'j':
+			if (flags & BSM_FMT_XML)
+				usage();
+			flags |= BSM_FMT_JSON;
+			break;
+		case 'l':
+			flags |= BSM_FMT_ONELINE;
+			break;
+		case 'n':
+			/* Accepted for praudit(1) compatibility */
+			break;
+		case 'p':
+			partial = 1;
+			break;
+		case 'r':
+			if (flags & BSM_FMT_SHORT)
+				usage();
+			flags |= BSM_FMT_RAW;
+			break;
+		case 's':
+			if (flags & BSM_FMT_RAW)
+				usage();
+			flags |= BSM_FMT_SHORT;
+			break;
+		case 'x':
+			if (flags & BSM_FMT_JSON)
+				usage();
+			flags |= BSM_FMT_XML;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	/* Without the database events are printed by number */
+	(void)bsm_load_events(eventfile);
+
+	if ((buf = malloc(READ_BUFFER_SIZE)) == NULL)
+		err(1, "malloc");
+
+	/* A terminal sees each record as soon as it is read, like stdio */
+	bsm_out_init(&out, STDOUT_FILENO);
+	interactive = isatty(STDOUT_FILENO);
+
+	if (flags & BSM_FMT_XML)
+		bsm_print_xml_header(&out);
+
+	if (argc == 0)
+		status = print_trail(STDIN_FILENO, "stdin", buf);
+	for (i = 0; i < argc; i++) {
+		if ((fd = open(argv[i], O_RDONLY)) == -1) {
+			warn("%s", argv[i]);
+			status = 1;
+			continue;
+		}
+		status |= print_trail(fd, argv[i], buf);
+		close(fd);
+	}
+
+	if (flags & BSM_FMT_XML)
+		bsm_print_xml_footer(&out);
+	if (bsm_out_flush(&out) == -1)
+		err(1, "stdout");
+
+	bsm_out_free(&out);
+	free(buf);
+	return (status);
+}
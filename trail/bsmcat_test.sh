@@ -0,0 +1,284 @@
+#
+# Copyright (c) 2018 Aniket Pandey
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+# OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+# HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+# OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE.
+#
+# $FreeBSD$
+#
+
+# The golden files are praudit(1)'s, recorded on FreeBSD in UTC, or for the
+# forms praudit lacks bsmcat's own in input/. Group 0 is "wheel" there,
+# substitute whatever this host calls it.
+setup_golden()
+{
+	export TZ=UTC
+	bsmcat="$(atf_get_srcdir)/bsmcat -e $(atf_get_srcdir)/input/audit_event"
+	input=$(atf_get_srcdir)/../praudit/input
+
+	if [ $# -gt 0 ]; then
+		golden=${input}/$1
+		[ -f ${golden} ] || golden=$(atf_get_srcdir)/input/$1
+		group=$(awk -F: '$3 == 0 { print $1; exit }' /etc/group)
+		sed "s/wheel/${group}/" ${golden} > $1
+	fi
+}
+
+
+atf_test_case bsmcat_delim_comma
+bsmcat_delim_comma_head()
+{
+	atf_set "descr" "Verify that comma delimiter is present with -d ','"
+}
+
+bsmcat_delim_comma_body()
+{
+	setup_golden del_comma
+	atf_check -o file:del_comma ${bsmcat} -d "," ${input}/trail
+}
+
+
+atf_test_case bsmcat_delim_underscore
+bsmcat_delim_underscore_head()
+{
+	atf_set "descr" "Verify that underscore delimiter is present with -d _"
+}
+
+bsmcat_delim_underscore_body()
+{
+	setup_golden del_underscore
+	atf_check -o file:del_underscore ${bsmcat} -d "_" ${input}/trail
+}
+
+
+atf_test_case bsmcat_no_args
+bsmcat_no_args_head()
+{
+	atf_set "descr" "Verify that bsmcat outputs the default form of " \
+			"praudit without any arguments"
+}
+
+bsmcat_no_args_body()
+{
+	setup_golden no_args
+	atf_check -o file:no_args ${bsmcat} ${input}/trail
+}
+
+
+atf_test_case bsmcat_numeric_form
+bsmcat_numeric_form_head()
+{
+	atf_set "descr" "Verify that -n is accepted and matches praudit -n"
+}
+
+bsmcat_numeric_form_body()
+{
+	setup_golden numeric_form
+	atf_check -o file:numeric_form ${bsmcat} -n ${input}/trail
+}
+
+
+atf_test_case bsmcat_raw_form
+bsmcat_raw_form_head()
+{
+	atf_set "descr" "Verify that bsmcat outputs the raw form with -r flag"
+}
+
+bsmcat_raw_form_body()
+{
+	setup_golden raw_form
+	atf_check -o file:raw_form ${bsmcat} -r ${input}/trail
+}
+
+
+atf_test_case bsmcat_same_line
+bsmcat_same_line_head()
+{
+	atf_set "descr" "Verify that bsmcat outputs each record in the same " \
+			"line with -l flag"
+}
+
+bsmcat_same_line_body()
+{
+	setup_golden same_line
+	atf_check -o file:same_line ${bsmcat} -l ${input}/trail
+}
+
+
+atf_test_case bsmcat_short_form
+bsmcat_short_form_head()
+{
+	atf_set "descr" "Verify that bsmcat outputs the short form " \
+			"with -s flag"
+}
+
+bsmcat_short_form_body()
+{
+	setup_golden short_form
+	atf_check -o file:short_form ${bsmcat} -s ${input}/trail
+}
+
+
+atf_test_case bsmcat_xml_form
+bsmcat_xml_form_head()
+{
+	atf_set "descr" "Verify that bsmcat outputs the XML file with -x flag"
+}
+
+bsmcat_xml_form_body()
+{
+	# praudit repeats the XML prologue before </audit>, bsmcat does not
+	setup_golden xml_form
+	awk '/^<\?xml/ && n++ { getline; next } { print }' xml_form > xml
+	atf_check -o file:xml ${bsmcat} -x ${input}/trail
+}
+
+
+atf_test_case bsmcat_json_form
+bsmcat_json_form_head()
+{
+	atf_set "descr" "Verify that bsmcat outputs one JSON object per " \
+			"record with -j flag, mirroring the XML form"
+}
+
+bsmcat_json_form_body()
+{
+	setup_golden json_form
+	atf_check -o file:json_form ${bsmcat} -j ${input}/trail
+}
+
+
+atf_test_case bsmcat_json_escape
+bsmcat_json_escape_head()
+{
+	atf_set "descr" "Verify that strings are escaped in the JSON and " \
+			"XML forms"
+}
+
+bsmcat_json_escape_body()
+{
+	setup_golden
+	# open(2) of a path holding quotes, a backslash, markup and controls
+	printf '\024\000\000\000\055\013\000\110\000\000\000\000\000' > trail
+	printf '\000\000\000\000\000\043\000\013a"b\\c<&>\n\t\000' >> trail
+	printf '\047\000\000\000\000\003\023\261\005\000\000\000\055' >> trail
+
+	atf_check -o match:'"text":"a\\"b\\\\c<&>\\n\\t"' ${bsmcat} -jr trail
+	atf_check -o match:'<path>a&quot;b\\c&lt;&amp;&gt;$' ${bsmcat} -xr trail
+}
+
+
+atf_test_case bsmcat_json_large
+bsmcat_json_large_head()
+{
+	atf_set "descr" "Verify that a trail many times larger than the " \
+			"output buffer comes out whole, a record per line"
+}
+
+bsmcat_json_large_body()
+{
+	setup_golden
+	atf_check $(atf_get_srcdir)/bsmgen -s 5 -n 20000 trail
+	${bsmcat} -jr trail > json || atf_fail "bsmcat failed"
+
+	atf_check -o match:"^ *20000\$" -x "wc -l < json"
+	atf_check -o match:"^ *20000\$" -x "grep -c '\]}\$' json"
+	atf_check -o match:"^ *20000\$" -x "${bsmcat} -lr trail | wc -l"
+}
+
+
+atf_test_case bsmcat_sync_to_next_record
+bsmcat_sync_to_next_record_head()
+{
+	atf_set "descr" "Verify that stdout is empty for a corrupted trail " \
+			"but the valid record after the garbage is printed " \
+			"with -p flag on"
+}
+
+bsmcat_sync_to_next_record_body()
+{
+	setup_golden no_args
+	atf_check ${bsmcat} ${input}/corrupted
+	atf_check -o file:no_args \
+		${bsmcat} -p ${input}/corrupted
+}
+
+
+atf_test_case bsmcat_stdin
+bsmcat_stdin_head()
+{
+	atf_set "descr" "Verify that bsmcat reads the trail from stdin " \
+			"when no file is given"
+}
+
+bsmcat_stdin_body()
+{
+	setup_golden no_args
+	atf_check -o file:no_args -x "${bsmcat} < ${input}/trail"
+}
+
+
+atf_test_case bsmcat_raw_short_exclusive
+bsmcat_raw_short_exclusive_head()
+{
+	atf_set "descr" "Verify that bsmcat outputs usage message on stderr " \
+			"when both raw and short options are specified"
+}
+
+bsmcat_raw_short_exclusive_body()
+{
+	setup_golden
+	atf_check -s exit:1 -e match:"usage: bsmcat" ${bsmcat} -rs ${input}/trail
+}
+
+
+atf_test_case bsmcat_json_xml_exclusive
+bsmcat_json_xml_exclusive_head()
+{
+	atf_set "descr" "Verify that bsmcat outputs usage message on stderr " \
+			"when both JSON and XML options are specified"
+}
+
+bsmcat_json_xml_exclusive_body()
+{
+	setup_golden
+	atf_check -s exit:1 -e match:"usage: bsmcat" ${bsmcat} -jx ${input}/trail
+}
+
+
+atf_init_test_cases()
+{
+	atf_add_test_case bsmcat_delim_comma
+	atf_add_test_case bsmcat_delim_underscore
+	atf_add_test_case bsmcat_no_args
+	atf_add_test_case bsmcat_numeric_form
+	atf_add_test_case bsmcat_raw_form
+	atf_add_test_case bsmcat_same_line
+	atf_add_test_case bsmcat_short_form
+	atf_add_test_case bsmcat_xml_form
+	atf_add_test_case bsmcat_json_form
+	atf_add_test_case bsmcat_json_escape
+	atf_add_test_case bsmcat_json_large
+	atf_add_test_case bsmcat_sync_to_next_record
+	atf_add_test_case bsmcat_stdin
+	atf_add_test_case bsmcat_raw_short_exclusive
+	atf_add_test_case bsmcat_json_xml_exclusive
+}
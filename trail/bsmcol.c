@@ -0,0 +1,688 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bsmcol.h"
+
+#define FOOTER_LEN	(8 + 4 + 4 + 8 + 8 + 8 + sizeof(BSM_COL_MAGIC))
+#define ENTRY_LEN	32
+
+/*
+ * Strings of a dictionary in the order they were first seen, their codes
+ * looked up through an open-addressing hash table
+ */
+struct dict {
+	char		*buf;		/* Each string NUL-terminated */
+	size_t		 len;
+	size_t		 cap;
+	size_t		*offs;		/* Of the string with code i + 1 */
+	uint32_t	 n;
+	uint32_t	*slots;		/* Codes, 0 for an empty slot */
+	uint32_t	 nslots;
+};
+
+static uint32_t
+get32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+	    (uint32_t)p[2] << 8 | p[3]);
+}
+
+static uint64_t
+get64(const uint8_t *p)
+{
+	return ((uint64_t)get32(p) << 32 | get32(p + 4));
+}
+
+static void
+set32(uint8_t *p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = (v >> 16) & 0xff;
+	p[2] = (v >> 8) & 0xff;
+	p[3] = v & 0xff;
+}
+
+static void
+set64(uint8_t *p, uint64_t v)
+{
+	set32(p, (uint32_t)(v >> 32));
+	set32(p + 4, (uint32_t)v);
+}
+
+static void
+put32(FILE *fp, uint32_t v)
+{
+	uint8_t b[4];
+
+	set32(b, v);
+	fwrite(b, 1, sizeof(b), fp);
+}
+
+static void
+put64(FILE *fp, uint64_t v)
+{
+	uint8_t b[8];
+
+	set64(b, v);
+	fwrite(b, 1, sizeof(b), fp);
+}
+
+/* FNV-1a */
+static uint32_t
+hash_string(const char *str, size_t len)
+{
+	uint32_t h = 2166136261u;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		h = (h ^ (uint8_t)str[i]) * 16777619u;
+	return (h);
+}
+
+static int
+dict_grow(struct dict *d)
+{
+	uint32_t *slots, nslots, code, i;
+	const char *str;
+
+	nslots = (d->nslots == 0) ? 1024 : d->nslots * 2;
+	if ((slots = calloc(nslots, sizeof(*slots))) == NULL)
+		return (-1);
+	for (code = 1; code <= d->n; code++) {
+		str = d->buf + d->offs[code - 1];
+		i = hash_string(str, strlen(str)) & (nslots - 1);
+		while (slots[i] != 0)
+			i = (i + 1) & (nslots - 1);
+		slots[i] = code;
+	}
+	free(d->slots);
+	d->slots = slots;
+	d->nslots = nslots;
+	return (0);
+}
+
+/*
+ * The code of a string, added to the dictionary if it is new. A string is
+ * cut at an embedded NUL, as it would be when read back.
+ */
+static int
+dict_code(struct dict *d, const char *str, size_t len, uint64_t *code)
+{
+	const char *s;
+	size_t *offs, cap;
+	char *buf;
+	uint32_t i;
+
+	len = strnlen(str, len);
+	if (2 * (d->n + 1) > d->nslots && dict_grow(d) == -1)
+		return (-1);
+
+	i = hash_string(str, len) & (d->nslots - 1);
+	for (; d->slots[i] != 0; i = (i + 1) & (d->nslots - 1)) {
+		s = d->buf + d->offs[d->slots[i] - 1];
+		if (strncmp(s, str, len) == 0 && s[len] == '\0') {
+			*code = d->slots[i];
+			return (0);
+		}
+	}
+
+	if (d->len + len + 1 > d->cap) {
+		cap = (d->cap == 0) ? 65536 : d->cap;
+		while (cap < d->len + len + 1)
+			cap *= 2;
+		if ((buf = realloc(d->buf, cap)) == NULL)
+			return (-1);
+		d->buf = buf;
+		d->cap = cap;
+	}
+	if ((d->n & 1023) == 0) {
+		offs = realloc(d->offs, (d->n + 1024) * sizeof(*offs));
+		if (offs == NULL)
+			return (-1);
+		d->offs = offs;
+	}
+	memcpy(d->buf + d->len, str, len);
+	d->buf[d->len + len] = '\0';
+	d->offs[d->n] = d->len;
+	d->len += len + 1;
+	d->slots[i] = ++d->n;
+	*code = d->n;
+	return (0);
+}
+
+static void
+dict_free(struct dict *d)
+{
+	free(d->buf);
+	free(d->offs);
+	free(d->slots);
+}
+
+static int
+addr_code(struct dict *d, const struct bsm_addr *addr, uint64_t *code)
+{
+	char str[INET6_ADDRSTRLEN];
+
+	if (inet_ntop(addr->type == BSM_IPV6 ? AF_INET6 : AF_INET,
+	    addr->addr, str, sizeof(str)) == NULL) {
+		*code = 0;
+		return (0);
+	}
+	return (dict_code(d, str, strlen(str), code));
+}
+
+/*
+ * Fill in row "r" of the block's columns from a record: its header, and
+ * its first subject, path and return tokens
+ */
+static int
+export_record(struct dict *dicts, struct bsm_cursor *rec, uint64_t *cols,
+    uint32_t block, size_t r)
+{
+	struct bsm_token tok;
+	int header = 0, subject = 0, path = 0, ret = 0, c;
+
+#define COL(c)	cols[(size_t)(c) * block + r]
+	for (c = 0; c < BSM_COL_NCOLUMNS; c++)
+		COL(c) = 0;
+
+	while (bsm_next_token(rec, &tok) == BSM_OK) {
+		switch (tok.id) {
+		case BSM_HEADER32:
+		case BSM_HEADER32_EX:
+		case BSM_HEADER64:
+		case BSM_HEADER64_EX:
+			if (header++)
+				break;
+			COL(BSM_COL_SIZE) = tok.tt.hdr.size;
+			COL(BSM_COL_VERSION) = tok.tt.hdr.version;
+			COL(BSM_COL_EVENT) = tok.tt.hdr.event;
+			COL(BSM_COL_MODIFIER) = tok.tt.hdr.modifier;
+			COL(BSM_COL_SEC) = tok.tt.hdr.sec;
+			COL(BSM_COL_MSEC) = tok.tt.hdr.msec;
+			break;
+		case BSM_SUBJECT32:
+		case BSM_SUBJECT64:
+		case BSM_SUBJECT32_EX:
+		case BSM_SUBJECT64_EX:
+			if (subject++)
+				break;
+			COL(BSM_COL_SUBJECT) = tok.id;
+			COL(BSM_COL_AUID) = tok.tt.subj.auid;
+			COL(BSM_COL_EUID) = tok.tt.subj.euid;
+			COL(BSM_COL_EGID) = tok.tt.subj.egid;
+			COL(BSM_COL_RUID) = tok.tt.subj.ruid;
+			COL(BSM_COL_RGID) = tok.tt.subj.rgid;
+			COL(BSM_COL_PID) = tok.tt.subj.pid;
+			COL(BSM_COL_SID) = tok.tt.subj.sid;
+			COL(BSM_COL_PORT) = tok.tt.subj.port;
+			if (addr_code(&dicts[BSM_COL_DICT_ADDR],
+			    &tok.tt.subj.addr, &COL(BSM_COL_ADDR)) == -1)
+				return (-1);
+			break;
+		case BSM_PATH:
+			if (path++)
+				break;
+			if (dict_code(&dicts[BSM_COL_DICT_PATH], tok.tt.str.str,
+			    tok.tt.str.len, &COL(BSM_COL_PATH)) == -1)
+				return (-1);
+			break;
+		case BSM_RETURN32:
+		case BSM_RETURN64:
+			if (ret++)
+				break;
+			COL(BSM_COL_RETURN) = tok.id;
+			COL(BSM_COL_STATUS) = tok.tt.ret.status;
+			COL(BSM_COL_RETVAL) = tok.tt.ret.val;
+			break;
+		}
+	}
+#undef COL
+	return (0);
+}
+
+/*
+ * Bytes needed for offsets up to "range", rounded up to a width the
+ * decoder has a fast path for
+ */
+static uint32_t
+offset_width(uint64_t range)
+{
+	if (range == 0)
+		return (0);
+	if (range <= UINT8_MAX)
+		return (1);
+	if (range <= UINT16_MAX)
+		return (2);
+	if (range <= UINT32_MAX)
+		return (4);
+	return (8);
+}
+
+/*
+ * Write the "n" rows of a block, column after column, and describe each
+ * column in the block's directory entries
+ */
+static void
+write_block(FILE *fp, const uint64_t *cols, uint32_t block, size_t n,
+    uint8_t *dir, uint64_t *off, uint8_t *buf)
+{
+	const uint64_t *v;
+	uint64_t min, max, d;
+	uint32_t width, k;
+	size_t i;
+	int c;
+
+	for (c = 0; c < BSM_COL_NCOLUMNS; c++) {
+		v = cols + (size_t)c * block;
+		min = max = v[0];
+		for (i = 1; i < n; i++) {
+			if (v[i] < min)
+				min = v[i];
+			if (v[i] > max)
+				max = v[i];
+		}
+		width = offset_width(max - min);
+		for (i = 0; i < n; i++) {
+			d = v[i] - min;
+			for (k = 0; k < width; k++)
+				buf[i * width + k] = d >> (8 * (width - 1 - k));
+		}
+		fwrite(buf, width, n, fp);
+
+		set64(dir, min);
+		set64(dir + 8, max);
+		set64(dir + 16, *off);
+		set32(dir + 24, width);
+		set32(dir + 28, 0);
+		dir += ENTRY_LEN;
+		*off += (uint64_t)width * n;
+	}
+}
+
+/*
+ * Write the columns of an indexed trail mapping to "fp", "block" rows per
+ * block. Returns -1 with errno set on failure.
+ */
+int
+bsm_col_build(const struct bsm_map *map, uint32_t block, FILE *fp)
+{
+	struct dict dicts[BSM_COL_NDICTS];
+	struct bsm_cursor rec;
+	uint64_t *cols = NULL, nblocks, off, dictoff, b;
+	uint8_t *dir = NULL, *buf = NULL;
+	size_t i, n;
+	int d, ret = -1;
+
+	memset(dicts, 0, sizeof(dicts));
+	if (block == 0)
+		block = BSM_COL_BLOCK;
+	nblocks = (map->nrecords + block - 1) / block;
+	if ((cols = malloc((size_t)block * BSM_COL_NCOLUMNS *
+	    sizeof(*cols))) == NULL ||
+	    (buf = malloc((size_t)block * sizeof(*cols))) == NULL ||
+	    (dir = malloc(nblocks * BSM_COL_NCOLUMNS * ENTRY_LEN + 1)) == NULL)
+		goto out;
+
+	fwrite(BSM_COL_MAGIC, 1, sizeof(BSM_COL_MAGIC), fp);
+	off = sizeof(BSM_COL_MAGIC);
+	for (b = 0; b < nblocks; b++) {
+		n = map->nrecords - b * block;
+		if (n > block)
+			n = block;
+		for (i = 0; i < n; i++) {
+			bsm_map_record(map, b * block + i, &rec);
+			if (export_record(dicts, &rec, cols, block, i) == -1)
+				goto out;
+		}
+		write_block(fp, cols, block, n,
+		    dir + b * BSM_COL_NCOLUMNS * ENTRY_LEN, &off, buf);
+	}
+
+	dictoff = off;
+	for (d = 0; d < BSM_COL_NDICTS; d++) {
+		put32(fp, dicts[d].n);
+		put32(fp, 0);
+		put64(fp, dicts[d].len);
+		if (dicts[d].len > 0)
+			fwrite(dicts[d].buf, 1, dicts[d].len, fp);
+		off += 16 + dicts[d].len;
+	}
+	fwrite(dir, ENTRY_LEN, nblocks * BSM_COL_NCOLUMNS, fp);
+
+	put64(fp, map->nrecords);
+	put32(fp, block);
+	put32(fp, BSM_COL_NCOLUMNS);
+	put64(fp, nblocks);
+	put64(fp, dictoff);
+	put64(fp, off);
+	fwrite(BSM_COL_MAGIC, 1, sizeof(BSM_COL_MAGIC), fp);
+	if (fflush(fp) == 0 && !ferror(fp))
+		ret = 0;
+
+out:
+	for (d = 0; d < BSM_COL_NDICTS; d++)
+		dict_free(&dicts[d]);
+	free(cols);
+	free(buf);
+	free(dir);
+	return (ret);
+}
+
+/*
+ * Point the strings of a dictionary, code 0 being the empty string, into
+ * the mapping at "p". Returns the dictionary's length, 0 if it is corrupt.
+ */
+static size_t
+load_dict(struct bsm_col *col, int d, const uint8_t *p, size_t left)
+{
+	const char *str, *end;
+	uint64_t len;
+	uint32_t count, i;
+
+	if (left < 16)
+		return (0);
+	count = get32(p);
+	len = get64(p + 8);
+	if (len > left - 16 || count > len ||
+	    (len > 0 && p[16 + len - 1] != '\0'))
+		return (0);
+	col->strings[d] = malloc(((size_t)count + 1) * sizeof(char *));
+	if (col->strings[d] == NULL)
+		return (0);
+
+	col->strings[d][0] = "";
+	str = (const char *)p + 16;
+	end = str + len;
+	for (i = 1; i <= count; i++) {
+		if (str >= end)
+			return (0);
+		col->strings[d][i] = str;
+		str += strlen(str) + 1;
+	}
+	if (str != end)
+		return (0);
+	col->nstrings[d] = count + 1;
+	return (16 + (size_t)len);
+}
+
+/*
+ * Map the columns at "path" and check that every block fits the file.
+ * Returns -1 with errno set on failure, EINVAL if they are corrupt.
+ */
+int
+bsm_col_open(struct bsm_col *col, const char *path)
+{
+	struct stat sb;
+	const uint8_t *foot, *ent;
+	void *base;
+	uint64_t dictoff, diroff, off, b;
+	size_t n, left;
+	uint32_t width;
+	int error, c, d;
+
+	memset(col, 0, sizeof(*col));
+	if ((col->fd = open(path, O_RDONLY)) == -1)
+		return (-1);
+	if (fstat(col->fd, &sb) == -1)
+		goto fail;
+	if ((uintmax_t)sb.st_size < sizeof(BSM_COL_MAGIC) + FOOTER_LEN ||
+	    (uintmax_t)sb.st_size > SIZE_MAX) {
+		errno = EINVAL;
+		goto fail;
+	}
+
+	col->len = (size_t)sb.st_size;
+	base = mmap(NULL, col->len, PROT_READ, MAP_SHARED, col->fd, 0);
+	if (base == MAP_FAILED)
+		goto fail;
+	col->base = base;
+
+	errno = EINVAL;
+	foot = col->base + col->len - FOOTER_LEN;
+	if (memcmp(col->base, BSM_COL_MAGIC, sizeof(BSM_COL_MAGIC)) != 0 ||
+	    memcmp(foot + 40, BSM_COL_MAGIC, sizeof(BSM_COL_MAGIC)) != 0 ||
+	    get32(foot + 12) != BSM_COL_NCOLUMNS)
+		goto fail;
+	col->nrows = get64(foot);
+	col->block = get32(foot + 8);
+	col->nblocks = get64(foot + 16);
+	dictoff = get64(foot + 24);
+	diroff = get64(foot + 32);
+	if (col->block == 0 ||
+	    col->nblocks != (col->nrows + col->block - 1) / col->block ||
+	    dictoff < sizeof(BSM_COL_MAGIC) || dictoff > diroff ||
+	    diroff > col->len - FOOTER_LEN ||
+	    col->nblocks != (col->len - FOOTER_LEN - diroff) /
+	    (BSM_COL_NCOLUMNS * ENTRY_LEN) ||
+	    (col->len - FOOTER_LEN - diroff) %
+	    (BSM_COL_NCOLUMNS * ENTRY_LEN) != 0)
+		goto fail;
+	col->dir = col->base + diroff;
+
+	off = dictoff;
+	for (d = 0; d < BSM_COL_NDICTS; d++) {
+		left = (size_t)(diroff - off);
+		if ((n = load_dict(col, d, col->base + off, left)) == 0)
+			goto fail;
+		off += n;
+	}
+	if (off != diroff)
+		goto fail;
+
+	ent = col->dir;
+	for (b = 0; b < col->nblocks; b++) {
+		n = bsm_col_rows(col, b);
+		for (c = 0; c < BSM_COL_NCOLUMNS; c++, ent += ENTRY_LEN) {
+			off = get64(ent + 16);
+			width = get32(ent + 24);
+			if (get64(ent) > get64(ent + 8) || width > 8 ||
+			    off < sizeof(BSM_COL_MAGIC) || off > dictoff ||
+			    (uint64_t)width * n > dictoff - off)
+				goto fail;
+		}
+	}
+	return (0);
+
+fail:
+	error = errno;
+	bsm_col_close(col);
+	errno = error;
+	return (-1);
+}
+
+void
+bsm_col_close(struct bsm_col *col)
+{
+	int d;
+
+	for (d = 0; d < BSM_COL_NDICTS; d++)
+		free(col->strings[d]);
+	if (col->base != NULL)
+		munmap((void *)(uintptr_t)col->base, col->len);
+	if (col->fd != -1)
+		close(col->fd);
+	memset(col, 0, sizeof(*col));
+	col->fd = -1;
+}
+
+/*
+ * The number of rows in block "b", only the last one may be short
+ */
+size_t
+bsm_col_rows(const struct bsm_col *col, uint64_t b)
+{
+	uint64_t n = col->nrows - b * col->block;
+
+	return ((size_t)(n < col->block ? n : col->block));
+}
+
+/*
+ * Decode column "c" of block "b" into "vals". Each width has a loop of its
+ * own, simple enough for the compiler to vectorise.
+ */
+void
+bsm_col_decode(const struct bsm_col *col, uint64_t b, int c, uint64_t *vals)
+{
+	const uint8_t *ent = col->dir + (b * BSM_COL_NCOLUMNS + c) * ENTRY_LEN;
+	const uint8_t *p = col->base + get64(ent + 16);
+	uint64_t min = get64(ent);
+	size_t i, n = bsm_col_rows(col, b);
+
+	switch (get32(ent + 24)) {
+	case 0:
+		for (i = 0; i < n; i++)
+			vals[i] = min;
+		break;
+	case 1:
+		for (i = 0; i < n; i++)
+			vals[i] = min + p[i];
+		break;
+	case 2:
+		for (i = 0; i < n; i++)
+			vals[i] = min + ((uint32_t)p[2 * i] << 8 | p[2 * i + 1]);
+		break;
+	case 4:
+		for (i = 0; i < n; i++)
+			vals[i] = min + get32(p + 4 * i);
+		break;
+	default:
+		for (i = 0; i < n; i++)
+			vals[i] = min + get64(p + 8 * i);
+		break;
+	}
+}
+
+/*
+ * Mark in "sel" the rows of block "b" passing every predicate, decoding
+ * columns into the scratch space "vals" as needed. Returns the number of
+ * rows marked. A block whose minimum and maximum rule a predicate out is
+ * not looked at, nor is a column whose every row passes.
+ */
+size_t
+bsm_col_select(const struct bsm_col *col, uint64_t b,
+    const struct bsm_col_pred *preds, int npreds, uint8_t *sel,
+    uint64_t *vals)
+{
+	const struct bsm_col_pred *p;
+	const uint8_t *ent;
+	uint64_t min, max, range, v;
+	size_t i, n = bsm_col_rows(col, b), count;
+	int k;
+
+	for (k = 0; k < npreds; k++) {
+		p = &preds[k];
+		ent = col->dir + (b * BSM_COL_NCOLUMNS + p->col) * ENTRY_LEN;
+		if (p->lo > p->hi || get64(ent + 8) < p->lo ||
+		    get64(ent) > p->hi)
+			return (0);
+	}
+
+	memset(sel, 1, n);
+	for (k = 0; k < npreds; k++) {
+		p = &preds[k];
+		ent = col->dir + (b * BSM_COL_NCOLUMNS + p->col) * ENTRY_LEN;
+		min = get64(ent);
+		max = get64(ent + 8);
+		if (p->set == NULL && min >= p->lo && max <= p->hi)
+			continue;
+
+		bsm_col_decode(col, b, p->col, vals);
+		range = p->hi - p->lo;
+		if (p->set == NULL) {
+			for (i = 0; i < n; i++)
+				sel[i] &= (vals[i] - p->lo) <= range;
+			continue;
+		}
+		for (i = 0; i < n; i++) {
+			v = vals[i];
+			if (v - p->lo > range ||
+			    !(p->set[v / 8] & (1 << (v % 8))))
+				sel[i] = 0;
+		}
+	}
+
+	count = 0;
+	for (i = 0; i < n; i++)
+		count += sel[i];
+	return (count);
+}
+
+/*
+ * A predicate on the strings of dictionary "d" matching the fnmatch(3)
+ * pattern. Returns the set it refers to, for the caller to free, or NULL
+ * if it cannot be allocated.
+ */
+uint8_t *
+bsm_col_match(const struct bsm_col *col, int d, const char *pattern,
+    struct bsm_col_pred *pred)
+{
+	uint8_t *set;
+	uint32_t code;
+
+	if ((set = calloc(col->nstrings[d] / 8 + 1, 1)) == NULL)
+		return (NULL);
+	pred->col = (d == BSM_COL_DICT_PATH) ? BSM_COL_PATH : BSM_COL_ADDR;
+	pred->lo = 1;
+	pred->hi = 0;
+	pred->set = set;
+	for (code = 1; code < col->nstrings[d]; code++) {
+		if (fnmatch(pattern, col->strings[d][code], 0) != 0)
+			continue;
+		set[code / 8] |= 1 << (code % 8);
+		if (pred->lo > pred->hi)
+			pred->lo = code;
+		pred->hi = code;
+	}
+	return (set);
+}
+
+/*
+ * The string with code "code" in dictionary "d", NULL if there is none
+ */
+const char *
+bsm_col_string(const struct bsm_col *col, int d, uint64_t code)
+{
+	if (code >= col->nstrings[d])
+		return (NULL);
+	return (col->strings[d][code]);
+}
@@ -0,0 +1,126 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#ifndef _BSMCOL_H_
+#define _BSMCOL_H_
+
+/*
+ * Columnar export of a trail, "<trail>.col", holding the fields analysts
+ * filter on with one column each. Rows are cut into blocks; within a
+ * block a column is stored as offsets from its minimum, each as wide as
+ * the block's largest needs (none at all if every row is equal), which
+ * makes timestamps deltas from the block's first second. Strings, the
+ * paths and terminal addresses, are stored once in a dictionary and
+ * referred to by code, 0 for none. Event numbers need no dictionary,
+ * audit_event(5) already is one. All integers are big-endian:
+ *
+ *	magic		"BSMCOL1\0"
+ *	per block	per column, nrows offsets from the minimum
+ *	per dictionary	uint32 count, uint32 reserved, uint64 length,
+ *			then count NUL-terminated strings
+ *	per block	per column, uint64 min, uint64 max, uint64 data
+ *			offset, uint32 width, uint32 reserved
+ *	footer		uint64 nrows, uint32 block, uint32 ncolumns,
+ *			uint64 nblocks, uint64 dictionaries offset,
+ *			uint64 directory offset, magic
+ *
+ * Keeping the directory at the end lets the file be written in one pass.
+ * The minimum and maximum of each block let queries skip whole blocks.
+ */
+
+#include <stdio.h>
+
+#include "bsmdec.h"
+#include "bsmmap.h"
+
+#define BSM_COL_MAGIC		"BSMCOL1"
+#define BSM_COL_SUFFIX		".col"
+#define BSM_COL_BLOCK		4096	/* Rows per block */
+
+#define BSM_COL_SIZE		0	/* Record length */
+#define BSM_COL_VERSION		1
+#define BSM_COL_EVENT		2
+#define BSM_COL_MODIFIER	3
+#define BSM_COL_SEC		4
+#define BSM_COL_MSEC		5
+#define BSM_COL_SUBJECT		6	/* Id of the first subject, 0 if none */
+#define BSM_COL_AUID		7
+#define BSM_COL_EUID		8
+#define BSM_COL_EGID		9
+#define BSM_COL_RUID		10
+#define BSM_COL_RGID		11
+#define BSM_COL_PID		12
+#define BSM_COL_SID		13
+#define BSM_COL_PORT		14	/* Terminal ID */
+#define BSM_COL_ADDR		15	/* Terminal address, dictionary code */
+#define BSM_COL_PATH		16	/* First path, dictionary code */
+#define BSM_COL_RETURN		17	/* Id of the return token, 0 if none */
+#define BSM_COL_STATUS		18	/* BSM errno, 0 on success */
+#define BSM_COL_RETVAL		19
+#define BSM_COL_NCOLUMNS	20
+
+#define BSM_COL_DICT_PATH	0
+#define BSM_COL_DICT_ADDR	1
+#define BSM_COL_NDICTS		2
+
+struct bsm_col {
+	int		 fd;
+	const uint8_t	*base;
+	size_t		 len;
+	uint64_t	 nrows;
+	uint32_t	 block;
+	uint64_t	 nblocks;
+	const uint8_t	*dir;
+	const char	**strings[BSM_COL_NDICTS];
+	uint32_t	 nstrings[BSM_COL_NDICTS];	/* Including code 0 */
+};
+
+/*
+ * Rows pass a predicate if the column's value lies within [lo, hi] and,
+ * given a set, its bit is set there too. For a set "lo" and "hi" bound
+ * the codes it holds, so that blocks without them are skipped.
+ */
+struct bsm_col_pred {
+	int		 col;
+	uint64_t	 lo;
+	uint64_t	 hi;
+	const uint8_t	*set;		/* Bitmap of dictionary codes */
+};
+
+int	bsm_col_build(const struct bsm_map *, uint32_t, FILE *);
+int	bsm_col_open(struct bsm_col *, const char *);
+void	bsm_col_close(struct bsm_col *);
+
+size_t	bsm_col_rows(const struct bsm_col *, uint64_t);
+void	bsm_col_decode(const struct bsm_col *, uint64_t, int, uint64_t *);
+size_t	bsm_col_select(const struct bsm_col *, uint64_t,
+	    const struct bsm_col_pred *, int, uint8_t *, uint64_t *);
+uint8_t	*bsm_col_match(const struct bsm_col *, int, const char *,
+	    struct bsm_col_pred *);
+const char *bsm_col_string(const struct bsm_col *, int, uint64_t);
+
+#endif /* _BSMCOL_H_ */
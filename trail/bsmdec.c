@@ -0,0 +1,582 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#include <string.h>
+
+#include "bsmdec.h"
+
+#if defined(BSM_SIMD_AVX2)
+#include <immintrin.h>
+#elif defined(BSM_SIMD_SSE2)
+#include <emmintrin.h>
+#endif
+
+/*
+ * Bounds-checked big-endian reader over the bytes of a single token. Once
+ * a read runs past the end, "err" sticks and every later read returns 0.
+ */
+struct reader {
+	const uint8_t	*p;
+	size_t		 left;
+	int		 err;
+};
+
+static const uint8_t *
+get_bytes(struct reader *rd, size_t n)
+{
+	const uint8_t *p = rd->p;
+
+	if (rd->err || n > rd->left) {
+		rd->err = 1;
+		return (NULL);
+	}
+	rd->p += n;
+	rd->left -= n;
+	return (p);
+}
+
+static uint8_t
+get8(struct reader *rd)
+{
+	const uint8_t *p;
+
+	return ((p = get_bytes(rd, 1)) != NULL ? p[0] : 0);
+}
+
+static uint16_t
+get16(struct reader *rd)
+{
+	const uint8_t *p;
+
+	if ((p = get_bytes(rd, 2)) == NULL)
+		return (0);
+	return ((uint16_t)(p[0] << 8 | p[1]));
+}
+
+static uint32_t
+get32(struct reader *rd)
+{
+	const uint8_t *p;
+
+	if ((p = get_bytes(rd, 4)) == NULL)
+		return (0);
+	return ((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+	    (uint32_t)p[2] << 8 | p[3]);
+}
+
+static uint64_t
+get64(struct reader *rd)
+{
+	uint64_t hi;
+
+	hi = get32(rd);
+	return (hi << 32 | get32(rd));
+}
+
+/*
+ * A string of "n" bytes; a trailing NUL is not counted in its length
+ */
+static void
+get_string(struct reader *rd, size_t n, struct bsm_string *s)
+{
+	if ((s->str = (const char *)get_bytes(rd, n)) == NULL)
+		n = 0;
+	if (n > 0 && s->str[n - 1] == '\0')
+		n--;
+	s->len = n;
+}
+
+/*
+ * An address of "type" bytes, either BSM_IPV4 or BSM_IPV6
+ */
+static void
+get_addr(struct reader *rd, uint32_t type, struct bsm_addr *addr)
+{
+	const uint8_t *p;
+
+	addr->type = type;
+	if (type != BSM_IPV4 && type != BSM_IPV6) {
+		rd->err = 1;
+		return;
+	}
+	if ((p = get_bytes(rd, type)) != NULL)
+		memcpy(addr->addr, p, type);
+}
+
+static void
+get_header(struct reader *rd, uint8_t id, struct bsm_header *hdr)
+{
+	hdr->size = get32(rd);
+	hdr->version = get8(rd);
+	hdr->event = get16(rd);
+	hdr->modifier = get16(rd);
+	hdr->host.type = 0;
+	if (id == BSM_HEADER32_EX || id == BSM_HEADER64_EX)
+		get_addr(rd, get32(rd), &hdr->host);
+	if (id == BSM_HEADER32 || id == BSM_HEADER32_EX) {
+		hdr->sec = get32(rd);
+		hdr->msec = get32(rd);
+	} else {
+		hdr->sec = get64(rd);
+		hdr->msec = get64(rd);
+	}
+}
+
+/*
+ * Subject and process tokens share a layout, differing only in the width
+ * of the terminal port and whether the terminal address carries its type.
+ */
+static void
+get_subject(struct reader *rd, uint8_t id, struct bsm_subject *subj)
+{
+	subj->auid = get32(rd);
+	subj->euid = get32(rd);
+	subj->egid = get32(rd);
+	subj->ruid = get32(rd);
+	subj->rgid = get32(rd);
+	subj->pid = get32(rd);
+	subj->sid = get32(rd);
+
+	switch (id) {
+	case BSM_SUBJECT32:
+	case BSM_PROCESS32:
+		subj->port = get32(rd);
+		get_addr(rd, BSM_IPV4, &subj->addr);
+		break;
+	case BSM_SUBJECT64:
+	case BSM_PROCESS64:
+		subj->port = get64(rd);
+		get_addr(rd, BSM_IPV4, &subj->addr);
+		break;
+	case BSM_SUBJECT32_EX:
+	case BSM_PROCESS32_EX:
+		subj->port = get32(rd);
+		get_addr(rd, get32(rd), &subj->addr);
+		break;
+	default:
+		subj->port = get64(rd);
+		get_addr(rd, get32(rd), &subj->addr);
+		break;
+	}
+}
+
+/*
+ * Exec argument and environment tokens hold "count" NUL-terminated strings
+ */
+static void
+get_exec(struct reader *rd, struct bsm_token *tok)
+{
+	const uint8_t *start, *nul;
+	uint32_t i;
+
+	tok->tt.exec.count = get32(rd);
+	tok->tt.exec.args = (const char *)rd->p;
+	start = rd->p;
+	for (i = 0; i < tok->tt.exec.count && !rd->err; i++) {
+		if ((nul = memchr(rd->p, '\0', rd->left)) == NULL) {
+			rd->err = 1;
+			break;
+		}
+		get_bytes(rd, (size_t)(nul - rd->p) + 1);
+	}
+	tok->tt.exec.len = (size_t)(rd->p - start);
+}
+
+/*
+ * Size of a single unit of an arbitrary data token
+ */
+static size_t
+data_unit(uint8_t bu)
+{
+	switch (bu) {
+	case 0:		/* AUR_CHAR */
+		return (1);
+	case 1:		/* AUR_SHORT */
+		return (2);
+	case 2:		/* AUR_INT32 */
+		return (4);
+	case 3:		/* AUR_INT64 */
+		return (8);
+	default:
+		return (0);
+	}
+}
+
+/*
+ * Decode the token at "buf" holding at most "len" bytes. Returns BSM_OK
+ * and sets tok->len to the number of bytes consumed, or BSM_ERROR if the
+ * token is unknown or truncated.
+ */
+int
+bsm_decode_token(const uint8_t *buf, size_t len, struct bsm_token *tok)
+{
+	struct reader rd = { buf, len, 0 };
+	const uint8_t *nul;
+	size_t n;
+
+	tok->id = get8(&rd);
+	tok->data = buf;
+
+	switch (tok->id) {
+	case BSM_HEADER32:
+	case BSM_HEADER32_EX:
+	case BSM_HEADER64:
+	case BSM_HEADER64_EX:
+		get_header(&rd, tok->id, &tok->tt.hdr);
+		break;
+
+	case BSM_TRAILER:
+		tok->tt.trail.magic = get16(&rd);
+		tok->tt.trail.count = get32(&rd);
+		break;
+
+	case BSM_ARG32:
+	case BSM_ARG64:
+		tok->tt.arg.no = get8(&rd);
+		tok->tt.arg.val = (tok->id == BSM_ARG32) ? get32(&rd) :
+		    get64(&rd);
+		n = get16(&rd);
+		get_string(&rd, n, &tok->tt.arg.text);
+		break;
+
+	case BSM_PATH:
+	case BSM_TEXT:
+	case BSM_ZONENAME:
+		n = get16(&rd);
+		get_string(&rd, n, &tok->tt.str);
+		break;
+
+	case BSM_SUBJECT32:
+	case BSM_SUBJECT64:
+	case BSM_SUBJECT32_EX:
+	case BSM_SUBJECT64_EX:
+	case BSM_PROCESS32:
+	case BSM_PROCESS64:
+	case BSM_PROCESS32_EX:
+	case BSM_PROCESS64_EX:
+		get_subject(&rd, tok->id, &tok->tt.subj);
+		break;
+
+	case BSM_RETURN32:
+	case BSM_RETURN64:
+		tok->tt.ret.status = get8(&rd);
+		tok->tt.ret.val = (tok->id == BSM_RETURN32) ? get32(&rd) :
+		    get64(&rd);
+		break;
+
+	case BSM_ATTR:
+	case BSM_ATTR32:
+	case BSM_ATTR64:
+		tok->tt.attr.mode = get32(&rd);
+		tok->tt.attr.uid = get32(&rd);
+		tok->tt.attr.gid = get32(&rd);
+		tok->tt.attr.fsid = get32(&rd);
+		tok->tt.attr.nodeid = get64(&rd);
+		tok->tt.attr.dev = (tok->id == BSM_ATTR64) ? get64(&rd) :
+		    get32(&rd);
+		break;
+
+	case BSM_IPC:
+		tok->tt.ipc.type = get8(&rd);
+		tok->tt.ipc.id = get32(&rd);
+		break;
+
+	case BSM_IPC_PERM:
+		tok->tt.ipcperm.uid = get32(&rd);
+		tok->tt.ipcperm.gid = get32(&rd);
+		tok->tt.ipcperm.puid = get32(&rd);
+		tok->tt.ipcperm.pgid = get32(&rd);
+		tok->tt.ipcperm.mode = get32(&rd);
+		tok->tt.ipcperm.seq = get32(&rd);
+		tok->tt.ipcperm.key = get32(&rd);
+		break;
+
+	case BSM_EXEC_ARGS:
+	case BSM_EXEC_ENV:
+		get_exec(&rd, tok);
+		break;
+
+	case BSM_SOCKINET32:
+	case BSM_SOCKINET128:
+		tok->tt.sockinet.family = get16(&rd);
+		tok->tt.sockinet.port = get16(&rd);
+		get_addr(&rd, (tok->id == BSM_SOCKINET32) ? BSM_IPV4 :
+		    BSM_IPV6, &tok->tt.sockinet.addr);
+		tok->tt.sockinet.path.str = NULL;
+		tok->tt.sockinet.path.len = 0;
+		break;
+
+	case BSM_SOCKUNIX:
+		tok->tt.sockinet.family = get16(&rd);
+		tok->tt.sockinet.port = 0;
+		tok->tt.sockinet.addr.type = 0;
+		/* The path is NUL-terminated within sizeof(sun_path) bytes */
+		n = (rd.left < 104) ? rd.left : 104;
+		if ((nul = memchr(rd.p, '\0', n)) != NULL)
+			n = (size_t)(nul - rd.p) + 1;
+		get_string(&rd, n, &tok->tt.sockinet.path);
+		break;
+
+	case BSM_SOCKET:
+		tok->tt.socket.domain = 0;
+		tok->tt.socket.type = get16(&rd);
+		tok->tt.socket.lport = get16(&rd);
+		get_addr(&rd, BSM_IPV4, &tok->tt.socket.laddr);
+		tok->tt.socket.rport = get16(&rd);
+		get_addr(&rd, BSM_IPV4, &tok->tt.socket.raddr);
+		break;
+
+	case BSM_SOCKET_EX:
+		tok->tt.socket.domain = get16(&rd);
+		tok->tt.socket.type = get16(&rd);
+		n = get16(&rd);
+		tok->tt.socket.lport = get16(&rd);
+		get_addr(&rd, (uint32_t)n, &tok->tt.socket.laddr);
+		tok->tt.socket.rport = get16(&rd);
+		get_addr(&rd, (uint32_t)n, &tok->tt.socket.raddr);
+		break;
+
+	case BSM_EXIT:
+		tok->tt.exit.status = get32(&rd);
+		tok->tt.exit.ret = get32(&rd);
+		break;
+
+	case BSM_SEQ:
+		tok->tt.seqno = get32(&rd);
+		break;
+
+	case BSM_NEWGROUPS:
+		tok->tt.groups.count = get16(&rd);
+		tok->tt.groups.gids = get_bytes(&rd,
+		    (size_t)tok->tt.groups.count * 4);
+		break;
+
+	case BSM_DATA:
+		tok->tt.data.howtopr = get8(&rd);
+		tok->tt.data.bu = get8(&rd);
+		tok->tt.data.uc = get8(&rd);
+		if ((n = data_unit(tok->tt.data.bu)) == 0)
+			return (BSM_ERROR);
+		tok->tt.data.len = n * tok->tt.data.uc;
+		tok->tt.data.data = get_bytes(&rd, tok->tt.data.len);
+		break;
+
+	case BSM_OPAQUE:
+		tok->tt.opaque.len = get16(&rd);
+		tok->tt.opaque.data = get_bytes(&rd, tok->tt.opaque.len);
+		break;
+
+	case BSM_IN_ADDR:
+		get_addr(&rd, BSM_IPV4, &tok->tt.inaddr);
+		break;
+
+	case BSM_IN_ADDR_EX:
+		get_addr(&rd, get32(&rd), &tok->tt.inaddr);
+		break;
+
+	case BSM_IP:
+		tok->tt.ip = get_bytes(&rd, 20);
+		break;
+
+	case BSM_IPORT:
+		tok->tt.iport = get16(&rd);
+		break;
+
+	case BSM_OTHER_FILE32:
+		tok->tt.file.sec = get32(&rd);
+		tok->tt.file.msec = get32(&rd);
+		n = get16(&rd);
+		get_string(&rd, n, &tok->tt.file.name);
+		break;
+
+	default:
+		return (BSM_ERROR);
+	}
+
+	if (rd.err)
+		return (BSM_ERROR);
+	tok->len = len - rd.left;
+	return (BSM_OK);
+}
+
+void
+bsm_cursor_init(struct bsm_cursor *cur, const void *buf, size_t len)
+{
+	cur->buf = buf;
+	cur->len = len;
+	cur->off = 0;
+}
+
+/*
+ * Decode the next token and move past it. Returns BSM_END once the buffer
+ * is exhausted; on BSM_ERROR the cursor is left on the offending byte.
+ */
+int
+bsm_next_token(struct bsm_cursor *cur, struct bsm_token *tok)
+{
+	if (cur->off >= cur->len)
+		return (BSM_END);
+	if (bsm_decode_token(cur->buf + cur->off, cur->len - cur->off, tok)
+	    != BSM_OK)
+		return (BSM_ERROR);
+	cur->off += tok->len;
+	return (BSM_OK);
+}
+
+int
+bsm_is_header(uint8_t id)
+{
+	return (id == BSM_HEADER32 || id == BSM_HEADER32_EX ||
+	    id == BSM_HEADER64 || id == BSM_HEADER64_EX);
+}
+
+/*
+ * Length of the record starting at "buf", as claimed by its header token,
+ * or 0 if "buf" does not start with a header.
+ */
+size_t
+bsm_record_len(const uint8_t *buf, size_t avail)
+{
+	if (avail < 5 || !bsm_is_header(buf[0]))
+		return (0);
+	return ((size_t)buf[1] << 24 | (size_t)buf[2] << 16 |
+	    (size_t)buf[3] << 8 | buf[4]);
+}
+
+/*
+ * Whether "buf" holds a complete record whose header length is confirmed
+ * by a trailer token carrying the same count
+ */
+int
+bsm_record_valid(const uint8_t *buf, size_t avail)
+{
+	const uint8_t *trail;
+	size_t size;
+
+	size = bsm_record_len(buf, avail);
+	if (size < BSM_HEADER32_LEN + BSM_TRAILER_LEN || size > avail)
+		return (0);
+
+	trail = buf + size - BSM_TRAILER_LEN;
+	return (trail[0] == BSM_TRAILER &&
+	    (trail[1] << 8 | trail[2]) == BSM_TRAILER_MAGIC &&
+	    size == ((size_t)trail[3] << 24 | (size_t)trail[4] << 16 |
+	    (size_t)trail[5] << 8 | trail[6]));
+}
+
+/*
+ * Point "rec" at the next record and move past it
+ */
+int
+bsm_next_record(struct bsm_cursor *cur, struct bsm_cursor *rec)
+{
+	size_t size;
+
+	if (cur->off >= cur->len)
+		return (BSM_END);
+
+	size = bsm_record_len(cur->buf + cur->off, cur->len - cur->off);
+	if (size < BSM_HEADER32_LEN || size > cur->len - cur->off)
+		return (BSM_ERROR);
+
+	bsm_cursor_init(rec, cur->buf + cur->off, size);
+	cur->off += size;
+	return (BSM_OK);
+}
+
+/*
+ * The first byte from "p" on holding the id of a header token, "end" if
+ * there is none. With SSE2 or AVX2, 16 or 32 bytes are compared at once.
+ */
+static const uint8_t *
+find_header(const uint8_t *p, const uint8_t *end)
+{
+#if defined(BSM_SIMD_AVX2)
+	const __m256i h32 = _mm256_set1_epi8(BSM_HEADER32);
+	const __m256i h32ex = _mm256_set1_epi8(BSM_HEADER32_EX);
+	const __m256i h64 = _mm256_set1_epi8(BSM_HEADER64);
+	const __m256i h64ex = _mm256_set1_epi8(BSM_HEADER64_EX);
+	__m256i v, m;
+	unsigned int mask;
+
+	for (; end - p >= 32; p += 32) {
+		v = _mm256_loadu_si256((const __m256i *)p);
+		m = _mm256_or_si256(
+		    _mm256_or_si256(_mm256_cmpeq_epi8(v, h32),
+		    _mm256_cmpeq_epi8(v, h32ex)),
+		    _mm256_or_si256(_mm256_cmpeq_epi8(v, h64),
+		    _mm256_cmpeq_epi8(v, h64ex)));
+		if ((mask = (unsigned int)_mm256_movemask_epi8(m)) != 0)
+			return (p + __builtin_ctz(mask));
+	}
+#elif defined(BSM_SIMD_SSE2)
+	const __m128i h32 = _mm_set1_epi8(BSM_HEADER32);
+	const __m128i h32ex = _mm_set1_epi8(BSM_HEADER32_EX);
+	const __m128i h64 = _mm_set1_epi8(BSM_HEADER64);
+	const __m128i h64ex = _mm_set1_epi8(BSM_HEADER64_EX);
+	__m128i v, m;
+	unsigned int mask;
+
+	for (; end - p >= 16; p += 16) {
+		v = _mm_loadu_si128((const __m128i *)p);
+		m = _mm_or_si128(
+		    _mm_or_si128(_mm_cmpeq_epi8(v, h32),
+		    _mm_cmpeq_epi8(v, h32ex)),
+		    _mm_or_si128(_mm_cmpeq_epi8(v, h64),
+		    _mm_cmpeq_epi8(v, h64ex)));
+		if ((mask = (unsigned int)_mm_movemask_epi8(m)) != 0)
+			return (p + __builtin_ctz(mask));
+	}
+#endif
+	for (; p < end; p++) {
+		if (bsm_is_header(*p))
+			break;
+	}
+	return (p);
+}
+
+/*
+ * Skip forward to the next offset at which a valid record starts, used to
+ * recover from corrupted or partially written trails. Only offsets holding
+ * a header id are worth checking, and those are rare in token data.
+ */
+int
+bsm_resync(struct bsm_cursor *cur)
+{
+	const uint8_t *p, *end = cur->buf + cur->len;
+
+	if (cur->off >= cur->len)
+		return (BSM_END);
+	for (p = cur->buf + cur->off; (p = find_header(p, end)) < end; p++) {
+		if (bsm_record_valid(p, (size_t)(end - p))) {
+			cur->off = (size_t)(p - cur->buf);
+			return (BSM_OK);
+		}
+	}
+	cur->off = cur->len;
+	return (BSM_END);
+}
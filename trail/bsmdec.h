@@ -0,0 +1,278 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#ifndef _BSMDEC_H_
+#define _BSMDEC_H_
+
+/*
+ * Portable, allocation-free decoder for BSM audit trails. Tokens are decoded
+ * in place: every string or byte array in a decoded token points back into
+ * the caller's buffer, which must outlive the token.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Token identifiers, see audit.log(5) */
+#define BSM_OTHER_FILE32	0x11
+#define BSM_TRAILER		0x13
+#define BSM_HEADER32		0x14
+#define BSM_HEADER32_EX		0x15
+#define BSM_DATA		0x21
+#define BSM_IPC			0x22
+#define BSM_PATH		0x23
+#define BSM_SUBJECT32		0x24
+#define BSM_PROCESS32		0x26
+#define BSM_RETURN32		0x27
+#define BSM_TEXT		0x28
+#define BSM_OPAQUE		0x29
+#define BSM_IN_ADDR		0x2a
+#define BSM_IP			0x2b
+#define BSM_IPORT		0x2c
+#define BSM_ARG32		0x2d
+#define BSM_SOCKET		0x2e
+#define BSM_SEQ			0x2f
+#define BSM_ATTR		0x31
+#define BSM_IPC_PERM		0x32
+#define BSM_NEWGROUPS		0x3b
+#define BSM_EXEC_ARGS		0x3c
+#define BSM_EXEC_ENV		0x3d
+#define BSM_ATTR32		0x3e
+#define BSM_EXIT		0x52
+#define BSM_ZONENAME		0x60
+#define BSM_ARG64		0x71
+#define BSM_RETURN64		0x72
+#define BSM_ATTR64		0x73
+#define BSM_HEADER64		0x74
+#define BSM_SUBJECT64		0x75
+#define BSM_PROCESS64		0x77
+#define BSM_HEADER64_EX		0x79
+#define BSM_SUBJECT32_EX	0x7a
+#define BSM_PROCESS32_EX	0x7b
+#define BSM_SUBJECT64_EX	0x7c
+#define BSM_PROCESS64_EX	0x7d
+#define BSM_IN_ADDR_EX		0x7e
+#define BSM_SOCKET_EX		0x7f
+#define BSM_SOCKINET32		0x80
+#define BSM_SOCKINET128		0x81
+#define BSM_SOCKUNIX		0x82
+
+#define BSM_TRAILER_MAGIC	0xb105
+#define BSM_TRAILER_LEN		7	/* id, magic, count */
+#define BSM_HEADER32_LEN	18	/* Smallest possible header token */
+
+/* Address types used by the *_EX tokens */
+#define BSM_IPV4		4
+#define BSM_IPV6		16
+
+/*
+ * Vector instructions the scanners for header and trailer tokens use, as
+ * chosen by the compiler flags, e.g. -mavx2 or -march=native
+ */
+#if defined(__GNUC__) && defined(__AVX2__)
+#define BSM_SIMD_AVX2
+#define BSM_SIMD		"AVX2"
+#elif defined(__GNUC__) && defined(__SSE2__)
+#define BSM_SIMD_SSE2
+#define BSM_SIMD		"SSE2"
+#else
+#define BSM_SIMD		"scalar"
+#endif
+
+/* Decoder status */
+#define BSM_OK			1
+#define BSM_END			0
+#define BSM_ERROR		(-1)
+
+/*
+ * A length-prefixed or NUL-terminated string inside the decoded buffer.
+ * "len" never includes the terminating NUL, if there is one.
+ */
+struct bsm_string {
+	const char	*str;
+	size_t		 len;
+};
+
+struct bsm_addr {
+	uint32_t	 type;		/* BSM_IPV4 or BSM_IPV6 */
+	uint8_t		 addr[16];	/* Network byte order */
+};
+
+struct bsm_header {
+	uint32_t	 size;		/* Length of the whole record */
+	uint8_t		 version;
+	uint16_t	 event;
+	uint16_t	 modifier;
+	struct bsm_addr	 host;		/* Only for the *_EX forms */
+	uint64_t	 sec;
+	uint64_t	 msec;
+};
+
+struct bsm_subject {
+	uint32_t	 auid;
+	uint32_t	 euid;
+	uint32_t	 egid;
+	uint32_t	 ruid;
+	uint32_t	 rgid;
+	uint32_t	 pid;
+	uint32_t	 sid;
+	uint64_t	 port;
+	struct bsm_addr	 addr;
+};
+
+struct bsm_token {
+	uint8_t		 id;
+	const uint8_t	*data;		/* Raw token, including the id */
+	size_t		 len;
+	union {
+		struct bsm_header hdr;
+		struct bsm_subject subj;	/* Also process tokens */
+		struct {
+			uint16_t	magic;
+			uint32_t	count;
+		} trail;
+		struct {
+			uint8_t		no;
+			uint64_t	val;
+			struct bsm_string text;
+		} arg;
+		struct {
+			uint8_t		status;	/* BSM errno, 0 on success */
+			uint64_t	val;
+		} ret;
+		struct bsm_string str;		/* path, text, zonename */
+		struct {
+			uint32_t	mode;
+			uint32_t	uid;
+			uint32_t	gid;
+			uint32_t	fsid;
+			uint64_t	nodeid;
+			uint64_t	dev;
+		} attr;
+		struct {
+			uint8_t		type;
+			uint32_t	id;
+		} ipc;
+		struct {
+			uint32_t	uid;
+			uint32_t	gid;
+			uint32_t	puid;
+			uint32_t	pgid;
+			uint32_t	mode;
+			uint32_t	seq;
+			uint32_t	key;
+		} ipcperm;
+		struct {
+			uint32_t	count;
+			const char	*args;	/* count NUL-terminated strings */
+			size_t		 len;
+		} exec;
+		struct {
+			uint16_t	family;
+			uint16_t	port;	/* Host byte order */
+			struct bsm_addr	addr;
+			struct bsm_string path;	/* BSM_SOCKUNIX only */
+		} sockinet;
+		struct {
+			uint16_t	domain;	/* BSM_SOCKET_EX only */
+			uint16_t	type;
+			uint16_t	lport;
+			struct bsm_addr	laddr;
+			uint16_t	rport;
+			struct bsm_addr	raddr;
+		} socket;
+		struct {
+			uint32_t	status;
+			uint32_t	ret;
+		} exit;
+		struct {
+			uint16_t	count;
+			const uint8_t	*gids;	/* count big-endian uint32_t */
+		} groups;
+		struct {
+			uint8_t		howtopr;
+			uint8_t		bu;
+			uint8_t		uc;
+			const uint8_t	*data;
+			size_t		 len;
+		} data;
+		struct {
+			uint16_t	len;
+			const uint8_t	*data;
+		} opaque;
+		struct bsm_addr inaddr;
+		uint16_t	iport;		/* Network byte order */
+		uint32_t	seqno;
+		const uint8_t	*ip;		/* 20 byte IPv4 header */
+		struct {
+			uint32_t	sec;
+			uint32_t	msec;
+			struct bsm_string name;
+		} file;
+	} tt;
+};
+
+/*
+ * A cursor walks a buffer holding any number of complete records, one
+ * token or one record at a time.
+ */
+struct bsm_cursor {
+	const uint8_t	*buf;
+	size_t		 len;
+	size_t		 off;
+};
+
+void	bsm_cursor_init(struct bsm_cursor *, const void *, size_t);
+int	bsm_next_token(struct bsm_cursor *, struct bsm_token *);
+int	bsm_next_record(struct bsm_cursor *, struct bsm_cursor *);
+int	bsm_resync(struct bsm_cursor *);
+
+/*
+ * A reader pulls complete records off a file descriptor into a buffer
+ * supplied by the caller, issuing as few large read(2) calls as possible
+ * and carrying a partially read record over to the next call. Records
+ * larger than the buffer are reported as errors.
+ */
+struct bsm_reader {
+	int		 fd;
+	uint8_t		*buf;
+	size_t		 size;		/* Capacity of buf */
+	size_t		 off;		/* First unconsumed byte */
+	size_t		 len;		/* End of the data read so far */
+	int		 eof;
+};
+
+void	bsm_reader_init(struct bsm_reader *, int, void *, size_t);
+int	bsm_read_record(struct bsm_reader *, struct bsm_cursor *);
+int	bsm_reader_resync(struct bsm_reader *);
+
+int	bsm_decode_token(const uint8_t *, size_t, struct bsm_token *);
+int	bsm_is_header(uint8_t);
+size_t	bsm_record_len(const uint8_t *, size_t);
+int	bsm_record_valid(const uint8_t *, size_t);
+
+#endif /* _BSMDEC_H_ */
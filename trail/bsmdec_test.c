@@ -0,0 +1,159 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#include <atf-c.h>
+#include <string.h>
+
+#include "bsmdec.h"
+
+/*
+ * The socket(2) record of praudit's "trail" input, 113 bytes long
+ */
+static const unsigned char socketrec[] = {
+	0x14, 0x00, 0x00, 0x00, 0x71, 0x0b, 0x00, 0xb7, 0x00, 0x00, 0x5b, 0x1e,
+	0x4c, 0x85, 0x00, 0x00, 0x01, 0x7c, 0x2d, 0x01, 0x00, 0x00, 0x00, 0x1c,
+	0x00, 0x07, 0x64, 0x6f, 0x6d, 0x61, 0x69, 0x6e, 0x00, 0x2d, 0x02, 0x00,
+	0x00, 0x00, 0x02, 0x00, 0x05, 0x74, 0x79, 0x70, 0x65, 0x00, 0x2d, 0x03,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x70, 0x72, 0x6f, 0x74, 0x6f, 0x63,
+	0x6f, 0x6c, 0x00, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x1b, 0x8d, 0x00, 0x00, 0x12, 0x74, 0x00, 0x00, 0x93, 0x04,
+	0x0a, 0x00, 0x02, 0x02, 0x27, 0x00, 0x00, 0x00, 0x00, 0x03, 0x13, 0xb1,
+	0x05, 0x00, 0x00, 0x00, 0x71
+};
+
+
+ATF_TC_WITHOUT_HEAD(decode_tokens);
+ATF_TC_BODY(decode_tokens, tc)
+{
+	struct bsm_cursor cur;
+	struct bsm_token tok;
+
+	bsm_cursor_init(&cur, socketrec, sizeof(socketrec));
+
+	ATF_REQUIRE_EQ(BSM_OK, bsm_next_token(&cur, &tok));
+	ATF_REQUIRE_EQ(BSM_HEADER32, tok.id);
+	ATF_REQUIRE_EQ(113, tok.tt.hdr.size);
+	ATF_REQUIRE_EQ(183, tok.tt.hdr.event);
+	ATF_REQUIRE_EQ(1528712325, tok.tt.hdr.sec);
+	ATF_REQUIRE_EQ(380, tok.tt.hdr.msec);
+
+	ATF_REQUIRE_EQ(BSM_OK, bsm_next_token(&cur, &tok));
+	ATF_REQUIRE_EQ(BSM_ARG32, tok.id);
+	ATF_REQUIRE_EQ(1, tok.tt.arg.no);
+	ATF_REQUIRE_EQ(0x1c, tok.tt.arg.val);
+	ATF_REQUIRE_EQ(6, tok.tt.arg.text.len);
+	ATF_REQUIRE(memcmp(tok.tt.arg.text.str, "domain", 6) == 0);
+
+	ATF_REQUIRE_EQ(BSM_OK, bsm_next_token(&cur, &tok));
+	ATF_REQUIRE_EQ(BSM_OK, bsm_next_token(&cur, &tok));
+
+	ATF_REQUIRE_EQ(BSM_OK, bsm_next_token(&cur, &tok));
+	ATF_REQUIRE_EQ(BSM_SUBJECT32, tok.id);
+	ATF_REQUIRE_EQ(7053, tok.tt.subj.pid);
+	ATF_REQUIRE_EQ(4724, tok.tt.subj.sid);
+	ATF_REQUIRE_EQ(BSM_IPV4, tok.tt.subj.addr.type);
+
+	ATF_REQUIRE_EQ(BSM_OK, bsm_next_token(&cur, &tok));
+	ATF_REQUIRE_EQ(BSM_RETURN32, tok.id);
+	ATF_REQUIRE_EQ(0, tok.tt.ret.status);
+	ATF_REQUIRE_EQ(3, tok.tt.ret.val);
+
+	ATF_REQUIRE_EQ(BSM_OK, bsm_next_token(&cur, &tok));
+	ATF_REQUIRE_EQ(BSM_TRAILER, tok.id);
+	ATF_REQUIRE_EQ(BSM_TRAILER_MAGIC, tok.tt.trail.magic);
+	ATF_REQUIRE_EQ(113, tok.tt.trail.count);
+
+	ATF_REQUIRE_EQ(BSM_END, bsm_next_token(&cur, &tok));
+}
+
+
+ATF_TC_WITHOUT_HEAD(decode_truncated);
+ATF_TC_BODY(decode_truncated, tc)
+{
+	struct bsm_token tok;
+	size_t len;
+
+	/* Every proper prefix of the header token must be rejected */
+	for (len = 0; len < BSM_HEADER32_LEN; len++)
+		ATF_REQUIRE_EQ(BSM_ERROR,
+		    bsm_decode_token(socketrec, len, &tok));
+	ATF_REQUIRE_EQ(BSM_OK,
+	    bsm_decode_token(socketrec, BSM_HEADER32_LEN, &tok));
+	ATF_REQUIRE_EQ(BSM_HEADER32_LEN, tok.len);
+
+	/* An argument token whose text runs past the end of the buffer */
+	ATF_REQUIRE_EQ(BSM_ERROR, bsm_decode_token(socketrec + 18, 14, &tok));
+}
+
+
+ATF_TC_WITHOUT_HEAD(next_record);
+ATF_TC_BODY(next_record, tc)
+{
+	unsigned char buff[2 * sizeof(socketrec)];
+	struct bsm_cursor trail, rec;
+
+	memcpy(buff, socketrec, sizeof(socketrec));
+	memcpy(buff + sizeof(socketrec), socketrec, sizeof(socketrec));
+	bsm_cursor_init(&trail, buff, sizeof(buff));
+
+	ATF_REQUIRE_EQ(BSM_OK, bsm_next_record(&trail, &rec));
+	ATF_REQUIRE_EQ(sizeof(socketrec), rec.len);
+	ATF_REQUIRE_EQ(BSM_OK, bsm_next_record(&trail, &rec));
+	ATF_REQUIRE(rec.buf == buff + sizeof(socketrec));
+	ATF_REQUIRE_EQ(BSM_END, bsm_next_record(&trail, &rec));
+}
+
+
+ATF_TC_WITHOUT_HEAD(resync_garbage);
+ATF_TC_BODY(resync_garbage, tc)
+{
+	unsigned char buff[31 + sizeof(socketrec)];
+	struct bsm_cursor trail, rec;
+
+	/* Garbage containing a header id must not be taken for a record */
+	memset(buff, 0x14, 31);
+	memcpy(buff + 31, socketrec, sizeof(socketrec));
+	bsm_cursor_init(&trail, buff, sizeof(buff));
+
+	ATF_REQUIRE_EQ(BSM_ERROR, bsm_next_record(&trail, &rec));
+	ATF_REQUIRE_EQ(BSM_OK, bsm_resync(&trail));
+	ATF_REQUIRE_EQ(31, trail.off);
+	ATF_REQUIRE_EQ(BSM_OK, bsm_next_record(&trail, &rec));
+	ATF_REQUIRE_EQ(sizeof(socketrec), rec.len);
+}
+
+
+ATF_TP_ADD_TCS(tp)
+{
+	ATF_TP_ADD_TC(tp, decode_tokens);
+	ATF_TP_ADD_TC(tp, decode_truncated);
+	ATF_TP_ADD_TC(tp, next_record);
+	ATF_TP_ADD_TC(tp, resync_garbage);
+
+	return (atf_no_error());
+}
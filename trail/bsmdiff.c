@@ -0,0 +1,600 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * bsmdiff(1) compares two trails, such as those recorded while the same
+ * audit/ test program ran on two kernel builds, and reports the records
+ * whose tokens changed, went missing or appeared. The n-th record of an
+ * event in the old trail is aligned with the n-th record of that event in
+ * the new one. Fields that differ from one run to the next are left out of
+ * the comparison: the size and time of the record, the process, audit
+ * session and terminal of subject and process tokens, sequence numbers,
+ * and the subject's pid where it ends a path component, as it does in the
+ * fixture names of the test programs.
+ *
+ * Differences are printed like a unified diff, a record at a time: a line
+ * "@@ -old +new event" with the positions of the records in their trails,
+ * then their tokens, each prefixed with ' ', '-' or '+'. The exit status
+ * is that of diff(1).
+ *
+ * Both trails are read as streams. A record waits for its counterpart
+ * among at most "window" records of its own trail, after which it is
+ * reported as missing from the other one, so memory stays bounded however
+ * large the trails are.
+ */
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bsmdec.h"
+#include "bsmfmt.h"
+
+#define AUDIT_EVENT_FILE	"/etc/security/audit_event"
+#define READ_BUFFER_SIZE	(1024 * 1024)
+#define DEFAULT_WINDOW		4096
+
+/* A record of one trail still waiting for its counterpart */
+struct pending {
+	struct pending	*prev;		/* In the order of the trail */
+	struct pending	*next;
+	struct pending	*evnext;	/* Next record of the same event */
+	uint64_t	 pos;		/* Position in the trail, from 1 */
+	uint16_t	 event;
+	size_t		 len;
+	uint8_t		 rec[];
+};
+
+struct trail {
+	const char	*name;
+	int		 fd;
+	struct bsm_reader rd;
+	uint64_t	 pos;		/* Records read so far */
+	int		 done;
+	struct pending	*first;
+	struct pending	*last;
+	size_t		 npending;
+	struct {
+		struct pending	*head;
+		struct pending	*tail;
+	} events[UINT16_MAX + 1];	/* Pending records, by event */
+};
+
+/* The decoded tokens of a record being compared */
+struct tokens {
+	struct bsm_token *toks;
+	size_t		 ntoks;
+	size_t		 cap;
+	uint32_t	 pid;		/* Of the first subject token */
+};
+
+struct event_count {
+	unsigned long	 changed;
+	unsigned long	 removed;
+	unsigned long	 added;
+};
+
+static struct trail trails[2];		/* Old, new */
+static struct tokens tokens[2];
+static struct event_count counts[UINT16_MAX + 1];
+static unsigned long ndiffs;
+static size_t *lcs;
+static size_t lcscap;
+static char paths[2][UINT16_MAX + 1];
+static const char *del = ",";
+static struct bsm_out out;
+static size_t window = DEFAULT_WINDOW;
+static int partial;
+static int summary;
+static int flags;
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: bsmdiff [-cp] [-r | -s] [-d del] "
+	    "[-e audit_event] [-w window] old new\n");
+	exit(2);
+}
+
+/*
+ * Point "rec" at the next record of "t". Like bsmcat(1), a corrupted
+ * record ends the trail unless -p asks to skip ahead to the next valid one.
+ */
+static int
+read_record(struct trail *t, struct bsm_cursor *rec)
+{
+	int ret;
+
+	for (;;) {
+		if (partial && bsm_reader_resync(&t->rd) != BSM_OK)
+			return (BSM_END);
+		errno = 0;
+		ret = bsm_read_record(&t->rd, rec);
+		if (ret == BSM_OK) {
+			t->pos++;
+			return (BSM_OK);
+		}
+		if (ret == BSM_ERROR && errno != 0)
+			err(2, "%s", t->name);
+		if (ret == BSM_END || !partial)
+			return (BSM_END);
+		/* The resync point was a false positive, look past it */
+		t->rd.off++;
+	}
+}
+
+/*
+ * Decode the record at position "pos" of trail "name" into "tk"
+ */
+static void
+decode_record(const char *name, uint64_t pos, const uint8_t *buf,
+    size_t len, struct tokens *tk)
+{
+	struct bsm_cursor cur;
+	struct bsm_token *toks;
+	int ret;
+
+	tk->ntoks = 0;
+	tk->pid = 0;
+	bsm_cursor_init(&cur, buf, len);
+	for (;;) {
+		if (tk->ntoks == tk->cap) {
+			tk->cap = (tk->cap == 0) ? 32 : tk->cap * 2;
+			toks = realloc(tk->toks, tk->cap * sizeof(*toks));
+			if (toks == NULL)
+				err(2, "realloc");
+			tk->toks = toks;
+		}
+		ret = bsm_next_token(&cur, &tk->toks[tk->ntoks]);
+		if (ret == BSM_END)
+			break;
+		if (ret == BSM_ERROR)
+			errx(2, "%s: corrupted record %ju", name,
+			    (uintmax_t)pos);
+
+		switch (tk->toks[tk->ntoks].id) {
+		case BSM_SUBJECT32:
+		case BSM_SUBJECT64:
+		case BSM_SUBJECT32_EX:
+		case BSM_SUBJECT64_EX:
+			if (tk->pid == 0)
+				tk->pid = tk->toks[tk->ntoks].tt.subj.pid;
+			break;
+		}
+		tk->ntoks++;
+	}
+	if (tk->ntoks == 0 || !bsm_is_header(tk->toks[0].id))
+		errx(2, "%s: corrupted record %ju", name, (uintmax_t)pos);
+}
+
+/*
+ * Copy "str" to "buf" with every ".<pid>" ending a path component replaced
+ * by ".*", which is never longer
+ */
+static size_t
+strip_pid(const struct bsm_string *str, uint32_t pid, char *buf)
+{
+	char pidstr[16];
+	size_t i = 0, len = 0, pidlen = 0;
+
+	if (pid != 0)
+		pidlen = (size_t)snprintf(pidstr, sizeof(pidstr), ".%u", pid);
+	while (i < str->len) {
+		if (pidlen > 0 && str->len - i >= pidlen &&
+		    memcmp(str->str + i, pidstr, pidlen) == 0 &&
+		    (i + pidlen == str->len || str->str[i + pidlen] == '/')) {
+			buf[len++] = '.';
+			buf[len++] = '*';
+			i += pidlen;
+			continue;
+		}
+		buf[len++] = str->str[i++];
+	}
+	return (len);
+}
+
+static int
+addr_equal(const struct bsm_addr *a, const struct bsm_addr *b)
+{
+	return (a->type == b->type && a->type <= sizeof(a->addr) &&
+	    memcmp(a->addr, b->addr, a->type) == 0);
+}
+
+/*
+ * Whether the tokens are the same but for the fields that vary between
+ * runs, see above
+ */
+static int
+token_equal(const struct bsm_token *a, uint32_t apid,
+    const struct bsm_token *b, uint32_t bpid)
+{
+	const struct bsm_header *ah = &a->tt.hdr, *bh = &b->tt.hdr;
+	const struct bsm_subject *as = &a->tt.subj, *bs = &b->tt.subj;
+	size_t alen, blen;
+
+	if (a->id != b->id)
+		return (0);
+
+	switch (a->id) {
+	case BSM_HEADER32_EX:
+	case BSM_HEADER64_EX:
+		if (!addr_equal(&ah->host, &bh->host))
+			return (0);
+		/* FALLTHROUGH */
+	case BSM_HEADER32:
+	case BSM_HEADER64:
+		return (ah->version == bh->version && ah->event == bh->event &&
+		    ah->modifier == bh->modifier);
+
+	case BSM_SUBJECT32:
+	case BSM_SUBJECT64:
+	case BSM_SUBJECT32_EX:
+	case BSM_SUBJECT64_EX:
+	case BSM_PROCESS32:
+	case BSM_PROCESS64:
+	case BSM_PROCESS32_EX:
+	case BSM_PROCESS64_EX:
+		return (as->auid == bs->auid && as->euid == bs->euid &&
+		    as->egid == bs->egid && as->ruid == bs->ruid &&
+		    as->rgid == bs->rgid);
+
+	case BSM_SEQ:
+	case BSM_TRAILER:
+		return (1);
+
+	case BSM_PATH:
+		alen = strip_pid(&a->tt.str, apid, paths[0]);
+		blen = strip_pid(&b->tt.str, bpid, paths[1]);
+		return (alen == blen && memcmp(paths[0], paths[1], alen) == 0);
+
+	default:
+		return (a->len == b->len && memcmp(a->data, b->data,
+		    a->len) == 0);
+	}
+}
+
+static void
+print_event(uint16_t event)
+{
+	const char *name;
+
+	if ((flags & BSM_FMT_RAW) == 0 &&
+	    (name = bsm_event_name(event, flags)) != NULL)
+		bsm_out_printf(&out, "%s\n", name);
+	else
+		bsm_out_printf(&out, "%u\n", event);
+}
+
+static void
+print_token(char sign, const struct bsm_token *tok)
+{
+	bsm_out_putc(&out, sign);
+	bsm_print_token(&out, tok, del, flags);
+	bsm_out_putc(&out, '\n');
+}
+
+/*
+ * Compare the tokens of a pair of aligned records through their longest
+ * common subsequence, so that a token added or dropped by the kernel shows
+ * up as such instead of shifting every token after it
+ */
+static void
+diff_records(uint64_t oldpos, uint64_t newpos, uint16_t event)
+{
+	const struct tokens *a = &tokens[0], *b = &tokens[1];
+	size_t *row, cols = b->ntoks + 1;
+	size_t i, j;
+
+	if ((a->ntoks + 1) * cols > lcscap) {
+		lcscap = (a->ntoks + 1) * cols;
+		if ((row = realloc(lcs, lcscap * sizeof(*lcs))) == NULL)
+			err(2, "realloc");
+		lcs = row;
+	}
+
+	/* lcs[i * cols + j] is the length for the tokens from i and j on */
+	for (i = a->ntoks + 1; i-- > 0;) {
+		for (j = b->ntoks + 1; j-- > 0;) {
+			row = &lcs[i * cols + j];
+			if (i == a->ntoks || j == b->ntoks)
+				*row = 0;
+			else if (token_equal(&a->toks[i], a->pid,
+			    &b->toks[j], b->pid))
+				*row = lcs[(i + 1) * cols + j + 1] + 1;
+			else if (lcs[(i + 1) * cols + j] >=
+			    lcs[i * cols + j + 1])
+				*row = lcs[(i + 1) * cols + j];
+			else
+				*row = lcs[i * cols + j + 1];
+		}
+	}
+	if (lcs[0] == a->ntoks && lcs[0] == b->ntoks)
+		return;
+
+	counts[event].changed++;
+	ndiffs++;
+	if (summary)
+		return;
+	bsm_out_printf(&out, "@@ -%ju +%ju ", (uintmax_t)oldpos,
+	    (uintmax_t)newpos);
+	print_event(event);
+	for (i = 0, j = 0; i < a->ntoks || j < b->ntoks;) {
+		if (i < a->ntoks && j < b->ntoks &&
+		    lcs[i * cols + j] == lcs[(i + 1) * cols + j + 1] + 1 &&
+		    token_equal(&a->toks[i], a->pid, &b->toks[j], b->pid)) {
+			print_token(' ', &a->toks[i++]);
+			j++;
+		} else if (j == b->ntoks || (i < a->ntoks &&
+		    lcs[(i + 1) * cols + j] >= lcs[i * cols + j + 1]))
+			print_token('-', &a->toks[i++]);
+		else
+			print_token('+', &b->toks[j++]);
+	}
+}
+
+/*
+ * Report a record that has no counterpart in the other trail
+ */
+static void
+diff_missing(struct trail *t, const struct pending *p)
+{
+	struct tokens *tk = &tokens[t - trails];
+	char sign = (t == &trails[0]) ? '-' : '+';
+	size_t i;
+
+	if (t == &trails[0])
+		counts[p->event].removed++;
+	else
+		counts[p->event].added++;
+	ndiffs++;
+	if (summary)
+		return;
+
+	decode_record(t->name, p->pos, p->rec, p->len, tk);
+	bsm_out_printf(&out, "@@ %c%ju ", sign, (uintmax_t)p->pos);
+	print_event(p->event);
+	for (i = 0; i < tk->ntoks; i++)
+		print_token(sign, &tk->toks[i]);
+}
+
+/*
+ * Take "p" off the pending records of "t". It is always the oldest one of
+ * its event.
+ */
+static void
+unlink_pending(struct trail *t, struct pending *p)
+{
+	if (p->prev != NULL)
+		p->prev->next = p->next;
+	else
+		t->first = p->next;
+	if (p->next != NULL)
+		p->next->prev = p->prev;
+	else
+		t->last = p->prev;
+
+	t->events[p->event].head = p->evnext;
+	if (p->evnext == NULL)
+		t->events[p->event].tail = NULL;
+	t->npending--;
+}
+
+static void
+add_pending(struct trail *t, const struct bsm_cursor *rec, uint16_t event)
+{
+	struct pending *p;
+
+	if ((p = malloc(sizeof(*p) + rec->len)) == NULL)
+		err(2, "malloc");
+	memcpy(p->rec, rec->buf, rec->len);
+	p->len = rec->len;
+	p->pos = t->pos;
+	p->event = event;
+	p->evnext = NULL;
+	p->next = NULL;
+	p->prev = t->last;
+	if (t->last != NULL)
+		t->last->next = p;
+	else
+		t->first = p;
+	t->last = p;
+	if (t->events[event].tail != NULL)
+		t->events[event].tail->evnext = p;
+	else
+		t->events[event].head = p;
+	t->events[event].tail = p;
+	t->npending++;
+}
+
+static void
+expire_pending(struct trail *t, size_t keep)
+{
+	struct pending *p;
+
+	while (t->npending > keep) {
+		p = t->first;
+		unlink_pending(t, p);
+		diff_missing(t, p);
+		free(p);
+	}
+}
+
+/*
+ * Pair "rec", just read from "t", with the oldest pending record of its
+ * event in the other trail, or keep it until that trail catches up
+ */
+static void
+align_record(struct trail *t, const struct bsm_cursor *rec)
+{
+	struct trail *other = &trails[1 - (t - trails)];
+	struct bsm_token hdr;
+	struct pending *p;
+	uint16_t event;
+
+	if (bsm_decode_token(rec->buf, rec->len, &hdr) != BSM_OK ||
+	    !bsm_is_header(hdr.id))
+		errx(2, "%s: corrupted record %ju", t->name, (uintmax_t)t->pos);
+	event = hdr.tt.hdr.event;
+	if ((p = other->events[event].head) == NULL) {
+		add_pending(t, rec, event);
+		expire_pending(t, window);
+		return;
+	}
+
+	unlink_pending(other, p);
+	decode_record(t->name, t->pos, rec->buf, rec->len,
+	    &tokens[t - trails]);
+	decode_record(other->name, p->pos, p->rec, p->len,
+	    &tokens[other - trails]);
+	if (t == &trails[0])
+		diff_records(t->pos, p->pos, event);
+	else
+		diff_records(p->pos, t->pos, event);
+	free(p);
+}
+
+static void
+open_trail(struct trail *t, const char *name)
+{
+	void *buf;
+
+	t->name = name;
+	if (strcmp(name, "-") == 0)
+		t->fd = STDIN_FILENO;
+	else if ((t->fd = open(name, O_RDONLY)) == -1)
+		err(2, "%s", name);
+	if ((buf = malloc(READ_BUFFER_SIZE)) == NULL)
+		err(2, "malloc");
+	bsm_reader_init(&t->rd, t->fd, buf, READ_BUFFER_SIZE);
+}
+
+static void
+print_summary(void)
+{
+	const struct event_count *c;
+	const char *name;
+	unsigned event;
+
+	for (event = 0; event <= UINT16_MAX; event++) {
+		c = &counts[event];
+		if (c->changed == 0 && c->removed == 0 && c->added == 0)
+			continue;
+		if ((flags & BSM_FMT_RAW) == 0 &&
+		    (name = bsm_event_name(event, flags)) != NULL)
+			bsm_out_puts(&out, name);
+		else
+			bsm_out_printf(&out, "%u", event);
+		bsm_out_printf(&out, " %lu %lu %lu\n", c->changed, c->removed,
+		    c->added);
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *eventfile = AUDIT_EVENT_FILE;
+	struct bsm_cursor rec;
+	char *end;
+	int ch, i;
+
+	while ((ch = getopt(argc, argv, "cd:e:prsw:")) != -1) {
+		switch (ch) {
+		case 'c':
+			summary = 1;
+			break;
+		case 'd':
+			del = optarg;
+			break;
+		case 'e':
+			eventfile = optarg;
+			break;
+		case 'p':
+			partial = 1;
+			break;
+		case 'r':
+			if (flags & BSM_FMT_SHORT)
+				usage();
+			flags |= BSM_FMT_RAW;
+			break;
+		case 's':
+			if (flags & BSM_FMT_RAW)
+				usage();
+			flags |= BSM_FMT_SHORT;
+			break;
+		case 'w':
+			errno = 0;
+			window = strtoul(optarg, &end, 10);
+			if (errno != 0 || *end != '\0' || window == 0)
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 2)
+		usage();
+
+	/* Without the database events are printed by number */
+	(void)bsm_load_events(eventfile);
+
+	open_trail(&trails[0], argv[0]);
+	open_trail(&trails[1], argv[1]);
+	bsm_out_init(&out, STDOUT_FILENO);
+
+	/* Take turns, so that the trails are aligned as they are read */
+	while (!trails[0].done || !trails[1].done) {
+		for (i = 0; i < 2; i++) {
+			if (trails[i].done)
+				continue;
+			if (read_record(&trails[i], &rec) == BSM_OK)
+				align_record(&trails[i], &rec);
+			else
+				trails[i].done = 1;
+		}
+	}
+	expire_pending(&trails[0], 0);
+	expire_pending(&trails[1], 0);
+
+	if (summary)
+		print_summary();
+	if (bsm_out_flush(&out) == -1)
+		err(2, "stdout");
+
+	bsm_out_free(&out);
+	for (i = 0; i < 2; i++) {
+		free(trails[i].rd.buf);
+		free(tokens[i].toks);
+	}
+	free(lcs);
+	return (ndiffs != 0);
+}
@@ -0,0 +1,180 @@
+#
+# Copyright (c) 2018 Aniket Pandey
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+# OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+# HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+# OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE.
+#
+# $FreeBSD$
+#
+
+setup_trail()
+{
+	bsmdiff="$(atf_get_srcdir)/bsmdiff -e $(atf_get_srcdir)/input/audit_event"
+	input=$(atf_get_srcdir)/../praudit/input
+}
+
+# Overwrite the bytes of file $1 from offset $2 on with the octal escapes $3
+patch_trail()
+{
+	printf "$3" | dd of=$1 bs=1 seek=$2 conv=notrunc 2>/dev/null
+}
+
+# Write an open(2) record of "/tmp/fileforaudit.$2" by the process whose
+# pid is given as the octal escapes of 4 big-endian bytes in $1
+put_open()
+{
+	printf '\024\000\000\000\136\013\000\110\000\000\133\036\114\205'
+	printf '\000\000\001\174\043\000\027/tmp/fileforaudit.%s\000' $2
+	printf '\044\000\000\000\000\000\000\000\000\000\000\000\000\000'
+	printf '\000\000\000\000\000\000\000'"$1"'\000\000\022\164'
+	printf '\000\000\223\004\012\000\002\002\047\000\000\000\000\003'
+	printf '\023\261\005\000\000\000\136'
+}
+
+
+atf_test_case bsmdiff_identical
+bsmdiff_identical_head()
+{
+	atf_set "descr" "Verify that trails differing only in time, pid, " \
+			"audit session and terminal are reported identical"
+}
+
+bsmdiff_identical_body()
+{
+	setup_trail
+	atf_check ${bsmdiff} ${input}/trail ${input}/trail
+
+	cp ${input}/trail trail
+	patch_trail trail 13 '\077'
+	patch_trail trail 84 '\000\001\002\003\004\005\006\007\010\011'
+	atf_check ${bsmdiff} ${input}/trail trail
+}
+
+
+atf_test_case bsmdiff_changed
+bsmdiff_changed_head()
+{
+	atf_set "descr" "Verify that the tokens of aligned records are " \
+			"compared one by one"
+}
+
+bsmdiff_changed_body()
+{
+	setup_trail
+	cp ${input}/trail trail
+	# The socket(2) call returns descriptor 4 rather than 3
+	patch_trail trail 105 '\004'
+	atf_check -s exit:1 -o inline:"@@ -1 +1 socket(2)\n\
+ header,113,11,socket(2),0,Mon Jun 11 10:18:45 2018, + 380 msec\n\
+ argument,1,0x1c,domain\n\
+ argument,2,0x2,type\n\
+ argument,3,0x0,protocol\n\
+ subject,root,root,root,root,0,7053,4724,37636,10.0.2.2\n\
+-return,success,3\n\
++return,success,4\n\
+ trailer,113\n" ${bsmdiff} ${input}/trail trail
+}
+
+
+atf_test_case bsmdiff_missing
+bsmdiff_missing_head()
+{
+	atf_set "descr" "Verify that records without a counterpart are " \
+			"reported and counted as removed or added"
+}
+
+bsmdiff_missing_body()
+{
+	setup_trail
+	cat ${input}/trail ${input}/trail > trail
+	atf_check -s exit:1 -o match:"^@@ \+2 socket\(2\)$" \
+		${bsmdiff} ${input}/trail trail
+	atf_check -s exit:1 -o inline:"socket(2) 0 1 0\n" \
+		${bsmdiff} -c trail ${input}/trail
+}
+
+
+atf_test_case bsmdiff_fixture_pid
+bsmdiff_fixture_pid_head()
+{
+	atf_set "descr" "Verify that the subject's pid ending a path is " \
+			"left out of the comparison"
+}
+
+bsmdiff_fixture_pid_body()
+{
+	setup_trail
+	put_open '\000\000\004\322' 1234 > old
+	put_open '\000\000\026\056' 5678 > new
+	atf_check ${bsmdiff} old new
+
+	# The same path, but not named after the subject
+	put_open '\000\000\004\322' 5678 > new
+	atf_check -s exit:1 -o inline:"open(2) - read 1 0 0\n" \
+		${bsmdiff} -c old new
+}
+
+
+atf_test_case bsmdiff_order
+bsmdiff_order_head()
+{
+	atf_set "descr" "Verify that records are aligned by event and " \
+			"relative order, within the window"
+}
+
+bsmdiff_order_body()
+{
+	setup_trail
+	put_open '\000\000\004\322' 1234 > open
+	cat ${input}/trail open > old
+	cat open ${input}/trail > new
+	atf_check ${bsmdiff} -w 1 old new
+
+	atf_check $(atf_get_srcdir)/bsmgen -s 5 -n 20000 trail
+	atf_check ${bsmdiff} -w 1 trail trail
+}
+
+
+atf_test_case bsmdiff_usage
+bsmdiff_usage_head()
+{
+	atf_set "descr" "Verify that bsmdiff needs exactly two trails and a " \
+			"positive window"
+}
+
+bsmdiff_usage_body()
+{
+	setup_trail
+	atf_check -s exit:2 -e match:"usage: bsmdiff" ${bsmdiff} ${input}/trail
+	atf_check -s exit:2 -e match:"usage: bsmdiff" \
+		${bsmdiff} -w 0 ${input}/trail ${input}/trail
+}
+
+
+atf_init_test_cases()
+{
+	atf_add_test_case bsmdiff_identical
+	atf_add_test_case bsmdiff_changed
+	atf_add_test_case bsmdiff_missing
+	atf_add_test_case bsmdiff_fixture_pid
+	atf_add_test_case bsmdiff_order
+	atf_add_test_case bsmdiff_usage
+}
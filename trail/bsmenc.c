@@ -0,0 +1,307 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bsmenc.h"
+
+#define BSM_VERSION	11	/* AUDIT_HEADER_VERSION_OPENBSM */
+
+void
+bsm_enc_init(struct bsm_enc *enc)
+{
+	memset(enc, 0, sizeof(*enc));
+}
+
+/*
+ * Drop the records built so far but keep the buffer for the next ones
+ */
+void
+bsm_enc_reset(struct bsm_enc *enc)
+{
+	enc->len = 0;
+	enc->start = 0;
+}
+
+void
+bsm_enc_free(struct bsm_enc *enc)
+{
+	free(enc->buf);
+	bsm_enc_init(enc);
+}
+
+/*
+ * Room for "n" more bytes, or NULL once an allocation has failed
+ */
+static uint8_t *
+put_bytes(struct bsm_enc *enc, size_t n)
+{
+	uint8_t *buf;
+	size_t cap;
+
+	if (enc->err)
+		return (NULL);
+	if (enc->len + n > enc->cap) {
+		cap = (enc->cap == 0) ? 4096 : enc->cap;
+		while (cap < enc->len + n)
+			cap *= 2;
+		if ((buf = realloc(enc->buf, cap)) == NULL) {
+			enc->err = 1;
+			return (NULL);
+		}
+		enc->buf = buf;
+		enc->cap = cap;
+	}
+	buf = enc->buf + enc->len;
+	enc->len += n;
+	return (buf);
+}
+
+static void
+put8(struct bsm_enc *enc, uint8_t val)
+{
+	uint8_t *p;
+
+	if ((p = put_bytes(enc, 1)) != NULL)
+		p[0] = val;
+}
+
+static void
+set16(uint8_t *p, uint16_t val)
+{
+	p[0] = val >> 8;
+	p[1] = val & 0xff;
+}
+
+static void
+set32(uint8_t *p, uint32_t val)
+{
+	p[0] = val >> 24;
+	p[1] = (val >> 16) & 0xff;
+	p[2] = (val >> 8) & 0xff;
+	p[3] = val & 0xff;
+}
+
+static void
+put16(struct bsm_enc *enc, uint16_t val)
+{
+	uint8_t *p;
+
+	if ((p = put_bytes(enc, 2)) != NULL)
+		set16(p, val);
+}
+
+static void
+put32(struct bsm_enc *enc, uint32_t val)
+{
+	uint8_t *p;
+
+	if ((p = put_bytes(enc, 4)) != NULL)
+		set32(p, val);
+}
+
+static void
+put64(struct bsm_enc *enc, uint64_t val)
+{
+	put32(enc, (uint32_t)(val >> 32));
+	put32(enc, (uint32_t)val);
+}
+
+/*
+ * A string with its length, which counts the terminating NUL
+ */
+static void
+put_string(struct bsm_enc *enc, const char *str)
+{
+	size_t len = strlen(str) + 1;
+	uint8_t *p;
+
+	put16(enc, (uint16_t)len);
+	if ((p = put_bytes(enc, len)) != NULL)
+		memcpy(p, str, len);
+}
+
+/*
+ * Start a record. Its length is filled in by bsm_enc_trailer().
+ */
+void
+bsm_enc_header32(struct bsm_enc *enc, uint16_t event, uint16_t modifier,
+    uint32_t sec, uint32_t msec)
+{
+	enc->start = enc->len;
+	put8(enc, BSM_HEADER32);
+	put32(enc, 0);
+	put8(enc, BSM_VERSION);
+	put16(enc, event);
+	put16(enc, modifier);
+	put32(enc, sec);
+	put32(enc, msec);
+}
+
+void
+bsm_enc_subject32(struct bsm_enc *enc, const struct bsm_subject *subj)
+{
+	int i;
+
+	put8(enc, BSM_SUBJECT32);
+	put32(enc, subj->auid);
+	put32(enc, subj->euid);
+	put32(enc, subj->egid);
+	put32(enc, subj->ruid);
+	put32(enc, subj->rgid);
+	put32(enc, subj->pid);
+	put32(enc, subj->sid);
+	put32(enc, (uint32_t)subj->port);
+	for (i = 0; i < 4; i++)
+		put8(enc, subj->addr.addr[i]);
+}
+
+void
+bsm_enc_arg32(struct bsm_enc *enc, uint8_t no, uint32_t val, const char *text)
+{
+	put8(enc, BSM_ARG32);
+	put8(enc, no);
+	put32(enc, val);
+	put_string(enc, text);
+}
+
+void
+bsm_enc_path(struct bsm_enc *enc, const char *path)
+{
+	put8(enc, BSM_PATH);
+	put_string(enc, path);
+}
+
+void
+bsm_enc_text(struct bsm_enc *enc, const char *text)
+{
+	put8(enc, BSM_TEXT);
+	put_string(enc, text);
+}
+
+void
+bsm_enc_attr32(struct bsm_enc *enc, uint32_t mode, uint32_t uid,
+    uint32_t gid, uint32_t fsid, uint64_t nodeid, uint32_t dev)
+{
+	put8(enc, BSM_ATTR32);
+	put32(enc, mode);
+	put32(enc, uid);
+	put32(enc, gid);
+	put32(enc, fsid);
+	put64(enc, nodeid);
+	put32(enc, dev);
+}
+
+/*
+ * The NULL-terminated argument vector of execve(2)
+ */
+void
+bsm_enc_exec_args(struct bsm_enc *enc, const char *const *argv)
+{
+	uint8_t *p;
+	size_t len;
+	int count;
+
+	for (count = 0; argv[count] != NULL; count++)
+		;
+	put8(enc, BSM_EXEC_ARGS);
+	put32(enc, (uint32_t)count);
+	for (; *argv != NULL; argv++) {
+		len = strlen(*argv) + 1;
+		if ((p = put_bytes(enc, len)) != NULL)
+			memcpy(p, *argv, len);
+	}
+}
+
+/*
+ * An IPv4 socket address, with "port" and "addr" in host byte order
+ */
+void
+bsm_enc_sockinet32(struct bsm_enc *enc, uint16_t family, uint16_t port,
+    uint32_t addr)
+{
+	put8(enc, BSM_SOCKINET32);
+	put16(enc, family);
+	put16(enc, port);
+	put32(enc, addr);
+}
+
+void
+bsm_enc_ipc(struct bsm_enc *enc, uint8_t type, uint32_t id)
+{
+	put8(enc, BSM_IPC);
+	put8(enc, type);
+	put32(enc, id);
+}
+
+void
+bsm_enc_ipc_perm(struct bsm_enc *enc, uint32_t uid, uint32_t gid,
+    uint32_t puid, uint32_t pgid, uint32_t mode, uint32_t seq, uint32_t key)
+{
+	put8(enc, BSM_IPC_PERM);
+	put32(enc, uid);
+	put32(enc, gid);
+	put32(enc, puid);
+	put32(enc, pgid);
+	put32(enc, mode);
+	put32(enc, seq);
+	put32(enc, key);
+}
+
+/*
+ * "status" is the BSM errno of a failed call, 0 on success
+ */
+void
+bsm_enc_return32(struct bsm_enc *enc, uint8_t status, uint32_t val)
+{
+	put8(enc, BSM_RETURN32);
+	put8(enc, status);
+	put32(enc, val);
+}
+
+/*
+ * Complete the record started by the last bsm_enc_header32(). Returns -1
+ * with errno set if any part of it could not be stored.
+ */
+int
+bsm_enc_trailer(struct bsm_enc *enc)
+{
+	uint32_t size;
+
+	size = (uint32_t)(enc->len - enc->start) + BSM_TRAILER_LEN;
+	put8(enc, BSM_TRAILER);
+	put16(enc, BSM_TRAILER_MAGIC);
+	put32(enc, size);
+	if (enc->err) {
+		errno = ENOMEM;
+		return (-1);
+	}
+	set32(enc->buf + enc->start + 1, size);
+	return (0);
+}
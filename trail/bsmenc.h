@@ -0,0 +1,72 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#ifndef _BSMENC_H_
+#define _BSMENC_H_
+
+/*
+ * Encoder for BSM records, the counterpart of bsmdec.h. Records are built
+ * token by token into a growing buffer: bsm_enc_header32() starts one and
+ * bsm_enc_trailer() completes it, filling in the record length. Like the
+ * decoder's reader, an allocation failure sticks in "err" and turns every
+ * later call into a no-op, so it only needs checking once.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bsmdec.h"
+
+struct bsm_enc {
+	uint8_t		*buf;
+	size_t		 len;
+	size_t		 cap;
+	size_t		 start;		/* Of the record being built */
+	int		 err;
+};
+
+void	bsm_enc_init(struct bsm_enc *);
+void	bsm_enc_reset(struct bsm_enc *);
+void	bsm_enc_free(struct bsm_enc *);
+
+void	bsm_enc_header32(struct bsm_enc *, uint16_t, uint16_t, uint32_t,
+	    uint32_t);
+void	bsm_enc_subject32(struct bsm_enc *, const struct bsm_subject *);
+void	bsm_enc_arg32(struct bsm_enc *, uint8_t, uint32_t, const char *);
+void	bsm_enc_path(struct bsm_enc *, const char *);
+void	bsm_enc_text(struct bsm_enc *, const char *);
+void	bsm_enc_attr32(struct bsm_enc *, uint32_t, uint32_t, uint32_t,
+	    uint32_t, uint64_t, uint32_t);
+void	bsm_enc_exec_args(struct bsm_enc *, const char *const *);
+void	bsm_enc_sockinet32(struct bsm_enc *, uint16_t, uint16_t, uint32_t);
+void	bsm_enc_ipc(struct bsm_enc *, uint8_t, uint32_t);
+void	bsm_enc_ipc_perm(struct bsm_enc *, uint32_t, uint32_t, uint32_t,
+	    uint32_t, uint32_t, uint32_t, uint32_t);
+void	bsm_enc_return32(struct bsm_enc *, uint8_t, uint32_t);
+int	bsm_enc_trailer(struct bsm_enc *);
+
+#endif /* _BSMENC_H_ */
@@ -0,0 +1,135 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * bsmexport(1) writes the columnar export "<trail>.col" of each given
+ * trail, for bsmselect(1) to filter on the fields analysts ask about
+ * without decoding a single record.
+ */
+
+#include <err.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bsmcol.h"
+#include "bsmmap.h"
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: bsmexport [-p] [-b rows] trail ...\n");
+	exit(1);
+}
+
+/*
+ * Export "trail" into a temporary file and rename it into place, so a
+ * reader never sees a partial export
+ */
+static int
+export_trail(const char *trail, uint32_t block, int resync)
+{
+	struct bsm_map map;
+	char *path, *tmp;
+	size_t len;
+	FILE *fp;
+	int ret = 1;
+
+	len = strlen(trail) + sizeof(BSM_COL_SUFFIX) + 4;
+	if ((path = malloc(len)) == NULL || (tmp = malloc(len)) == NULL)
+		err(1, "malloc");
+	snprintf(path, len, "%s%s", trail, BSM_COL_SUFFIX);
+	snprintf(tmp, len, "%s.tmp", path);
+
+	if (bsm_map_open(&map, trail) == -1) {
+		warn("%s", trail);
+		goto out;
+	}
+	if (bsm_map_index(&map, resync) == -1) {
+		if (errno == EINVAL)
+			warnx("%s: corrupted record after %zu records",
+			    trail, map.nrecords);
+		else
+			warn("%s", trail);
+		goto unmap;
+	}
+
+	if ((fp = fopen(tmp, "w")) == NULL) {
+		warn("%s", tmp);
+		goto unmap;
+	}
+	if (bsm_col_build(&map, block, fp) == -1 || fclose(fp) != 0) {
+		warn("%s", tmp);
+		unlink(tmp);
+		goto unmap;
+	}
+	if (rename(tmp, path) == -1) {
+		warn("%s", path);
+		unlink(tmp);
+		goto unmap;
+	}
+	ret = 0;
+
+unmap:
+	bsm_map_close(&map);
+out:
+	free(path);
+	free(tmp);
+	return (ret);
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned long block = BSM_COL_BLOCK;
+	int ch, i, resync = 0, status = 0;
+
+	while ((ch = getopt(argc, argv, "b:p")) != -1) {
+		switch (ch) {
+		case 'b':
+			block = strtoul(optarg, NULL, 10);
+			if (block == 0 || block > UINT32_MAX)
+				usage();
+			break;
+		case 'p':
+			resync = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc == 0)
+		usage();
+
+	for (i = 0; i < argc; i++)
+		status |= export_trail(argv[i], (uint32_t)block, resync);
+	return (status);
+}
@@ -0,0 +1,1215 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <fcntl.h>
+#include <grp.h>
+#include <pwd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bsmfmt.h"
+
+struct event_ent {
+	uint16_t	 number;
+	const char	*name;		/* AUE_* */
+	const char	*desc;		/* e.g. "socket(2)" */
+};
+
+/* Contents of audit_event(5), sorted by event number */
+static struct event_ent *events;
+static size_t nevents;
+
+/*
+ * BSM error numbers differ from the local errno(2) values; the text is
+ * that of FreeBSD's strerror(3), so output matches praudit(1) anywhere.
+ */
+static const struct {
+	uint8_t		 error;
+	const char	*text;
+} bsm_errors[] = {
+	{ 1, "Operation not permitted" },
+	{ 2, "No such file or directory" },
+	{ 3, "No such process" },
+	{ 4, "Interrupted system call" },
+	{ 5, "Input/output error" },
+	{ 6, "Device not configured" },
+	{ 7, "Argument list too long" },
+	{ 8, "Exec format error" },
+	{ 9, "Bad file descriptor" },
+	{ 10, "No child processes" },
+	{ 11, "Resource temporarily unavailable" },
+	{ 12, "Cannot allocate memory" },
+	{ 13, "Permission denied" },
+	{ 14, "Bad address" },
+	{ 15, "Block device required" },
+	{ 16, "Device busy" },
+	{ 17, "File exists" },
+	{ 18, "Cross-device link" },
+	{ 19, "Operation not supported by device" },
+	{ 20, "Not a directory" },
+	{ 21, "Is a directory" },
+	{ 22, "Invalid argument" },
+	{ 23, "Too many open files in system" },
+	{ 24, "Too many open files" },
+	{ 25, "Inappropriate ioctl for device" },
+	{ 26, "Text file busy" },
+	{ 27, "File too large" },
+	{ 28, "No space left on device" },
+	{ 29, "Illegal seek" },
+	{ 30, "Read-only file system" },
+	{ 31, "Too many links" },
+	{ 32, "Broken pipe" },
+	{ 33, "Numerical argument out of domain" },
+	{ 34, "Result too large" },
+	{ 35, "No message of desired type" },
+	{ 36, "Identifier removed" },
+	{ 45, "Resource deadlock avoided" },
+	{ 46, "No locks available" },
+	{ 47, "Operation canceled" },
+	{ 48, "Operation not supported" },
+	{ 49, "Disc quota exceeded" },
+	{ 71, "Protocol error" },
+	{ 74, "Multihop attempted" },
+	{ 77, "Bad message" },
+	{ 78, "File name too long" },
+	{ 79, "Value too large to be stored in data type" },
+	{ 88, "Illegal byte sequence" },
+	{ 89, "Function not implemented" },
+	{ 90, "Too many levels of symbolic links" },
+	{ 93, "Directory not empty" },
+	{ 94, "Too many users" },
+	{ 95, "Socket operation on non-socket" },
+	{ 96, "Destination address required" },
+	{ 97, "Message too long" },
+	{ 98, "Protocol wrong type for socket" },
+	{ 99, "Protocol not available" },
+	{ 120, "Protocol not supported" },
+	{ 121, "Socket type not supported" },
+	{ 122, "Operation not supported" },
+	{ 123, "Protocol family not supported" },
+	{ 124, "Address family not supported by protocol family" },
+	{ 125, "Address already in use" },
+	{ 126, "Can't assign requested address" },
+	{ 127, "Network is down" },
+	{ 128, "Network is unreachable" },
+	{ 129, "Network dropped connection on reset" },
+	{ 130, "Software caused connection abort" },
+	{ 131, "Connection reset by peer" },
+	{ 132, "No buffer space available" },
+	{ 133, "Socket is already connected" },
+	{ 134, "Socket is not connected" },
+	{ 143, "Can't send after socket shutdown" },
+	{ 144, "Too many references: can't splice" },
+	{ 145, "Operation timed out" },
+	{ 146, "Connection refused" },
+	{ 147, "Host is down" },
+	{ 148, "No route to host" },
+	{ 149, "Operation already in progress" },
+	{ 150, "Operation now in progress" },
+	{ 151, "Stale NFS file handle" },
+};
+
+static int
+cmp_event(const void *a, const void *b)
+{
+	const struct event_ent *ea = a, *eb = b;
+
+	return ((int)ea->number - (int)eb->number);
+}
+
+/*
+ * Load the audit_event(5) database at "path". Lines have the form
+ * number:name:description:classes. Returns -1 if it cannot be read.
+ */
+int
+bsm_load_events(const char *path)
+{
+	struct stat sb;
+	char *buff, *line, *next, *name, *desc, *end;
+	size_t cap = 0;
+	ssize_t n;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) == -1)
+		return (-1);
+	if (fstat(fd, &sb) == -1 ||
+	    (buff = malloc((size_t)sb.st_size + 1)) == NULL) {
+		close(fd);
+		return (-1);
+	}
+	n = read(fd, buff, (size_t)sb.st_size);
+	close(fd);
+	if (n != sb.st_size) {
+		free(buff);
+		return (-1);
+	}
+	buff[n] = '\0';
+
+	for (line = buff; line != NULL && *line != '\0'; line = next) {
+		if ((next = strchr(line, '\n')) != NULL)
+			*next++ = '\0';
+		if (*line == '#' || (name = strchr(line, ':')) == NULL)
+			continue;
+		*name++ = '\0';
+		if ((desc = strchr(name, ':')) == NULL)
+			continue;
+		*desc++ = '\0';
+		if ((end = strchr(desc, ':')) != NULL)
+			*end = '\0';
+
+		if (nevents == cap) {
+			cap = (cap == 0) ? 512 : cap * 2;
+			events = realloc(events, cap * sizeof(*events));
+			if (events == NULL)
+				return (-1);
+		}
+		events[nevents].number = (uint16_t)strtoul(line, NULL, 10);
+		events[nevents].name = name;
+		events[nevents].desc = desc;
+		nevents++;
+	}
+
+	qsort(events, nevents, sizeof(*events), cmp_event);
+	return (0);
+}
+
+/*
+ * The short (AUE_*) or descriptive name of "event", NULL if unknown
+ */
+const char *
+bsm_event_name(uint16_t event, int flags)
+{
+	struct event_ent key, *ent;
+
+	key.number = event;
+	ent = bsearch(&key, events, nevents, sizeof(*events), cmp_event);
+	if (ent == NULL)
+		return (NULL);
+	return ((flags & BSM_FMT_SHORT) ? ent->name : ent->desc);
+}
+
+/*
+ * The number of the event with the given number, short or descriptive
+ * name, -1 if there is none
+ */
+int
+bsm_event_number(const char *name)
+{
+	char *end;
+	unsigned long number;
+	size_t i;
+
+	number = strtoul(name, &end, 10);
+	if (*name != '\0' && *end == '\0')
+		return (number <= UINT16_MAX ? (int)number : -1);
+
+	for (i = 0; i < nevents; i++) {
+		if (strcmp(events[i].name, name) == 0 ||
+		    strcmp(events[i].desc, name) == 0)
+			return (events[i].number);
+	}
+	return (-1);
+}
+
+const char *
+bsm_strerror(uint8_t error)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(bsm_errors) / sizeof(bsm_errors[0]); i++) {
+		if (bsm_errors[i].error == error)
+			return (bsm_errors[i].text);
+	}
+	return (NULL);
+}
+
+/*
+ * getpwuid(3) and getgrgid(3) are far too slow to call for every token of
+ * a large trail, remember the most recent answers.
+ */
+#define NAMECACHE	64
+
+struct name_ent {
+	int		 valid;
+	uint32_t	 id;
+	char		 name[32];
+};
+
+static struct name_ent usercache[NAMECACHE], groupcache[NAMECACHE];
+
+static const char *
+lookup_name(struct name_ent *cache, uint32_t id, int group)
+{
+	struct name_ent *ent = &cache[id % NAMECACHE];
+	struct passwd *pw;
+	struct group *gr;
+	const char *name = NULL;
+
+	if (ent->valid && ent->id == id)
+		return (ent->name[0] != '\0' ? ent->name : NULL);
+
+	if (group && (gr = getgrgid((gid_t)id)) != NULL)
+		name = gr->gr_name;
+	else if (!group && (pw = getpwuid((uid_t)id)) != NULL)
+		name = pw->pw_name;
+
+	ent->valid = 1;
+	ent->id = id;
+	snprintf(ent->name, sizeof(ent->name), "%s",
+	    name != NULL ? name : "");
+	return (name != NULL ? ent->name : NULL);
+}
+
+static void
+print_delim(struct bsm_out *out, const char *del)
+{
+	bsm_out_puts(out, del);
+}
+
+/*
+ * The token's name, or its numeric id in the raw form
+ */
+static void
+print_tok_type(struct bsm_out *out, uint8_t id, const char *name, int flags)
+{
+	if (flags & BSM_FMT_RAW)
+		bsm_out_printf(out, "%u", id);
+	else
+		bsm_out_puts(out, name);
+}
+
+/*
+ * The escape sequence for "c" in the XML or JSON form, NULL if it stands
+ * for itself
+ */
+static const char *
+escape_char(unsigned char c, int flags, char *buf, size_t size)
+{
+	if (flags & BSM_FMT_XML) {
+		switch (c) {
+		case '&':
+			return ("&amp;");
+		case '<':
+			return ("&lt;");
+		case '>':
+			return ("&gt;");
+		case '"':
+			return ("&quot;");
+		case '\'':
+			return ("&apos;");
+		}
+		return (NULL);
+	}
+
+	switch (c) {
+	case '"':
+		return ("\\\"");
+	case '\\':
+		return ("\\\\");
+	case '\n':
+		return ("\\n");
+	case '\t':
+		return ("\\t");
+	}
+	if (c < 0x20) {
+		snprintf(buf, size, "\\u%04x", c);
+		return (buf);
+	}
+	return (NULL);
+}
+
+/*
+ * Write a string, escaping the characters XML reserves in attributes and
+ * character data, or those JSON reserves in strings. Runs that need no
+ * escaping are written whole.
+ */
+static void
+print_string(struct bsm_out *out, const char *str, size_t len, int flags)
+{
+	const char *esc;
+	char buf[8];
+	size_t i, run = 0;
+
+	if (!(flags & BSM_FMT_MARKUP)) {
+		bsm_out_write(out, str, len);
+		return;
+	}
+
+	for (i = 0; i < len; i++) {
+		esc = escape_char((unsigned char)str[i], flags, buf,
+		    sizeof(buf));
+		if (esc == NULL)
+			continue;
+		bsm_out_write(out, str + run, i - run);
+		bsm_out_puts(out, esc);
+		run = i + 1;
+	}
+	bsm_out_write(out, str + run, len - run);
+}
+
+static void
+print_bstring(struct bsm_out *out, const struct bsm_string *s, int flags)
+{
+	print_string(out, s->str, s->len, flags);
+}
+
+static void
+open_attr(struct bsm_out *out, const char *name, int flags)
+{
+	if (flags & BSM_FMT_JSON)
+		bsm_out_printf(out, ",\"%s\":\"", name);
+	else
+		bsm_out_printf(out, "%s=\"", name);
+}
+
+static void
+close_attr(struct bsm_out *out, int flags)
+{
+	bsm_out_puts(out, (flags & BSM_FMT_JSON) ? "\"" : "\" ");
+}
+
+/*
+ * In the XML form every field becomes an attribute of the token's element,
+ * in the JSON form a member of the token's object, both holding the text
+ * of the default form. Otherwise fields are separated by the delimiter.
+ */
+static void
+next_field(struct bsm_out *out, const char *del, const char *attr, int flags)
+{
+	if (flags & BSM_FMT_MARKUP)
+		open_attr(out, attr, flags);
+	else
+		print_delim(out, del);
+}
+
+static void
+end_field(struct bsm_out *out, int flags)
+{
+	if (flags & BSM_FMT_MARKUP)
+		close_attr(out, flags);
+}
+
+/*
+ * A token with fields is an empty element carrying them as attributes, or
+ * an object naming the token in its "token" member
+ */
+static void
+open_elem(struct bsm_out *out, const char *name, int flags)
+{
+	if (flags & BSM_FMT_JSON)
+		bsm_out_printf(out, "{\"token\":\"%s\"", name);
+	else
+		bsm_out_printf(out, "<%s ", name);
+}
+
+static void
+close_elem(struct bsm_out *out, int flags)
+{
+	bsm_out_puts(out, (flags & BSM_FMT_JSON) ? "}" : "/>");
+}
+
+/*
+ * A token's data, following its fields or on its own, is the element's
+ * character data or the object's "text" member
+ */
+static void
+begin_text(struct bsm_out *out, int flags)
+{
+	bsm_out_puts(out, (flags & BSM_FMT_JSON) ? ",\"text\":\"" : ">");
+}
+
+static void
+open_text(struct bsm_out *out, const char *name, int flags)
+{
+	if (flags & BSM_FMT_JSON)
+		bsm_out_printf(out, "{\"token\":\"%s\",\"text\":\"", name);
+	else
+		bsm_out_printf(out, "<%s>", name);
+}
+
+static void
+close_text(struct bsm_out *out, const char *name, int flags)
+{
+	if (flags & BSM_FMT_JSON)
+		bsm_out_puts(out, "\"}");
+	else
+		bsm_out_printf(out, "</%s>", name);
+}
+
+/*
+ * Tokens holding a variable number of values, such as the arguments of
+ * exec_args, have a child element for each or an array of them
+ */
+static void
+open_list(struct bsm_out *out, const char *name, const char *item,
+    int flags)
+{
+	if (flags & BSM_FMT_JSON)
+		bsm_out_printf(out, "{\"token\":\"%s\",\"%s\":[", name, item);
+	else
+		bsm_out_printf(out, "<%s>", name);
+}
+
+static void
+open_item(struct bsm_out *out, const char *item, int first, int flags)
+{
+	if (flags & BSM_FMT_JSON)
+		bsm_out_puts(out, first ? "\"" : ",\"");
+	else
+		bsm_out_printf(out, "<%s>", item);
+}
+
+static void
+close_item(struct bsm_out *out, const char *item, int flags)
+{
+	if (flags & BSM_FMT_JSON)
+		bsm_out_putc(out, '"');
+	else
+		bsm_out_printf(out, "</%s>", item);
+}
+
+static void
+close_list(struct bsm_out *out, const char *name, int flags)
+{
+	if (flags & BSM_FMT_JSON)
+		bsm_out_puts(out, "]}");
+	else
+		bsm_out_printf(out, "</%s>", name);
+}
+
+static void
+print_user(struct bsm_out *out, uint32_t uid, int flags)
+{
+	const char *name;
+
+	if (!(flags & BSM_FMT_RAW) &&
+	    (name = lookup_name(usercache, uid, 0)) != NULL)
+		bsm_out_puts(out, name);
+	else
+		bsm_out_printf(out, "%d", (int)uid);
+}
+
+static void
+print_group(struct bsm_out *out, uint32_t gid, int flags)
+{
+	const char *name;
+
+	if (!(flags & BSM_FMT_RAW) &&
+	    (name = lookup_name(groupcache, gid, 1)) != NULL)
+		bsm_out_puts(out, name);
+	else
+		bsm_out_printf(out, "%d", (int)gid);
+}
+
+static void
+print_ip_address(struct bsm_out *out, const struct bsm_addr *addr)
+{
+	char str[INET6_ADDRSTRLEN];
+
+	if (inet_ntop(addr->type == BSM_IPV6 ? AF_INET6 : AF_INET,
+	    addr->addr, str, sizeof(str)) != NULL)
+		bsm_out_puts(out, str);
+}
+
+static void
+print_event(struct bsm_out *out, uint16_t event, int flags)
+{
+	const char *name;
+
+	if (!(flags & BSM_FMT_RAW) &&
+	    (name = bsm_event_name(event, flags)) != NULL)
+		print_string(out, name, strlen(name), flags);
+	else
+		bsm_out_printf(out, "%u", event);
+}
+
+/*
+ * Seconds since the Epoch in ctime(3) form, without the newline
+ */
+static void
+print_sec(struct bsm_out *out, uint64_t sec, int flags)
+{
+	char timestr[26];
+	time_t timestamp;
+
+	if (flags & BSM_FMT_RAW) {
+		bsm_out_printf(out, "%llu", (unsigned long long)sec);
+		return;
+	}
+
+	timestamp = (time_t)sec;
+	if (ctime_r(&timestamp, timestr) == NULL) {
+		bsm_out_printf(out, "%llu", (unsigned long long)sec);
+		return;
+	}
+	timestr[24] = '\0';
+	bsm_out_puts(out, timestr);
+}
+
+static void
+print_msec(struct bsm_out *out, uint64_t msec, int flags)
+{
+	if (flags & BSM_FMT_RAW)
+		bsm_out_printf(out, "%llu", (unsigned long long)msec);
+	else
+		bsm_out_printf(out, " + %llu msec", (unsigned long long)msec);
+}
+
+static void
+print_retval(struct bsm_out *out, uint8_t status, int flags)
+{
+	const char *text;
+
+	if (flags & BSM_FMT_RAW)
+		bsm_out_printf(out, "%u", status);
+	else if (status == 0)
+		bsm_out_puts(out, "success");
+	else if ((text = bsm_strerror(status)) != NULL)
+		bsm_out_printf(out, "failure : %s", text);
+	else
+		bsm_out_printf(out, "failure : Unknown error: %u", status);
+}
+
+static void
+print_ipctype(struct bsm_out *out, uint8_t type, int flags)
+{
+	if (flags & BSM_FMT_RAW)
+		bsm_out_printf(out, "%u", type);
+	else if (type == 1)
+		bsm_out_puts(out, "Message IPC");
+	else if (type == 2)
+		bsm_out_puts(out, "Semaphore IPC");
+	else if (type == 3)
+		bsm_out_puts(out, "Shared Memory IPC");
+	else
+		bsm_out_printf(out, "%u", type);
+}
+
+static void
+print_hex(struct bsm_out *out, const uint8_t *data, size_t len)
+{
+	size_t i;
+
+	bsm_out_puts(out, "0x");
+	for (i = 0; i < len; i++)
+		bsm_out_printf(out, "%02x", data[i]);
+}
+
+static void
+print_header(struct bsm_out *out, const struct bsm_token *tok, const char *del,
+    int flags)
+{
+	const struct bsm_header *hdr = &tok->tt.hdr;
+
+	if (flags & BSM_FMT_MARKUP)
+		open_elem(out, "record", flags);
+	else {
+		print_tok_type(out, tok->id, "header", flags);
+		print_delim(out, del);
+		bsm_out_printf(out, "%u", hdr->size);
+	}
+
+	next_field(out, del, "version", flags);
+	bsm_out_printf(out, "%u", hdr->version);
+	end_field(out, flags);
+	next_field(out, del, "event", flags);
+	print_event(out, hdr->event, flags);
+	end_field(out, flags);
+	next_field(out, del, "modifier", flags);
+	bsm_out_printf(out, "%u", hdr->modifier);
+	end_field(out, flags);
+	if (hdr->host.type != 0) {
+		next_field(out, del, "host", flags);
+		print_ip_address(out, &hdr->host);
+		end_field(out, flags);
+	}
+	next_field(out, del, "time", flags);
+	print_sec(out, hdr->sec, flags);
+	end_field(out, flags);
+	next_field(out, del, "msec", flags);
+	print_msec(out, hdr->msec, flags);
+	end_field(out, flags);
+
+	/* The record's other tokens are its children */
+	if (flags & BSM_FMT_JSON)
+		bsm_out_puts(out, ",\"tokens\":[");
+	else if (flags & BSM_FMT_XML)
+		bsm_out_puts(out, ">");
+}
+
+static void
+print_subject(struct bsm_out *out, const struct bsm_token *tok,
+    const char *name, const char *del, int flags)
+{
+	const struct bsm_subject *subj = &tok->tt.subj;
+
+	if (flags & BSM_FMT_MARKUP)
+		open_elem(out, name, flags);
+	else
+		print_tok_type(out, tok->id, name, flags);
+
+	next_field(out, del, "audit-uid", flags);
+	print_user(out, subj->auid, flags);
+	end_field(out, flags);
+	next_field(out, del, "uid", flags);
+	print_user(out, subj->euid, flags);
+	end_field(out, flags);
+	next_field(out, del, "gid", flags);
+	print_group(out, subj->egid, flags);
+	end_field(out, flags);
+	next_field(out, del, "ruid", flags);
+	print_user(out, subj->ruid, flags);
+	end_field(out, flags);
+	/* praudit(1) leaves the real group ID numeric */
+	next_field(out, del, "rgid", flags);
+	bsm_out_printf(out, "%u", subj->rgid);
+	end_field(out, flags);
+	next_field(out, del, "pid", flags);
+	bsm_out_printf(out, "%u", subj->pid);
+	end_field(out, flags);
+	next_field(out, del, "sid", flags);
+	bsm_out_printf(out, "%u", subj->sid);
+	end_field(out, flags);
+	next_field(out, del, "tid", flags);
+	bsm_out_printf(out, "%llu", (unsigned long long)subj->port);
+	bsm_out_puts(out, (flags & BSM_FMT_MARKUP) ? " " : del);
+	print_ip_address(out, &subj->addr);
+	end_field(out, flags);
+
+	if (flags & BSM_FMT_MARKUP)
+		close_elem(out, flags);
+}
+
+/*
+ * Tokens holding a single string: path, text and zone name
+ */
+static void
+print_str_token(struct bsm_out *out, const struct bsm_token *tok,
+    const char *name, const char *del, int flags)
+{
+	if (flags & BSM_FMT_MARKUP) {
+		open_text(out, name, flags);
+		print_bstring(out, &tok->tt.str, flags);
+		close_text(out, name, flags);
+		return;
+	}
+
+	print_tok_type(out, tok->id, name, flags);
+	print_delim(out, del);
+	print_bstring(out, &tok->tt.str, flags);
+}
+
+static void
+print_exec(struct bsm_out *out, const struct bsm_token *tok, const char *del,
+    int flags)
+{
+	const char *arg = tok->tt.exec.args;
+	const char *tag = (tok->id == BSM_EXEC_ARGS) ? "arg" : "env";
+	const char *name = (tok->id == BSM_EXEC_ARGS) ?
+	    "exec_args" : "exec_env";
+	size_t len;
+	uint32_t i;
+
+	if (flags & BSM_FMT_MARKUP)
+		open_list(out, name, tag, flags);
+	else
+		print_tok_type(out, tok->id, (tok->id == BSM_EXEC_ARGS) ?
+		    "exec arg" : "exec env", flags);
+
+	for (i = 0; i < tok->tt.exec.count; i++) {
+		len = strlen(arg);
+		if (flags & BSM_FMT_MARKUP) {
+			open_item(out, tag, i == 0, flags);
+			print_string(out, arg, len, flags);
+			close_item(out, tag, flags);
+		} else {
+			print_delim(out, del);
+			print_string(out, arg, len, flags);
+		}
+		arg += len + 1;
+	}
+
+	if (flags & BSM_FMT_MARKUP)
+		close_list(out, name, flags);
+}
+
+/*
+ * Print "tok" without a trailing newline or delimiter, the caller decides
+ * how tokens of a record are separated
+ */
+void
+bsm_print_token(struct bsm_out *out, const struct bsm_token *tok,
+    const char *del, int flags)
+{
+	int markup = flags & BSM_FMT_MARKUP;
+	uint16_t i;
+
+	switch (tok->id) {
+	case BSM_HEADER32:
+	case BSM_HEADER32_EX:
+	case BSM_HEADER64:
+	case BSM_HEADER64_EX:
+		print_header(out, tok, del, flags);
+		break;
+
+	case BSM_TRAILER:
+		if (markup)
+			bsm_out_puts(out, (flags & BSM_FMT_JSON) ?
+			    "]}" : "</record>");
+		else {
+			print_tok_type(out, tok->id, "trailer", flags);
+			print_delim(out, del);
+			bsm_out_printf(out, "%u", tok->tt.trail.count);
+		}
+		break;
+
+	case BSM_ARG32:
+	case BSM_ARG64:
+		if (markup)
+			open_elem(out, "argument", flags);
+		else
+			print_tok_type(out, tok->id, "argument", flags);
+		next_field(out, del, "arg-num", flags);
+		bsm_out_printf(out, "%u", tok->tt.arg.no);
+		end_field(out, flags);
+		next_field(out, del, "value", flags);
+		bsm_out_printf(out, "0x%llx",
+		    (unsigned long long)tok->tt.arg.val);
+		end_field(out, flags);
+		next_field(out, del, "desc", flags);
+		print_bstring(out, &tok->tt.arg.text, flags);
+		end_field(out, flags);
+		if (markup)
+			close_elem(out, flags);
+		break;
+
+	case BSM_PATH:
+		print_str_token(out, tok, "path", del, flags);
+		break;
+
+	case BSM_TEXT:
+		print_str_token(out, tok, "text", del, flags);
+		break;
+
+	case BSM_ZONENAME:
+		print_str_token(out, tok, "zone", del, flags);
+		break;
+
+	case BSM_SUBJECT32:
+	case BSM_SUBJECT64:
+	case BSM_SUBJECT32_EX:
+	case BSM_SUBJECT64_EX:
+		print_subject(out, tok, "subject", del, flags);
+		break;
+
+	case BSM_PROCESS32:
+	case BSM_PROCESS64:
+	case BSM_PROCESS32_EX:
+	case BSM_PROCESS64_EX:
+		print_subject(out, tok, "process", del, flags);
+		break;
+
+	case BSM_RETURN32:
+	case BSM_RETURN64:
+		if (markup)
+			open_elem(out, "return", flags);
+		else
+			print_tok_type(out, tok->id, "return", flags);
+		next_field(out, del, "errval", flags);
+		print_retval(out, tok->tt.ret.status, flags);
+		end_field(out, flags);
+		next_field(out, del, "retval", flags);
+		if (tok->id == BSM_RETURN32)
+			bsm_out_printf(out, "%u", (uint32_t)tok->tt.ret.val);
+		else
+			bsm_out_printf(out, "%lld", (long long)tok->tt.ret.val);
+		end_field(out, flags);
+		if (markup)
+			close_elem(out, flags);
+		break;
+
+	case BSM_ATTR:
+	case BSM_ATTR32:
+	case BSM_ATTR64:
+		if (markup)
+			open_elem(out, "attribute", flags);
+		else
+			print_tok_type(out, tok->id, "attribute", flags);
+		next_field(out, del, "mode", flags);
+		bsm_out_printf(out, "%o", tok->tt.attr.mode);
+		end_field(out, flags);
+		next_field(out, del, "uid", flags);
+		print_user(out, tok->tt.attr.uid, flags);
+		end_field(out, flags);
+		next_field(out, del, "gid", flags);
+		print_group(out, tok->tt.attr.gid, flags);
+		end_field(out, flags);
+		next_field(out, del, "fsid", flags);
+		bsm_out_printf(out, "%u", tok->tt.attr.fsid);
+		end_field(out, flags);
+		next_field(out, del, "nodeid", flags);
+		bsm_out_printf(out, "%llu",
+		    (unsigned long long)tok->tt.attr.nodeid);
+		end_field(out, flags);
+		next_field(out, del, "device", flags);
+		bsm_out_printf(out, "%llu",
+		    (unsigned long long)tok->tt.attr.dev);
+		end_field(out, flags);
+		if (markup)
+			close_elem(out, flags);
+		break;
+
+	case BSM_IPC:
+		if (markup)
+			open_elem(out, "IPC", flags);
+		else
+			print_tok_type(out, tok->id, "IPC", flags);
+		next_field(out, del, "ipc-type", flags);
+		print_ipctype(out, tok->tt.ipc.type, flags);
+		end_field(out, flags);
+		next_field(out, del, "ipc-id", flags);
+		bsm_out_printf(out, "%u", tok->tt.ipc.id);
+		end_field(out, flags);
+		if (markup)
+			close_elem(out, flags);
+		break;
+
+	case BSM_IPC_PERM:
+		if (markup)
+			open_elem(out, "IPC_perm", flags);
+		else
+			print_tok_type(out, tok->id, "IPC perm", flags);
+		next_field(out, del, "uid", flags);
+		print_user(out, tok->tt.ipcperm.uid, flags);
+		end_field(out, flags);
+		next_field(out, del, "gid", flags);
+		print_group(out, tok->tt.ipcperm.gid, flags);
+		end_field(out, flags);
+		next_field(out, del, "creator-uid", flags);
+		print_user(out, tok->tt.ipcperm.puid, flags);
+		end_field(out, flags);
+		next_field(out, del, "creator-gid", flags);
+		print_group(out, tok->tt.ipcperm.pgid, flags);
+		end_field(out, flags);
+		next_field(out, del, "mode", flags);
+		bsm_out_printf(out, "%o", tok->tt.ipcperm.mode);
+		end_field(out, flags);
+		next_field(out, del, "seq", flags);
+		bsm_out_printf(out, "%u", tok->tt.ipcperm.seq);
+		end_field(out, flags);
+		next_field(out, del, "key", flags);
+		bsm_out_printf(out, "%u", tok->tt.ipcperm.key);
+		end_field(out, flags);
+		if (markup)
+			close_elem(out, flags);
+		break;
+
+	case BSM_EXEC_ARGS:
+	case BSM_EXEC_ENV:
+		print_exec(out, tok, del, flags);
+		break;
+
+	case BSM_SOCKINET32:
+	case BSM_SOCKINET128:
+	case BSM_SOCKUNIX:
+		if (markup)
+			open_elem(out, (tok->id == BSM_SOCKINET32) ?
+			    "socket-inet" : (tok->id == BSM_SOCKINET128) ?
+			    "socket-inet6" : "socket-unix", flags);
+		else
+			print_tok_type(out, tok->id, (tok->id ==
+			    BSM_SOCKINET32) ? "socket-inet" : (tok->id ==
+			    BSM_SOCKINET128) ? "socket-inet6" : "socket-unix",
+			    flags);
+		next_field(out, del, "type", flags);
+		bsm_out_printf(out, "%u", tok->tt.sockinet.family);
+		end_field(out, flags);
+		if (tok->id == BSM_SOCKUNIX) {
+			next_field(out, del, "addr", flags);
+			print_bstring(out, &tok->tt.sockinet.path, flags);
+			end_field(out, flags);
+		} else {
+			next_field(out, del, "port", flags);
+			bsm_out_printf(out, "%u", tok->tt.sockinet.port);
+			end_field(out, flags);
+			next_field(out, del, "addr", flags);
+			print_ip_address(out, &tok->tt.sockinet.addr);
+			end_field(out, flags);
+		}
+		if (markup)
+			close_elem(out, flags);
+		break;
+
+	case BSM_SOCKET:
+	case BSM_SOCKET_EX:
+		if (markup)
+			open_elem(out, "socket", flags);
+		else
+			print_tok_type(out, tok->id, "socket", flags);
+		if (tok->id == BSM_SOCKET_EX) {
+			next_field(out, del, "sock_dom", flags);
+			bsm_out_printf(out, "%u", tok->tt.socket.domain);
+			end_field(out, flags);
+		}
+		next_field(out, del, "sock_type", flags);
+		bsm_out_printf(out, "%u", tok->tt.socket.type);
+		end_field(out, flags);
+		next_field(out, del, "lport", flags);
+		bsm_out_printf(out, "%u", tok->tt.socket.lport);
+		end_field(out, flags);
+		next_field(out, del, "laddr", flags);
+		print_ip_address(out, &tok->tt.socket.laddr);
+		end_field(out, flags);
+		next_field(out, del, "fport", flags);
+		bsm_out_printf(out, "%u", tok->tt.socket.rport);
+		end_field(out, flags);
+		next_field(out, del, "faddr", flags);
+		print_ip_address(out, &tok->tt.socket.raddr);
+		end_field(out, flags);
+		if (markup)
+			close_elem(out, flags);
+		break;
+
+	case BSM_EXIT:
+		if (markup)
+			open_elem(out, "exit", flags);
+		else
+			print_tok_type(out, tok->id, "exit", flags);
+		next_field(out, del, "errval", flags);
+		bsm_out_printf(out, "%u", tok->tt.exit.status);
+		end_field(out, flags);
+		next_field(out, del, "retval", flags);
+		bsm_out_printf(out, "%u", tok->tt.exit.ret);
+		end_field(out, flags);
+		if (markup)
+			close_elem(out, flags);
+		break;
+
+	case BSM_SEQ:
+		if (markup)
+			open_elem(out, "sequence", flags);
+		else
+			print_tok_type(out, tok->id, "sequence", flags);
+		next_field(out, del, "seq-num", flags);
+		bsm_out_printf(out, "%u", tok->tt.seqno);
+		end_field(out, flags);
+		if (markup)
+			close_elem(out, flags);
+		break;
+
+	case BSM_NEWGROUPS:
+		if (markup)
+			open_list(out, "group", "gid", flags);
+		else
+			print_tok_type(out, tok->id, "group", flags);
+		for (i = 0; i < tok->tt.groups.count; i++) {
+			const uint8_t *g = tok->tt.groups.gids + 4 * i;
+			uint32_t gid = (uint32_t)g[0] << 24 |
+			    (uint32_t)g[1] << 16 | (uint32_t)g[2] << 8 | g[3];
+
+			if (markup)
+				open_item(out, "gid", i == 0, flags);
+			else
+				print_delim(out, del);
+			print_group(out, gid, flags);
+			if (markup)
+				close_item(out, "gid", flags);
+		}
+		if (markup)
+			close_list(out, "group", flags);
+		break;
+
+	case BSM_DATA:
+		if (markup)
+			open_elem(out, "arbitrary", flags);
+		else
+			print_tok_type(out, tok->id, "arbitrary", flags);
+		next_field(out, del, "print", flags);
+		bsm_out_printf(out, "%u", tok->tt.data.howtopr);
+		end_field(out, flags);
+		next_field(out, del, "type", flags);
+		bsm_out_printf(out, "%u", tok->tt.data.bu);
+		end_field(out, flags);
+		next_field(out, del, "count", flags);
+		bsm_out_printf(out, "%u", tok->tt.data.uc);
+		end_field(out, flags);
+		if (markup)
+			begin_text(out, flags);
+		else
+			print_delim(out, del);
+		print_hex(out, tok->tt.data.data, tok->tt.data.len);
+		if (markup)
+			close_text(out, "arbitrary", flags);
+		break;
+
+	case BSM_OPAQUE:
+		if (markup)
+			open_text(out, "opaque", flags);
+		else {
+			print_tok_type(out, tok->id, "opaque", flags);
+			print_delim(out, del);
+			bsm_out_printf(out, "%u", tok->tt.opaque.len);
+			print_delim(out, del);
+		}
+		print_hex(out, tok->tt.opaque.data, tok->tt.opaque.len);
+		if (markup)
+			close_text(out, "opaque", flags);
+		break;
+
+	case BSM_IN_ADDR:
+	case BSM_IN_ADDR_EX:
+		if (markup)
+			open_text(out, "ip_address", flags);
+		else {
+			print_tok_type(out, tok->id, (tok->id == BSM_IN_ADDR) ?
+			    "ip addr" : "ip addr ex", flags);
+			print_delim(out, del);
+		}
+		print_ip_address(out, &tok->tt.inaddr);
+		if (markup)
+			close_text(out, "ip_address", flags);
+		break;
+
+	case BSM_IP:
+		if (markup)
+			open_text(out, "ip", flags);
+		else {
+			print_tok_type(out, tok->id, "ip", flags);
+			print_delim(out, del);
+		}
+		print_hex(out, tok->tt.ip, 20);
+		if (markup)
+			close_text(out, "ip", flags);
+		break;
+
+	case BSM_IPORT:
+		if (markup)
+			open_text(out, "ip_port", flags);
+		else {
+			print_tok_type(out, tok->id, "ip port", flags);
+			print_delim(out, del);
+		}
+		bsm_out_printf(out, "0x%x", tok->tt.iport);
+		if (markup)
+			close_text(out, "ip_port", flags);
+		break;
+
+	case BSM_OTHER_FILE32:
+		if (markup)
+			open_elem(out, "file", flags);
+		else
+			print_tok_type(out, tok->id, "file", flags);
+		next_field(out, del, "time", flags);
+		print_sec(out, tok->tt.file.sec, flags);
+		end_field(out, flags);
+		next_field(out, del, "msec", flags);
+		print_msec(out, tok->tt.file.msec, flags);
+		end_field(out, flags);
+		if (markup)
+			begin_text(out, flags);
+		else
+			print_delim(out, del);
+		print_bstring(out, &tok->tt.file.name, flags);
+		if (markup)
+			close_text(out, "file", flags);
+		break;
+	}
+}
+
+/*
+ * A record in the JSON form is one line: the header's object, holding the
+ * other tokens in its "tokens" array. One cut short of its trailer is
+ * still closed, so that every line parses.
+ */
+static void
+print_json_record(struct bsm_out *out, struct bsm_cursor *rec, int flags)
+{
+	struct bsm_token tok;
+	int header = 0, trailer = 0, first = 1;
+
+	while (bsm_next_token(rec, &tok) == BSM_OK) {
+		if (tok.id == BSM_TRAILER)
+			trailer = 1;
+		else if (!first)
+			bsm_out_putc(out, ',');
+		bsm_print_token(out, &tok, "", flags);
+		if (bsm_is_header(tok.id))
+			header = 1;
+		else
+			first = 0;
+	}
+	if (header && !trailer)
+		bsm_out_puts(out, "]}");
+	bsm_out_putc(out, '\n');
+}
+
+/*
+ * Print every token of a record, each on its own line or, with
+ * BSM_FMT_ONELINE, all on one line followed by the delimiter
+ */
+void
+bsm_print_record(struct bsm_out *out, struct bsm_cursor *rec,
+    const char *del, int flags)
+{
+	struct bsm_token tok;
+
+	if (flags & BSM_FMT_JSON) {
+		print_json_record(out, rec, flags);
+		return;
+	}
+	while (bsm_next_token(rec, &tok) == BSM_OK) {
+		bsm_print_token(out, &tok, del, flags);
+		if (flags & BSM_FMT_ONELINE)
+			bsm_out_puts(out, del);
+		else
+			bsm_out_putc(out, '\n');
+	}
+	if (flags & BSM_FMT_ONELINE)
+		bsm_out_putc(out, '\n');
+}
+
+void
+bsm_print_xml_header(struct bsm_out *out)
+{
+	bsm_out_puts(out, "<?xml version='1.0' ?>\n<audit>\n");
+}
+
+void
+bsm_print_xml_footer(struct bsm_out *out)
+{
+	bsm_out_puts(out, "</audit>\n");
+}
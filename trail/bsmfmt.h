@@ -0,0 +1,61 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#ifndef _BSMFMT_H_
+#define _BSMFMT_H_
+
+/*
+ * Renders decoded tokens the way praudit(1) does, in the default, raw
+ * (-r), short (-s) and XML (-x) forms, or as newline-delimited JSON whose
+ * members mirror the XML form's elements and attributes. Each token is
+ * written as it is decoded, nothing is built up per record.
+ */
+
+#include "bsmdec.h"
+#include "bsmout.h"
+
+#define BSM_FMT_RAW		0x01
+#define BSM_FMT_SHORT		0x02
+#define BSM_FMT_XML		0x04
+#define BSM_FMT_ONELINE		0x08	/* One record per line */
+#define BSM_FMT_JSON		0x10	/* One JSON object per record */
+
+#define BSM_FMT_MARKUP		(BSM_FMT_XML | BSM_FMT_JSON)
+
+int		 bsm_load_events(const char *);
+const char	*bsm_event_name(uint16_t, int);
+int		 bsm_event_number(const char *);
+const char	*bsm_strerror(uint8_t);
+
+void	bsm_print_token(struct bsm_out *, const struct bsm_token *,
+	    const char *, int);
+void	bsm_print_record(struct bsm_out *, struct bsm_cursor *, const char *,
+	    int);
+void	bsm_print_xml_header(struct bsm_out *);
+void	bsm_print_xml_footer(struct bsm_out *);
+
+#endif /* _BSMFMT_H_ */
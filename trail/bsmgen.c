@@ -0,0 +1,499 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * bsmgen(1) writes a synthetic trail of any size for load and scale tests
+ * of the trail tools. Records are drawn from a weighted mix of the kinds of
+ * syscalls the test-suite audits, each with the tokens the kernel emits for
+ * it. A few busy processes and a few users account for most records, and
+ * paths are drawn from a skewed pool as well, so the trail compresses and
+ * indexes like a real one. The same seed always gives the same trail.
+ */
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bsmdec.h"
+#include "bsmenc.h"
+
+#define NPROCS		512
+#define NUSERS		24
+#define NPATHS		4096
+#define FLUSH_SIZE	(1024 * 1024)
+
+/* BSM errno values, see bsm_errno(9) */
+#define BSM_ENOENT	2
+#define BSM_EACCES	13
+#define BSM_EINVAL	22
+
+struct process {
+	struct bsm_subject subj;
+	int		 nextfd;
+};
+
+struct gen {
+	uint64_t	 seed;
+	int		 failure;	/* Percentage of failed calls */
+	struct process	 procs[NPROCS];
+	char		*paths[NPATHS];
+	struct bsm_enc	 enc;
+};
+
+typedef void (*gen_fn)(struct gen *, struct process *, int);
+
+static void gen_open(struct gen *, struct process *, int);
+static void gen_stat(struct gen *, struct process *, int);
+static void gen_close(struct gen *, struct process *, int);
+static void gen_chmod(struct gen *, struct process *, int);
+static void gen_unlink(struct gen *, struct process *, int);
+static void gen_exec(struct gen *, struct process *, int);
+static void gen_socket(struct gen *, struct process *, int);
+static void gen_connect(struct gen *, struct process *, int);
+static void gen_msgget(struct gen *, struct process *, int);
+static void gen_kill(struct gen *, struct process *, int);
+
+/*
+ * Kinds of records and their default share of the trail
+ */
+static struct {
+	const char	*name;
+	uint16_t	 event;
+	gen_fn		 fn;
+	unsigned	 weight;
+} kinds[] = {
+	{ "open", 72, gen_open, 30 },		/* AUE_OPEN_R */
+	{ "stat", 16, gen_stat, 20 },		/* AUE_STAT */
+	{ "close", 112, gen_close, 20 },	/* AUE_CLOSE */
+	{ "chmod", 10, gen_chmod, 5 },		/* AUE_CHMOD */
+	{ "unlink", 6, gen_unlink, 5 },		/* AUE_UNLINK */
+	{ "exec", 23, gen_exec, 3 },		/* AUE_EXECVE */
+	{ "socket", 183, gen_socket, 5 },	/* AUE_SOCKET */
+	{ "connect", 32, gen_connect, 5 },	/* AUE_CONNECT */
+	{ "msgget", 88, gen_msgget, 2 },	/* AUE_MSGGET */
+	{ "kill", 15, gen_kill, 5 },		/* AUE_KILL */
+};
+
+#define NKINDS	(sizeof(kinds) / sizeof(kinds[0]))
+
+static const char *dirs[] = {
+	"/usr/bin", "/usr/lib", "/etc", "/tmp", "/var/log", "/var/run",
+	"/usr/local/bin", "/usr/local/etc", "/home/aniket", "/home/alan",
+	"/usr/share/zoneinfo", "/dev",
+};
+
+static const char *syllables[] = {
+	"au", "dit", "pipe", "log", "ker", "nel", "conf", "lib", "bsm", "sys",
+	"net", "ssh", "cron", "tmp", "pro", "file",
+};
+
+static const char *extensions[] = {
+	"", "", "", ".so", ".conf", ".log", ".pid", ".db", ".sh", ".txt",
+};
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: bsmgen [-f failure_percent] [-m kind=weight,...] "
+	    "[-n records]\n"
+	    "              [-r rate] [-s seed] [-S megabytes] [-t start] "
+	    "[trail]\n");
+	exit(1);
+}
+
+/*
+ * 64 bit linear congruential generator (Knuth's MMIX constants); only the
+ * better distributed upper half is used
+ */
+static uint32_t
+next_random(struct gen *gen)
+{
+	gen->seed = gen->seed * 6364136223846793005ULL +
+	    1442695040888963407ULL;
+	return ((uint32_t)(gen->seed >> 32));
+}
+
+/*
+ * Uniform in [0, n)
+ */
+static uint32_t
+uniform(struct gen *gen, uint32_t n)
+{
+	return ((uint32_t)(((uint64_t)next_random(gen) * n) >> 32));
+}
+
+/*
+ * In [0, n), cubically skewed towards 0: the first 10% of the range get
+ * about half of the draws
+ */
+static uint32_t
+skewed(struct gen *gen, uint32_t n)
+{
+	uint64_t u = next_random(gen);
+
+	u = (u * u) >> 32;
+	u = (u * next_random(gen)) >> 32;
+	return ((uint32_t)((u * n) >> 32));
+}
+
+static int
+failed(struct gen *gen)
+{
+	return ((int)uniform(gen, 100) < gen->failure);
+}
+
+static void
+init_pool(struct gen *gen)
+{
+	struct bsm_subject *subj;
+	uint32_t users[NUSERS];
+	char name[64];
+	size_t len;
+	int i, n;
+
+	/* root and daemons without an audit ID, then ordinary users */
+	users[0] = 0;
+	users[1] = UINT32_MAX;
+	for (i = 2; i < NUSERS; i++)
+		users[i] = 1000 + i;
+
+	for (i = 0; i < NPROCS; i++) {
+		subj = &gen->procs[i].subj;
+		memset(subj, 0, sizeof(*subj));
+		subj->auid = users[skewed(gen, NUSERS)];
+		subj->euid = subj->ruid = (subj->auid == UINT32_MAX) ? 0 :
+		    subj->auid;
+		subj->egid = subj->rgid = (subj->euid == 0) ? 0 : 1000;
+		subj->pid = 100 + uniform(gen, 99900);
+		subj->sid = (subj->auid == UINT32_MAX) ? 0 : subj->pid;
+		subj->addr.type = BSM_IPV4;
+		subj->addr.addr[0] = 10;
+		subj->addr.addr[3] = (uint8_t)uniform(gen, 256);
+		gen->procs[i].nextfd = 3;
+	}
+
+	for (i = 0; i < NPATHS; i++) {
+		len = (size_t)snprintf(name, sizeof(name), "%s/",
+		    dirs[skewed(gen, sizeof(dirs) / sizeof(dirs[0]))]);
+		for (n = 1 + uniform(gen, 3); n > 0; n--)
+			len += (size_t)snprintf(name + len, sizeof(name) - len,
+			    "%s", syllables[uniform(gen,
+			    sizeof(syllables) / sizeof(syllables[0]))]);
+		snprintf(name + len, sizeof(name) - len, "%s",
+		    extensions[uniform(gen,
+		    sizeof(extensions) / sizeof(extensions[0]))]);
+		if ((gen->paths[i] = strdup(name)) == NULL)
+			err(1, "strdup");
+	}
+}
+
+static const char *
+pick_path(struct gen *gen)
+{
+	return (gen->paths[skewed(gen, NPATHS)]);
+}
+
+/*
+ * The same path always has the same inode, derived from its FNV-1a hash
+ */
+static void
+put_attr(struct gen *gen, const char *path)
+{
+	uint64_t node = 14695981039346656037ULL;
+
+	for (; *path != '\0'; path++)
+		node = (node ^ (uint8_t)*path) * 1099511628211ULL;
+	bsm_enc_attr32(&gen->enc, 0100644, 0, 0, 0x5a, node % 1000000, 0);
+}
+
+static void
+put_return(struct gen *gen, struct process *proc, int fail, uint8_t error,
+    uint32_t val)
+{
+	bsm_enc_subject32(&gen->enc, &proc->subj);
+	if (fail)
+		bsm_enc_return32(&gen->enc, error, UINT32_MAX);
+	else
+		bsm_enc_return32(&gen->enc, 0, val);
+}
+
+static void
+gen_open(struct gen *gen, struct process *proc, int fail)
+{
+	const char *path = pick_path(gen);
+
+	bsm_enc_arg32(&gen->enc, 2, 0, "flags");
+	bsm_enc_path(&gen->enc, path);
+	if (!fail)
+		put_attr(gen, path);
+	put_return(gen, proc, fail, BSM_ENOENT, (uint32_t)proc->nextfd++);
+}
+
+static void
+gen_stat(struct gen *gen, struct process *proc, int fail)
+{
+	const char *path = pick_path(gen);
+
+	bsm_enc_path(&gen->enc, path);
+	if (!fail)
+		put_attr(gen, path);
+	put_return(gen, proc, fail, BSM_ENOENT, 0);
+}
+
+static void
+gen_close(struct gen *gen, struct process *proc, int fail)
+{
+	uint32_t fd = fail ? UINT32_MAX : (uint32_t)(proc->nextfd > 3 ?
+	    --proc->nextfd : 3);
+
+	bsm_enc_arg32(&gen->enc, 1, fd, "fd");
+	if (!fail)
+		put_attr(gen, pick_path(gen));
+	put_return(gen, proc, fail, BSM_EINVAL, 0);
+}
+
+static void
+gen_chmod(struct gen *gen, struct process *proc, int fail)
+{
+	const char *path = pick_path(gen);
+
+	bsm_enc_arg32(&gen->enc, 2, 0644, "new file mode");
+	bsm_enc_path(&gen->enc, path);
+	if (!fail)
+		put_attr(gen, path);
+	put_return(gen, proc, fail, BSM_EACCES, 0);
+}
+
+static void
+gen_unlink(struct gen *gen, struct process *proc, int fail)
+{
+	const char *path = pick_path(gen);
+
+	bsm_enc_path(&gen->enc, path);
+	if (!fail)
+		put_attr(gen, path);
+	put_return(gen, proc, fail, BSM_ENOENT, 0);
+}
+
+static void
+gen_exec(struct gen *gen, struct process *proc, int fail)
+{
+	const char *argv[4];
+
+	argv[0] = pick_path(gen);
+	argv[1] = "-c";
+	argv[2] = pick_path(gen);
+	argv[3] = NULL;
+	bsm_enc_exec_args(&gen->enc, argv);
+	bsm_enc_path(&gen->enc, argv[0]);
+	if (!fail)
+		put_attr(gen, argv[0]);
+	put_return(gen, proc, fail, BSM_ENOENT, 0);
+}
+
+static void
+gen_socket(struct gen *gen, struct process *proc, int fail)
+{
+	bsm_enc_arg32(&gen->enc, 1, 2, "domain");
+	bsm_enc_arg32(&gen->enc, 2, 1 + uniform(gen, 2), "type");
+	bsm_enc_arg32(&gen->enc, 3, 0, "protocol");
+	put_return(gen, proc, fail, BSM_EINVAL, (uint32_t)proc->nextfd++);
+}
+
+static void
+gen_connect(struct gen *gen, struct process *proc, int fail)
+{
+	static const uint16_t ports[] = { 22, 53, 80, 443, 514, 8080 };
+
+	bsm_enc_arg32(&gen->enc, 1, (uint32_t)proc->nextfd, "fd");
+	bsm_enc_sockinet32(&gen->enc, 2,
+	    ports[skewed(gen, sizeof(ports) / sizeof(ports[0]))],
+	    0x0a000000 | uniform(gen, 1 << 16));
+	put_return(gen, proc, fail, 61, 0);	/* ECONNREFUSED */
+}
+
+static void
+gen_msgget(struct gen *gen, struct process *proc, int fail)
+{
+	uint32_t key = 0x51000000 | uniform(gen, 64);
+
+	bsm_enc_arg32(&gen->enc, 1, key, "msg key");
+	if (!fail) {
+		bsm_enc_ipc(&gen->enc, 1, key & 0xff);	/* AT_IPC_MSG */
+		bsm_enc_ipc_perm(&gen->enc, proc->subj.euid, proc->subj.egid,
+		    proc->subj.euid, proc->subj.egid, 0600, 0, key);
+	}
+	put_return(gen, proc, fail, BSM_EACCES, key & 0xff);
+}
+
+static void
+gen_kill(struct gen *gen, struct process *proc, int fail)
+{
+	bsm_enc_arg32(&gen->enc, 1,
+	    gen->procs[uniform(gen, NPROCS)].subj.pid, "pid");
+	bsm_enc_arg32(&gen->enc, 2, 15, "signal");
+	put_return(gen, proc, fail, 3, 0);	/* ESRCH */
+}
+
+/*
+ * Replace the default weights by those of "mix", "kind=weight,..."
+ */
+static void
+parse_mix(char *mix)
+{
+	char *item, *value, *end, *last;
+	size_t i;
+	long weight;
+
+	for (i = 0; i < NKINDS; i++)
+		kinds[i].weight = 0;
+	for (item = strtok_r(mix, ",", &last); item != NULL;
+	    item = strtok_r(NULL, ",", &last)) {
+		if ((value = strchr(item, '=')) == NULL)
+			errx(1, "%s: not kind=weight", item);
+		*value++ = '\0';
+		weight = strtol(value, &end, 10);
+		if (*value == '\0' || *end != '\0' || weight < 0)
+			errx(1, "%s: invalid weight %s", item, value);
+		for (i = 0; i < NKINDS; i++) {
+			if (strcmp(kinds[i].name, item) == 0)
+				break;
+		}
+		if (i == NKINDS)
+			errx(1, "%s: unknown kind of record", item);
+		kinds[i].weight = (unsigned)weight;
+	}
+}
+
+static size_t
+pick_kind(struct gen *gen, unsigned total)
+{
+	unsigned w = uniform(gen, total);
+	size_t i;
+
+	for (i = 0; w >= kinds[i].weight; i++)
+		w -= kinds[i].weight;
+	return (i);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct gen gen;
+	struct process *proc;
+	FILE *out = stdout;
+	uint64_t usec, gap, size = 0, written = 0;
+	unsigned long long records = 0, n = 0;
+	unsigned total = 0;
+	long rate = 1000;
+	size_t i, k;
+	int ch, fail;
+
+	memset(&gen, 0, sizeof(gen));
+	gen.seed = 1;
+	gen.failure = 10;
+	usec = 1528706400ULL * 1000000;		/* 2018-06-11 08:40 UTC */
+
+	while ((ch = getopt(argc, argv, "f:m:n:r:s:S:t:")) != -1) {
+		switch (ch) {
+		case 'f':
+			gen.failure = (int)strtol(optarg, NULL, 10);
+			if (gen.failure < 0 || gen.failure > 100)
+				usage();
+			break;
+		case 'm':
+			parse_mix(optarg);
+			break;
+		case 'n':
+			records = strtoull(optarg, NULL, 10);
+			break;
+		case 'r':
+			if ((rate = strtol(optarg, NULL, 10)) <= 0)
+				usage();
+			break;
+		case 's':
+			gen.seed = strtoull(optarg, NULL, 10);
+			break;
+		case 'S':
+			size = strtoull(optarg, NULL, 10) * 1024 * 1024;
+			break;
+		case 't':
+			usec = strtoull(optarg, NULL, 10) * 1000000;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc > 1 || (records == 0 && size == 0))
+		usage();
+	if (argc == 1 && (out = fopen(argv[0], "w")) == NULL)
+		err(1, "%s", argv[0]);
+
+	for (i = 0; i < NKINDS; i++)
+		total += kinds[i].weight;
+	if (total == 0)
+		errx(1, "no kind of record has a weight");
+
+	bsm_enc_init(&gen.enc);
+	init_pool(&gen);
+
+	/* Gaps between records average out to the requested rate */
+	gap = 2000000 / (uint64_t)rate;
+	while ((records == 0 || n < records) && (size == 0 || written < size)) {
+		k = pick_kind(&gen, total);
+		proc = &gen.procs[skewed(&gen, NPROCS)];
+		fail = failed(&gen);
+
+		bsm_enc_header32(&gen.enc, kinds[k].event, 0,
+		    (uint32_t)(usec / 1000000), (uint32_t)(usec % 1000000 / 1000));
+		kinds[k].fn(&gen, proc, fail);
+		if (bsm_enc_trailer(&gen.enc) == -1)
+			err(1, "record");
+		written += gen.enc.len - gen.enc.start;
+		usec += uniform(&gen, (uint32_t)gap + 1);
+		n++;
+
+		if (gen.enc.len >= FLUSH_SIZE) {
+			if (fwrite(gen.enc.buf, gen.enc.len, 1, out) != 1)
+				err(1, "write");
+			bsm_enc_reset(&gen.enc);
+		}
+	}
+	if (gen.enc.len > 0 && fwrite(gen.enc.buf, gen.enc.len, 1, out) != 1)
+		err(1, "write");
+	if (fclose(out) != 0)
+		err(1, "write");
+
+	for (i = 0; i < NPATHS; i++)
+		free(gen.paths[i]);
+	bsm_enc_free(&gen.enc);
+	return (0);
+}
@@ -0,0 +1,115 @@
+#
+# Copyright (c) 2018 Aniket Pandey
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+# OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+# HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+# OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE.
+#
+# $FreeBSD$
+#
+
+setup_gen()
+{
+	bsmgen="$(atf_get_srcdir)/bsmgen"
+	bsmstat="$(atf_get_srcdir)/bsmstat -e $(atf_get_srcdir)/input/audit_event"
+}
+
+
+atf_test_case bsmgen_deterministic
+bsmgen_deterministic_head()
+{
+	atf_set "descr" "Verify that a seed always gives the same trail and " \
+			"another seed a different one"
+}
+
+bsmgen_deterministic_body()
+{
+	setup_gen
+	atf_check ${bsmgen} -s 42 -n 1000 first
+	atf_check ${bsmgen} -s 42 -n 1000 second
+	atf_check ${bsmgen} -s 43 -n 1000 other
+	atf_check cmp -s first second
+	atf_check -s exit:1 cmp -s first other
+}
+
+
+atf_test_case bsmgen_valid
+bsmgen_valid_head()
+{
+	atf_set "descr" "Verify that every generated record decodes, with " \
+			"the requested number of records"
+}
+
+bsmgen_valid_body()
+{
+	setup_gen
+	atf_check -o save:trail ${bsmgen} -n 2000
+	# bsmstat fails on the first record it cannot decode
+	atf_check -o save:counts ${bsmstat} trail "open(2)" "stat(2)" \
+		"close(2)" "chmod(2)" "unlink(2)" "execve(2)" "socket(2)" \
+		"connect(2)" "msgget(2)" "kill(2)"
+	atf_check -o inline:"2000\n" awk '{ n += $2 + $3 } END { print n }' \
+		counts
+}
+
+
+atf_test_case bsmgen_mix
+bsmgen_mix_head()
+{
+	atf_set "descr" "Verify that -m restricts the kinds of records and " \
+			"-f sets the share of failed calls"
+}
+
+bsmgen_mix_body()
+{
+	setup_gen
+	atf_check ${bsmgen} -m socket=1 -f 0 -n 100 success
+	atf_check -o inline:"socket(2) 100 0\nopen(2) 0 0\n" \
+		${bsmstat} success "socket(2)" "open(2)"
+	atf_check ${bsmgen} -m socket=1,open=0 -f 100 -n 100 failure
+	atf_check -o inline:"socket(2) 0 100\nopen(2) 0 0\n" \
+		${bsmstat} failure "socket(2)" "open(2)"
+	atf_check -s exit:1 -e match:"unknown kind" ${bsmgen} -m fork=1 -n 1
+}
+
+
+atf_test_case bsmgen_size
+bsmgen_size_head()
+{
+	atf_set "descr" "Verify that -S stops at the first record boundary " \
+			"past the requested size"
+}
+
+bsmgen_size_body()
+{
+	setup_gen
+	atf_check ${bsmgen} -S 1 trail
+	size=$(wc -c < trail)
+	atf_check test ${size} -ge 1048576 -a ${size} -lt 1049600
+}
+
+
+atf_init_test_cases()
+{
+	atf_add_test_case bsmgen_deterministic
+	atf_add_test_case bsmgen_valid
+	atf_add_test_case bsmgen_mix
+	atf_add_test_case bsmgen_size
+}
@@ -0,0 +1,398 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bsmidx.h"
+
+#define HEADER_LEN	(8 + 8 + 4 + 4 + BSM_IDX_NSECTIONS * 16)
+#define KEY_LEN		24
+
+struct entry {
+	uint64_t	 key;
+	uint64_t	 off;
+	uint64_t	 end;
+};
+
+struct entries {
+	struct entry	*ent;
+	size_t		 n;
+	size_t		 cap;
+};
+
+static uint32_t
+get32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+	    (uint32_t)p[2] << 8 | p[3]);
+}
+
+static uint64_t
+get64(const uint8_t *p)
+{
+	return ((uint64_t)get32(p) << 32 | get32(p + 4));
+}
+
+static void
+put32(FILE *fp, uint32_t v)
+{
+	putc((int)(v >> 24), fp);
+	putc((int)(v >> 16) & 0xff, fp);
+	putc((int)(v >> 8) & 0xff, fp);
+	putc((int)v & 0xff, fp);
+}
+
+static void
+put64(FILE *fp, uint64_t v)
+{
+	put32(fp, (uint32_t)(v >> 32));
+	put32(fp, (uint32_t)v);
+}
+
+static int
+add_entry(struct entries *e, uint64_t key, uint64_t off, uint64_t end)
+{
+	struct entry *ent;
+
+	if (e->n == e->cap) {
+		e->cap = (e->cap == 0) ? 1024 : e->cap * 2;
+		if ((ent = realloc(e->ent, e->cap * sizeof(*ent))) == NULL)
+			return (-1);
+		e->ent = ent;
+	}
+	e->ent[e->n].key = key;
+	e->ent[e->n].off = off;
+	e->ent[e->n].end = end;
+	e->n++;
+	return (0);
+}
+
+static int
+cmp_entry(const void *a, const void *b)
+{
+	const struct entry *ea = a, *eb = b;
+
+	if (ea->key != eb->key)
+		return (ea->key < eb->key ? -1 : 1);
+	if (ea->off != eb->off)
+		return (ea->off < eb->off ? -1 : 1);
+	return (0);
+}
+
+/*
+ * Sort the entries of a section by key and merge entries with equal keys.
+ * Posting sections keep every offset; the time section keeps one range.
+ */
+static void
+sort_section(struct entries *e, int sect, uint32_t *nkeys)
+{
+	size_t i, j;
+
+	qsort(e->ent, e->n, sizeof(*e->ent), cmp_entry);
+	*nkeys = 0;
+	for (i = 0; i < e->n; i = j) {
+		for (j = i + 1; j < e->n && e->ent[j].key == e->ent[i].key; j++)
+			if (sect == BSM_IDX_TIME && e->ent[j].end > e->ent[i].end)
+				e->ent[i].end = e->ent[j].end;
+		(*nkeys)++;
+	}
+}
+
+static void
+write_section(FILE *fp, const struct entries *e, int sect)
+{
+	size_t i, j;
+
+	for (i = 0; i < e->n; i = j) {
+		for (j = i + 1; j < e->n && e->ent[j].key == e->ent[i].key; j++)
+			;
+		put64(fp, e->ent[i].key);
+		if (sect == BSM_IDX_TIME) {
+			put64(fp, e->ent[i].off);
+			put64(fp, e->ent[i].end);
+		} else {
+			put64(fp, i);
+			put64(fp, j - i);
+		}
+	}
+	if (sect != BSM_IDX_TIME) {
+		for (i = 0; i < e->n; i++)
+			put64(fp, e->ent[i].off);
+	}
+}
+
+/*
+ * Collect the keys of one record: its time and event from the header and
+ * pid and audit ID from the first subject token, if there is one
+ */
+static int
+index_record(struct entries *e, struct bsm_cursor *rec, uint64_t off,
+    uint32_t bucket)
+{
+	struct bsm_token tok;
+	uint64_t end = off + rec->len;
+	int subject = 0;
+
+	while (bsm_next_token(rec, &tok) == BSM_OK) {
+		switch (tok.id) {
+		case BSM_HEADER32:
+		case BSM_HEADER32_EX:
+		case BSM_HEADER64:
+		case BSM_HEADER64_EX:
+			if (add_entry(&e[BSM_IDX_TIME],
+			    tok.tt.hdr.sec - tok.tt.hdr.sec % bucket, off,
+			    end) == -1 ||
+			    add_entry(&e[BSM_IDX_EVENT], tok.tt.hdr.event, off,
+			    end) == -1)
+				return (-1);
+			break;
+		case BSM_SUBJECT32:
+		case BSM_SUBJECT64:
+		case BSM_SUBJECT32_EX:
+		case BSM_SUBJECT64_EX:
+			if (subject++)
+				break;
+			if (add_entry(&e[BSM_IDX_PID], tok.tt.subj.pid, off,
+			    end) == -1 ||
+			    add_entry(&e[BSM_IDX_AUID], tok.tt.subj.auid, off,
+			    end) == -1)
+				return (-1);
+			break;
+		}
+	}
+	return (0);
+}
+
+/*
+ * Write the index of an indexed trail mapping to "fp" with time buckets
+ * of "bucket" seconds. Returns -1 with errno set on failure.
+ */
+int
+bsm_idx_build(const struct bsm_map *map, uint32_t bucket, FILE *fp)
+{
+	struct entries e[BSM_IDX_NSECTIONS];
+	struct bsm_cursor rec;
+	uint32_t nkeys[BSM_IDX_NSECTIONS];
+	size_t i;
+	int sect, ret = -1;
+
+	memset(e, 0, sizeof(e));
+	if (bucket == 0)
+		bucket = BSM_IDX_BUCKET;
+
+	for (i = 0; i < map->nrecords; i++) {
+		bsm_map_record(map, i, &rec);
+		if (index_record(e, &rec, map->offsets[i], bucket) == -1)
+			goto out;
+	}
+	for (sect = 0; sect < BSM_IDX_NSECTIONS; sect++)
+		sort_section(&e[sect], sect, &nkeys[sect]);
+
+	fwrite(BSM_IDX_MAGIC, 1, sizeof(BSM_IDX_MAGIC), fp);
+	put64(fp, map->len);
+	put32(fp, bucket);
+	put32(fp, BSM_IDX_NSECTIONS);
+	for (sect = 0; sect < BSM_IDX_NSECTIONS; sect++) {
+		put32(fp, nkeys[sect]);
+		put32(fp, 0);
+		put64(fp, sect == BSM_IDX_TIME ? 0 : e[sect].n);
+	}
+	for (sect = 0; sect < BSM_IDX_NSECTIONS; sect++)
+		write_section(fp, &e[sect], sect);
+	if (fflush(fp) == 0 && !ferror(fp))
+		ret = 0;
+
+out:
+	for (sect = 0; sect < BSM_IDX_NSECTIONS; sect++)
+		free(e[sect].ent);
+	return (ret);
+}
+
+/*
+ * Map the index at "path" and check that its sections fit the file.
+ * Returns -1 with errno set on failure, EINVAL if it is no index.
+ */
+int
+bsm_idx_open(struct bsm_idx *idx, const char *path)
+{
+	struct stat sb;
+	const uint8_t *p;
+	void *base;
+	size_t left;
+	int error, sect;
+
+	memset(idx, 0, sizeof(*idx));
+	if ((idx->fd = open(path, O_RDONLY)) == -1)
+		return (-1);
+	if (fstat(idx->fd, &sb) == -1)
+		goto fail;
+	if (sb.st_size < HEADER_LEN || (uintmax_t)sb.st_size > SIZE_MAX) {
+		errno = EINVAL;
+		goto fail;
+	}
+
+	idx->len = (size_t)sb.st_size;
+	base = mmap(NULL, idx->len, PROT_READ, MAP_SHARED, idx->fd, 0);
+	if (base == MAP_FAILED)
+		goto fail;
+	idx->base = base;
+
+	if (memcmp(idx->base, BSM_IDX_MAGIC, sizeof(BSM_IDX_MAGIC)) != 0 ||
+	    get32(idx->base + 20) != BSM_IDX_NSECTIONS) {
+		errno = EINVAL;
+		goto fail;
+	}
+	idx->trailsize = get64(idx->base + 8);
+	idx->bucket = get32(idx->base + 16);
+
+	p = idx->base + HEADER_LEN;
+	left = idx->len - HEADER_LEN;
+	for (sect = 0; sect < BSM_IDX_NSECTIONS; sect++) {
+		const uint8_t *h = idx->base + 24 + sect * 16;
+		struct bsm_idx_section *s = &idx->sect[sect];
+
+		s->nkeys = get32(h);
+		s->nposts = get64(h + 8);
+		if (s->nkeys > left / KEY_LEN ||
+		    s->nposts > (left - s->nkeys * KEY_LEN) / 8) {
+			errno = EINVAL;
+			goto fail;
+		}
+		s->keys = p;
+		s->posts = p + s->nkeys * KEY_LEN;
+		p += s->nkeys * KEY_LEN + s->nposts * 8;
+		left -= s->nkeys * KEY_LEN + s->nposts * 8;
+	}
+	return (0);
+
+fail:
+	error = errno;
+	bsm_idx_close(idx);
+	errno = error;
+	return (-1);
+}
+
+void
+bsm_idx_close(struct bsm_idx *idx)
+{
+	if (idx->base != NULL)
+		munmap((void *)(uintptr_t)idx->base, idx->len);
+	if (idx->fd != -1)
+		close(idx->fd);
+	idx->base = NULL;
+	idx->fd = -1;
+}
+
+/*
+ * Binary search for "key" in a section. Returns the key entry or NULL.
+ */
+static const uint8_t *
+find_key(const struct bsm_idx_section *s, uint64_t key)
+{
+	const uint8_t *ent;
+	uint32_t lo = 0, hi = s->nkeys, mid;
+	uint64_t k;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		ent = s->keys + (size_t)mid * KEY_LEN;
+		if ((k = get64(ent)) == key)
+			return (ent);
+		if (k < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (NULL);
+}
+
+/*
+ * Point "posts" at the offsets of the records having "key" in a posting
+ * section. Returns their number, read each with bsm_idx_offset().
+ */
+uint64_t
+bsm_idx_postings(const struct bsm_idx *idx, int sect, uint64_t key,
+    const uint8_t **posts)
+{
+	const struct bsm_idx_section *s = &idx->sect[sect];
+	const uint8_t *ent;
+	uint64_t first, count;
+
+	if ((ent = find_key(s, key)) == NULL)
+		return (0);
+	first = get64(ent + 8);
+	count = get64(ent + 16);
+	if (first > s->nposts || count > s->nposts - first)
+		return (0);
+	*posts = s->posts + first * 8;
+	return (count);
+}
+
+uint64_t
+bsm_idx_offset(const uint8_t *posts, uint64_t i)
+{
+	return (get64(posts + i * 8));
+}
+
+/*
+ * The smallest range of trail offsets holding every record stamped between
+ * "from" and "to", inclusive. Returns 0 if there are none.
+ */
+int
+bsm_idx_time_range(const struct bsm_idx *idx, uint64_t from, uint64_t to,
+    uint64_t *lo, uint64_t *hi)
+{
+	const struct bsm_idx_section *s = &idx->sect[BSM_IDX_TIME];
+	const uint8_t *ent;
+	uint64_t key;
+	uint32_t i;
+	int found = 0;
+
+	from -= from % idx->bucket;
+	for (i = 0; i < s->nkeys; i++) {
+		ent = s->keys + (size_t)i * KEY_LEN;
+		key = get64(ent);
+		if (key < from)
+			continue;
+		if (key > to)
+			break;
+		if (!found || get64(ent + 8) < *lo)
+			*lo = get64(ent + 8);
+		if (!found || get64(ent + 16) > *hi)
+			*hi = get64(ent + 16);
+		found = 1;
+	}
+	return (found);
+}
@@ -0,0 +1,90 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#ifndef _BSMIDX_H_
+#define _BSMIDX_H_
+
+/*
+ * Sidecar index of a trail, stored next to it as "<trail>.idx". It maps
+ * event numbers, subject pids and audit IDs to the offsets of matching
+ * records, and time buckets to the range of offsets holding their
+ * records. All integers are big-endian, as in the trail itself:
+ *
+ *	magic		"BSMIDX1\0"
+ *	trail size	uint64
+ *	bucket		uint32, seconds per time bucket
+ *	sections	uint32, BSM_IDX_NSECTIONS
+ *	per section	uint32 nkeys, uint32 reserved, uint64 nposts
+ *	per section	nkeys keys, then nposts uint64 record offsets
+ *
+ * A key is three uint64: the key itself and, for the posting sections,
+ * the index of its first posting and the number of postings. Keys of the
+ * time section are the start of a bucket followed by the offset of its
+ * first record and the end of its last one.
+ */
+
+#include <stdio.h>
+
+#include "bsmdec.h"
+#include "bsmmap.h"
+
+#define BSM_IDX_MAGIC		"BSMIDX1"
+#define BSM_IDX_SUFFIX		".idx"
+#define BSM_IDX_BUCKET		60
+
+#define BSM_IDX_TIME		0
+#define BSM_IDX_EVENT		1
+#define BSM_IDX_PID		2
+#define BSM_IDX_AUID		3
+#define BSM_IDX_NSECTIONS	4
+
+struct bsm_idx_section {
+	const uint8_t	*keys;
+	uint32_t	 nkeys;
+	const uint8_t	*posts;
+	uint64_t	 nposts;
+};
+
+struct bsm_idx {
+	int		 fd;
+	const uint8_t	*base;
+	size_t		 len;
+	uint64_t	 trailsize;
+	uint32_t	 bucket;
+	struct bsm_idx_section sect[BSM_IDX_NSECTIONS];
+};
+
+int	bsm_idx_build(const struct bsm_map *, uint32_t, FILE *);
+int	bsm_idx_open(struct bsm_idx *, const char *);
+void	bsm_idx_close(struct bsm_idx *);
+uint64_t bsm_idx_postings(const struct bsm_idx *, int, uint64_t,
+	    const uint8_t **);
+uint64_t bsm_idx_offset(const uint8_t *, uint64_t);
+int	bsm_idx_time_range(const struct bsm_idx *, uint64_t, uint64_t,
+	    uint64_t *, uint64_t *);
+
+#endif /* _BSMIDX_H_ */
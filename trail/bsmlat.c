@@ -0,0 +1,282 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * bsmlat(1) reports the audit delivery latency of every event in a trail
+ * recorded by audit/bench/latency_bench: the 50th, 90th and 99th percentile
+ * and the maximum time from the start of a syscall to the arrival of its
+ * record, in microseconds, and the rate at which the records arrived. It
+ * only needs the trail and its "<trail>.lat" file, so the results of
+ * different kernels can be compared on any host.
+ *
+ * Without the latency file, records are dated by their header alone and
+ * only the counts and the rate are reported.
+ */
+
+#include <err.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bsmdec.h"
+#include "bsmfmt.h"
+#include "bsmmap.h"
+
+#define AUDIT_EVENT_FILE	"/etc/security/audit_event"
+#define LAT_MAGIC		"BSMLAT1"	/* Followed by a NUL */
+#define LAT_SUFFIX		".lat"
+
+struct event_lat {
+	uint16_t	 event;
+	size_t		 records;
+	uint64_t	*lat;		/* Nanoseconds, of the timed records */
+	size_t		 nlat;
+	size_t		 cap;
+	uint64_t	 first;		/* Earliest start of a syscall */
+	uint64_t	 last;		/* Latest arrival of a record */
+};
+
+static struct event_lat *events;
+static size_t nevents;
+static long slots[UINT16_MAX + 1];	/* Index in events, or -1 */
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: bsmlat [-p] [-e audit_event] [-l latencies] "
+	    "trail\n");
+	exit(1);
+}
+
+static uint64_t
+get_be64(const uint8_t *buf)
+{
+	uint64_t val = 0;
+	int i;
+
+	for (i = 0; i < 8; i++)
+		val = (val << 8) | buf[i];
+	return (val);
+}
+
+/*
+ * The per-event statistics of "event", in order of first appearance
+ */
+static struct event_lat *
+event_lat(uint16_t event)
+{
+	struct event_lat *ev;
+
+	if (slots[event] == -1) {
+		ev = realloc(events, (nevents + 1) * sizeof(*events));
+		if (ev == NULL)
+			err(1, "realloc");
+		events = ev;
+		memset(&events[nevents], 0, sizeof(*events));
+		events[nevents].event = event;
+		events[nevents].first = UINT64_MAX;
+		slots[event] = (long)nevents++;
+	}
+	return (&events[slots[event]]);
+}
+
+static void
+add_latency(struct event_lat *ev, uint64_t lat)
+{
+	uint64_t *buf;
+
+	if (ev->nlat == ev->cap) {
+		ev->cap = (ev->cap == 0) ? 256 : ev->cap * 2;
+		if ((buf = realloc(ev->lat, ev->cap * sizeof(*buf))) == NULL)
+			err(1, "realloc");
+		ev->lat = buf;
+	}
+	ev->lat[ev->nlat++] = lat;
+}
+
+static int
+compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return ((x > y) - (x < y));
+}
+
+/*
+ * Nearest-rank percentile "p" of the sorted latencies, in microseconds
+ */
+static double
+percentile(const struct event_lat *ev, int p)
+{
+	size_t rank;
+
+	rank = (ev->nlat * p + 99) / 100;
+	return (ev->lat[rank > 0 ? rank - 1 : 0] / 1e3);
+}
+
+/*
+ * Read "path" whole and check that it holds one entry per record
+ */
+static uint8_t *
+load_latencies(const char *path, size_t nrecords)
+{
+	uint8_t *buf;
+	size_t len;
+	FILE *fp;
+
+	len = sizeof(LAT_MAGIC) + nrecords * 16;
+	if ((buf = malloc(len + 1)) == NULL)
+		err(1, "malloc");
+	if ((fp = fopen(path, "r")) == NULL)
+		err(1, "%s", path);
+	if (fread(buf, 1, len + 1, fp) != len ||
+	    memcmp(buf, LAT_MAGIC, sizeof(LAT_MAGIC)) != 0)
+		errx(1, "%s: does not match the %zu records of the trail",
+		    path, nrecords);
+	fclose(fp);
+	return (buf);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *eventfile = AUDIT_EVENT_FILE;
+	const char *latpath = NULL, *name;
+	struct event_lat *ev;
+	struct bsm_map map;
+	struct bsm_cursor rec;
+	struct bsm_token tok;
+	uint8_t *lat = NULL, *entry;
+	uint64_t started, arrival;
+	char *path = NULL;
+	size_t i;
+	int ch, resync = 0;
+
+	while ((ch = getopt(argc, argv, "e:l:p")) != -1) {
+		switch (ch) {
+		case 'e':
+			eventfile = optarg;
+			break;
+		case 'l':
+			latpath = optarg;
+			break;
+		case 'p':
+			resync = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 1)
+		usage();
+
+	(void)bsm_load_events(eventfile);
+	memset(slots, 0xff, sizeof(slots));
+
+	if (bsm_map_open(&map, argv[0]) == -1)
+		err(1, "%s", argv[0]);
+	if (bsm_map_index(&map, resync) == -1) {
+		if (errno == EINVAL)
+			errx(1, "%s: corrupted records, skipped with -p",
+			    argv[0]);
+		err(1, "%s", argv[0]);
+	}
+
+	/* The recorder writes the latencies next to the trail */
+	if (latpath == NULL) {
+		if ((path = malloc(strlen(argv[0]) + sizeof(LAT_SUFFIX))) ==
+		    NULL)
+			err(1, "malloc");
+		sprintf(path, "%s%s", argv[0], LAT_SUFFIX);
+		if (access(path, F_OK) == 0)
+			latpath = path;
+	}
+	if (latpath != NULL)
+		lat = load_latencies(latpath, map.nrecords);
+
+	for (i = 0; i < map.nrecords; i++) {
+		bsm_map_record(&map, i, &rec);
+		if (bsm_next_token(&rec, &tok) != BSM_OK ||
+		    !bsm_is_header(tok.id))
+			continue;
+		ev = event_lat(tok.tt.hdr.event);
+		ev->records++;
+
+		started = tok.tt.hdr.sec * 1000000000 +
+		    tok.tt.hdr.msec * 1000000;
+		arrival = started;
+		if (lat != NULL) {
+			entry = lat + sizeof(LAT_MAGIC) + i * 16;
+			arrival = get_be64(entry + 8);
+
+			/* Records of other processes were not timed */
+			if (get_be64(entry) != 0) {
+				started = get_be64(entry);
+				add_latency(ev, arrival - started);
+			}
+		}
+		if (started < ev->first)
+			ev->first = started;
+		if (arrival > ev->last)
+			ev->last = arrival;
+	}
+
+	/* event records p50 p90 p99 max records/s, "-" where unknown */
+	for (i = 0; i < nevents; i++) {
+		ev = &events[i];
+		if ((name = bsm_event_name(ev->event, 0)) != NULL)
+			printf("%s %zu", name, ev->records);
+		else
+			printf("%u %zu", ev->event, ev->records);
+
+		if (ev->nlat > 0) {
+			qsort(ev->lat, ev->nlat, sizeof(*ev->lat),
+			    compare_u64);
+			printf(" %.1f %.1f %.1f %.1f", percentile(ev, 50),
+			    percentile(ev, 90), percentile(ev, 99),
+			    ev->lat[ev->nlat - 1] / 1e3);
+		} else
+			printf(" - - - -");
+
+		if (ev->last > ev->first)
+			printf(" %.0f\n", ev->records /
+			    ((ev->last - ev->first) / 1e9));
+		else
+			printf(" -\n");
+		free(ev->lat);
+	}
+
+	free(events);
+	free(lat);
+	free(path);
+	bsm_map_close(&map);
+	return (0);
+}
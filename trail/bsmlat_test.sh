@@ -0,0 +1,108 @@
+#
+# Copyright (c) 2018 Aniket Pandey
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+# OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+# HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+# OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE.
+#
+# $FreeBSD$
+#
+
+setup_trail()
+{
+	bsmlat="$(atf_get_srcdir)/bsmlat -e $(atf_get_srcdir)/input/audit_event"
+	input=$(atf_get_srcdir)/../praudit/input
+	cat ${input}/trail ${input}/trail ${input}/trail > trail
+}
+
+# Append a latency entry to file $1: syscall start $2 and record arrival $3,
+# in nanoseconds since the epoch, each as 8 big-endian bytes
+put_entry()
+{
+	for byte in $(printf '%016x%016x' $2 $3 | sed 's/../& /g'); do
+		printf "\\$(printf '%03o' 0x${byte})"
+	done >> $1
+}
+
+
+atf_test_case bsmlat_percentiles
+bsmlat_percentiles_head()
+{
+	atf_set "descr" "Verify the latency percentiles and the arrival rate " \
+			"computed from the latency file next to the trail"
+}
+
+bsmlat_percentiles_body()
+{
+	setup_trail
+	printf 'BSMLAT1\000' > trail.lat
+	put_entry trail.lat 1000000000 1000010000
+	put_entry trail.lat 1000000000 1000020000
+	put_entry trail.lat 1000000000 1000030000
+	atf_check -o inline:"socket(2) 3 20.0 30.0 30.0 30.0 100000\n" \
+		${bsmlat} trail
+}
+
+
+atf_test_case bsmlat_untimed
+bsmlat_untimed_head()
+{
+	atf_set "descr" "Verify that records of other processes and trails " \
+			"without a latency file are only counted"
+}
+
+bsmlat_untimed_body()
+{
+	setup_trail
+	atf_check -o inline:"socket(2) 3 - - - - -\n" ${bsmlat} trail
+
+	# Only the second record comes from a timed syscall
+	printf 'BSMLAT1\000' > trail.lat
+	put_entry trail.lat 0 1000010000
+	put_entry trail.lat 1000000000 1000020000
+	put_entry trail.lat 0 1000030000
+	atf_check -o inline:"socket(2) 3 20.0 20.0 20.0 20.0 100000\n" \
+		${bsmlat} trail
+}
+
+
+atf_test_case bsmlat_mismatch
+bsmlat_mismatch_head()
+{
+	atf_set "descr" "Verify that a latency file for a different trail " \
+			"is rejected"
+}
+
+bsmlat_mismatch_body()
+{
+	setup_trail
+	printf 'BSMLAT1\000' > short.lat
+	put_entry short.lat 1000000000 1000010000
+	atf_check -s exit:1 -e match:"does not match the 3 records" \
+		${bsmlat} -l short.lat trail
+}
+
+
+atf_init_test_cases()
+{
+	atf_add_test_case bsmlat_percentiles
+	atf_add_test_case bsmlat_untimed
+	atf_add_test_case bsmlat_mismatch
+}
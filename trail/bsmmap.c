@@ -0,0 +1,158 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bsmmap.h"
+
+/*
+ * Map the trail at "path". An empty file maps to an empty trail. Returns
+ * -1 with errno set on failure.
+ */
+int
+bsm_map_open(struct bsm_map *map, const char *path)
+{
+	struct stat sb;
+	void *base;
+	int error;
+
+	map->base = NULL;
+	map->len = 0;
+	map->offsets = NULL;
+	map->nrecords = 0;
+	map->skipped = 0;
+
+	if ((map->fd = open(path, O_RDONLY)) == -1)
+		return (-1);
+	if (fstat(map->fd, &sb) == -1)
+		goto fail;
+	if (!S_ISREG(sb.st_mode)) {
+		errno = EINVAL;
+		goto fail;
+	}
+	if (sb.st_size == 0)
+		return (0);
+	if ((uintmax_t)sb.st_size > SIZE_MAX) {
+		errno = EFBIG;
+		goto fail;
+	}
+
+	map->len = (size_t)sb.st_size;
+	base = mmap(NULL, map->len, PROT_READ, MAP_SHARED, map->fd, 0);
+	if (base == MAP_FAILED)
+		goto fail;
+	map->base = base;
+
+	/* Records are visited front to back, let the kernel read ahead */
+	(void)posix_madvise(base, map->len, POSIX_MADV_SEQUENTIAL);
+	return (0);
+
+fail:
+	error = errno;
+	close(map->fd);
+	map->fd = -1;
+	errno = error;
+	return (-1);
+}
+
+/*
+ * Find the start of every record in one pass over the mapping. A record
+ * counts only if its trailer confirms the length in its header. With
+ * "resync" garbage between records is skipped, otherwise indexing stops
+ * at it and -1 is returned with errno set to EINVAL. Returns -1 with
+ * errno set to ENOMEM if memory runs out.
+ */
+int
+bsm_map_index(struct bsm_map *map, int resync)
+{
+	struct bsm_cursor cur;
+	size_t cap, start, size, *offsets;
+
+	cap = map->len / 128 + 16;
+	if ((map->offsets = malloc(cap * sizeof(size_t))) == NULL)
+		return (-1);
+
+	bsm_cursor_init(&cur, map->base, map->len);
+	while (cur.off < cur.len) {
+		if (!bsm_record_valid(cur.buf + cur.off, cur.len - cur.off)) {
+			if (!resync) {
+				errno = EINVAL;
+				return (-1);
+			}
+			start = cur.off;
+			bsm_resync(&cur);
+			map->skipped += cur.off - start;
+			if (cur.off == cur.len)
+				break;
+		}
+
+		if (map->nrecords == cap) {
+			cap *= 2;
+			offsets = realloc(map->offsets, cap * sizeof(size_t));
+			if (offsets == NULL)
+				return (-1);
+			map->offsets = offsets;
+		}
+		map->offsets[map->nrecords++] = cur.off;
+
+		size = bsm_record_len(cur.buf + cur.off, cur.len - cur.off);
+		cur.off += size;
+	}
+	return (0);
+}
+
+/*
+ * Point "rec" at record number "i" of an indexed trail
+ */
+void
+bsm_map_record(const struct bsm_map *map, size_t i, struct bsm_cursor *rec)
+{
+	size_t off = map->offsets[i];
+
+	bsm_cursor_init(rec, map->base + off,
+	    bsm_record_len(map->base + off, map->len - off));
+}
+
+void
+bsm_map_close(struct bsm_map *map)
+{
+	if (map->base != NULL)
+		munmap((void *)(uintptr_t)map->base, map->len);
+	if (map->fd != -1)
+		close(map->fd);
+	free(map->offsets);
+	map->base = NULL;
+	map->offsets = NULL;
+	map->fd = -1;
+}
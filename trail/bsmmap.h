@@ -0,0 +1,53 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#ifndef _BSMMAP_H_
+#define _BSMMAP_H_
+
+/*
+ * Read-only mapping of a whole trail file. Record boundaries are indexed
+ * once from the header and trailer lengths; records are then handed out as
+ * cursors into the mapping, without copying.
+ */
+
+#include "bsmdec.h"
+
+struct bsm_map {
+	int		 fd;
+	const uint8_t	*base;
+	size_t		 len;
+	size_t		*offsets;	/* Start of each record */
+	size_t		 nrecords;
+	size_t		 skipped;	/* Bytes of garbage between records */
+};
+
+int	bsm_map_open(struct bsm_map *, const char *);
+int	bsm_map_index(struct bsm_map *, int);
+void	bsm_map_record(const struct bsm_map *, size_t, struct bsm_cursor *);
+void	bsm_map_close(struct bsm_map *);
+
+#endif /* _BSMMAP_H_ */
@@ -0,0 +1,218 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bsmout.h"
+
+void
+bsm_out_init(struct bsm_out *out, int fd)
+{
+	memset(out, 0, sizeof(*out));
+	out->fd = fd;
+}
+
+/*
+ * Drop the chunks, along with anything not yet flushed
+ */
+void
+bsm_out_free(struct bsm_out *out)
+{
+	int i;
+
+	for (i = 0; i < BSM_OUT_NCHUNKS; i++)
+		free(out->chunks[i]);
+	bsm_out_init(out, out->fd);
+}
+
+/*
+ * Write every filled chunk with as few writev(2) calls as the descriptor
+ * allows, then start over at the first one
+ */
+int
+bsm_out_flush(struct bsm_out *out)
+{
+	struct iovec *iov = out->iov;
+	ssize_t done;
+	int i, n = out->cur + 1;
+
+	if (out->err) {
+		errno = out->err;
+		return (-1);
+	}
+	while (n > 0) {
+		if ((done = writev(out->fd, iov, n)) == -1) {
+			if (errno == EINTR)
+				continue;
+			out->err = errno;
+			return (-1);
+		}
+		while (n > 0 && (size_t)done >= iov->iov_len) {
+			done -= iov->iov_len;
+			iov++;
+			n--;
+		}
+		if (n > 0) {
+			iov->iov_base = (char *)iov->iov_base + done;
+			iov->iov_len -= done;
+		}
+	}
+
+	for (i = 0; i < BSM_OUT_NCHUNKS; i++) {
+		out->iov[i].iov_base = out->chunks[i];
+		out->iov[i].iov_len = 0;
+	}
+	out->cur = 0;
+	return (0);
+}
+
+/*
+ * Leave the rest of the current chunk unused and move on to the next,
+ * flushing once the last one is done with
+ */
+static void
+next_chunk(struct bsm_out *out)
+{
+	if (out->cur + 1 < BSM_OUT_NCHUNKS)
+		out->cur++;
+	else
+		(void)bsm_out_flush(out);
+}
+
+/*
+ * Where the next byte goes, with the room left after it in "avail". NULL
+ * once an error has stuck.
+ */
+static char *
+next_byte(struct bsm_out *out, size_t *avail)
+{
+	struct iovec *iov;
+
+	if (!out->err && out->iov[out->cur].iov_len == BSM_OUT_CHUNK)
+		next_chunk(out);
+	if (out->err)
+		return (NULL);
+
+	iov = &out->iov[out->cur];
+	if (out->chunks[out->cur] == NULL) {
+		if ((out->chunks[out->cur] = malloc(BSM_OUT_CHUNK)) == NULL) {
+			out->err = ENOMEM;
+			return (NULL);
+		}
+		iov->iov_base = out->chunks[out->cur];
+	}
+	*avail = BSM_OUT_CHUNK - iov->iov_len;
+	return (out->chunks[out->cur] + iov->iov_len);
+}
+
+void
+bsm_out_write(struct bsm_out *out, const void *data, size_t len)
+{
+	const char *src = data;
+	size_t avail, n;
+	char *p;
+
+	while (len > 0 && (p = next_byte(out, &avail)) != NULL) {
+		n = (len < avail) ? len : avail;
+		memcpy(p, src, n);
+		out->iov[out->cur].iov_len += n;
+		src += n;
+		len -= n;
+	}
+}
+
+void
+bsm_out_puts(struct bsm_out *out, const char *str)
+{
+	bsm_out_write(out, str, strlen(str));
+}
+
+void
+bsm_out_putc(struct bsm_out *out, int c)
+{
+	size_t avail;
+	char *p;
+
+	if ((p = next_byte(out, &avail)) != NULL) {
+		*p = (char)c;
+		out->iov[out->cur].iov_len++;
+	}
+}
+
+/*
+ * Format in place. Output that does not fit what is left of the chunk is
+ * formatted again at the start of the next one, rather than staged in a
+ * buffer and copied; only output larger than a whole chunk needs one.
+ */
+void
+bsm_out_printf(struct bsm_out *out, const char *fmt, ...)
+{
+	va_list ap;
+	size_t avail;
+	char *p, *tmp;
+	int n;
+
+	if ((p = next_byte(out, &avail)) == NULL)
+		return;
+	va_start(ap, fmt);
+	n = vsnprintf(p, avail, fmt, ap);
+	va_end(ap);
+	if (n < 0) {
+		out->err = errno;
+		return;
+	}
+	if ((size_t)n < avail) {
+		out->iov[out->cur].iov_len += n;
+		return;
+	}
+
+	if (n < BSM_OUT_CHUNK) {
+		next_chunk(out);
+		if ((p = next_byte(out, &avail)) == NULL)
+			return;
+		va_start(ap, fmt);
+		(void)vsnprintf(p, avail, fmt, ap);
+		va_end(ap);
+		out->iov[out->cur].iov_len += n;
+		return;
+	}
+
+	if ((tmp = malloc((size_t)n + 1)) == NULL) {
+		out->err = ENOMEM;
+		return;
+	}
+	va_start(ap, fmt);
+	(void)vsnprintf(tmp, (size_t)n + 1, fmt, ap);
+	va_end(ap);
+	bsm_out_write(out, tmp, (size_t)n);
+	free(tmp);
+}
@@ -0,0 +1,65 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#ifndef _BSMOUT_H_
+#define _BSMOUT_H_
+
+/*
+ * Buffered output to a file descriptor, used in place of stdio by the
+ * renderers. Output is formatted straight into a small, fixed set of
+ * chunks that are handed to the kernel with a single writev(2) once they
+ * are all full, so memory stays bounded however large the trail is and
+ * no byte is copied twice. As with the encoder, the first write error
+ * sticks in "err" and turns later calls into no-ops.
+ */
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <stddef.h>
+
+#define BSM_OUT_CHUNK		(32 * 1024)
+#define BSM_OUT_NCHUNKS		8
+
+struct bsm_out {
+	int		 fd;
+	char		*chunks[BSM_OUT_NCHUNKS];
+	struct iovec	 iov[BSM_OUT_NCHUNKS];
+	int		 cur;		/* Chunk being filled */
+	int		 err;		/* errno of the first failure */
+};
+
+void	bsm_out_init(struct bsm_out *, int);
+int	bsm_out_flush(struct bsm_out *);
+void	bsm_out_free(struct bsm_out *);
+
+void	bsm_out_write(struct bsm_out *, const void *, size_t);
+void	bsm_out_puts(struct bsm_out *, const char *);
+void	bsm_out_putc(struct bsm_out *, int);
+void	bsm_out_printf(struct bsm_out *, const char *, ...);
+
+#endif /* _BSMOUT_H_ */
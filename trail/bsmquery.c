@@ -0,0 +1,339 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * bsmquery(1) prints the records of a trail matching an event, subject pid,
+ * audit ID and time window. It looks the candidates up in the sidecar index
+ * written by bsmindex(1) and reads only those records.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bsmdec.h"
+#include "bsmfmt.h"
+#include "bsmidx.h"
+
+#define AUDIT_EVENT_FILE	"/etc/security/audit_event"
+
+struct query {
+	int		 event;		/* -1 for any */
+	int64_t		 pid;
+	int64_t		 auid;
+	uint64_t	 from;
+	uint64_t	 to;
+};
+
+static const char *del = ",";
+static struct bsm_out out;
+static int flags;
+
+static uint8_t *recbuf;
+static size_t recsize;
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: bsmquery [-l] [-j | -x] [-r | -s] [-d del] "
+	    "[-e audit_event] [-i index]\n"
+	    "                [-E event] [-p pid] [-u auid] [-t from] [-T to] "
+	    "trail\n");
+	exit(1);
+}
+
+/*
+ * Seconds since the Epoch, or local time as "YYYY-MM-DD HH:MM[:SS]"
+ */
+static uint64_t
+parse_time(const char *str)
+{
+	struct tm tm;
+	char *end;
+	uint64_t sec;
+	time_t t;
+
+	sec = strtoull(str, &end, 10);
+	if (*str != '\0' && *end == '\0')
+		return (sec);
+
+	memset(&tm, 0, sizeof(tm));
+	if (sscanf(str, "%d-%d-%d%*[ T]%d:%d:%d", &tm.tm_year, &tm.tm_mon,
+	    &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec) < 5)
+		errx(1, "%s: invalid time", str);
+	tm.tm_year -= 1900;
+	tm.tm_mon -= 1;
+	tm.tm_isdst = -1;
+	if ((t = mktime(&tm)) == -1)
+		errx(1, "%s: invalid time", str);
+	return ((uint64_t)t);
+}
+
+static int64_t
+parse_id(const char *str)
+{
+	char *end;
+	unsigned long id;
+
+	id = strtoul(str, &end, 10);
+	if (*str == '\0' || *end != '\0' || id > UINT32_MAX)
+		errx(1, "%s: invalid ID", str);
+	return ((int64_t)id);
+}
+
+/*
+ * Read the record at "off" into the record buffer. Returns its length, 0
+ * if there is no valid record at "off".
+ */
+static size_t
+read_record(int fd, uint64_t off)
+{
+	uint8_t hdr[5];
+	size_t size;
+	ssize_t n;
+
+	if (pread(fd, hdr, sizeof(hdr), (off_t)off) != sizeof(hdr))
+		return (0);
+	size = bsm_record_len(hdr, sizeof(hdr));
+	if (size < BSM_HEADER32_LEN)
+		return (0);
+
+	if (size > recsize) {
+		free(recbuf);
+		if ((recbuf = malloc(size)) == NULL)
+			err(1, "malloc");
+		recsize = size;
+	}
+	n = pread(fd, recbuf, size, (off_t)off);
+	if (n < 0 || (size_t)n != size || !bsm_record_valid(recbuf, size))
+		return (0);
+	return (size);
+}
+
+/*
+ * The index only narrows the search, every candidate is checked in full
+ */
+static int
+match_record(const struct query *q, const uint8_t *buf, size_t len)
+{
+	struct bsm_cursor rec;
+	struct bsm_token tok;
+	int header = 0, subject = 0;
+
+	bsm_cursor_init(&rec, buf, len);
+	while (bsm_next_token(&rec, &tok) == BSM_OK) {
+		if (bsm_is_header(tok.id) && !header++) {
+			if ((q->event != -1 && tok.tt.hdr.event != q->event) ||
+			    tok.tt.hdr.sec < q->from || tok.tt.hdr.sec > q->to)
+				return (0);
+		}
+		switch (tok.id) {
+		case BSM_SUBJECT32:
+		case BSM_SUBJECT64:
+		case BSM_SUBJECT32_EX:
+		case BSM_SUBJECT64_EX:
+			if (subject++)
+				break;
+			if ((q->pid != -1 && tok.tt.subj.pid != q->pid) ||
+			    (q->auid != -1 && tok.tt.subj.auid != q->auid))
+				return (0);
+			break;
+		}
+	}
+	return (header && (subject || (q->pid == -1 && q->auid == -1)));
+}
+
+static void
+print_match(const struct query *q, size_t len)
+{
+	struct bsm_cursor rec;
+
+	if (len == 0 || !match_record(q, recbuf, len))
+		return;
+	bsm_cursor_init(&rec, recbuf, len);
+	bsm_print_record(&out, &rec, del, flags);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *eventfile = AUDIT_EVENT_FILE, *event = NULL;
+	const uint8_t *posts, *best = NULL;
+	char *idxpath = NULL, *path = NULL;
+	struct query q = { -1, -1, -1, 0, UINT64_MAX };
+	struct bsm_idx idx;
+	struct stat sb;
+	uint64_t lo = 0, hi = 0, n, nbest = 0, i, off;
+	size_t len;
+	int ch, fd, keyed = 0;
+
+	while ((ch = getopt(argc, argv, "d:E:e:i:jlp:rsT:t:u:x")) != -1) {
+		switch (ch) {
+		case 'd':
+			del = optarg;
+			break;
+		case 'E':
+			event = optarg;
+			break;
+		case 'e':
+			eventfile = optarg;
+			break;
+		case 'i':
+			idxpath = optarg;
+			break;
+		case 'j':
+			if (flags & BSM_FMT_XML)
+				usage();
+			flags |= BSM_FMT_JSON;
+			break;
+		case 'l':
+			flags |= BSM_FMT_ONELINE;
+			break;
+		case 'p':
+			q.pid = parse_id(optarg);
+			break;
+		case 'r':
+			if (flags & BSM_FMT_SHORT)
+				usage();
+			flags |= BSM_FMT_RAW;
+			break;
+		case 's':
+			if (flags & BSM_FMT_RAW)
+				usage();
+			flags |= BSM_FMT_SHORT;
+			break;
+		case 'T':
+			q.to = parse_time(optarg);
+			break;
+		case 't':
+			q.from = parse_time(optarg);
+			break;
+		case 'u':
+			q.auid = parse_id(optarg);
+			break;
+		case 'x':
+			if (flags & BSM_FMT_JSON)
+				usage();
+			flags |= BSM_FMT_XML;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 1)
+		usage();
+
+	(void)bsm_load_events(eventfile);
+	if (event != NULL && (q.event = bsm_event_number(event)) == -1)
+		errx(1, "%s: unknown event", event);
+
+	if (idxpath == NULL) {
+		n = strlen(argv[0]) + sizeof(BSM_IDX_SUFFIX);
+		if ((path = malloc(n)) == NULL)
+			err(1, "malloc");
+		snprintf(path, n, "%s%s", argv[0], BSM_IDX_SUFFIX);
+		idxpath = path;
+	}
+	if ((fd = open(argv[0], O_RDONLY)) == -1 || fstat(fd, &sb) == -1)
+		err(1, "%s", argv[0]);
+	if (bsm_idx_open(&idx, idxpath) == -1)
+		err(1, "%s", idxpath);
+	if (idx.trailsize != (uint64_t)sb.st_size)
+		errx(1, "%s: stale index, run bsmindex again", idxpath);
+
+	/* Nothing in the time window means nothing to print */
+	if (!bsm_idx_time_range(&idx, q.from, q.to, &lo, &hi))
+		goto out;
+
+	/* Walk the shortest posting list, the others are checked per record */
+	if (q.event != -1) {
+		nbest = bsm_idx_postings(&idx, BSM_IDX_EVENT,
+		    (uint64_t)q.event, &best);
+		keyed = 1;
+	}
+	if (q.pid != -1) {
+		n = bsm_idx_postings(&idx, BSM_IDX_PID, (uint64_t)q.pid,
+		    &posts);
+		if (!keyed || n < nbest) {
+			nbest = n;
+			best = posts;
+		}
+		keyed = 1;
+	}
+	if (q.auid != -1) {
+		n = bsm_idx_postings(&idx, BSM_IDX_AUID, (uint64_t)q.auid,
+		    &posts);
+		if (!keyed || n < nbest) {
+			nbest = n;
+			best = posts;
+		}
+		keyed = 1;
+	}
+
+	bsm_out_init(&out, STDOUT_FILENO);
+	if (flags & BSM_FMT_XML)
+		bsm_print_xml_header(&out);
+
+	if (keyed) {
+		for (i = 0; i < nbest; i++) {
+			off = bsm_idx_offset(best, i);
+			if (off < lo || off >= hi)
+				continue;
+			print_match(&q, read_record(fd, off));
+		}
+	} else {
+		/* Only a time window, read every record within its range */
+		for (off = lo; off < hi; off += len) {
+			if ((len = read_record(fd, off)) == 0)
+				break;
+			print_match(&q, len);
+		}
+	}
+
+	if (flags & BSM_FMT_XML)
+		bsm_print_xml_footer(&out);
+	if (bsm_out_flush(&out) == -1)
+		err(1, "stdout");
+	bsm_out_free(&out);
+
+out:
+	bsm_idx_close(&idx);
+	close(fd);
+	free(recbuf);
+	free(path);
+	return (0);
+}
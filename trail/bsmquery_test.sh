@@ -0,0 +1,164 @@
+#
+# Copyright (c) 2018 Aniket Pandey
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+# OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+# HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+# OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE.
+#
+# $FreeBSD$
+#
+
+# Two socket(2) records, the second from pid 1 an hour later. Records are
+# printed in the raw form, which does not depend on the host's user names
+# or time zone.
+rec1="20,113,11,183,0,1528712325,380,45,1,0x1c,domain,45,2,0x2,type,45,3,0x0,protocol,36,0,0,0,0,0,7053,4724,37636,10.0.2.2,39,0,3,19,113,"
+rec2="20,113,11,183,0,1528715925,380,45,1,0x1c,domain,45,2,0x2,type,45,3,0x0,protocol,36,0,0,0,0,0,1,4724,37636,10.0.2.2,39,0,3,19,113,"
+
+setup_trail()
+{
+	bsmindex="$(atf_get_srcdir)/bsmindex"
+	bsmquery="$(atf_get_srcdir)/bsmquery -rl -e $(atf_get_srcdir)/input/audit_event"
+	input=$(atf_get_srcdir)/../praudit/input
+
+	cp ${input}/trail second
+	# pid, then seconds of the header timestamp
+	printf '\000\000\000\001' | \
+		dd of=second bs=1 seek=84 conv=notrunc 2>/dev/null
+	printf '\133\036\132\225' | \
+		dd of=second bs=1 seek=10 conv=notrunc 2>/dev/null
+	cat ${input}/trail second > trail
+	atf_check ${bsmindex} trail
+}
+
+
+atf_test_case bsmquery_pid
+bsmquery_pid_head()
+{
+	atf_set "descr" "Verify that only the records of the given pid " \
+			"are printed"
+}
+
+bsmquery_pid_body()
+{
+	setup_trail
+	atf_check -o inline:"${rec1}\n" ${bsmquery} -p 7053 trail
+	atf_check -o inline:"${rec2}\n" ${bsmquery} -p 1 trail
+	atf_check ${bsmquery} -p 2 trail
+}
+
+
+atf_test_case bsmquery_event
+bsmquery_event_head()
+{
+	atf_set "descr" "Verify that records are looked up by event number, " \
+			"name or description"
+}
+
+bsmquery_event_body()
+{
+	setup_trail
+	atf_check -o inline:"${rec1}\n${rec2}\n" ${bsmquery} -E 183 trail
+	atf_check -o inline:"${rec1}\n${rec2}\n" ${bsmquery} -E AUE_SOCKET trail
+	atf_check -o inline:"${rec1}\n${rec2}\n" \
+		${bsmquery} -E "socket(2)" -u 0 trail
+	atf_check -s exit:1 -e match:"unknown event" \
+		${bsmquery} -E AUE_NONE trail
+}
+
+
+atf_test_case bsmquery_time
+bsmquery_time_head()
+{
+	atf_set "descr" "Verify that -t and -T select records by time, " \
+			"alone and together with other keys"
+}
+
+bsmquery_time_body()
+{
+	setup_trail
+	atf_check -o inline:"${rec1}\n" ${bsmquery} -T 1528712400 trail
+	atf_check -o inline:"${rec2}\n" ${bsmquery} -t 1528712400 trail
+	atf_check -o inline:"${rec2}\n" \
+		${bsmquery} -t 1528715925 -T 1528715925 -E 183 trail
+	atf_check ${bsmquery} -t 1528712326 -T 1528715924 trail
+}
+
+
+atf_test_case bsmquery_json
+bsmquery_json_head()
+{
+	atf_set "descr" "Verify that matches are printed one JSON object " \
+			"per line with -j"
+}
+
+bsmquery_json_body()
+{
+	setup_trail
+	${bsmquery} -j -E 183 trail > json || atf_fail "bsmquery failed"
+	atf_check -o match:"^ *2\$" -x "wc -l < json"
+	atf_check -o match:'^{"token":"record",.*"pid":"1",.*]}$' \
+		${bsmquery} -j -p 1 trail
+}
+
+
+atf_test_case bsmquery_stale_index
+bsmquery_stale_index_head()
+{
+	atf_set "descr" "Verify that an index not matching the trail is " \
+			"refused"
+}
+
+bsmquery_stale_index_body()
+{
+	setup_trail
+	cat second >> trail
+	atf_check -s exit:1 -e match:"stale index" ${bsmquery} -p 1 trail
+	atf_check ${bsmindex} trail
+	atf_check -o inline:"${rec2}\n${rec2}\n" ${bsmquery} -p 1 trail
+}
+
+
+atf_test_case bsmquery_no_index
+bsmquery_no_index_head()
+{
+	atf_set "descr" "Verify that bsmquery fails without an index and " \
+			"that bsmindex refuses a corrupted trail"
+}
+
+bsmquery_no_index_body()
+{
+	setup_trail
+	rm trail.idx
+	atf_check -s exit:1 -e match:"trail.idx" ${bsmquery} -p 1 trail
+	cp ${input}/corrupted corrupted
+	atf_check -s exit:1 -e match:"corrupted record" ${bsmindex} corrupted
+	atf_check ${bsmindex} -p corrupted
+}
+
+
+atf_init_test_cases()
+{
+	atf_add_test_case bsmquery_pid
+	atf_add_test_case bsmquery_event
+	atf_add_test_case bsmquery_time
+	atf_add_test_case bsmquery_json
+	atf_add_test_case bsmquery_stale_index
+	atf_add_test_case bsmquery_no_index
+}
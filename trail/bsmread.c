@@ -0,0 +1,137 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bsmdec.h"
+
+void
+bsm_reader_init(struct bsm_reader *rd, int fd, void *buf, size_t size)
+{
+	rd->fd = fd;
+	rd->buf = buf;
+	rd->size = size;
+	rd->off = 0;
+	rd->len = 0;
+	rd->eof = 0;
+}
+
+/*
+ * Move the unconsumed bytes to the front of the buffer and read as much as
+ * fits behind them. Returns the number of bytes read, 0 at end-of-file.
+ */
+static ssize_t
+fill(struct bsm_reader *rd)
+{
+	ssize_t n;
+
+	if (rd->off > 0) {
+		memmove(rd->buf, rd->buf + rd->off, rd->len - rd->off);
+		rd->len -= rd->off;
+		rd->off = 0;
+	}
+
+	do {
+		n = read(rd->fd, rd->buf + rd->len, rd->size - rd->len);
+	} while (n == -1 && errno == EINTR);
+
+	if (n == 0)
+		rd->eof = 1;
+	if (n > 0)
+		rd->len += (size_t)n;
+	return (n);
+}
+
+/*
+ * Point "rec" at the next complete record. The record stays valid until
+ * the next call on the reader. Returns BSM_END at a clean end-of-file and
+ * BSM_ERROR on garbage, a truncated record or a read(2) failure.
+ */
+int
+bsm_read_record(struct bsm_reader *rd, struct bsm_cursor *rec)
+{
+	size_t avail, size;
+
+	for (;;) {
+		avail = rd->len - rd->off;
+		if (avail >= 5) {
+			size = bsm_record_len(rd->buf + rd->off, avail);
+			if (size < BSM_HEADER32_LEN || size > rd->size)
+				return (BSM_ERROR);
+			if (avail >= size) {
+				bsm_cursor_init(rec, rd->buf + rd->off, size);
+				rd->off += size;
+				return (BSM_OK);
+			}
+		}
+
+		if (rd->eof)
+			return (avail == 0 ? BSM_END : BSM_ERROR);
+		if (fill(rd) == -1)
+			return (BSM_ERROR);
+	}
+}
+
+/*
+ * Skip garbage up to the next valid record, reading more input as needed.
+ * A candidate header near the end of the buffer is kept, since its record
+ * may only be confirmed once the rest of it has been read.
+ */
+int
+bsm_reader_resync(struct bsm_reader *rd)
+{
+	struct bsm_cursor cur;
+	size_t keep, size;
+
+	for (;;) {
+		bsm_cursor_init(&cur, rd->buf + rd->off, rd->len - rd->off);
+		if (bsm_resync(&cur) == BSM_OK) {
+			rd->off += cur.off;
+			return (BSM_OK);
+		}
+		if (rd->eof) {
+			rd->off = rd->len;
+			return (BSM_END);
+		}
+
+		for (keep = rd->off; keep < rd->len; keep++) {
+			size = bsm_record_len(rd->buf + keep, rd->len - keep);
+			if (rd->len - keep < 5 || (size > rd->len - keep &&
+			    size <= rd->size))
+				break;
+		}
+
+		/* A full buffer without a record start cannot make progress */
+		if (keep == rd->off && rd->len - rd->off == rd->size)
+			keep++;
+		rd->off = keep;
+		if (fill(rd) == -1)
+			return (BSM_ERROR);
+	}
+}
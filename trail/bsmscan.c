@@ -0,0 +1,400 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bsmscan.h"
+
+#if defined(BSM_SIMD_AVX2)
+#include <immintrin.h>
+#elif defined(BSM_SIMD_SSE2)
+#include <emmintrin.h>
+#endif
+
+struct chunk {
+	pthread_t	 thread;
+	const uint8_t	*buf;
+	size_t		 len;
+	size_t		 start;		/* Records starting in [start, end) */
+	size_t		 end;
+	size_t		 first;		/* Where the chunk synchronised */
+	size_t		 next;		/* First record after the chunk */
+	bsm_pred_t	 pred;
+	void		*arg;
+	struct bsm_scan	 res;
+	int		 error;
+};
+
+static int
+add_match(struct bsm_scan *res, size_t off, size_t *cap)
+{
+	size_t *matches;
+
+	if (res->nmatches == *cap) {
+		*cap = (*cap == 0) ? 256 : *cap * 2;
+		matches = realloc(res->matches, *cap * sizeof(size_t));
+		if (matches == NULL)
+			return (ENOMEM);
+		res->matches = matches;
+	}
+	res->matches[res->nmatches++] = off;
+	return (0);
+}
+
+/*
+ * Test every record starting between "from" and the end of the chunk
+ */
+static int
+scan_records(struct chunk *ch, size_t from)
+{
+	struct bsm_cursor cur, rec;
+	size_t cap = ch->res.nmatches, size, skip;
+
+	bsm_cursor_init(&cur, ch->buf, ch->len);
+	cur.off = from;
+	while (cur.off < ch->end) {
+		if (!bsm_record_valid(cur.buf + cur.off, cur.len - cur.off)) {
+			skip = cur.off;
+			bsm_resync(&cur);
+			ch->res.skipped += cur.off - skip;
+			continue;
+		}
+
+		size = bsm_record_len(cur.buf + cur.off, cur.len - cur.off);
+		bsm_cursor_init(&rec, cur.buf + cur.off, size);
+		ch->res.nrecords++;
+		if (ch->pred(&rec, ch->arg) &&
+		    add_match(&ch->res, cur.off, &cap) != 0)
+			return (ENOMEM);
+		cur.off += size;
+	}
+	ch->next = cur.off;
+	return (0);
+}
+
+static void *
+scan_chunk(void *arg)
+{
+	struct chunk *ch = arg;
+	struct bsm_cursor cur;
+
+	/* The bytes before the first record belong to the previous chunk */
+	bsm_cursor_init(&cur, ch->buf, ch->len);
+	cur.off = ch->start;
+	if (ch->start > 0)
+		bsm_resync(&cur);
+	ch->first = cur.off;
+	ch->error = scan_records(ch, ch->first);
+	return (NULL);
+}
+
+/*
+ * Run "pred" over every record of "buf" with "nthreads" threads. Wanted
+ * records are reported in trail order, as if scanned by a single thread.
+ * Returns 0, or an errno value if a thread could not be started or memory
+ * ran out.
+ */
+int
+bsm_scan(const uint8_t *buf, size_t len, int nthreads, bsm_pred_t pred,
+    void *arg, struct bsm_scan *res)
+{
+	struct chunk *chunks, *ch;
+	size_t cap, i, n, size;
+	int error = 0, started;
+
+	memset(res, 0, sizeof(*res));
+	if (nthreads < 1)
+		nthreads = 1;
+	/* Not worth a thread for less than a megabyte */
+	if ((size_t)nthreads > len / (1024 * 1024) + 1)
+		nthreads = (int)(len / (1024 * 1024)) + 1;
+	n = (size_t)nthreads;
+
+	if ((chunks = calloc(n, sizeof(*chunks))) == NULL)
+		return (ENOMEM);
+	for (i = 0; i < n; i++) {
+		ch = &chunks[i];
+		ch->buf = buf;
+		ch->len = len;
+		ch->start = len / n * i;
+		ch->end = (i == n - 1) ? len : len / n * (i + 1);
+		ch->pred = pred;
+		ch->arg = arg;
+	}
+
+	/* The first chunk is scanned by the calling thread */
+	for (started = 1; started < nthreads; started++) {
+		error = pthread_create(&chunks[started].thread, NULL,
+		    scan_chunk, &chunks[started]);
+		if (error != 0)
+			break;
+	}
+	scan_chunk(&chunks[0]);
+	for (i = 1; i < (size_t)started; i++)
+		pthread_join(chunks[i].thread, NULL);
+	if (error != 0)
+		goto out;
+
+	/*
+	 * A chunk may have synchronised on bytes inside a record that the
+	 * previous chunk ran into, or on garbage that merely looked valid.
+	 * Then its records do not continue where the previous chunk stopped
+	 * and it is scanned again from there.
+	 */
+	for (i = 1; i < n; i++) {
+		ch = &chunks[i];
+		if (ch->first == chunks[i - 1].next || ch->error != 0)
+			continue;
+		free(ch->res.matches);
+		memset(&ch->res, 0, sizeof(ch->res));
+		ch->first = chunks[i - 1].next;
+		ch->error = scan_records(ch, ch->first);
+	}
+
+	for (i = 0, cap = 0; i < n; i++) {
+		if ((error = chunks[i].error) != 0)
+			goto out;
+		cap += chunks[i].res.nmatches;
+	}
+	if (cap > 0 && (res->matches = malloc(cap * sizeof(size_t))) == NULL) {
+		error = ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < n; i++) {
+		ch = &chunks[i];
+		size = ch->res.nmatches * sizeof(size_t);
+		if (size > 0)
+			memcpy(res->matches + res->nmatches, ch->res.matches,
+			    size);
+		res->nmatches += ch->res.nmatches;
+		res->nrecords += ch->res.nrecords;
+		res->skipped += ch->res.skipped;
+	}
+
+out:
+	for (i = 0; i < n; i++)
+		free(chunks[i].res.matches);
+	free(chunks);
+	if (error != 0)
+		bsm_scan_free(res);
+	return (error);
+}
+
+/*
+ * The first byte from "p" on starting the id and magic number of a trailer
+ * token, "end" if there is none. The vector loops compare the id, and the
+ * two bytes of the magic number, at 32 or 16 offsets at once.
+ */
+static const uint8_t *
+find_trailer(const uint8_t *p, const uint8_t *end)
+{
+#if defined(BSM_SIMD_AVX2)
+	const __m256i id = _mm256_set1_epi8(BSM_TRAILER);
+	const __m256i hi = _mm256_set1_epi8((char)(BSM_TRAILER_MAGIC >> 8));
+	const __m256i lo = _mm256_set1_epi8(BSM_TRAILER_MAGIC & 0xff);
+	__m256i m;
+	unsigned int mask;
+
+	for (; end - p >= 32 + 2; p += 32) {
+		m = _mm256_and_si256(_mm256_and_si256(
+		    _mm256_cmpeq_epi8(_mm256_loadu_si256((const void *)p), id),
+		    _mm256_cmpeq_epi8(_mm256_loadu_si256((const void *)(p + 1)),
+		    hi)),
+		    _mm256_cmpeq_epi8(_mm256_loadu_si256((const void *)(p + 2)),
+		    lo));
+		if ((mask = (unsigned int)_mm256_movemask_epi8(m)) != 0)
+			return (p + __builtin_ctz(mask));
+	}
+#elif defined(BSM_SIMD_SSE2)
+	const __m128i id = _mm_set1_epi8(BSM_TRAILER);
+	const __m128i hi = _mm_set1_epi8((char)(BSM_TRAILER_MAGIC >> 8));
+	const __m128i lo = _mm_set1_epi8(BSM_TRAILER_MAGIC & 0xff);
+	__m128i m;
+	unsigned int mask;
+
+	for (; end - p >= 16 + 2; p += 16) {
+		m = _mm_and_si128(_mm_and_si128(
+		    _mm_cmpeq_epi8(_mm_loadu_si128((const void *)p), id),
+		    _mm_cmpeq_epi8(_mm_loadu_si128((const void *)(p + 1)), hi)),
+		    _mm_cmpeq_epi8(_mm_loadu_si128((const void *)(p + 2)), lo));
+		if ((mask = (unsigned int)_mm_movemask_epi8(m)) != 0)
+			return (p + __builtin_ctz(mask));
+	}
+#endif
+	while (end - p > 2 &&
+	    (p = memchr(p, BSM_TRAILER, (size_t)(end - p) - 2)) != NULL) {
+		if ((p[1] << 8 | p[2]) == BSM_TRAILER_MAGIC)
+			return (p);
+		p++;
+	}
+	return (end);
+}
+
+/*
+ * Collect the start of every valid record whose trailer begins in the
+ * chunk, in the order of the trailers
+ */
+static void *
+find_chunk(void *arg)
+{
+	struct chunk *ch = arg;
+	const uint8_t *p, *lim;
+	size_t cap = 0, size, t;
+
+	lim = ch->buf + (ch->len - ch->end < 2 ? ch->len : ch->end + 2);
+	for (p = ch->buf + ch->start; (p = find_trailer(p, lim)) < lim; p++) {
+		t = (size_t)(p - ch->buf);
+		if (t >= ch->end)
+			break;
+		if (ch->len - t < BSM_TRAILER_LEN)
+			continue;
+		size = (size_t)p[3] << 24 | (size_t)p[4] << 16 |
+		    (size_t)p[5] << 8 | p[6];
+		if (size < BSM_HEADER32_LEN + BSM_TRAILER_LEN ||
+		    size > t + BSM_TRAILER_LEN)
+			continue;
+		t = t + BSM_TRAILER_LEN - size;
+		if (bsm_record_len(ch->buf + t, ch->len - t) != size ||
+		    !bsm_record_valid(ch->buf + t, ch->len - t))
+			continue;
+		if (add_match(&ch->res, t, &cap) != 0) {
+			ch->error = ENOMEM;
+			break;
+		}
+	}
+	return (NULL);
+}
+
+/*
+ * Find the offset of every record of "buf" with "nthreads" threads, the
+ * same records a single thread walking the trail record by record would
+ * find. Only the offsets of the trailer tokens are searched for, and a
+ * record checked where its trailer says it starts.
+ * Returns 0, or an errno value as bsm_scan() does.
+ */
+int
+bsm_find_records(const uint8_t *buf, size_t len, int nthreads,
+    struct bsm_scan *res)
+{
+	struct chunk *chunks, *ch;
+	size_t cap, end, i, j, k, n, off, size, top, used;
+	int error = 0, started;
+
+	memset(res, 0, sizeof(*res));
+	if (nthreads < 1)
+		nthreads = 1;
+	if ((size_t)nthreads > len / (1024 * 1024) + 1)
+		nthreads = (int)(len / (1024 * 1024)) + 1;
+	n = (size_t)nthreads;
+
+	if ((chunks = calloc(n, sizeof(*chunks))) == NULL)
+		return (ENOMEM);
+	for (i = 0; i < n; i++) {
+		ch = &chunks[i];
+		ch->buf = buf;
+		ch->len = len;
+		ch->start = len / n * i;
+		ch->end = (i == n - 1) ? len : len / n * (i + 1);
+	}
+
+	for (started = 1; started < nthreads; started++) {
+		error = pthread_create(&chunks[started].thread, NULL,
+		    find_chunk, &chunks[started]);
+		if (error != 0)
+			break;
+	}
+	find_chunk(&chunks[0]);
+	for (i = 1; i < (size_t)started; i++)
+		pthread_join(chunks[i].thread, NULL);
+	if (error != 0)
+		goto out;
+
+	for (i = 0, cap = 0; i < n; i++) {
+		if ((error = chunks[i].error) != 0)
+			goto out;
+		cap += chunks[i].res.nmatches;
+	}
+	if (cap > 0 && (res->matches = malloc(cap * sizeof(size_t))) == NULL) {
+		error = ENOMEM;
+		goto out;
+	}
+
+	/*
+	 * Records may be nested in others, e.g. in a text token, or overlap
+	 * garbage that happens to look valid. A walker takes the record
+	 * starting first and skips everything inside it. The records are
+	 * taken in the order they end, so one starting before the records
+	 * last taken contains them and replaces them, unless it starts
+	 * inside the record taken before those.
+	 */
+	for (i = 0, used = 0, end = 0; i < n; i++) {
+		ch = &chunks[i];
+		for (j = 0; j < ch->res.nmatches; j++) {
+			off = ch->res.matches[j];
+			size = bsm_record_len(buf + off, len - off);
+			if (off < end) {
+				for (k = res->nmatches; k > 0 &&
+				    res->matches[k - 1] >= off; k--)
+					;
+				if (k == res->nmatches)
+					continue;
+				top = (k > 0) ? res->matches[k - 1] : 0;
+				if (k > 0 && top +
+				    bsm_record_len(buf + top, len - top) > off)
+					continue;
+				for (; res->nmatches > k; res->nmatches--) {
+					top = res->matches[res->nmatches - 1];
+					used -= bsm_record_len(buf + top,
+					    len - top);
+				}
+			}
+			res->matches[res->nmatches++] = off;
+			used += size;
+			end = off + size;
+		}
+	}
+	res->nrecords = res->nmatches;
+	res->skipped = len - used;
+
+out:
+	for (i = 0; i < n; i++)
+		free(chunks[i].res.matches);
+	free(chunks);
+	if (error != 0)
+		bsm_scan_free(res);
+	return (error);
+}
+
+void
+bsm_scan_free(struct bsm_scan *res)
+{
+	free(res->matches);
+	memset(res, 0, sizeof(*res));
+}
@@ -0,0 +1,61 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#ifndef _BSMSCAN_H_
+#define _BSMSCAN_H_
+
+/*
+ * Parallel scan of an in-memory trail. The trail is cut into one chunk per
+ * thread; each thread resynchronises on the first valid record of its
+ * chunk and tests every record starting in it against a predicate.
+ *
+ * bsm_find_records() only locates the records, searching for trailer
+ * tokens rather than walking the tokens, which is cheap enough to be done
+ * before handing the records out to be decoded in parallel.
+ */
+
+#include "bsmdec.h"
+
+/*
+ * Called from several threads at once, so it must not modify "arg".
+ * Returns non-zero if the record is wanted.
+ */
+typedef int	(*bsm_pred_t)(struct bsm_cursor *, void *);
+
+struct bsm_scan {
+	size_t		*matches;	/* Offsets of wanted records, in order */
+	size_t		 nmatches;
+	size_t		 nrecords;
+	size_t		 skipped;	/* Bytes of garbage between records */
+};
+
+int	bsm_scan(const uint8_t *, size_t, int, bsm_pred_t, void *,
+	    struct bsm_scan *);
+int	bsm_find_records(const uint8_t *, size_t, int, struct bsm_scan *);
+void	bsm_scan_free(struct bsm_scan *);
+
+#endif /* _BSMSCAN_H_ */
@@ -0,0 +1,264 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#include <atf-c.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bsmscan.h"
+
+/*
+ * A 113 byte socket(2) record and a 31 byte record without arguments
+ */
+static const unsigned char socketrec[] = {
+	0x14, 0x00, 0x00, 0x00, 0x71, 0x0b, 0x00, 0xb7, 0x00, 0x00, 0x5b, 0x1e,
+	0x4c, 0x85, 0x00, 0x00, 0x01, 0x7c, 0x2d, 0x01, 0x00, 0x00, 0x00, 0x1c,
+	0x00, 0x07, 0x64, 0x6f, 0x6d, 0x61, 0x69, 0x6e, 0x00, 0x2d, 0x02, 0x00,
+	0x00, 0x00, 0x02, 0x00, 0x05, 0x74, 0x79, 0x70, 0x65, 0x00, 0x2d, 0x03,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x70, 0x72, 0x6f, 0x74, 0x6f, 0x63,
+	0x6f, 0x6c, 0x00, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x1b, 0x8d, 0x00, 0x00, 0x12, 0x74, 0x00, 0x00, 0x93, 0x04,
+	0x0a, 0x00, 0x02, 0x02, 0x27, 0x00, 0x00, 0x00, 0x00, 0x03, 0x13, 0xb1,
+	0x05, 0x00, 0x00, 0x00, 0x71
+};
+
+static const unsigned char shortrec[] = {
+	0x14, 0x00, 0x00, 0x00, 0x1f, 0x0b, 0x00, 0x01, 0x00, 0x00, 0x5b, 0x1e,
+	0x4c, 0x85, 0x00, 0x00, 0x01, 0x7c, 0x27, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x13, 0xb1, 0x05, 0x00, 0x00, 0x00, 0x1f
+};
+
+#define TRAIL_SIZE	(8 * 1024 * 1024)
+
+static unsigned char *trail;
+static size_t traillen;
+static unsigned long seed;
+
+/* The same sequence everywhere, unlike random(3) */
+static unsigned long
+next_random(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return ((seed >> 16) & 0x7fff);
+}
+
+static int
+is_any(struct bsm_cursor *rec, void *arg)
+{
+	(void)rec;
+	(void)arg;
+	return (1);
+}
+
+static int
+is_socket(struct bsm_cursor *rec, void *arg)
+{
+	(void)arg;
+	return (rec->len == sizeof(socketrec));
+}
+
+/*
+ * Fill the trail with both records in a pseudo-random order, so chunk
+ * boundaries fall at every possible position inside a record. With
+ * "garbage", random bytes are mixed in between some records.
+ */
+static void
+build_trail(int garbage)
+{
+	size_t i;
+
+	trail = malloc(TRAIL_SIZE);
+	ATF_REQUIRE(trail != NULL);
+	seed = 1;
+	traillen = 0;
+	while (traillen + sizeof(socketrec) + 64 < TRAIL_SIZE) {
+		if (next_random() % 3 == 0) {
+			memcpy(trail + traillen, shortrec, sizeof(shortrec));
+			traillen += sizeof(shortrec);
+		} else {
+			memcpy(trail + traillen, socketrec, sizeof(socketrec));
+			traillen += sizeof(socketrec);
+		}
+		if (garbage && next_random() % 1000 == 0) {
+			for (i = next_random() % 64; i > 0; i--)
+				trail[traillen++] = (unsigned char)next_random();
+		}
+	}
+}
+
+/*
+ * Scan with 1 to 8 threads and require the single-threaded result each time
+ */
+static void
+check_threads(int garbage)
+{
+	struct bsm_scan serial, scan;
+	int nthreads;
+
+	ATF_REQUIRE_EQ(0, bsm_scan(trail, traillen, 1, is_socket, NULL,
+	    &serial));
+	ATF_REQUIRE(serial.nmatches > 0);
+	ATF_REQUIRE(serial.nmatches < serial.nrecords);
+	ATF_REQUIRE_EQ(garbage != 0, serial.skipped > 0);
+
+	for (nthreads = 2; nthreads <= 8; nthreads++) {
+		ATF_REQUIRE_EQ(0, bsm_scan(trail, traillen, nthreads,
+		    is_socket, NULL, &scan));
+		ATF_REQUIRE_EQ(serial.nrecords, scan.nrecords);
+		ATF_REQUIRE_EQ(serial.skipped, scan.skipped);
+		ATF_REQUIRE_EQ(serial.nmatches, scan.nmatches);
+		ATF_REQUIRE(memcmp(serial.matches, scan.matches,
+		    serial.nmatches * sizeof(size_t)) == 0);
+		bsm_scan_free(&scan);
+	}
+	bsm_scan_free(&serial);
+	free(trail);
+}
+
+/*
+ * Search for the records with 1 to 8 threads and require the records a
+ * single-threaded walk finds each time
+ */
+static void
+check_bounds(void)
+{
+	struct bsm_scan serial, scan;
+	int nthreads;
+
+	ATF_REQUIRE_EQ(0, bsm_scan(trail, traillen, 1, is_any, NULL,
+	    &serial));
+	ATF_REQUIRE(serial.nrecords > 0);
+
+	for (nthreads = 1; nthreads <= 8; nthreads++) {
+		ATF_REQUIRE_EQ(0, bsm_find_records(trail, traillen, nthreads,
+		    &scan));
+		ATF_REQUIRE_EQ(serial.nrecords, scan.nrecords);
+		ATF_REQUIRE_EQ(serial.skipped, scan.skipped);
+		ATF_REQUIRE_EQ(serial.nmatches, scan.nmatches);
+		ATF_REQUIRE(memcmp(serial.matches, scan.matches,
+		    serial.nmatches * sizeof(size_t)) == 0);
+		bsm_scan_free(&scan);
+	}
+	bsm_scan_free(&serial);
+	free(trail);
+}
+
+
+ATF_TC_WITHOUT_HEAD(scan_ordered);
+ATF_TC_BODY(scan_ordered, tc)
+{
+	build_trail(0);
+	check_threads(0);
+}
+
+
+ATF_TC_WITHOUT_HEAD(scan_garbage);
+ATF_TC_BODY(scan_garbage, tc)
+{
+	build_trail(1);
+	check_threads(1);
+}
+
+
+ATF_TC_WITHOUT_HEAD(scan_empty);
+ATF_TC_BODY(scan_empty, tc)
+{
+	struct bsm_scan scan;
+
+	ATF_REQUIRE_EQ(0, bsm_scan(NULL, 0, 4, is_socket, NULL, &scan));
+	ATF_REQUIRE_EQ(0, scan.nrecords);
+	ATF_REQUIRE_EQ(0, scan.nmatches);
+	bsm_scan_free(&scan);
+}
+
+
+ATF_TC_WITHOUT_HEAD(bound_ordered);
+ATF_TC_BODY(bound_ordered, tc)
+{
+	build_trail(0);
+	check_bounds();
+}
+
+
+ATF_TC_WITHOUT_HEAD(bound_garbage);
+ATF_TC_BODY(bound_garbage, tc)
+{
+	build_trail(1);
+	check_bounds();
+}
+
+
+/*
+ * A record carrying another one in a text token, as when a trail is
+ * written to a file that is audited in turn, counts once
+ */
+ATF_TC_WITHOUT_HEAD(bound_nested);
+ATF_TC_BODY(bound_nested, tc)
+{
+	static const unsigned char header[] = {
+		0x14, 0x00, 0x00, 0x00, 0x3b, 0x0b, 0x00, 0x01, 0x00, 0x00,
+		0x5b, 0x1e, 0x4c, 0x85, 0x00, 0x00, 0x01, 0x7c, 0x28, 0x00,
+		0x1f
+	};
+	static const unsigned char trailer[] = {
+		0x13, 0xb1, 0x05, 0x00, 0x00, 0x00, 0x3b
+	};
+	struct bsm_scan scan;
+
+	trail = malloc(TRAIL_SIZE);
+	ATF_REQUIRE(trail != NULL);
+	memcpy(trail, shortrec, sizeof(shortrec));
+	traillen = sizeof(shortrec);
+	memcpy(trail + traillen, header, sizeof(header));
+	traillen += sizeof(header);
+	memcpy(trail + traillen, shortrec, sizeof(shortrec));
+	traillen += sizeof(shortrec);
+	memcpy(trail + traillen, trailer, sizeof(trailer));
+	traillen += sizeof(trailer);
+
+	ATF_REQUIRE_EQ(0, bsm_find_records(trail, traillen, 1, &scan));
+	ATF_REQUIRE_EQ(2, scan.nrecords);
+	ATF_REQUIRE_EQ(0, scan.skipped);
+	ATF_REQUIRE_EQ(0, scan.matches[0]);
+	ATF_REQUIRE_EQ(sizeof(shortrec), scan.matches[1]);
+	bsm_scan_free(&scan);
+	check_bounds();
+}
+
+
+ATF_TP_ADD_TCS(tp)
+{
+	ATF_TP_ADD_TC(tp, scan_ordered);
+	ATF_TP_ADD_TC(tp, scan_garbage);
+	ATF_TP_ADD_TC(tp, scan_empty);
+	ATF_TP_ADD_TC(tp, bound_ordered);
+	ATF_TP_ADD_TC(tp, bound_garbage);
+	ATF_TP_ADD_TC(tp, bound_nested);
+
+	return (atf_no_error());
+}
@@ -0,0 +1,351 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * bsmselect(1) filters the columnar export of a trail, written by
+ * bsmexport(1), on its event, subject, time, return status and path
+ * columns. Matching rows are printed as the tokens they were taken from,
+ * or only counted.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bsmcol.h"
+#include "bsmdec.h"
+#include "bsmfmt.h"
+
+#define AUDIT_EVENT_FILE	"/etc/security/audit_event"
+#define MAX_PREDS		8
+
+static const char *del = ",";
+static struct bsm_out out;
+static int flags;
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: bsmselect [-cl] [-r | -s] [-d del] "
+	    "[-e audit_event] [-E event]\n"
+	    "                 [-p pid] [-u auid] [-t from] [-T to] "
+	    "[-R status] [-P path] file\n");
+	exit(1);
+}
+
+/*
+ * Seconds since the Epoch, or local time as "YYYY-MM-DD HH:MM[:SS]"
+ */
+static uint64_t
+parse_time(const char *str)
+{
+	struct tm tm;
+	char *end;
+	uint64_t sec;
+	time_t t;
+
+	sec = strtoull(str, &end, 10);
+	if (*str != '\0' && *end == '\0')
+		return (sec);
+
+	memset(&tm, 0, sizeof(tm));
+	if (sscanf(str, "%d-%d-%d%*[ T]%d:%d:%d", &tm.tm_year, &tm.tm_mon,
+	    &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec) < 5)
+		errx(1, "%s: invalid time", str);
+	tm.tm_year -= 1900;
+	tm.tm_mon -= 1;
+	tm.tm_isdst = -1;
+	if ((t = mktime(&tm)) == -1)
+		errx(1, "%s: invalid time", str);
+	return ((uint64_t)t);
+}
+
+static uint64_t
+parse_id(const char *str)
+{
+	char *end;
+	unsigned long id;
+
+	id = strtoul(str, &end, 10);
+	if (*str == '\0' || *end != '\0' || id > UINT32_MAX)
+		errx(1, "%s: invalid ID", str);
+	return ((uint64_t)id);
+}
+
+/*
+ * "success", "failure" or a BSM error number, as a range of statuses
+ */
+static void
+parse_status(const char *str, struct bsm_col_pred *pred)
+{
+	char *end;
+	unsigned long error;
+
+	pred->col = BSM_COL_STATUS;
+	if (strcmp(str, "success") == 0) {
+		pred->lo = pred->hi = 0;
+		return;
+	}
+	if (strcmp(str, "failure") == 0) {
+		pred->lo = 1;
+		pred->hi = UINT8_MAX;
+		return;
+	}
+	error = strtoul(str, &end, 10);
+	if (*str == '\0' || *end != '\0' || error > UINT8_MAX)
+		errx(1, "%s: invalid status", str);
+	pred->lo = pred->hi = error;
+}
+
+static struct bsm_col_pred *
+add_pred(struct bsm_col_pred *preds, int *npreds, int col)
+{
+	struct bsm_col_pred *pred;
+
+	if (*npreds == MAX_PREDS)
+		errx(1, "too many conditions");
+	pred = &preds[(*npreds)++];
+	memset(pred, 0, sizeof(*pred));
+	pred->col = col;
+	return (pred);
+}
+
+static void
+print_token(const struct bsm_token *tok)
+{
+	bsm_print_token(&out, tok, del, flags);
+	if (flags & BSM_FMT_ONELINE)
+		bsm_out_puts(&out, del);
+	else
+		bsm_out_putc(&out, '\n');
+}
+
+/*
+ * Print row "r" of a block as the tokens its columns came from, in their
+ * usual order within a record
+ */
+static void
+print_row(const struct bsm_col *col, uint64_t *const *vals, size_t r)
+{
+	struct bsm_token tok;
+	const char *str;
+
+#define VAL(c)	vals[c][r]
+	memset(&tok, 0, sizeof(tok));
+	tok.id = BSM_HEADER32;
+	tok.tt.hdr.size = (uint32_t)VAL(BSM_COL_SIZE);
+	tok.tt.hdr.version = (uint8_t)VAL(BSM_COL_VERSION);
+	tok.tt.hdr.event = (uint16_t)VAL(BSM_COL_EVENT);
+	tok.tt.hdr.modifier = (uint16_t)VAL(BSM_COL_MODIFIER);
+	tok.tt.hdr.sec = VAL(BSM_COL_SEC);
+	tok.tt.hdr.msec = VAL(BSM_COL_MSEC);
+	print_token(&tok);
+
+	str = bsm_col_string(col, BSM_COL_DICT_PATH, VAL(BSM_COL_PATH));
+	if (VAL(BSM_COL_PATH) != 0 && str != NULL) {
+		memset(&tok, 0, sizeof(tok));
+		tok.id = BSM_PATH;
+		tok.tt.str.str = str;
+		tok.tt.str.len = strlen(str);
+		print_token(&tok);
+	}
+
+	if (VAL(BSM_COL_SUBJECT) != 0) {
+		memset(&tok, 0, sizeof(tok));
+		tok.id = (uint8_t)VAL(BSM_COL_SUBJECT);
+		tok.tt.subj.auid = (uint32_t)VAL(BSM_COL_AUID);
+		tok.tt.subj.euid = (uint32_t)VAL(BSM_COL_EUID);
+		tok.tt.subj.egid = (uint32_t)VAL(BSM_COL_EGID);
+		tok.tt.subj.ruid = (uint32_t)VAL(BSM_COL_RUID);
+		tok.tt.subj.rgid = (uint32_t)VAL(BSM_COL_RGID);
+		tok.tt.subj.pid = (uint32_t)VAL(BSM_COL_PID);
+		tok.tt.subj.sid = (uint32_t)VAL(BSM_COL_SID);
+		tok.tt.subj.port = VAL(BSM_COL_PORT);
+		tok.tt.subj.addr.type = BSM_IPV4;
+		str = bsm_col_string(col, BSM_COL_DICT_ADDR,
+		    VAL(BSM_COL_ADDR));
+		if (str != NULL && strchr(str, ':') != NULL &&
+		    inet_pton(AF_INET6, str, tok.tt.subj.addr.addr) == 1)
+			tok.tt.subj.addr.type = BSM_IPV6;
+		else if (str != NULL)
+			(void)inet_pton(AF_INET, str, tok.tt.subj.addr.addr);
+		print_token(&tok);
+	}
+
+	if (VAL(BSM_COL_RETURN) != 0) {
+		memset(&tok, 0, sizeof(tok));
+		tok.id = (uint8_t)VAL(BSM_COL_RETURN);
+		tok.tt.ret.status = (uint8_t)VAL(BSM_COL_STATUS);
+		tok.tt.ret.val = VAL(BSM_COL_RETVAL);
+		print_token(&tok);
+	}
+
+	memset(&tok, 0, sizeof(tok));
+	tok.id = BSM_TRAILER;
+	tok.tt.trail.magic = BSM_TRAILER_MAGIC;
+	tok.tt.trail.count = (uint32_t)VAL(BSM_COL_SIZE);
+	print_token(&tok);
+	if (flags & BSM_FMT_ONELINE)
+		bsm_out_putc(&out, '\n');
+#undef VAL
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *eventfile = AUDIT_EVENT_FILE, *event = NULL, *path = NULL;
+	struct bsm_col_pred preds[MAX_PREDS], *pred;
+	struct bsm_col col;
+	uint64_t *vals[BSM_COL_NCOLUMNS], *scratch, b, count = 0;
+	uint8_t *sel, *set = NULL;
+	size_t i, n;
+	int ch, c, e, npreds = 0, countonly = 0;
+
+	while ((ch = getopt(argc, argv, "cd:E:e:lP:p:R:rsT:t:u:")) != -1) {
+		switch (ch) {
+		case 'c':
+			countonly = 1;
+			break;
+		case 'd':
+			del = optarg;
+			break;
+		case 'E':
+			event = optarg;
+			break;
+		case 'e':
+			eventfile = optarg;
+			break;
+		case 'l':
+			flags |= BSM_FMT_ONELINE;
+			break;
+		case 'P':
+			path = optarg;
+			break;
+		case 'p':
+			pred = add_pred(preds, &npreds, BSM_COL_PID);
+			pred->lo = pred->hi = parse_id(optarg);
+			break;
+		case 'R':
+			parse_status(optarg, add_pred(preds, &npreds,
+			    BSM_COL_STATUS));
+			break;
+		case 'r':
+			if (flags & BSM_FMT_SHORT)
+				usage();
+			flags |= BSM_FMT_RAW;
+			break;
+		case 's':
+			if (flags & BSM_FMT_RAW)
+				usage();
+			flags |= BSM_FMT_SHORT;
+			break;
+		case 'T':
+			pred = add_pred(preds, &npreds, BSM_COL_SEC);
+			pred->lo = 0;
+			pred->hi = parse_time(optarg);
+			break;
+		case 't':
+			pred = add_pred(preds, &npreds, BSM_COL_SEC);
+			pred->lo = parse_time(optarg);
+			pred->hi = UINT64_MAX;
+			break;
+		case 'u':
+			pred = add_pred(preds, &npreds, BSM_COL_AUID);
+			pred->lo = pred->hi = parse_id(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 1)
+		usage();
+
+	(void)bsm_load_events(eventfile);
+	if (event != NULL) {
+		if ((e = bsm_event_number(event)) == -1)
+			errx(1, "%s: unknown event", event);
+		pred = add_pred(preds, &npreds, BSM_COL_EVENT);
+		pred->lo = pred->hi = (uint64_t)e;
+	}
+
+	if (bsm_col_open(&col, argv[0]) == -1)
+		err(1, "%s", argv[0]);
+	if (path != NULL) {
+		pred = add_pred(preds, &npreds, BSM_COL_PATH);
+		if ((set = bsm_col_match(&col, BSM_COL_DICT_PATH, path,
+		    pred)) == NULL)
+			err(1, "malloc");
+	}
+
+	if ((sel = malloc(col.block)) == NULL ||
+	    (scratch = malloc(col.block * sizeof(*scratch))) == NULL)
+		err(1, "malloc");
+	for (c = 0; c < BSM_COL_NCOLUMNS; c++) {
+		vals[c] = NULL;
+		if (!countonly &&
+		    (vals[c] = malloc(col.block * sizeof(**vals))) == NULL)
+			err(1, "malloc");
+	}
+
+	bsm_out_init(&out, STDOUT_FILENO);
+	for (b = 0; b < col.nblocks; b++) {
+		n = bsm_col_select(&col, b, preds, npreds, sel, scratch);
+		count += n;
+		if (n == 0 || countonly)
+			continue;
+		for (c = 0; c < BSM_COL_NCOLUMNS; c++)
+			bsm_col_decode(&col, b, c, vals[c]);
+		for (i = 0; i < bsm_col_rows(&col, b); i++) {
+			if (sel[i])
+				print_row(&col, vals, i);
+		}
+	}
+	if (countonly)
+		bsm_out_printf(&out, "%llu\n", (unsigned long long)count);
+	if (bsm_out_flush(&out) == -1)
+		err(1, "stdout");
+
+	bsm_out_free(&out);
+	for (c = 0; c < BSM_COL_NCOLUMNS; c++)
+		free(vals[c]);
+	free(scratch);
+	free(sel);
+	free(set);
+	bsm_col_close(&col);
+	return (0);
+}
@@ -0,0 +1,145 @@
+#
+# Copyright (c) 2018 Aniket Pandey
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+# OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+# HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+# OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE.
+#
+# $FreeBSD$
+#
+
+setup_export()
+{
+	export TZ=UTC
+	bsmexport="$(atf_get_srcdir)/bsmexport"
+	bsmselect="$(atf_get_srcdir)/bsmselect -e $(atf_get_srcdir)/input/audit_event"
+	input=$(atf_get_srcdir)/../praudit/input
+	group=$(awk -F: '$3 == 0 { print $1; exit }' /etc/group)
+}
+
+# A synthetic trail cut into several blocks, and the tools to check the
+# export's answers against
+setup_synthetic()
+{
+	setup_export
+	events="$(atf_get_srcdir)/input/audit_event"
+	atf_check $(atf_get_srcdir)/bsmgen -s 5 -n 20000 -r 50 trail
+	atf_check ${bsmexport} -b 1000 trail
+	atf_check $(atf_get_srcdir)/bsmindex trail
+}
+
+
+atf_test_case bsmselect_round_trip
+bsmselect_round_trip_head()
+{
+	atf_set "descr" "Verify that the header, subject and return fields " \
+			"of praudit's golden trail survive the export"
+}
+
+bsmselect_round_trip_body()
+{
+	setup_export
+	cp ${input}/trail trail
+	atf_check ${bsmexport} trail
+
+	# Argument tokens are not exported, everything else is
+	grep -v '^argument' ${input}/no_args | sed "s/wheel/${group}/" > no_args
+	sed -e 's/argument,[^,]*,[^,]*,[^,]*,//g' -e "s/wheel/${group}/" \
+		${input}/same_line > same_line
+	atf_check -o file:no_args ${bsmselect} trail.col
+	atf_check -o file:same_line ${bsmselect} -l trail.col
+}
+
+
+atf_test_case bsmselect_count
+bsmselect_count_head()
+{
+	atf_set "descr" "Verify that filtering the columns finds the records " \
+			"that decoding the trail does"
+}
+
+bsmselect_count_body()
+{
+	setup_synthetic
+	atf_check -o inline:"20000\n" ${bsmselect} -c trail.col
+
+	# bsmstat(1) counts successful and failed records of an event
+	$(atf_get_srcdir)/bsmstat -e ${events} trail 72 > stat
+	atf_check -o inline:"$(awk '{ print $2 }' stat)\n" \
+		${bsmselect} -c -E 72 -R success trail.col
+	atf_check -o inline:"$(awk '{ print $3 }' stat)\n" \
+		${bsmselect} -c -E AUE_OPEN_R -R failure trail.col
+
+	# The first path of a record
+	n=$($(atf_get_srcdir)/bsmcat -r -e ${events} trail | grep -c '^35,/etc/')
+	atf_check -o inline:"${n}\n" ${bsmselect} -c -P '/etc/*' trail.col
+	atf_check -o inline:"0\n" ${bsmselect} -c -P /nonexistent trail.col
+}
+
+
+atf_test_case bsmselect_query
+bsmselect_query_head()
+{
+	atf_set "descr" "Verify that rows selected by pid and time window " \
+			"are those bsmquery prints"
+}
+
+bsmselect_query_body()
+{
+	setup_synthetic
+	bsmquery="$(atf_get_srcdir)/bsmquery -rl -e ${events}"
+	pid=$(${bsmselect} -rl trail.col | awk -F, 'NR == 77 { print $16 }')
+
+	# Compare headers, return and trailer, the tokens every record has
+	fields='{ print $1,$2,$3,$4,$5,$6,$7,$(NF-5),$(NF-4),$(NF-3),$(NF-2) }'
+	${bsmquery} -p ${pid} trail | awk -F, "${fields}" > expect
+	${bsmselect} -rl -p ${pid} trail.col | awk -F, "${fields}" > rows
+	atf_check -o match:"^ *30 " wc -l expect
+	atf_check cmp expect rows
+
+	${bsmquery} -t 1528706500 -T 1528706600 trail | wc -l > expect
+	atf_check -o match:"^ *$(cat expect)\$" \
+		${bsmselect} -c -t 1528706500 -T 1528706600 trail.col
+}
+
+
+atf_test_case bsmselect_corrupt
+bsmselect_corrupt_head()
+{
+	atf_set "descr" "Verify that a truncated export is rejected"
+}
+
+bsmselect_corrupt_body()
+{
+	setup_export
+	cp ${input}/trail trail
+	atf_check ${bsmexport} trail
+	head -c 100 trail.col > short.col
+	atf_check -s exit:1 -e match:"short.col" ${bsmselect} -c short.col
+}
+
+
+atf_init_test_cases()
+{
+	atf_add_test_case bsmselect_round_trip
+	atf_add_test_case bsmselect_count
+	atf_add_test_case bsmselect_query
+	atf_add_test_case bsmselect_corrupt
+}
@@ -0,0 +1,250 @@
+/*-
+ * Copyright (c) 2018 Aniket Pandey
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * bsmstat(1) counts the successful and failed records of each of the given
+ * events in a trail, in a single pass over the memory-mapped file spread
+ * across all CPUs. It replaces running praudit(1) and grep(1) once per
+ * system call.
+ */
+
+#include <err.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bsmdec.h"
+#include "bsmfmt.h"
+#include "bsmmap.h"
+#include "bsmscan.h"
+
+#define AUDIT_EVENT_FILE	"/etc/security/audit_event"
+#define MAX_EVENTS		64
+
+struct event_count {
+	const char	*name;
+	unsigned long	 success;
+	unsigned long	 failure;
+};
+
+static struct event_count counts[MAX_EVENTS];
+static int ncounts;
+
+/*
+ * Which of the requested events each event number matches. It is filled
+ * in before the scan starts, since the scanning threads share it.
+ */
+static uint64_t eventmask[UINT16_MAX + 1];
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: bsmstat [-p] [-e audit_event] [-j threads] "
+	    "[-s success_path]\n"
+	    "               [-f failure_path] trail event ...\n");
+	exit(1);
+}
+
+/*
+ * Requested events match like grep(1) on praudit(1) output: "open(2)"
+ * matches every "open(2) - ..." variant. Short AUE_* names and plain
+ * numbers are accepted as well.
+ */
+static uint64_t
+match_events(uint16_t event)
+{
+	const char *desc, *name;
+	char number[8];
+	uint64_t mask = 0;
+	int i;
+
+	desc = bsm_event_name(event, 0);
+	name = bsm_event_name(event, BSM_FMT_SHORT);
+	snprintf(number, sizeof(number), "%u", event);
+	for (i = 0; i < ncounts; i++) {
+		if ((desc != NULL && strstr(desc, counts[i].name) != NULL) ||
+		    (name != NULL && strcmp(name, counts[i].name) == 0) ||
+		    strcmp(number, counts[i].name) == 0)
+			mask |= (uint64_t)1 << i;
+	}
+	return (mask);
+}
+
+/*
+ * Scan predicate: whether the record is one of the requested events
+ */
+static int
+wanted_record(struct bsm_cursor *rec, void *arg)
+{
+	struct bsm_token tok;
+
+	(void)arg;
+	return (bsm_next_token(rec, &tok) == BSM_OK &&
+	    bsm_is_header(tok.id) && eventmask[tok.tt.hdr.event] != 0);
+}
+
+/*
+ * Whether a path token of the record contains "path"; always true without
+ * a path to look for
+ */
+static int
+has_path(const struct bsm_token *tok, const char *path)
+{
+	const struct bsm_string *s = &tok->tt.str;
+	size_t len, off;
+
+	if (path == NULL)
+		return (1);
+	if (tok->id != BSM_PATH)
+		return (0);
+
+	/* Paths in the trail are not NUL-terminated, strstr(3) won't do */
+	len = strlen(path);
+	for (off = 0; off + len <= s->len; off++) {
+		if (memcmp(s->str + off, path, len) == 0)
+			return (1);
+	}
+	return (0);
+}
+
+static void
+count_record(struct bsm_cursor *rec, const char *okpath, const char *failpath)
+{
+	struct bsm_token tok;
+	uint64_t mask = 0;
+	int okfound = 0, failfound = 0, status = -1, i;
+
+	while (bsm_next_token(rec, &tok) == BSM_OK) {
+		switch (tok.id) {
+		case BSM_HEADER32:
+		case BSM_HEADER32_EX:
+		case BSM_HEADER64:
+		case BSM_HEADER64_EX:
+			mask = eventmask[tok.tt.hdr.event];
+			break;
+		case BSM_RETURN32:
+		case BSM_RETURN64:
+			status = tok.tt.ret.status;
+			break;
+		}
+		okfound |= has_path(&tok, okpath);
+		failfound |= has_path(&tok, failpath);
+	}
+
+	for (i = 0; i < ncounts; i++) {
+		if (!(mask & ((uint64_t)1 << i)))
+			continue;
+		if (status == 0 && okfound)
+			counts[i].success++;
+		else if (status > 0 && failfound)
+			counts[i].failure++;
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *eventfile = AUDIT_EVENT_FILE;
+	const char *okpath = NULL, *failpath = NULL;
+	struct bsm_map map;
+	struct bsm_scan scan;
+	struct bsm_cursor rec;
+	size_t i, off;
+	long nthreads;
+	int ch, error, n, resync = 0;
+
+	if ((nthreads = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+		nthreads = 1;
+
+	while ((ch = getopt(argc, argv, "e:f:j:ps:")) != -1) {
+		switch (ch) {
+		case 'e':
+			eventfile = optarg;
+			break;
+		case 'f':
+			failpath = optarg;
+			break;
+		case 'j':
+			nthreads = strtol(optarg, NULL, 10);
+			if (nthreads < 1 || nthreads > 1024)
+				usage();
+			break;
+		case 'p':
+			resync = 1;
+			break;
+		case 's':
+			okpath = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc < 2)
+		usage();
+	if (argc - 1 > MAX_EVENTS)
+		errx(1, "at most %d events can be counted", MAX_EVENTS);
+
+	for (ncounts = 0; ncounts < argc - 1; ncounts++)
+		counts[ncounts].name = argv[ncounts + 1];
+
+	/* Without the database only event numbers can be matched */
+	(void)bsm_load_events(eventfile);
+	for (i = 0; i <= UINT16_MAX; i++)
+		eventmask[i] = match_events((uint16_t)i);
+
+	if (bsm_map_open(&map, argv[0]) == -1)
+		err(1, "%s", argv[0]);
+	error = bsm_scan(map.base, map.len, (int)nthreads, wanted_record, NULL,
+	    &scan);
+	if (error != 0) {
+		errno = error;
+		err(1, "%s", argv[0]);
+	}
+	if (scan.skipped > 0 && !resync)
+		errx(1, "%s: corrupted records, %zu bytes skipped with -p",
+		    argv[0], scan.skipped);
+
+	/* Only the wanted records are decoded in full */
+	for (i = 0; i < scan.nmatches; i++) {
+		off = scan.matches[i];
+		bsm_cursor_init(&rec, map.base + off,
+		    bsm_record_len(map.base + off, map.len - off));
+		count_record(&rec, okpath, failpath);
+	}
+
+	for (n = 0; n < ncounts; n++)
+		printf("%s %lu %lu\n", counts[n].name, counts[n].success,
+		    counts[n].failure);
+
+	bsm_scan_free(&scan);
+	bsm_map_close(&map);
+	return (0);
+}
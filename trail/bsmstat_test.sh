@@ -0,0 +1,122 @@
+#
+# Copyright (c) 2018 Aniket Pandey
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+# OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+# HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+# OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE.
+#
+# $FreeBSD$
+#
+
+setup_trail()
+{
+	bsmstat="$(atf_get_srcdir)/bsmstat -e $(atf_get_srcdir)/input/audit_event"
+	input=$(atf_get_srcdir)/../praudit/input
+}
+
+
+atf_test_case bsmstat_count
+bsmstat_count_head()
+{
+	atf_set "descr" "Verify that each requested event is counted once " \
+			"per record, by description, name or number"
+}
+
+bsmstat_count_body()
+{
+	setup_trail
+	cat ${input}/trail ${input}/trail ${input}/trail > trail
+	atf_check -o inline:"socket(2) 3 0\nAUE_SOCKET 3 0\n183 3 0\n" \
+		${bsmstat} trail "socket(2)" AUE_SOCKET 183
+}
+
+
+atf_test_case bsmstat_prefix
+bsmstat_prefix_head()
+{
+	atf_set "descr" "Verify that events are matched like grep(1) on " \
+			"the event description"
+}
+
+bsmstat_prefix_body()
+{
+	setup_trail
+	atf_check -o inline:"socket 1 0\nopen(2) 0 0\n" \
+		${bsmstat} ${input}/trail socket "open(2)"
+}
+
+
+atf_test_case bsmstat_path_filter
+bsmstat_path_filter_head()
+{
+	atf_set "descr" "Verify that -s and -f only count records with a " \
+			"matching path token"
+}
+
+bsmstat_path_filter_body()
+{
+	setup_trail
+	# The socket(2) record has no path token at all
+	atf_check -o inline:"socket(2) 0 0\n" \
+		${bsmstat} -s templog ${input}/trail "socket(2)"
+	atf_check -o inline:"socket(2) 1 0\n" \
+		${bsmstat} -f ERROR ${input}/trail "socket(2)"
+}
+
+
+atf_test_case bsmstat_corrupted
+bsmstat_corrupted_head()
+{
+	atf_set "descr" "Verify that a corrupted trail is an error unless " \
+			"-p skips to the next valid record"
+}
+
+bsmstat_corrupted_body()
+{
+	setup_trail
+	atf_check -s exit:1 -e match:"corrupted record" \
+		${bsmstat} ${input}/corrupted "socket(2)"
+	atf_check -o inline:"socket(2) 1 0\n" \
+		${bsmstat} -p ${input}/corrupted "socket(2)"
+}
+
+
+atf_test_case bsmstat_empty
+bsmstat_empty_head()
+{
+	atf_set "descr" "Verify that an empty trail counts nothing"
+}
+
+bsmstat_empty_body()
+{
+	setup_trail
+	touch trail
+	atf_check -o inline:"socket(2) 0 0\n" ${bsmstat} trail "socket(2)"
+}
+
+
+atf_init_test_cases()
+{
+	atf_add_test_case bsmstat_count
+	atf_add_test_case bsmstat_prefix
+	atf_add_test_case bsmstat_path_filter
+	atf_add_test_case bsmstat_corrupted
+	atf_add_test_case bsmstat_empty
+}